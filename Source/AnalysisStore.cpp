@@ -0,0 +1,642 @@
+#include "AnalysisStore.h"
+#include <cstring>
+
+namespace
+{
+    constexpr uint32 makeTag(char a, char b, char c, char d) noexcept
+    {
+        return static_cast<uint32>(static_cast<uint8>(a)) | (static_cast<uint32>(static_cast<uint8>(b)) << 8)
+            | (static_cast<uint32>(static_cast<uint8>(c)) << 16) | (static_cast<uint32>(static_cast<uint8>(d)) << 24);
+    }
+
+    // Values are written in the machine's byte order; a store from a machine with the
+    // other order fails the magic check and is rebuilt
+    constexpr uint32 fileMagic = makeTag('O', 'T', 'A', 'S');
+    constexpr uint32 recordMagic = makeTag('R', 'E', 'C', 'D');
+
+    // Section tags
+    constexpr uint32 pathTag = makeTag('P', 'A', 'T', 'H');
+    constexpr uint32 analysisTag = makeTag('A', 'N', 'L', 'Y');
+    constexpr uint32 waveformTag = makeTag('W', 'A', 'V', 'E');
+    constexpr uint32 frameIndexTag = makeTag('M', 'P', '3', 'I');
+
+    // Bytes hashed from each end of a file to identify its contents
+    constexpr int keySampleBytes = 65536;
+
+    // The store compacts itself on opening once dead records take up more than this
+    // and more than the live ones
+    constexpr int64 compactionThreshold = 1 << 20;
+
+    // The file grows by at least this much, or an eighth of its size, when it runs out of
+    // room for a record
+    constexpr int64 minGrowthBytes = 1 << 20;
+
+    struct FileHeader
+    {
+        uint32 magic;
+        uint32 version;
+        uint64 reserved;
+    };
+
+    // Rounds a size up to the 8 byte alignment of records and sections
+    inline uint32 padded(size_t size) noexcept
+    {
+        return static_cast<uint32>((size + 7) & ~static_cast<size_t>(7));
+    }
+
+    // 64 bit FNV-1a
+    inline uint64 hashBytes(uint64 hash, const void* data, size_t size) noexcept
+    {
+        const auto* bytes = static_cast<const uint8*>(data);
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+        return hash;
+    }
+
+    inline uint32 checksum(const void* data, size_t size) noexcept
+    {
+        const auto hash = hashBytes(0xcbf29ce484222325ull, data, size);
+        return static_cast<uint32>(hash ^ (hash >> 32));
+    }
+
+    inline int64 getModificationTime(const File& file)
+    {
+        return file.getLastModificationTime().toMilliseconds();
+    }
+
+    MemoryBlock encodeAnalysis(const TrackAnalysis& analysis)
+    {
+        MemoryOutputStream out;
+        out.writeDouble(analysis.beatGrid.bpm);
+        out.writeDouble(analysis.beatGrid.firstBeatSeconds);
+        out.writeDouble(analysis.beatGrid.firstDownbeatSeconds);
+        out.writeFloat(analysis.beatGrid.confidence);
+        out.writeFloat(analysis.loudnessLufs);
+        out.writeFloat(analysis.peak);
+        out.writeInt(analysis.key);
+        out.writeFloat(analysis.keyConfidence);
+        out.writeDouble(analysis.lengthSeconds);
+        return out.getMemoryBlock();
+    }
+
+    // Sections written before the length was added are 8 bytes shorter
+    constexpr uint32 analysisSizeWithoutLength = 44;
+    constexpr uint32 analysisSize = 52;
+
+    bool decodeAnalysis(const void* data, uint32 size, TrackAnalysis& result)
+    {
+        if (data == nullptr || (size != analysisSize && size != analysisSizeWithoutLength))
+            return false;
+
+        MemoryInputStream in(data, size, false);
+        result.beatGrid.bpm = in.readDouble();
+        result.beatGrid.firstBeatSeconds = in.readDouble();
+        result.beatGrid.firstDownbeatSeconds = in.readDouble();
+        result.beatGrid.confidence = in.readFloat();
+        result.loudnessLufs = in.readFloat();
+        result.peak = in.readFloat();
+        result.key = in.readInt();
+        result.keyConfidence = in.readFloat();
+        result.lengthSeconds = size == analysisSize ? in.readDouble() : 0.0;
+        return true;
+    }
+}
+
+//------------------------------------------------------------------------------
+AnalysisStore::AnalysisStore(const File& storeFile)
+    : file(storeFile)
+{
+    const ScopedLock sl(lock);
+    open();
+}
+
+AnalysisStore::~AnalysisStore()
+{
+}
+
+File AnalysisStore::getDefaultFile()
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory)
+        .getChildFile("OtoDecks")
+        .getChildFile("AnalysisStore.bin");
+}
+
+uint64 AnalysisStore::computeKey(const File& fileToHash)
+{
+    FileInputStream in(fileToHash);
+    if (!in.openedOk())
+        return 0;
+
+    const int64 size = in.getTotalLength();
+    const int64 modified = getModificationTime(fileToHash);
+
+    uint64 hash = 0xcbf29ce484222325ull;
+    hash = hashBytes(hash, &size, sizeof(size));
+    hash = hashBytes(hash, &modified, sizeof(modified));
+
+    // The ends of a file tell versions apart without reading the whole track
+    HeapBlock<char> buffer(keySampleBytes);
+    auto hashFrom = [&](int64 start)
+    {
+        in.setPosition(start);
+        const int numRead = in.read(buffer, keySampleBytes);
+        if (numRead > 0)
+            hash = hashBytes(hash, buffer, static_cast<size_t>(numRead));
+    };
+
+    hashFrom(0);
+    if (size > keySampleBytes)
+        hashFrom(jmax(static_cast<int64>(keySampleBytes), size - keySampleBytes));
+
+    // 0 means no key
+    return hash != 0 ? hash : 1;
+}
+
+uint64 AnalysisStore::getKey(const File& fileToFind)
+{
+    {
+        const ScopedLock sl(lock);
+        Location location;
+        if (findPath(fileToFind, location))
+            return readHeader(location).key;
+    }
+
+    return computeKey(fileToFind);
+}
+
+uint64 AnalysisStore::findKey(const File& fileToFind)
+{
+    const ScopedLock sl(lock);
+    Location location;
+    return findPath(fileToFind, location) ? readHeader(location).key : 0;
+}
+
+bool AnalysisStore::findAnalysis(const File& fileToFind, TrackAnalysis& result)
+{
+    const ScopedLock sl(lock);
+    Location location;
+    if (!findPath(fileToFind, location))
+        return false;
+
+    uint32 size = 0;
+    const void* data = findSection(location, analysisTag, size);
+    return decodeAnalysis(data, size, result);
+}
+
+bool AnalysisStore::findAnalysis(uint64 key, TrackAnalysis& result)
+{
+    const ScopedLock sl(lock);
+    const auto found = keyIndex.find(key);
+    if (found == keyIndex.end() || !ensureMapped())
+        return false;
+
+    uint32 size = 0;
+    const void* data = findSection(found->second, analysisTag, size);
+    return decodeAnalysis(data, size, result);
+}
+
+void AnalysisStore::storeAnalysis(const File& analysedFile, uint64 key, const TrackAnalysis& analysis)
+{
+    if (key == 0)
+        return;
+
+    const ScopedLock sl(lock);
+    if (!ensureMapped())
+        return;
+
+    const auto path = analysedFile.getFullPathName();
+    const auto pathData = path.toUTF8();
+    const MemoryBlock pathBlock(pathData.getAddress(), pathData.sizeInBytes() - 1);
+    const auto analysisBlock = encodeAnalysis(analysis);
+
+    // Keep the other sections of the record already held for these contents
+    Sections sections;
+    const auto existing = keyIndex.find(key);
+    if (existing != keyIndex.end())
+    {
+        sections = readSections(existing->second);
+        if (sections[pathTag] == pathBlock && sections[analysisTag] == analysisBlock
+            && readHeader(existing->second).pathHash != 0)
+            return;
+    }
+
+    // A record for the file's earlier contents is out of date
+    const auto pathHash = static_cast<uint64>(path.hashCode64());
+    const auto oldPath = pathIndex.find(pathHash);
+    if (oldPath != pathIndex.end() && readHeader(oldPath->second).key != key)
+        removePath(pathHash);
+
+    sections[pathTag] = pathBlock;
+    sections[analysisTag] = analysisBlock;
+
+    RecordHeader header {};
+    header.key = key;
+    header.pathHash = pathHash;
+    header.fileSize = analysedFile.getSize();
+    header.modificationTime = getModificationTime(analysedFile);
+    appendRecord(header, sections);
+}
+
+bool AnalysisStore::findWaveform(uint64 key, PeakPyramid& result)
+{
+    const ScopedLock sl(lock);
+    const auto found = keyIndex.find(key);
+    if (found == keyIndex.end() || !ensureMapped())
+        return false;
+
+    uint32 size = 0;
+    const void* data = findSection(found->second, waveformTag, size);
+    return data != nullptr && result.loadFrom(data, size);
+}
+
+void AnalysisStore::storeWaveform(uint64 key, const PeakPyramid& waveform)
+{
+    MemoryOutputStream out;
+    waveform.writeTo(out);
+    storeSection(key, waveformTag, out.getMemoryBlock());
+}
+
+bool AnalysisStore::findFrameIndex(uint64 key, Mp3FrameIndex& result)
+{
+    const ScopedLock sl(lock);
+    const auto found = keyIndex.find(key);
+    if (found == keyIndex.end() || !ensureMapped())
+        return false;
+
+    uint32 size = 0;
+    const void* data = findSection(found->second, frameIndexTag, size);
+    return data != nullptr && result.loadFrom(data, size);
+}
+
+void AnalysisStore::storeFrameIndex(uint64 key, const Mp3FrameIndex& index)
+{
+    MemoryOutputStream out;
+    index.writeTo(out);
+    storeSection(key, frameIndexTag, out.getMemoryBlock());
+}
+
+void AnalysisStore::storeSection(uint64 key, uint32 tag, const MemoryBlock& data)
+{
+    if (key == 0)
+        return;
+
+    const ScopedLock sl(lock);
+    if (!ensureMapped())
+        return;
+
+    // Add the section to the record already held for these contents, if any
+    RecordHeader header {};
+    header.key = key;
+
+    Sections sections;
+    const auto existing = keyIndex.find(key);
+    if (existing != keyIndex.end())
+    {
+        sections = readSections(existing->second);
+        if (sections[tag] == data)
+            return;
+
+        const auto old = readHeader(existing->second);
+        header.pathHash = old.pathHash;
+        header.fileSize = old.fileSize;
+        header.modificationTime = old.modificationTime;
+    }
+
+    sections[tag] = data;
+    appendRecord(header, sections);
+}
+
+void AnalysisStore::compact()
+{
+    const ScopedLock sl(lock);
+    if (!ensureMapped())
+        return;
+
+    // Live records in file order
+    const auto live = getLiveRecords();
+
+    const auto temp = file.getSiblingFile(file.getFileName() + ".tmp");
+    temp.deleteFile();
+
+    {
+        FileOutputStream out(temp);
+        if (out.failedToOpen())
+            return;
+
+        const FileHeader fileHeader { fileMagic, formatVersion, 0 };
+        out.write(&fileHeader, sizeof(fileHeader));
+
+        const auto* data = static_cast<const char*>(mappedFile->getData());
+        for (const auto& record : live)
+            out.write(data + record.first, record.second);
+
+        out.flush();
+        if (out.getStatus().failed())
+        {
+            temp.deleteFile();
+            return;
+        }
+    }
+
+    // The file can't be replaced while it is mapped
+    mappedFile.reset();
+    if (temp.moveFileTo(file))
+        open();
+    else
+        temp.deleteFile();
+}
+
+int AnalysisStore::getNumEntries() const
+{
+    const ScopedLock sl(lock);
+    return static_cast<int>(getLiveRecords().size());
+}
+
+int64 AnalysisStore::getFileSize() const
+{
+    const ScopedLock sl(lock);
+    return endOfData;
+}
+
+int64 AnalysisStore::getDeadBytes() const
+{
+    const ScopedLock sl(lock);
+    int64 liveBytes = 0;
+    for (const auto& record : getLiveRecords())
+        liveBytes += record.second;
+
+    return jmax(static_cast<int64>(0), endOfData - static_cast<int64>(sizeof(FileHeader)) - liveBytes);
+}
+
+//------------------------------------------------------------------------------
+void AnalysisStore::open()
+{
+    keyIndex.clear();
+    pathIndex.clear();
+    mappedFile.reset();
+    endOfData = 0;
+
+    if (!file.existsAsFile())
+    {
+        createEmpty();
+        return;
+    }
+
+    mappedFile = std::make_unique<MemoryMappedFile>(file, MemoryMappedFile::readWrite);
+    const auto* data = static_cast<const char*>(mappedFile->getData());
+    const auto size = static_cast<int64>(mappedFile->getSize());
+
+    FileHeader fileHeader {};
+    if (data != nullptr && size >= static_cast<int64>(sizeof(fileHeader)))
+        std::memcpy(&fileHeader, data, sizeof(fileHeader));
+
+    if (fileHeader.magic != fileMagic || fileHeader.version != formatVersion)
+    {
+        std::cout << "AnalysisStore: rebuilding " << file.getFullPathName() << std::endl;
+        createEmpty();
+        return;
+    }
+
+    // Index every complete record; a later record for the same key or path wins
+    int64 offset = sizeof(FileHeader);
+    endOfData = offset;
+    while (offset + static_cast<int64>(sizeof(RecordHeader)) <= size)
+    {
+        RecordHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+
+        if (header.magic != recordMagic || header.size < sizeof(RecordHeader) || header.size % 8 != 0
+            || offset + header.size > size
+            || checksum(data + offset + sizeof(header), header.size - sizeof(header)) != header.checksum)
+            break;
+
+        indexRecord(header, { offset, header.size });
+        offset += header.size;
+        endOfData = offset;
+    }
+
+    // Cut off a record that was only partly written, and the room left for more
+    if (endOfData < size)
+    {
+        mappedFile.reset();
+        FileOutputStream out(file);
+        if (out.openedOk())
+        {
+            out.setPosition(endOfData);
+            out.truncate();
+        }
+    }
+
+    const auto deadBytes = getDeadBytes();
+    if (deadBytes > compactionThreshold && deadBytes > endOfData - deadBytes)
+        compact();
+}
+
+void AnalysisStore::createEmpty()
+{
+    keyIndex.clear();
+    pathIndex.clear();
+    mappedFile.reset();
+    endOfData = 0;
+
+    file.deleteFile();
+    file.getParentDirectory().createDirectory();
+
+    FileOutputStream out(file);
+    if (out.failedToOpen())
+    {
+        std::cout << "AnalysisStore: can't write " << file.getFullPathName() << std::endl;
+        return;
+    }
+
+    const FileHeader fileHeader { fileMagic, formatVersion, 0 };
+    out.write(&fileHeader, sizeof(fileHeader));
+    out.flush();
+
+    if (out.getStatus().wasOk())
+        endOfData = sizeof(fileHeader);
+}
+
+bool AnalysisStore::ensureMapped()
+{
+    if (endOfData == 0)
+        return false;
+
+    if (mappedFile == nullptr)
+        mappedFile = std::make_unique<MemoryMappedFile>(file, MemoryMappedFile::readWrite);
+
+    return mappedFile->getData() != nullptr && static_cast<int64>(mappedFile->getSize()) >= endOfData;
+}
+
+bool AnalysisStore::ensureCapacity(int64 end)
+{
+    if (ensureMapped() && static_cast<int64>(mappedFile->getSize()) >= end)
+        return true;
+
+    // The file can't be extended while it is mapped on some platforms
+    mappedFile.reset();
+
+    const int64 capacity = end + jmax(minGrowthBytes, end / 8);
+    {
+        FileOutputStream out(file);
+        if (!out.openedOk() || out.getPosition() > capacity)
+            return false;
+
+        out.writeRepeatedByte(0, static_cast<size_t>(capacity - out.getPosition()));
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return ensureMapped() && static_cast<int64>(mappedFile->getSize()) >= end;
+}
+
+AnalysisStore::RecordHeader AnalysisStore::readHeader(const Location& location) const
+{
+    RecordHeader header;
+    std::memcpy(&header, static_cast<const char*>(mappedFile->getData()) + location.offset, sizeof(header));
+    return header;
+}
+
+const void* AnalysisStore::findSection(const Location& location, uint32 tag, uint32& size)
+{
+    const auto* record = static_cast<const char*>(mappedFile->getData()) + location.offset;
+    const auto* section = record + sizeof(RecordHeader);
+    const auto* end = record + location.size;
+    const auto numSections = readHeader(location).numSections;
+
+    for (uint32 i = 0; i < numSections && section + 8 <= end; ++i)
+    {
+        uint32 sectionTag, sectionSize;
+        std::memcpy(&sectionTag, section, 4);
+        std::memcpy(&sectionSize, section + 4, 4);
+
+        if (section + 8 + sectionSize > end)
+            break;
+
+        if (sectionTag == tag)
+        {
+            size = sectionSize;
+            return section + 8;
+        }
+
+        section += 8 + padded(sectionSize);
+    }
+
+    return nullptr;
+}
+
+AnalysisStore::Sections AnalysisStore::readSections(const Location& location)
+{
+    Sections sections;
+    for (const auto tag : { pathTag, analysisTag, waveformTag, frameIndexTag })
+    {
+        uint32 size = 0;
+        if (const void* data = findSection(location, tag, size))
+            sections[tag] = MemoryBlock(data, size);
+    }
+
+    return sections;
+}
+
+void AnalysisStore::appendRecord(const RecordHeader& headerToWrite, const Sections& sections)
+{
+    if (endOfData == 0)
+        return;
+
+    MemoryOutputStream body;
+    for (const auto& section : sections)
+    {
+        const auto size = static_cast<uint32>(section.second.getSize());
+        body.write(&section.first, 4);
+        body.write(&size, 4);
+        body.write(section.second.getData(), size);
+        body.writeRepeatedByte(0, padded(size) - size);
+    }
+
+    auto header = headerToWrite;
+    header.magic = recordMagic;
+    header.size = static_cast<uint32>(sizeof(RecordHeader) + body.getDataSize());
+    header.numSections = static_cast<uint32>(sections.size());
+    header.checksum = checksum(body.getData(), body.getDataSize());
+
+    if (!ensureCapacity(endOfData + header.size))
+    {
+        open();
+        return;
+    }
+
+    // Index first: dropping a path reads the record it pointed to, which needs the map
+    const Location location { endOfData, header.size };
+    indexRecord(header, location);
+
+    // The body goes in before the header, so a record cut short never looks complete
+    auto* data = static_cast<char*>(mappedFile->getData()) + endOfData;
+    std::memcpy(data + sizeof(header), body.getData(), body.getDataSize());
+    std::memcpy(data, &header, sizeof(header));
+    endOfData += header.size;
+}
+
+void AnalysisStore::indexRecord(const RecordHeader& header, const Location& location)
+{
+    if (header.key == 0)
+    {
+        removePath(header.pathHash);
+        return;
+    }
+
+    keyIndex[header.key] = location;
+    if (header.pathHash != 0)
+        pathIndex[header.pathHash] = location;
+}
+
+void AnalysisStore::removePath(uint64 pathHash)
+{
+    const auto found = pathIndex.find(pathHash);
+    if (found == pathIndex.end())
+        return;
+
+    // The contents it was stored under are gone too, unless a newer record holds them
+    const auto old = found->second;
+    pathIndex.erase(found);
+
+    const auto key = keyIndex.find(readHeader(old).key);
+    if (key != keyIndex.end() && key->second.offset == old.offset)
+        keyIndex.erase(key);
+}
+
+bool AnalysisStore::findPath(const File& fileToFind, Location& location)
+{
+    const auto pathHash = static_cast<uint64>(fileToFind.getFullPathName().hashCode64());
+    const auto found = pathIndex.find(pathHash);
+    if (found == pathIndex.end() || !ensureMapped() || !pathMatches(found->second, fileToFind))
+        return false;
+
+    // A file that has changed since it was stored is looked up again once its new
+    // contents are stored; nothing is written here
+    const auto header = readHeader(found->second);
+    if (header.fileSize != fileToFind.getSize() || header.modificationTime != getModificationTime(fileToFind))
+        return false;
+
+    location = found->second;
+    return true;
+}
+
+bool AnalysisStore::pathMatches(const Location& location, const File& fileToFind)
+{
+    uint32 size = 0;
+    const auto* data = static_cast<const char*>(findSection(location, pathTag, size));
+    return data != nullptr && String::fromUTF8(data, static_cast<int>(size)) == fileToFind.getFullPathName();
+}
+
+std::map<int64, uint32> AnalysisStore::getLiveRecords() const
+{
+    std::map<int64, uint32> live;
+    for (const auto& entry : keyIndex)
+        live[entry.second.offset] = entry.second.size;
+    for (const auto& entry : pathIndex)
+        live[entry.second.offset] = entry.second.size;
+
+    return live;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Mp3FrameIndex.h"
+#include "PeakPyramid.h"
+#include "TrackAnalysis.h"
+#include <map>
+#include <memory>
+
+// AnalysisStore keeps track analysis and waveform data on disk, so a track that has been
+// seen before is never decoded again. The store is one append-only file of records, each
+// holding one version of a track's data as tagged sections. It is read through a memory
+// map: opening walks the record headers to build an index, and a lookup is an index search
+// followed by a read straight out of the mapped file, whatever the length of the track.
+//
+// Records are keyed by a hash of the file's size, modification time and a sample of its
+// contents, so a changed file no longer matches its old record. A second index by path
+// finds a known file from its size and modification time alone, without reading it; a
+// path whose file has changed stops matching until its new contents are stored.
+// Superseded records are dead space, and the store compacts itself on opening once they
+// make up most of the file.
+//
+// The file grows in steps ahead of the records written to it and is mapped for writing,
+// so a record is appended by copying it into the map. The map is only replaced when the
+// file grows. Safe to use from any thread, but only lookups by path are cheap enough for
+// the message thread: computing a key reads the file, and storing writes to the store
+class AnalysisStore
+{
+public:
+    // Bumped whenever the layout of the file or of a section changes. A store written
+    // with another version is discarded and rebuilt
+    static constexpr uint32 formatVersion = 2;
+
+    // Opens the store, creating it if it does not exist
+    explicit AnalysisStore(const File& storeFile);
+
+    // Destructor
+    ~AnalysisStore();
+
+    // Returns the store file used by the application
+    static File getDefaultFile();
+
+    // Returns the key of a file's current contents: a hash of its size, modification time
+    // and its first and last 64 KB. Returns 0 if the file can't be read
+    static uint64 computeKey(const File& file);
+
+    // Returns the key for a file, from the path index if the file is unchanged since it
+    // was stored and otherwise by reading it. Not for the message thread
+    uint64 getKey(const File& file);
+
+    // Returns the key for a file from the path index, or 0 if the file has not been stored
+    // or has changed since. Never reads the file itself
+    uint64 findKey(const File& file);
+
+    // Copies a file's analysis into result if the path index holds it at the file's
+    // current size and modification time. Never reads the file itself
+    bool findAnalysis(const File& file, TrackAnalysis& result);
+
+    // Copies the analysis stored under a key into result
+    bool findAnalysis(uint64 key, TrackAnalysis& result);
+
+    // Stores a file's analysis under its key and indexes it by the file's path
+    void storeAnalysis(const File& file, uint64 key, const TrackAnalysis& analysis);
+
+    // Loads the waveform stored under a key into result, copying it straight out of the map
+    bool findWaveform(uint64 key, PeakPyramid& result);
+
+    // Stores a complete waveform under a key
+    void storeWaveform(uint64 key, const PeakPyramid& waveform);
+
+    // Loads the MP3 frame index stored under a key into result
+    bool findFrameIndex(uint64 key, Mp3FrameIndex& result);
+
+    // Stores an MP3 frame index under a key, empty for a file that can't be indexed
+    void storeFrameIndex(uint64 key, const Mp3FrameIndex& index);
+
+    // Rewrites the file with only the live records
+    void compact();
+
+    // Returns the number of tracks with live records
+    int getNumEntries() const;
+
+    // Returns the size of the store file in bytes
+    int64 getFileSize() const;
+
+    // Returns the bytes taken by records that are no longer reachable
+    int64 getDeadBytes() const;
+
+private:
+    // Fixed part of each record, followed by its sections
+    struct RecordHeader
+    {
+        uint32 magic;
+        uint32 size;          // Whole record including this header, a multiple of 8
+        uint64 key;           // Content key, or 0 for a record that invalidates a path
+        uint64 pathHash;      // Hash of the full path, or 0 if not indexed by path
+        int64 fileSize;
+        int64 modificationTime;
+        uint32 numSections;
+        uint32 checksum;      // Of the section bytes, so a torn write is detected
+    };
+
+    // Where a record lives in the file and how big it is
+    struct Location
+    {
+        int64 offset = 0;
+        uint32 size = 0;
+    };
+
+    // Section contents by tag
+    using Sections = std::map<uint32, MemoryBlock>;
+
+    // Reads the file, discarding it if it has the wrong version and cutting off any
+    // partly written record at the end. Lock held
+    void open();
+
+    // Starts an empty file. Lock held
+    void createEmpty();
+
+    // Maps the file unless it is already mapped. Lock held
+    bool ensureMapped();
+
+    // Grows the file and remaps it if the map ends before end. Lock held
+    bool ensureCapacity(int64 end);
+
+    // Returns the header of a record. The map must be current. Lock held
+    RecordHeader readHeader(const Location& location) const;
+
+    // Returns the data of one section of a record, or nullptr. Lock held
+    const void* findSection(const Location& location, uint32 tag, uint32& size);
+
+    // Copies every section of a record. Lock held
+    Sections readSections(const Location& location);
+
+    // Adds a section to the record held for key, or starts a record for it
+    void storeSection(uint64 key, uint32 tag, const MemoryBlock& data);
+
+    // Appends a record and indexes it. Lock held
+    void appendRecord(const RecordHeader& header, const Sections& sections);
+
+    // Adds a record to the indexes, or removes a path for a record with no key. Lock held
+    void indexRecord(const RecordHeader& header, const Location& location);
+
+    // Drops a path from the index, along with the key of its record. Lock held
+    void removePath(uint64 pathHash);
+
+    // Returns the location of a path's record if the file is unchanged since it was
+    // stored. Lock held
+    bool findPath(const File& file, Location& location);
+
+    // Returns true if a record's path section matches the file. Lock held
+    bool pathMatches(const Location& location, const File& file);
+
+    // Returns the size of every record reachable from an index, by offset. Lock held
+    std::map<int64, uint32> getLiveRecords() const;
+
+    const File file;
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    int64 endOfData = 0;
+
+    std::map<uint64, Location> keyIndex;
+    std::map<uint64, Location> pathIndex;
+
+    CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisStore)
+};
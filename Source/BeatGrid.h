@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <cmath>
+
+// BeatGrid describes a track's tempo as a constant-tempo grid: the beat length, the time
+// of the first beat and the time of the first downbeat (the "1" of a 4/4 bar).
+// A default-constructed grid is invalid, meaning the track has not been analysed or no
+// steady beat was found
+struct BeatGrid
+{
+    // Beats per minute, 0 if unknown
+    double bpm = 0.0;
+
+    // Time of the first beat in seconds, between 0 and one beat length
+    double firstBeatSeconds = 0.0;
+
+    // Time of the first downbeat in seconds, between 0 and one bar length
+    double firstDownbeatSeconds = 0.0;
+
+    // How clearly the beat stands out, from 0 (not at all) to 1
+    float confidence = 0.0f;
+
+    // Returns true if the grid has a tempo
+    bool isValid() const noexcept { return bpm > 0.0; }
+
+    // Returns the length of one beat in seconds
+    double getBeatLength() const noexcept { return bpm > 0.0 ? 60.0 / bpm : 0.0; }
+
+    // Returns the time of the given beat; beat 0 is the first beat
+    double getBeatTime(int beatIndex) const noexcept { return firstBeatSeconds + beatIndex * getBeatLength(); }
+
+    // Returns the position in beats (fractional) of a time in seconds
+    double getBeatPosition(double seconds) const noexcept
+    {
+        return bpm > 0.0 ? (seconds - firstBeatSeconds) / getBeatLength() : 0.0;
+    }
+
+    // Returns the time of the beat nearest to the given time
+    double getNearestBeatTime(double seconds) const noexcept
+    {
+        return bpm > 0.0 ? getBeatTime(static_cast<int>(std::floor(getBeatPosition(seconds) + 0.5))) : seconds;
+    }
+};
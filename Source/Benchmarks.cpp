@@ -0,0 +1,416 @@
+#include "Benchmarks.h"
+#include "FusedResampler.h"
+#include "IndexedMp3Reader.h"
+#include "MappedAudioSource.h"
+#include "MidSideKernel.h"
+#include "PeakPyramid.h"
+#include "TimeStretcher.h"
+
+namespace
+{
+    // Measures the average time of one call to fn over a number of iterations, in nanoseconds
+    template <typename Fn>
+    double timePerCallNs(int iterations, Fn&& fn)
+    {
+        const int64 start = Time::getHighResolutionTicks();
+        for (int i = 0; i < iterations; ++i)
+            fn(i);
+        const int64 end = Time::getHighResolutionTicks();
+        return Time::highResolutionTicksToSeconds(end - start) * 1.0e9 / iterations;
+    }
+
+    // Fills a buffer with reproducible noise
+    void fillWithNoise(AudioBuffer<float>& buffer, int64 seed)
+    {
+        Random random(seed);
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    // Prints one result line
+    void report(const String& name, double nsPerCall, const String& unit)
+    {
+        std::cout << name.paddedRight(' ', 44) << String(nsPerCall, 1) << " ns/" << unit << std::endl;
+    }
+
+    // Writes a stereo 16-bit WAV of noise to a temporary file
+    File writeTestWav(double seconds, double sampleRate)
+    {
+        auto file = File::getSpecialLocation(File::tempDirectory).getNonexistentChildFile("otodecks-bench", ".wav");
+        const int numSamples = static_cast<int>(seconds * sampleRate);
+
+        AudioBuffer<float> noise(2, numSamples);
+        fillWithNoise(noise, 2);
+
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer(wav.createWriterFor(new FileOutputStream(file),
+            sampleRate, 2, 16, {}, 0));
+        if (writer != nullptr)
+            writer->writeFromAudioSampleBuffer(noise, 0, numSamples);
+
+        return file;
+    }
+
+    // Loops a block of noise, so the source itself costs next to nothing
+    class NoiseLoopSource : public AudioSource
+    {
+    public:
+        NoiseLoopSource() : noise(2, 8192) { fillWithNoise(noise, 4); }
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+
+        void getNextAudioBlock(const AudioSourceChannelInfo& info) override
+        {
+            for (int done = 0; done < info.numSamples;)
+            {
+                const int num = jmin(info.numSamples - done, noise.getNumSamples() - position);
+                for (int ch = 0; ch < info.buffer->getNumChannels(); ++ch)
+                    info.buffer->copyFrom(ch, info.startSample + done, noise, ch % 2, position, num);
+
+                position = (position + num) % noise.getNumSamples();
+                done += num;
+            }
+        }
+
+    private:
+        AudioBuffer<float> noise;
+        int position = 0;
+    };
+
+    // The per-sample mid/side loop DJAudioPlayer used before MidSideKernel
+    void legacyMidSide(float* leftChannel, float* rightChannel, int numSamples, double vocalMix)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float L = leftChannel[i];
+            float R = rightChannel[i];
+            float mid = (L + R) * 0.5f;
+            float side = (L - R) * 0.5f;
+
+            float midGain, sideGain;
+            if (vocalMix < 0.5)
+            {
+                midGain = 2.0f * static_cast<float>(vocalMix);
+                sideGain = 1.0f;
+            }
+            else
+            {
+                midGain = 1.0f;
+                sideGain = 2.0f - 2.0f * static_cast<float>(vocalMix);
+            }
+
+            leftChannel[i] = midGain * mid + sideGain * side;
+            rightChannel[i] = midGain * mid - sideGain * side;
+        }
+    }
+}
+
+namespace Benchmarks
+{
+
+void runAll()
+{
+    std::cout << "OtoDecks benchmarks" << std::endl;
+    midSideKernel();
+    memoryMappedSeek();
+    timeStretch();
+    resampler();
+    waveformPaint();
+    mp3Seek();
+}
+
+void midSideKernel()
+{
+    const int blockSize = 512;
+    const int iterations = 20000;
+
+    AudioBuffer<float> source(2, blockSize);
+    AudioBuffer<float> work(2, blockSize);
+    fillWithNoise(source, 1);
+
+    std::cout << "-- Mid/side kernel (" << MidSideKernel::getInstructionSetName()
+        << ", " << blockSize << " samples per block)" << std::endl;
+
+    const double copyOnly = timePerCallNs(iterations, [&](int) { work.makeCopyOf(source, true); });
+    report("buffer copy (subtracted baseline)", copyOnly, "block");
+
+    // Every variant processes a fresh copy so the data stays in range; the copy's cost is
+    // taken off each result
+    auto runVariant = [&](const String& name, std::function<void(float*, float*, int)> body)
+    {
+        const double ns = timePerCallNs(iterations, [&](int i)
+            {
+                work.makeCopyOf(source, true);
+                body(work.getWritePointer(0), work.getWritePointer(1), i);
+            });
+        report(name, jmax(0.0, ns - copyOnly), "block");
+    };
+
+    runVariant("legacy loop, mix 0.3", [](float* l, float* r, int) { legacyMidSide(l, r, blockSize, 0.3); });
+    runVariant("legacy loop, mix 0.5", [](float* l, float* r, int) { legacyMidSide(l, r, blockSize, 0.5); });
+
+    const auto fixedStart = MidSideKernel::fromVocalMix(0.3f, 1.0f);
+    runVariant("kernel scalar, mix 0.3", [&](float* l, float* r, int)
+        { MidSideKernel::processScalar(l, r, blockSize, fixedStart, fixedStart); });
+    runVariant("kernel, mix 0.3", [&](float* l, float* r, int)
+        { MidSideKernel::process(l, r, blockSize, fixedStart, fixedStart); });
+
+    const auto rampEnd = MidSideKernel::fromVocalMix(0.7f, 0.8f);
+    runVariant("kernel, ramping mix 0.3 -> 0.7", [&](float* l, float* r, int)
+        { MidSideKernel::process(l, r, blockSize, fixedStart, rampEnd); });
+
+    const auto neutral = MidSideKernel::fromVocalMix(0.5f, 1.0f);
+    runVariant("kernel, neutral mix 0.5", [&](float* l, float* r, int)
+        { MidSideKernel::process(l, r, blockSize, neutral, neutral); });
+}
+
+void memoryMappedSeek()
+{
+    const int blockSize = 512;
+    const int seeks = 5000;
+    const double sampleRate = 44100.0;
+
+    std::cout << "-- Random seek + " << blockSize << "-sample read (60 s stereo WAV)" << std::endl;
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    auto file = writeTestWav(60.0, sampleRate);
+    AudioBuffer<float> block(2, blockSize);
+
+    // The same random positions for both paths
+    Random random(3);
+    Array<int64> positions;
+    for (int i = 0; i < seeks; ++i)
+        positions.add(static_cast<int64>(random.nextDouble() * 59.0 * sampleRate));
+
+    auto runSeeks = [&](PositionableAudioSource& source)
+    {
+        source.prepareToPlay(blockSize, sampleRate);
+        return timePerCallNs(seeks, [&](int i)
+            {
+                source.setNextReadPosition(positions.getUnchecked(i));
+                source.getNextAudioBlock(AudioSourceChannelInfo(block));
+            });
+    };
+
+    // Stream path: the reader DJAudioPlayer used before, over a file stream
+    {
+        AudioFormatReaderSource streamSource(formatManager.createReaderFor(file), true);
+        runSeeks(streamSource);
+        report("streaming reader", runSeeks(streamSource), "seek");
+    }
+
+    // Mapped path, without a prefetch thread so every access is measured directly
+    if (auto mappedSource = MappedAudioSource::create(formatManager, file, nullptr, 0.0))
+    {
+        runSeeks(*mappedSource);
+        report("memory-mapped reader", runSeeks(*mappedSource), "seek");
+    }
+    else
+    {
+        std::cout << "memory-mapped reader unavailable" << std::endl;
+    }
+
+    file.deleteFile();
+}
+
+void timeStretch()
+{
+    const int blockSize = 512;
+    const int blocks = 2000;
+    const double sampleRate = 44100.0;
+    const double blockNs = blockSize / sampleRate * 1.0e9;
+
+    std::cout << "-- Key-lock time stretch, " << blockSize << "-sample blocks at 44.1 kHz" << std::endl;
+
+    for (auto quality : { TimeStretcher::Quality::low, TimeStretcher::Quality::medium, TimeStretcher::Quality::high })
+    {
+        for (auto tempo : { 0.8, 1.25 })
+        {
+            ToneGeneratorAudioSource tone;
+            tone.setFrequency(440.0);
+            tone.prepareToPlay(blockSize, sampleRate);
+
+            TimeStretcher stretcher;
+            stretcher.prepare(sampleRate, blockSize);
+            stretcher.setQuality(quality);
+
+            AudioBuffer<float> block(2, blockSize);
+            AudioSourceChannelInfo info(block);
+
+            const double ns = timePerCallNs(blocks, [&](int) { stretcher.process(tone, info, tempo); });
+            report(TimeStretcher::getQualityName(quality) + ", tempo " + String(tempo, 2), ns, "block");
+            std::cout << "    " << String(100.0 * ns / blockNs, 2) << "% of one core per deck" << std::endl;
+        }
+    }
+}
+
+void resampler()
+{
+    const int blockSize = 512;
+    const int blocks = 4000;
+    const double deviceRate = 44100.0;
+
+    // A 48 kHz file on a 44.1 kHz device, played 6% fast
+    const double rateRatio = 48000.0 / deviceRate;
+    const double speed = 1.06;
+
+    std::cout << "-- Resampling 48 kHz -> 44.1 kHz at speed " << speed
+              << " (sinc uses " << FusedResampler::getInstructionSetName() << ")" << std::endl;
+
+    AudioBuffer<float> block(2, blockSize);
+    AudioSourceChannelInfo info(block);
+
+    // The previous chain: rate conversion in the track, then the tempo resampler
+    {
+        NoiseLoopSource source;
+        ResamplingAudioSource rateStage(&source, false, 2);
+        ResamplingAudioSource tempoStage(&rateStage, false, 2);
+        rateStage.setResamplingRatio(rateRatio);
+        tempoStage.setResamplingRatio(speed);
+        tempoStage.prepareToPlay(blockSize, deviceRate);
+
+        const double ns = timePerCallNs(blocks, [&](int) { tempoStage.getNextAudioBlock(info); });
+        report("two ResamplingAudioSource stages", ns / blockSize, "sample");
+    }
+
+    for (auto type : { FusedResampler::Interpolator::linear, FusedResampler::Interpolator::lagrange, FusedResampler::Interpolator::sinc })
+    {
+        NoiseLoopSource source;
+        FusedResampler fused(&source, 2);
+        fused.prepareToPlay(blockSize, deviceRate);
+        fused.setInterpolator(type);
+        fused.setRatio(rateRatio * speed);
+
+        const double ns = timePerCallNs(blocks, [&](int) { fused.getNextAudioBlock(info); });
+        report("fused " + FusedResampler::getInterpolatorName(type), ns / blockSize, "sample");
+    }
+}
+
+void waveformPaint()
+{
+    const double sampleRate = 44100.0;
+    const int64 length = static_cast<int64>(600.0 * sampleRate);
+    const int paints = 200;
+
+    std::cout << "-- Painting a 10 minute waveform 1000 px wide" << std::endl;
+
+    // Both summaries are fed the same noise, one block at a time
+    AudioFormatManager formatManager;
+    AudioThumbnailCache thumbCache(1);
+    AudioThumbnail thumb(1000, formatManager, thumbCache);
+    thumb.reset(2, sampleRate, length);
+
+    PeakPyramid pyramid;
+    pyramid.startBuild(length, sampleRate);
+
+    AudioBuffer<float> block(2, 32768);
+    fillWithNoise(block, 6);
+    for (int64 pos = 0; pos < length; pos += block.getNumSamples())
+    {
+        const int num = static_cast<int>(jmin(static_cast<int64>(block.getNumSamples()), length - pos));
+        thumb.addBlock(pos, block, 0, num);
+        pyramid.addSamples(block, num);
+    }
+    pyramid.finishBuild();
+
+    Image image(Image::RGB, 1000, 120, true);
+    Graphics g(image);
+    const auto bounds = image.getBounds();
+
+    // The whole track, then a 10 second window as a zoomed view would show it
+    for (const double seconds : { 600.0, 10.0 })
+    {
+        const double start = 0.5 * (600.0 - seconds);
+        const String view = seconds >= 600.0 ? "overview" : "10 s zoom";
+
+        double ns = timePerCallNs(paints, [&](int) { thumb.drawChannel(g, bounds, start, start + seconds, 0, 1.0f); });
+        report("AudioThumbnail " + view, ns, "paint");
+
+        ns = timePerCallNs(paints, [&](int)
+            {
+                pyramid.draw(g, bounds, start * sampleRate, seconds * sampleRate / bounds.getWidth(),
+                    Colours::orange, Colours::white);
+            });
+        report("PeakPyramid " + view, ns, "paint");
+    }
+}
+
+void mp3Seek()
+{
+    const int blockSize = 512;
+    const int seeks = 200;
+
+    std::cout << "-- Random seek + " << blockSize << "-sample read (bundled MP3s)" << std::endl;
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    const auto assets = File(String(__FILE__)).getParentDirectory().getChildFile("assets");
+    for (const auto& file : assets.findChildFiles(File::findFiles, false, "*.mp3"))
+    {
+        std::cout << file.getFileName() << std::endl;
+
+        auto index = std::make_shared<Mp3FrameIndex>();
+        bool indexed = false;
+        report("  build index", timePerCallNs(1, [&](int) { indexed = index->build(formatManager, file); }), "file");
+
+        if (!indexed)
+        {
+            std::cout << "  not indexable" << std::endl;
+            continue;
+        }
+
+        std::unique_ptr<AudioFormatReader> plain(formatManager.createReaderFor(file));
+        auto fast = IndexedMp3Reader::create(formatManager, file, index);
+        if (plain == nullptr || fast == nullptr)
+            continue;
+
+        // The same random positions for both readers, clear of the end JUCE's reader only estimates
+        Random random(7);
+        Array<int64> positions;
+        const int64 range = index->getLengthInSamples() - 4 * Mp3FrameIndex::samplesPerFrame;
+        for (int i = 0; i < seeks; ++i)
+            positions.add(static_cast<int64>(random.nextDouble() * static_cast<double>(jmax<int64>(1, range))));
+
+        AudioBuffer<float> block(2, blockSize);
+        AudioBuffer<float> expected(2, blockSize);
+
+        // Warm: one reader serves every seek. Cold: each seek opens a reader, as a fresh load does
+        auto runSeeks = [&](const String& name, AudioFormatReader& warm, std::function<AudioFormatReader*()> open)
+        {
+            report("  " + name + ", warm", timePerCallNs(seeks, [&](int i)
+                {
+                    warm.read(&block, 0, blockSize, positions.getUnchecked(i), true, true);
+                }), "seek");
+
+            report("  " + name + ", cold", timePerCallNs(seeks / 10, [&](int i)
+                {
+                    std::unique_ptr<AudioFormatReader> reader(open());
+                    reader->read(&block, 0, blockSize, positions.getUnchecked(i), true, true);
+                }), "seek");
+        };
+
+        runSeeks("JUCE reader", *plain, [&] { return formatManager.createReaderFor(file); });
+        runSeeks("indexed reader", *fast, [&] { return IndexedMp3Reader::create(formatManager, file, index).release(); });
+
+        // Every indexed seek should give exactly the samples of JUCE's reader
+        float maxError = 0.0f;
+        for (const auto position : positions)
+        {
+            plain->read(&expected, 0, blockSize, position, true, true);
+            fast->read(&block, 0, blockSize, position, true, true);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < blockSize; ++i)
+                    maxError = jmax(maxError, std::abs(block.getSample(ch, i) - expected.getSample(ch, i)));
+        }
+
+        std::cout << String("  largest sample difference").paddedRight(' ', 44) << maxError << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Benchmarks holds the micro-benchmarks for the audio engine.
+// Run them by launching the app with --benchmark; results are printed to stdout
+namespace Benchmarks
+{
+    // Runs every benchmark in turn
+    void runAll();
+
+    // Compares the original per-sample mid/side loop against MidSideKernel
+    void midSideKernel();
+
+    // Compares random-seek latency of the streaming reader against the memory-mapped reader
+    void memoryMappedSeek();
+
+    // Reports the CPU cost of one key-locked deck at each time-stretch quality tier
+    void timeStretch();
+
+    // Measures resampler throughput for each interpolator against the old two-stage chain
+    void resampler();
+
+    // Compares painting a long track's waveform from AudioThumbnail and from PeakPyramid
+    void waveformPaint();
+
+    // Compares random-seek latency and accuracy in the bundled MP3s with and without a frame index
+    void mp3Seek();
+}
@@ -1,106 +1,513 @@
 #include "DJAudioPlayer.h"
+#include "MidSideKernel.h"
 
 // Constructs DJAudioPlayer using AudioFormatManager
-DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager)
-    : formatManager(_formatManager)
+DJAudioPlayer::DJAudioPlayer(AudioFormatManager& _formatManager,
+    TimeSliceThread* _readAheadThread,
+    DecodedTrackCache* _cache,
+    SyncEngine* _syncEngine,
+    AnalysisStore* _analysisStore)
+    : formatManager(_formatManager),
+    readAheadThread(_readAheadThread),
+    trackCache(_cache),
+    analysisStore(_analysisStore),
+    hotCueBank(_formatManager, _readAheadThread),
+    syncEngine(_syncEngine)
 {
+    if (syncEngine != nullptr)
+        syncEngine->addDeck(this);
 }
 
 
 DJAudioPlayer::~DJAudioPlayer()
 {
+    if (syncEngine != nullptr)
+        syncEngine->removeDeck(this);
 }
 
 // Prepares audio player for playback
 void DJAudioPlayer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
     transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    resampleSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    resampler.prepareToPlay(samplesPerBlockExpected, sampleRate);
     currentSampleRate = sampleRate;
+
+    gain.prepare(sampleRate, gainRampSeconds);
+    speed.prepare(sampleRate, speedRampSeconds);
+    vocalMix.prepare(sampleRate, gainRampSeconds);
+    stretcher.prepare(sampleRate, samplesPerBlockExpected);
+    scratch.prepare(sampleRate);
+    keyLockActive = keyLock.load();
 }
 
 // Fills buffer with next block of audio
 void DJAudioPlayer::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
 {
-    // Get the next audio block from resampling source
-    resampleSource.getNextAudioBlock(bufferToFill);
+    gain.update();
+    speed.update();
+    vocalMix.update();
+
+    applyLoopCommands();
+    hotCueBank.update();
+
+    // A hand on the platter takes the record from the sample being heard, at the speed
+    // it was playing at
+    if (!scratchActive && scratchTouched.load())
+    {
+        transportSource.idle();
+        scratch.begin(getAudiblePosition(), transportSource.isPlaying() ? (syncing ? syncSpeed : speed.getCurrentValue()) : 0.0);
+        scratchActive = true;
+    }
+
+    // A quantized start waits for the master clock to reach the deck's phase, which may
+    // fall inside this block. A pending track or seek is taken first, as it moves the phase
+    int startSample = -1;
+    if (startPending.load() && !scratchActive)
+    {
+        transportSource.idle();
+        const double wait = getSamplesUntilStart();
+        if (transportSource.isPlaying())
+            startPending = false;
+        else if (wait < bufferToFill.numSamples && startPending.exchange(false))
+            startSample = static_cast<int>(wait);
+    }
+
+    // A stopped or empty deck skips the resampler and mid/side kernel entirely. The
+    // resampler keeps its history, so playback carries on seamlessly when restarted
+    if (!transportSource.isPlaying() && startSample < 0 && !scratchActive)
+    {
+        // A jump left pending when the track ran out has nothing left to line up with
+        if (jumpTarget.load() >= 0.0)
+            jumpTarget = -1.0;
+
+        transportSource.idle();
+        bufferToFill.clearActiveBufferRegion();
+        gain.skip(bufferToFill.numSamples);
+        speed.skip(bufferToFill.numSamples);
+        vocalMix.skip(bufferToFill.numSamples);
+        outputSilent.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    outputSilent.store(false, std::memory_order_relaxed);
+    resampler.setInterpolator(static_cast<FusedResampler::Interpolator>(interpolatorType.load()));
+
+    // Switching key lock restarts the stretcher
+    if (keyLock.load() != keyLockActive)
+    {
+        keyLockActive = !keyLockActive;
+        stretcher.reset();
+    }
+
+    // After a seek or a new track the buffered history belongs to the old position
+    const bool flushed = flushPending.exchange(false);
+    if (flushed)
+    {
+        resampler.flushBuffers();
+        stretcher.reset();
+    }
+
+    // The deck is silent up to the beat it starts on
+    int done = 0;
+    if (startSample >= 0)
+    {
+        if (startSample > 0 && bufferToFill.buffer != nullptr)
+            bufferToFill.buffer->clear(bufferToFill.startSample, startSample);
+
+        speed.skip(startSample);
+        transportSource.start();
+        done = startSample;
+    }
+
+    updateSync();
+
+    // A seek while scratching moves the record under the hand
+    if (scratchActive)
+    {
+        transportSource.idle();
+        if (flushed)
+            scratch.setPosition(static_cast<double>(transportSource.getNextReadPosition()));
+
+        renderScratch(bufferToFill);
+        done = bufferToFill.numSamples;
+    }
+
+    // A quantized jump plays up to its beat, then carries on from the target
+    double target = jumpTarget.load();
+    if (target >= 0.0 && !scratchActive)
+    {
+        const double wait = done + getSamplesUntilJump(target);
+        if (wait < bufferToFill.numSamples && jumpTarget.compare_exchange_strong(target, -1.0))
+        {
+            const int jumpSample = static_cast<int>(wait);
+            if (jumpSample > done)
+                render(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, jumpSample - done));
+
+            // A hot cue's preroll plays while the track seeks
+            const auto* preroll = hotCueBank.find(transportSource.getActiveTrack(),
+                static_cast<int64>(target * transportSource.getActiveSampleRate()));
+            transportSource.setPositionNow(target, preroll != nullptr ? &preroll->audio : nullptr);
+            resampler.flushBuffers();
+            stretcher.reset();
+            done = jumpSample;
+        }
+    }
+
+    if (done < bufferToFill.numSamples)
+        render(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, bufferToFill.numSamples - done));
+
+    if (bufferToFill.buffer == nullptr)
+        return;
+
+    // Gain and vocal mix are evaluated once at each end of the block and ramped between
+    const int numSamples = bufferToFill.numSamples;
+    const float startGain = gain.getCurrentValue();
+    const float startMix = vocalMix.getCurrentValue();
+    const float endGain = gain.skip(numSamples);
+    const float endMix = vocalMix.skip(numSamples);
 
-    // Processes audio
-    if (bufferToFill.buffer != nullptr && bufferToFill.buffer->getNumChannels() >= 2)
+    if (bufferToFill.buffer->getNumChannels() >= 2)
     {
-        const int numSamples = bufferToFill.numSamples;
-        float* leftChannel = bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample);
-        float* rightChannel = bufferToFill.buffer->getWritePointer(1, bufferToFill.startSample);
+        // Processes audio through the mid/side kernel
+        MidSideKernel::process(bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample),
+            bufferToFill.buffer->getWritePointer(1, bufferToFill.startSample),
+            numSamples,
+            MidSideKernel::fromVocalMix(startMix, startGain),
+            MidSideKernel::fromVocalMix(endMix, endGain));
+    }
+    else
+    {
+        // Mono output: only the gain applies
+        bufferToFill.buffer->applyGainRamp(0, bufferToFill.startSample, numSamples, startGain, endGain);
+    }
+}
+
+// Resamples a range of the block. A synced deck plays at the sync speed, with the phase
+// correction applied through the resampling ratio
+void DJAudioPlayer::render(const AudioSourceChannelInfo& bufferToFill)
+{
+    // File-to-device rate conversion and speed share one resampler
+    const double rateRatio = transportSource.getActiveSampleRate() / currentSampleRate;
+    const int numSamples = bufferToFill.numSamples;
 
-        for (int i = 0; i < numSamples; ++i)
+    if (keyLockActive)
+    {
+        // Key lock: the resampler only converts the rate and the stretcher applies the speed as tempo
+        resampler.setRatio(rateRatio * phaseCorrection);
+        stretcher.setQuality(static_cast<TimeStretcher::Quality>(keyLockQuality.load()));
+        const double tempo = speed.skip(numSamples);
+        stretcher.process(resampler, bufferToFill, syncing ? syncSpeed : tempo);
+    }
+    // While the speed is ramping the block is pulled in short sub-blocks so the ratio
+    // changes smoothly
+    else if (speed.isSmoothing() && !syncing)
+    {
+        for (int done = 0; done < numSamples;)
         {
-            float L = leftChannel[i];
-            float R = rightChannel[i];
+            const int num = jmin(speedSubBlockSize, numSamples - done);
+            resampler.setRatio(rateRatio * speed.skip(num));
+            resampler.getNextAudioBlock(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, num));
+            done += num;
+        }
+    }
+    else
+    {
+        const double tempo = syncing ? syncSpeed * phaseCorrection : speed.getCurrentValue();
+        speed.skip(numSamples);
+        resampler.setRatio(rateRatio * tempo);
+        resampler.getNextAudioBlock(bufferToFill);
+    }
+}
 
-            // Compute mid and side components
-            float mid = (L + R) * 0.5f;
-            float side = (L - R) * 0.5f;
+// The scratch engine follows the platter while it is held, and the deck's own speed once
+// it is let go. It plays without key lock, so the pitch moves with the record as on vinyl
+void DJAudioPlayer::renderScratch(const AudioSourceChannelInfo& bufferToFill)
+{
+    const bool touched = scratchTouched.load();
+    if (touched)
+        scratch.setTarget(scratchVelocity.load(), scratchSmoothingSeconds);
+    else
+        scratch.setTarget(transportSource.isPlaying() ? (syncing ? syncSpeed : speed.getCurrentValue()) : 0.0,
+            releaseSmoothingSeconds);
 
-            float midGain, sideGain;
-            if (vocalMix < 0.5)
-            {
-                // For vocalMix in [0.0, 0.5): blend from side-only to original stereo
-                midGain = 2.0f * static_cast<float>(vocalMix); // 0 at 0.0 to 1 at 0.5
-                sideGain = 1.0f; // full side channel always
-            }
-            else
+    speed.skip(bufferToFill.numSamples);
+    scratch.process(transportSource, bufferToFill);
+
+    // Normal playback carries on from where the record was let go
+    if (!touched && scratch.hasSettled())
+    {
+        scratchActive = false;
+        resampler.flushBuffers();
+        stretcher.reset();
+    }
+}
+
+// Locks the deck's tempo to the master clock and bends it slightly to close any phase
+// error, a little more each block, so the beats drift back together without a jump
+void DJAudioPlayer::updateSync() noexcept
+{
+    syncing = false;
+    phaseCorrection = 1.0;
+
+    if (syncEngine == nullptr || !syncEnabled.load() || !hasBeatGrid() || syncEngine->getMaster() == this)
+        return;
+
+    const auto& clock = syncEngine->getClock();
+    if (clock.beatsPerSample <= 0.0)
+        return;
+
+    // Tempo at unity speed, and the multiple of the clock it plays against
+    const double ownBeatsPerSample = gridBpm.load() / (60.0 * currentSampleRate);
+    const double multiple = SyncEngine::getTempoMultiple(clock.beatsPerSample, ownBeatsPerSample);
+    const double targetBeatsPerSample = clock.beatsPerSample * multiple;
+
+    syncing = true;
+    syncSpeed = jlimit(0.01, 100.0, targetBeatsPerSample / ownBeatsPerSample);
+
+    if (clock.running && transportSource.isPlaying())
+    {
+        // Positive when the deck is behind the clock
+        const double error = SyncEngine::wrapPhase(clock.beat * multiple - getBeatPosition());
+        const double beatsPerSecond = targetBeatsPerSample * currentSampleRate;
+        phaseCorrection = 1.0 + jlimit(-maxPhaseCorrection, maxPhaseCorrection,
+            error / (beatsPerSecond * phaseCorrectionSeconds));
+    }
+}
+
+// Samples until the master clock reaches the phase of the deck's playhead, or 0 if there
+// is nothing to wait for
+double DJAudioPlayer::getSamplesUntilStart() const noexcept
+{
+    if (syncEngine == nullptr || !quantizeEnabled.load() || !hasBeatGrid())
+        return 0.0;
+
+    const auto& clock = syncEngine->getClock();
+    if (!clock.running || clock.beatsPerSample <= 0.0)
+        return 0.0;
+
+    const double ownBeatsPerSample = gridBpm.load() / (60.0 * currentSampleRate);
+    const double multiple = SyncEngine::getTempoMultiple(clock.beatsPerSample, ownBeatsPerSample);
+    const double wait = getBeatPosition() - clock.beat * multiple;
+    return (wait - std::floor(wait)) / (clock.beatsPerSample * multiple);
+}
+
+// Samples until the deck's own phase matches the target's, or 0 if there is nothing to
+// wait for
+double DJAudioPlayer::getSamplesUntilJump(double targetSeconds) const noexcept
+{
+    const double beatsPerSample = getBeatsPerSample();
+    if (!quantizeEnabled.load() || beatsPerSample <= 0.0)
+        return 0.0;
+
+    const double wait = (targetSeconds - gridFirstBeat.load()) * gridBpm.load() / 60.0 - getBeatPosition();
+    return (wait - std::floor(wait)) / beatsPerSample;
+}
+
+// Position of the audible sample: the transport has read ahead by whatever the resampler
+// (and, with key lock, the stretcher) is holding
+double DJAudioPlayer::getAudiblePosition() const noexcept
+{
+    // A scratch plays the audio itself, so nothing is held between it and the output
+    if (scratchActive)
+        return scratch.getPosition();
+
+    double position = static_cast<double>(transportSource.getNextReadPosition());
+    if (!flushPending.load(std::memory_order_relaxed))
+    {
+        const double rateRatio = transportSource.getActiveSampleRate() / currentSampleRate;
+        position -= resampler.getBufferedInput();
+        if (keyLockActive)
+            position -= stretcher.getLatencySamples() * rateRatio;
+    }
+
+    return jmax(0.0, position);
+}
+
+// The audible position counted in beats of the grid
+double DJAudioPlayer::getBeatPosition() const noexcept
+{
+    const double bpm = gridBpm.load(std::memory_order_relaxed);
+    const double fileRate = transportSource.getActiveSampleRate();
+    if (bpm <= 0.0 || fileRate <= 0.0)
+        return 0.0;
+
+    return (getAudiblePosition() / fileRate - gridFirstBeat.load(std::memory_order_relaxed)) * bpm / 60.0;
+}
+
+// Takes a pending track or seek first, so the loop lands on the position being heard
+void DJAudioPlayer::applyLoopCommands() noexcept
+{
+    if (loopCommandFifo.getNumReady() == 0)
+        return;
+
+    transportSource.idle();
+
+    const auto scope = loopCommandFifo.read(loopCommandFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i)
+        applyLoopCommand(loopCommands[static_cast<size_t>(scope.startIndex1 + i)]);
+    for (int i = 0; i < scope.blockSize2; ++i)
+        applyLoopCommand(loopCommands[static_cast<size_t>(scope.startIndex2 + i)]);
+}
+
+// Loops are set in the track's samples. The transport's looper replays them from memory,
+// so changing one never seeks the track
+void DJAudioPlayer::applyLoopCommand(const LoopCommand& command) noexcept
+{
+    const double fileRate = transportSource.getActiveSampleRate();
+    const double bpm = gridBpm.load();
+    const double beatLength = bpm > 0.0 ? fileRate * 60.0 / bpm : 0.0;
+
+    switch (command.type)
+    {
+        case LoopCommand::Type::beats:
+        {
+            if (beatLength <= 0.0 || command.value <= 0.0)
+                break;
+
+            // Whole beats start on the beat; fractions of a beat on a multiple of their length
+            const double step = beatLength * jmin(1.0, command.value);
+            const double firstBeat = gridFirstBeat.load() * fileRate;
+            const double start = firstBeat + std::floor((getAudiblePosition() - firstBeat) / step) * step;
+            transportSource.setLoop(static_cast<int64>(std::round(jmax(0.0, start))),
+                static_cast<int64>(std::round(start + command.value * beatLength)));
+            break;
+        }
+
+        case LoopCommand::Type::in:
+            loopInPoint = static_cast<int64>(std::round(snapToBeat(getAudiblePosition())));
+            break;
+
+        case LoopCommand::Type::out:
+        {
+            const auto start = loopInPoint.load();
+            const auto end = static_cast<int64>(std::round(snapToBeat(getAudiblePosition())));
+            if (start >= 0 && end > start)
+                transportSource.setLoop(start, end);
+            break;
+        }
+
+        case LoopCommand::Type::resize:
+            if (transportSource.isLooping())
             {
-                // For vocalMix in [0.5, 1.0]: blend from original stereo to mid-only
-                midGain = 1.0f; // full mid channel always
-                sideGain = 2.0f - 2.0f * static_cast<float>(vocalMix); // 1 at 0.5 to 0 at 1.0
+                const auto length = transportSource.getLoopEnd() - transportSource.getLoopStart();
+                transportSource.setLoopLength(static_cast<int64>(std::round(length * command.value)));
             }
+            break;
 
-            leftChannel[i] = midGain * mid + sideGain * side;
-            rightChannel[i] = midGain * mid - sideGain * side;
-        }
+        case LoopCommand::Type::exit:
+            transportSource.clearLoop();
+            break;
     }
 }
 
+// Nearest beat of the grid, counted in the track's samples
+double DJAudioPlayer::snapToBeat(double position) const noexcept
+{
+    const double fileRate = transportSource.getActiveSampleRate();
+    const double bpm = gridBpm.load();
+    if (!quantizeEnabled.load() || bpm <= 0.0 || fileRate <= 0.0)
+        return position;
+
+    const double beatLength = fileRate * 60.0 / bpm;
+    const double firstBeat = gridFirstBeat.load() * fileRate;
+    return jmax(0.0, firstBeat + std::round((position - firstBeat) / beatLength) * beatLength);
+}
+
+// The grid's tempo scaled by the speed the deck is playing at
+double DJAudioPlayer::getBeatsPerSample() const noexcept
+{
+    const double bpm = gridBpm.load(std::memory_order_relaxed);
+    if (bpm <= 0.0)
+        return 0.0;
+
+    const double playbackSpeed = syncing ? syncSpeed * phaseCorrection : speed.getCurrentValue();
+    return bpm * playbackSpeed / (60.0 * currentSampleRate);
+}
+
 // Releases audio resources
 void DJAudioPlayer::releaseResources()
 {
     transportSource.releaseResources();
-    resampleSource.releaseResources();
+    resampler.releaseResources();
 }
 
 // Loads an audio file from the given URL
 void DJAudioPlayer::loadURL(URL audioURL)
 {
-    auto* reader = formatManager.createReaderFor(audioURL.createInputStream(false));
-    if (reader != nullptr)
+    // Decode straight into the cache when there is one, so the next load is instant
+    if (trackCache != nullptr && audioURL.isLocalFile())
     {
-        std::unique_ptr<AudioFormatReaderSource> newSource(new AudioFormatReaderSource(reader, true));
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-        readerSource.reset(newSource.release());
+        if (auto entry = trackCache->decode(formatManager, audioURL.getLocalFile()))
+        {
+            setTrack(DeckTrack::fromCache(audioURL, entry, getLoadSettings()));
+            return;
+        }
     }
+
+    auto track = DeckTrack::open(formatManager, audioURL, getLoadSettings());
+    if (track != nullptr)
+        setTrack(track);
 }
 
-// Sets gain for the audio playback
-void DJAudioPlayer::setGain(double gain)
+// Queues the track for the audio thread
+void DJAudioPlayer::setTrack(DeckTrack::Ptr track)
 {
-    if (gain < 0 || gain > 1.0)
-        std::cout << "DJAudioPlayer::setGain gain should be between 0 and 1" << std::endl;
-    else
-        transportSource.setGain(gain);
+    // A new track stops the deck, and its grid is set once it is known
+    if (track != nullptr && !track->continuesPlayback())
+    {
+        flushPending = true;
+        startPending = false;
+        jumpTarget = -1.0;
+        gridBpm = 0.0;
+        loopInPoint = -1;
+        hotCues = HotCues();
+        hotCueBank.reset();
+    }
+
+    transportSource.setTrack(track);
+}
+
+// Sets gain for the audio playback. The audio thread ramps towards it
+void DJAudioPlayer::setGain(double newGain)
+{
+    gain.setTarget(static_cast<float>(jlimit(0.0, 1.0, newGain)));
 }
 
-// Sets playback speed by adjusting resampling ratio.
+// Sets playback speed. The audio thread ramps the resampling ratio (or, with key lock, the tempo) towards it
 void DJAudioPlayer::setSpeed(double ratio)
 {
-    if (ratio < 0 || ratio > 100.0)
-        std::cout << "DJAudioPlayer::setSpeed ratio should be between 0 and 100" << std::endl;
-    else
-        resampleSource.setResamplingRatio(ratio);
+    speed.setTarget(static_cast<float>(jlimit(0.01, 100.0, ratio)));
 }
 
-// Sets current playback position
+// Turns key lock on or off; the audio thread switches over at the next block
+void DJAudioPlayer::setKeyLock(bool shouldLockKey)
+{
+    keyLock = shouldLockKey;
+}
+
+// Returns whether key lock is on
+bool DJAudioPlayer::isKeyLockEnabled() const
+{
+    return keyLock.load();
+}
+
+// Selects the stretcher's quality tier
+void DJAudioPlayer::setKeyLockQuality(TimeStretcher::Quality quality)
+{
+    keyLockQuality = static_cast<int>(quality);
+}
+
+// Selects the resampler's interpolator
+void DJAudioPlayer::setInterpolator(FusedResampler::Interpolator type)
+{
+    interpolatorType = static_cast<int>(type);
+}
+
+// Sets current playback position. Audio buffered in the resampler and stretcher is dropped
 void DJAudioPlayer::setPosition(double posInSecs)
 {
+    jumpTarget = -1.0;
+    flushPending = true;
     transportSource.setPosition(posInSecs);
 }
 
@@ -119,25 +526,181 @@ void DJAudioPlayer::setPositionRelative(double pos)
 // Sets the vocal mix parameter for mid/side processing
 void DJAudioPlayer::setVocalMix(double sliderValue)
 {
-    vocalMix = jlimit(0.0, 1.0, sliderValue);
+    vocalMix.setTarget(static_cast<float>(jlimit(0.0, 1.0, sliderValue)));
 }
 
-// Starts audio playback
+// Starts audio playback, or leaves a quantized start for the audio thread to time
 void DJAudioPlayer::start()
 {
-    transportSource.start();
+    if (syncEngine != nullptr && quantizeEnabled.load() && hasBeatGrid())
+        startPending = true;
+    else
+        transportSource.start();
 }
 
 // Stops audio playback
 void DJAudioPlayer::stop()
 {
+    startPending = false;
+    jumpTarget = -1.0;
     transportSource.stop();
 }
 
+// A playing deck jumps on the audio thread, straight away unless it is quantized. A
+// stopped deck just seeks
+void DJAudioPlayer::jumpTo(double posInSecs)
+{
+    posInSecs = jlimit(0.0, transportSource.getLengthInSeconds(), posInSecs);
+
+    if (transportSource.isPlaying())
+        jumpTarget = posInSecs;
+    else
+        setPosition(posInSecs);
+}
+
+// Keeps the cue and has its audio decoded ahead
+void DJAudioPlayer::setHotCue(int index, double posInSecs)
+{
+    if (!isPositiveAndBelow(index, HotCues::maxCues))
+        return;
+
+    hotCues.set(index, jlimit(0.0, transportSource.getLengthInSeconds(), posInSecs));
+    prepareHotCue(index);
+}
+
+// Forgets the cue; a preroll already decoded for it is never matched again
+void DJAudioPlayer::clearHotCue(int index)
+{
+    hotCues.clear(index);
+    hotCueBank.clearCue(index);
+}
+
+// Takes every cue, decoding ahead from each one that is set
+void DJAudioPlayer::setHotCues(const HotCues& cues)
+{
+    for (int i = 0; i < HotCues::maxCues; ++i)
+    {
+        if (cues.isSet(i))
+            setHotCue(i, cues.get(i));
+        else
+            clearHotCue(i);
+    }
+}
+
+// Jumps like a cue, so it is quantized the same way
+void DJAudioPlayer::triggerHotCue(int index)
+{
+    if (hotCues.isSet(index))
+        jumpTo(hotCues.get(index));
+}
+
+// Positions are worked out as the transport does, so the audio thread finds the preroll
+void DJAudioPlayer::prepareHotCue(int index)
+{
+    if (auto* track = transportSource.getTrack())
+        hotCueBank.setCue(index, track, static_cast<int64>(hotCues.get(index) * track->getSampleRate()));
+}
+
+// Queues a beat loop for the audio thread, which finds the beat it starts on
+void DJAudioPlayer::setBeatLoop(double numBeats)
+{
+    postLoopCommand(LoopCommand::Type::beats, numBeats);
+}
+
+// Queues the loop in point for the audio thread, which knows the audible position
+void DJAudioPlayer::setLoopIn()
+{
+    postLoopCommand(LoopCommand::Type::in);
+}
+
+// Queues the loop out point
+void DJAudioPlayer::setLoopOut()
+{
+    postLoopCommand(LoopCommand::Type::out);
+}
+
+// Queues a change of loop length
+void DJAudioPlayer::resizeLoop(double factor)
+{
+    if (factor > 0.0)
+        postLoopCommand(LoopCommand::Type::resize, factor);
+}
+
+// Queues the end of the loop
+void DJAudioPlayer::exitLoop()
+{
+    postLoopCommand(LoopCommand::Type::exit);
+}
+
+// The velocity is cleared before the touch is published, so the record stops under the
+// hand rather than taking the last scratch's rate
+void DJAudioPlayer::beginScratch()
+{
+    scratchVelocity = 0.0;
+    scratchTouched = true;
+}
+
+// Published for the audio thread, which glides to it
+void DJAudioPlayer::setScratchVelocity(double rate)
+{
+    scratchVelocity = jlimit(-ScratchEngine::maxRatio, ScratchEngine::maxRatio, rate);
+}
+
+// The audio thread hands the deck back once the record is back to speed
+void DJAudioPlayer::endScratch()
+{
+    scratchTouched = false;
+}
+
+// Writes a command into the hand-off FIFO
+void DJAudioPlayer::postLoopCommand(LoopCommand::Type type, double value)
+{
+    const auto scope = loopCommandFifo.write(1);
+    if (scope.blockSize1 > 0)
+        loopCommands[static_cast<size_t>(scope.startIndex1)] = { type, value };
+    else if (scope.blockSize2 > 0)
+        loopCommands[static_cast<size_t>(scope.startIndex2)] = { type, value };
+}
+
+// Publishes the grid to the audio thread
+void DJAudioPlayer::setBeatGrid(const BeatGrid& grid)
+{
+    gridFirstBeat = grid.firstBeatSeconds;
+    gridBpm = grid.isValid() ? grid.bpm : 0.0;
+}
+
+// Rebuilds the grid from what the audio thread uses
+BeatGrid DJAudioPlayer::getBeatGrid() const
+{
+    BeatGrid grid;
+    grid.bpm = gridBpm.load();
+    grid.firstBeatSeconds = gridFirstBeat.load();
+    return grid;
+}
+
+// Takes effect from the next block
+void DJAudioPlayer::setSyncEnabled(bool shouldSync)
+{
+    syncEnabled = shouldSync;
+}
+
+// Takes effect from the next start or jump
+void DJAudioPlayer::setQuantizeEnabled(bool shouldQuantize)
+{
+    quantizeEnabled = shouldQuantize;
+}
+
+// Returns whether the deck is playing
+bool DJAudioPlayer::isPlaying() const noexcept
+{
+    return transportSource.isPlaying();
+}
+
 // Returns relative position of playhead
 double DJAudioPlayer::getPositionRelative()
 {
-    return transportSource.getCurrentPosition() / transportSource.getLengthInSeconds();
+    const double length = transportSource.getLengthInSeconds();
+    return length > 0.0 ? transportSource.getCurrentPosition() / length : 0.0;
 }
 
 // Returns current playback position
@@ -151,3 +714,56 @@ double DJAudioPlayer::getTrackLength()
 {
     return transportSource.getLengthInSeconds();
 }
+
+// Returns the device sample rate
+double DJAudioPlayer::getDeviceSampleRate() const
+{
+    return transportSource.getDeviceSampleRate();
+}
+
+// Returns the device block size
+int DJAudioPlayer::getBlockSize() const
+{
+    return transportSource.getBlockSize();
+}
+
+// Collects the settings used to open tracks for this deck
+DeckTrack::LoadSettings DJAudioPlayer::getLoadSettings()
+{
+    DeckTrack::LoadSettings settings;
+    settings.blockSize = getBlockSize();
+    settings.readAheadThread = readAheadThread;
+    settings.readAheadSeconds = readAheadSeconds;
+    settings.readAheadCounters = &readAheadCounters;
+    settings.cache = trackCache;
+    settings.analysisStore = analysisStore;
+    return settings;
+}
+
+// Sets read-ahead length for future loads
+void DJAudioPlayer::setReadAheadSeconds(double seconds)
+{
+    readAheadSeconds = jlimit(0.5, 60.0, seconds);
+}
+
+// Returns the number of read-ahead underruns
+int64 DJAudioPlayer::getUnderrunCount() const
+{
+    return readAheadCounters.underruns.load();
+}
+
+// Returns the number of samples lost to underruns
+int64 DJAudioPlayer::getUnderrunSamples() const
+{
+    return readAheadCounters.samplesMissed.load();
+}
+
+// Returns the decoded audio waiting ahead of the playhead
+double DJAudioPlayer::getBufferedSeconds() const
+{
+    auto* track = transportSource.getTrack();
+    if (track == nullptr || track->getReadAheadBuffer() == nullptr || track->getSampleRate() <= 0.0)
+        return 0.0;
+
+    return track->getReadAheadBuffer()->getNumBufferedSamples() / track->getSampleRate();
+}
@@ -1,13 +1,33 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "AnalysisStore.h"
+#include "BeatGrid.h"
+#include "DeckTransport.h"
+#include "FusedResampler.h"
+#include "HotCueBank.h"
+#include "HotCues.h"
+#include "ScratchEngine.h"
+#include "SilenceAwareMixer.h"
+#include "SmoothedParameter.h"
+#include "SyncEngine.h"
+#include "TimeStretcher.h"
+#include <array>
 #include <cmath>
 
 // DJAudioPlayer handles audio playback and processing
-class DJAudioPlayer : public AudioSource {
+class DJAudioPlayer : public SilenceAwareMixer::Source {
 public:
-    // Constructs DJAudioPlayer using AudioFormatManager
-    DJAudioPlayer(AudioFormatManager& _formatManager);
+    // Constructs DJAudioPlayer using AudioFormatManager. Tracks decode ahead of the
+    // playhead on readAheadThread if one is given, otherwise on the audio thread.
+    // Decoded tracks are shared through cache if one is given, and the deck joins
+    // syncEngine's clock if one is given. MP3s seek through frame indexes kept in
+    // analysisStore if one is given
+    DJAudioPlayer(AudioFormatManager& _formatManager,
+        TimeSliceThread* readAheadThread = nullptr,
+        DecodedTrackCache* cache = nullptr,
+        SyncEngine* syncEngine = nullptr,
+        AnalysisStore* analysisStore = nullptr);
 
     // Destructor.
     ~DJAudioPlayer();
@@ -21,15 +41,37 @@ public:
     // Releases audio resources
     void releaseResources() override;
 
-    // Loads audio file from the provided URL
+    // Returns true if the last block was silence because the deck is stopped or empty
+    bool isOutputSilent() const noexcept override { return outputSilent.load(std::memory_order_relaxed); }
+
+    // Returns true while the deck is playing
+    bool isPlaying() const noexcept;
+
+    // Loads audio file from the provided URL, blocking until it is open (and decoded, if the
+    // player has a cache). Decks should use TrackLoader so the message thread is not stalled
     void loadURL(URL audioURL);
 
-    // Sets gain level
+    // Hands a track prepared off-thread to the audio thread. Message thread only
+    void setTrack(DeckTrack::Ptr track);
+
+    // Sets gain level (0 to 1). Safe to call from the message thread while playing
     void setGain(double gain);
 
-    // Sets playback speed ratio
+    // Sets playback speed ratio (clamped to 0.01 to 100)
     void setSpeed(double ratio);
 
+    // Turns key lock on or off. With key lock, speed changes tempo but not pitch
+    void setKeyLock(bool shouldLockKey);
+
+    // Returns true if key lock is on
+    bool isKeyLockEnabled() const;
+
+    // Selects the time-stretch quality used while key lock is on
+    void setKeyLockQuality(TimeStretcher::Quality quality);
+
+    // Selects the interpolator used for rate conversion and speed
+    void setInterpolator(FusedResampler::Interpolator type);
+
     // Sets the playback position
     void setPosition(double posInSecs);
 
@@ -39,12 +81,100 @@ public:
     // Sets the vocal mix slider value to control mid/side processing.
     void setVocalMix(double sliderValue);
 
-    // Starts audio playback.
+    // Starts audio playback. With quantize on and another deck playing, the deck starts on
+    // the audio thread at the exact sample where the master clock reaches the deck's phase
     void start();
 
-    // Stops audio playback.
+    // Stops audio playback, cancelling a quantized start or jump
     void stop();
 
+    // Moves the playhead, as a cue or hot cue does. While playing the jump is made on the
+    // audio thread and crossfaded; with quantize on it waits for the sample where the
+    // deck's own beat phase matches the target's, so the beat carries on unbroken
+    void jumpTo(double posInSecs);
+
+    // Sets a hot cue of the loaded track. A second of audio from the cue is decoded in
+    // the background, so jumping to it plays from memory while the track seeks
+    void setHotCue(int index, double posInSecs);
+
+    // Clears a hot cue
+    void clearHotCue(int index);
+
+    // Replaces every hot cue, as when a track is loaded with the cues stored for it
+    void setHotCues(const HotCues& cues);
+
+    // Returns the loaded track's hot cues. Loading a new track clears them
+    const HotCues& getHotCues() const noexcept { return hotCues; }
+
+    // Jumps to a hot cue, if it is set
+    void triggerHotCue(int index);
+
+    // Loops numBeats beats of the grid from the beat at or before the playhead. A loop of
+    // less than a beat starts on the nearest whole multiple of its length. Needs a beat grid
+    void setBeatLoop(double numBeats);
+
+    // Marks where the next manual loop starts: the playhead, snapped to the nearest beat
+    // with quantize on
+    void setLoopIn();
+
+    // Loops from the loop in point to the playhead, snapped like the in point
+    void setLoopOut();
+
+    // Multiplies the loop's length, keeping its start: 0.5 halves it and 2 doubles it.
+    // Applied on the audio thread, crossfading if the playhead has to wrap
+    void resizeLoop(double factor);
+
+    // Ends the loop. The deck plays on through the loop end
+    void exitLoop();
+
+    // Returns true while the deck is looping
+    bool isLooping() const noexcept { return transportSource.isLooping(); }
+
+    // Puts a hand on the platter: the record is held still until a velocity arrives, and
+    // from then on plays at whatever rate the platter turns, forwards or backwards
+    void beginScratch();
+
+    // Sets the platter's rate, where 1 is the record's normal speed and negative values
+    // play backwards. The audio thread glides to it, so it can be updated once a frame
+    void setScratchVelocity(double rate);
+
+    // Lets go of the platter. The record glides back to the deck's speed, or to a stop
+    // if the deck is not playing
+    void endScratch();
+
+    // Returns true while a hand is on the platter
+    bool isScratching() const noexcept { return scratchTouched.load(std::memory_order_relaxed); }
+
+    // Sets the beat grid of the loaded track. Loading a new track clears it. Message thread only
+    void setBeatGrid(const BeatGrid& grid);
+
+    // Returns the beat grid of the loaded track; invalid if it is not known
+    BeatGrid getBeatGrid() const;
+
+    // Turns tempo and phase lock to the master clock on or off
+    void setSyncEnabled(bool shouldSync);
+
+    // Returns true if the deck follows the master clock
+    bool isSyncEnabled() const noexcept { return syncEnabled.load(std::memory_order_relaxed); }
+
+    // Turns quantized start and jumps on or off
+    void setQuantizeEnabled(bool shouldQuantize);
+
+    // Returns true if starts and jumps wait for the beat
+    bool isQuantizeEnabled() const noexcept { return quantizeEnabled.load(std::memory_order_relaxed); }
+
+    // Returns true while a quantized start is waiting for its beat
+    bool isStartPending() const noexcept { return startPending.load(std::memory_order_relaxed); }
+
+    // Returns true if the loaded track has a beat grid
+    bool hasBeatGrid() const noexcept { return gridBpm.load(std::memory_order_relaxed) > 0.0; }
+
+    // Returns the position of the sample about to be heard, in beats of the grid. Audio thread only
+    double getBeatPosition() const noexcept;
+
+    // Returns the deck's tempo in beats per device sample at its current speed. Audio thread only
+    double getBeatsPerSample() const noexcept;
+
     // Returns relative playhead position
     double getPositionRelative();
 
@@ -54,17 +184,164 @@ public:
     // Returns total length of track
     double getTrackLength();
 
+    // Returns the device sample rate tracks should be prepared for
+    double getDeviceSampleRate() const;
+
+    // Returns the device block size tracks should be prepared for
+    int getBlockSize() const;
+
+    // Returns the settings new tracks for this deck should be opened with
+    DeckTrack::LoadSettings getLoadSettings();
+
+    // Sets how far ahead of the playhead tracks are decoded. Applies from the next load
+    void setReadAheadSeconds(double seconds);
+
+    // Returns how many times the read-ahead buffer ran dry on this deck
+    int64 getUnderrunCount() const;
+
+    // Returns how many samples were played as silence because of underruns
+    int64 getUnderrunSamples() const;
+
+    // Returns how much audio is decoded ahead of the playhead, in seconds
+    double getBufferedSeconds() const;
+
 private:
+    // Produces a range of the block at the current speed, or the sync speed when synced
+    void render(const AudioSourceChannelInfo& bufferToFill);
+
+    // Produces the block through the scratch engine, ending the scratch once the platter
+    // has been let go and the record is back to speed
+    void renderScratch(const AudioSourceChannelInfo& bufferToFill);
+
+    // Works out this block's tempo and phase correction from the master clock
+    void updateSync() noexcept;
+
+    // Returns how many samples from the start of the block a quantized start should wait
+    double getSamplesUntilStart() const noexcept;
+
+    // Returns how many samples from the start of the block a quantized jump should wait
+    double getSamplesUntilJump(double targetSeconds) const noexcept;
+
+    // Asks the hot cue bank to decode the audio from a hot cue of the current track
+    void prepareHotCue(int index);
+
+    // Returns the position of the sample about to be heard, in the track's samples. Audio thread only
+    double getAudiblePosition() const noexcept;
+
+    // Loop changes, queued by the message thread and applied on the audio thread at the
+    // start of a block, where the audible position is known
+    struct LoopCommand
+    {
+        enum class Type { beats, in, out, resize, exit };
+
+        Type type = Type::exit;
+        double value = 0.0;
+    };
+
+    // Queues a loop change. Dropped if the queue is full. Message thread only
+    void postLoopCommand(LoopCommand::Type type, double value = 0.0);
+
+    // Applies queued loop changes. Audio thread only
+    void applyLoopCommands() noexcept;
+
+    // Applies one loop change. Audio thread only
+    void applyLoopCommand(const LoopCommand& command) noexcept;
+
+    // Returns a position in the track's samples snapped to the nearest beat if quantizing
+    double snapToBeat(double position) const noexcept;
+
     AudioFormatManager& formatManager;
-    std::unique_ptr<AudioFormatReaderSource> readerSource;
-    AudioTransportSource transportSource;
-    ResamplingAudioSource resampleSource{ &transportSource, false, 2 };
+
+    // Shared disk I/O thread and this deck's read-ahead settings
+    TimeSliceThread* readAheadThread;
+    double readAheadSeconds = 2.0;
+    ReadAheadBuffer::Counters readAheadCounters;
+
+    // Decoded tracks shared with the other players
+    DecodedTrackCache* trackCache;
+
+    // Frame indexes for seeking in MP3s
+    AnalysisStore* analysisStore;
+
+    // Hot cues of the loaded track, and the audio decoded from each on the read-ahead thread
+    HotCues hotCues;
+    HotCueBank hotCueBank;
+
+    DeckTransport transportSource;
+
+    // Converts the track to the device rate and applies the speed in one pass
+    FusedResampler resampler{ &transportSource, 2 };
+    std::atomic<int> interpolatorType{ static_cast<int>(FusedResampler::Interpolator::sinc) };
 
     // Current sample rate for audio processing
     double currentSampleRate = 44100.0;
 
+    // Ramp lengths used when parameters change
+    static constexpr double gainRampSeconds = 0.05;
+    static constexpr double speedRampSeconds = 0.1;
+
+    // Block size used while the speed ratio is ramping
+    static constexpr int speedSubBlockSize = 64;
+
+    // Parameters written by the GUI and smoothed on the audio thread
+    SmoothedParameter gain{ 1.0f };
+    SmoothedParameter speed{ 1.0f };
+
     // Vocal mix parameter controlling mid/side processing
-    double vocalMix = 0.5;
+    SmoothedParameter vocalMix{ 0.5f };
+
+    // Key lock: the resampler only converts the rate and the stretcher applies the speed as tempo
+    TimeStretcher stretcher;
+    std::atomic<bool> keyLock{ false };
+    std::atomic<int> keyLockQuality{ static_cast<int>(TimeStretcher::Quality::medium) };
+
+    // Set by seeks and new tracks; the audio thread then flushes the resampler and stretcher
+    std::atomic<bool> flushPending{ false };
+    bool keyLockActive = false;
+
+    // Set by the audio thread while the deck is idle
+    std::atomic<bool> outputSilent{ true };
+
+    // Master clock, and the grid of the loaded track
+    SyncEngine* syncEngine;
+    std::atomic<double> gridBpm{ 0.0 };
+    std::atomic<double> gridFirstBeat{ 0.0 };
+
+    // Longest a phase error is left to close, and the most the correction bends the tempo
+    static constexpr double phaseCorrectionSeconds = 1.0;
+    static constexpr double maxPhaseCorrection = 0.02;
+
+    std::atomic<bool> syncEnabled{ false };
+    std::atomic<bool> quantizeEnabled{ false };
+
+    // Starts and jumps waiting for their beat. A jump target below 0 means none
+    std::atomic<bool> startPending{ false };
+    std::atomic<double> jumpTarget{ -1.0 };
+
+    // Hand-off of loop changes to the audio thread
+    static constexpr int loopCommandCapacity = 16;
+    AbstractFifo loopCommandFifo{ loopCommandCapacity };
+    std::array<LoopCommand, loopCommandCapacity> loopCommands{};
+
+    // Start of the next manual loop in the track's samples, or -1 if not marked
+    std::atomic<int64> loopInPoint{ -1 };
+
+    // How quickly the record follows the hand, and comes back to speed when let go
+    static constexpr double scratchSmoothingSeconds = 0.01;
+    static constexpr double releaseSmoothingSeconds = 0.1;
+
+    // Hand-off of the platter from the GUI: whether it is held, and the rate it turns at
+    std::atomic<bool> scratchTouched{ false };
+    std::atomic<double> scratchVelocity{ 0.0 };
+
+    // Set by the audio thread from the touch until the record is back to speed
+    bool scratchActive = false;
+    ScratchEngine scratch;
+
+    // This block's sync state, worked out by updateSync. Audio thread only
+    bool syncing = false;
+    double syncSpeed = 1.0;
+    double phaseCorrection = 1.0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DJAudioPlayer)
 };
@@ -3,24 +3,75 @@
 
 DeckGUI::DeckGUI(DJAudioPlayer* _player,
     AudioFormatManager& formatManagerToUse,
-    AudioThumbnailCache& cacheToUse,
+    FrameScheduler& schedulerToUse,
+    WaveformCache& cacheToUse,
+    TrackLoader& loaderToUse,
+    TrackAnalyzer& analyzerToUse,
+    LibraryImporter& importerToUse,
+    LibraryStore& libraryToUse,
     const String& label)
-    : player(_player),
-    waveformDisplay(formatManagerToUse, cacheToUse),
+    : waveformDisplay(formatManagerToUse, cacheToUse),
+    scrollingWaveform(*_player, schedulerToUse, "Zoom " + label),
+    waveformCache(cacheToUse),
+    frameScheduler(schedulerToUse),
+    player(_player),
+    trackLoader(loaderToUse),
+    trackAnalyzer(analyzerToUse),
+    libraryImporter(importerToUse),
+    libraryStore(libraryToUse),
     deckLabel(label)
 {
+    // Every pixel is filled, so repainting the border never repaints what is behind
+    setOpaque(true);
+
     // --- Set up buttons ---
     addAndMakeVisible(playButton);
     addAndMakeVisible(stopButton);
     addAndMakeVisible(loadButton);
+    addAndMakeVisible(keyLockButton);
+    keyLockButton.setClickingTogglesState(true);
+    addAndMakeVisible(cueButton);
+    addAndMakeVisible(syncButton);
+    syncButton.setClickingTogglesState(true);
+    addAndMakeVisible(quantizeButton);
+    quantizeButton.setClickingTogglesState(true);
+    addAndMakeVisible(vinylButton);
+    vinylButton.setClickingTogglesState(true);
+    vinylButton.setToggleState(true, dontSendNotification);
+    addAndMakeVisible(loopInButton);
+    addAndMakeVisible(loopOutButton);
+    addAndMakeVisible(loopButton);
+    addAndMakeVisible(loopHalveButton);
+    addAndMakeVisible(loopDoubleButton);
+    for (size_t i = 0; i < hotCueButtons.size(); ++i)
+    {
+        hotCueButtons[i].setButtonText(String(static_cast<int>(i) + 1));
+        addAndMakeVisible(hotCueButtons[i]);
+    }
 
-    // --- Set up waveform display ---
+    // --- Set up waveform displays ---
+    addAndMakeVisible(scrollingWaveform);
     addAndMakeVisible(waveformDisplay);
 
     // --- Register button listeners ---
     playButton.addListener(this);
     stopButton.addListener(this);
     loadButton.addListener(this);
+    keyLockButton.addListener(this);
+    cueButton.addListener(this);
+    syncButton.addListener(this);
+    quantizeButton.addListener(this);
+    loopInButton.addListener(this);
+    loopOutButton.addListener(this);
+    loopButton.addListener(this);
+    loopHalveButton.addListener(this);
+    loopDoubleButton.addListener(this);
+    for (auto& button : hotCueButtons)
+        button.addListener(this);
+
+    // Beat grids arrive from the analyser, and tracks from the importer
+    trackAnalyzer.addListener(this);
+    libraryImporter.addListener(this);
 
     // --- Initialize the color list with 10 distinct colours ---
     colorList.push_back(Colours::red);
@@ -34,26 +85,27 @@ DeckGUI::DeckGUI(DJAudioPlayer* _player,
     colorList.push_back(Colours::lime);
     colorList.push_back(Colours::pink);
 
-    // Set the starting time for the color transition and start the timer
+    // Set the starting time for the color transition and animate with the display
     lastColorUpdateTime = Time::getMillisecondCounterHiRes();
-    startTimer(50); // Timer interval of 50ms
+    frameScheduler.addClient(this, "Deck " + deckLabel);
 }
 
 DeckGUI::~DeckGUI()
 {
-    stopTimer();
+    trackAnalyzer.removeListener(this);
+    libraryImporter.removeListener(this);
+    frameScheduler.removeClient(this);
 }
 
 void DeckGUI::paint(Graphics& g)
 {
+    const FrameScheduler::ScopedPaintTimer paintTimer(*this);
+
     // Background colour
     g.fillAll(Colours::rebeccapurple.darker(2.0f));
 
-    // Draw color-changing border
-    double currentTime = Time::getMillisecondCounterHiRes();
-    double elapsed = currentTime - lastColorUpdateTime;
-    // Limit time to 1 second (1000ms)
-    float factor = static_cast<float>(jlimit(0.0, 1000.0, elapsed) / 1000.0);
+    // Draw color-changing border, at the fade reached by the last frame
+    float factor = colourFade;
     int nextColorIndex = (currentColorIndex + 1) % static_cast<int>(colorList.size());
     Colour effectiveColour = colorList[currentColorIndex].interpolatedWith(colorList[nextColorIndex], factor);
     g.setColour(effectiveColour);
@@ -68,55 +120,20 @@ void DeckGUI::paint(Graphics& g)
         g.fillRect(topBarArea.reduced(2));
     }
 
-    // Turntable drawing
+    // Turntable: cached layers from resized(). The platter is round, so turning it only
+    // shows in the label, which is the one layer blitted with a rotation
+    if (platterImage.isValid() && g.clipRegionIntersects(turntableBounds))
     {
-        auto centerArea = getLocalBounds().reduced(10);
-        // Diameter of the turntable wheel.
-        auto wheelDiameter = jmin(centerArea.getWidth(), centerArea.getHeight()) - 20;
-        float centerX = static_cast<float>(centerArea.getCentreX());
-        float centerY = static_cast<float>(centerArea.getCentreY() + 60);
-
-        // Save the current state of the graphics
-        Graphics::ScopedSaveState state(g);
-        // Rotate the turntable
-        g.addTransform(AffineTransform::rotation(rotationAngle, centerX, centerY));
-
-        // Draw the main turntable circle.
-        g.setColour(Colours::black);
-        g.fillEllipse(centerX - wheelDiameter / 2, centerY - wheelDiameter / 2, wheelDiameter, wheelDiameter);
-        // Draw the outer border of the turntable.
-        g.setColour(Colours::darkgrey);
-        g.drawEllipse(centerX - wheelDiameter / 2, centerY - wheelDiameter / 2, wheelDiameter, wheelDiameter, 3.0f);
-        // Draw an additional border.
-        g.setColour(Colours::red);
-        g.drawEllipse(centerX - wheelDiameter / 2 - 2, centerY - wheelDiameter / 2 - 2, wheelDiameter + 4, wheelDiameter + 4, 2.0f);
+        const auto toBounds = AffineTransform::scale(1.0f / turntableScale)
+            .translated(static_cast<float>(turntableBounds.getX()), static_cast<float>(turntableBounds.getY()));
+        g.drawImageTransformed(platterImage, toBounds);
 
-        // Draw inner circles for turntable
-        int numCircles = 5;
-        float outerRadius = wheelDiameter / 2.0f;
-        for (int j = 1; j <= numCircles; j++)
+        if (labelImage.isValid())
         {
-            float radius = outerRadius - j * (outerRadius / (numCircles + 1));
-            float diameter = radius * 2.0f;
-            float x = centerX - radius;
-            float y = centerY - radius;
-            g.setColour(Colours::grey);
-            g.drawEllipse(x, y, diameter, diameter, 1.0f);
-        }
-
-        //Draw L or R in turntable
-        if (!deckLabel.isEmpty())
-        {
-            float innerRadius = outerRadius - numCircles * (outerRadius / (numCircles + 1));
-            float innerDiameter = innerRadius * 2.0f;
-            g.setColour(Colours::red);
-            Font labelFont(innerDiameter * 0.8f, Font::bold);
-            g.setFont(labelFont);
-            Rectangle<int> labelBounds(static_cast<int>(centerX - innerRadius),
-                static_cast<int>(centerY - innerRadius),
-                static_cast<int>(innerDiameter),
-                static_cast<int>(innerDiameter));
-            g.drawFittedText(deckLabel, labelBounds, Justification::centred, 1);
+            const auto toLabel = AffineTransform::scale(1.0f / turntableScale)
+                .translated(static_cast<float>(labelBounds.getX()), static_cast<float>(labelBounds.getY()))
+                .rotated(rotationAngle, turntableCentre.x, turntableCentre.y);
+            g.drawImageTransformed(labelImage, toLabel);
         }
     }
 
@@ -136,17 +153,124 @@ void DeckGUI::resized()
     // Reserve space for the top colour changing bar
     area.removeFromTop(getHeight() / 30 + 2);
 
-    // Set bounds for the waveform display
+    // Set bounds for the zoomed waveform and the whole-track overview below it
     auto waveHeight = area.getHeight() / 6;
-    waveformDisplay.setBounds(area.removeFromTop(waveHeight).reduced(5));
+    scrollingWaveform.setBounds(area.removeFromTop(waveHeight).reduced(5));
+    waveformDisplay.setBounds(area.removeFromTop(waveHeight / 2).reduced(5));
 
-    // Set bounds for the control buttons
-    auto buttonHeight = area.getHeight() / 10;
+    // Set bounds for the four rows of control buttons, kept clear of the turntable
+    auto buttonHeight = area.getHeight() / 20;
     auto buttonArea = area.removeFromTop(buttonHeight);
-    int buttonWidth = buttonArea.getWidth() / 3;
+    int buttonWidth = buttonArea.getWidth() / 4;
     playButton.setBounds(buttonArea.removeFromLeft(buttonWidth).reduced(5));
     stopButton.setBounds(buttonArea.removeFromLeft(buttonWidth).reduced(5));
     loadButton.setBounds(buttonArea.removeFromLeft(buttonWidth).reduced(5));
+    keyLockButton.setBounds(buttonArea.removeFromLeft(buttonWidth).reduced(5));
+
+    // Cue, the beat sync controls and the platter mode on a second row
+    auto syncArea = area.removeFromTop(buttonHeight);
+    cueButton.setBounds(syncArea.removeFromLeft(buttonWidth).reduced(5));
+    syncButton.setBounds(syncArea.removeFromLeft(buttonWidth).reduced(5));
+    quantizeButton.setBounds(syncArea.removeFromLeft(buttonWidth).reduced(5));
+    vinylButton.setBounds(syncArea.removeFromLeft(buttonWidth).reduced(5));
+
+    // Loop controls on a third row
+    auto loopArea = area.removeFromTop(buttonHeight);
+    int loopButtonWidth = loopArea.getWidth() / 5;
+    loopInButton.setBounds(loopArea.removeFromLeft(loopButtonWidth).reduced(5));
+    loopOutButton.setBounds(loopArea.removeFromLeft(loopButtonWidth).reduced(5));
+    loopButton.setBounds(loopArea.removeFromLeft(loopButtonWidth).reduced(5));
+    loopHalveButton.setBounds(loopArea.removeFromLeft(loopButtonWidth).reduced(5));
+    loopDoubleButton.setBounds(loopArea.removeFromLeft(loopButtonWidth).reduced(5));
+
+    // Hot cues on a fourth row
+    auto hotCueArea = area.removeFromTop(buttonHeight);
+    int hotCueWidth = hotCueArea.getWidth() / HotCues::maxCues;
+    for (auto& button : hotCueButtons)
+        button.setBounds(hotCueArea.removeFromLeft(hotCueWidth).reduced(3, 5));
+
+    renderTurntableLayers();
+}
+
+void DeckGUI::renderTurntableLayers()
+{
+    auto centerArea = getLocalBounds().reduced(10);
+    // Diameter of the turntable wheel.
+    auto wheelDiameter = jmin(centerArea.getWidth(), centerArea.getHeight()) - 20;
+    turntableCentre = { static_cast<float>(centerArea.getCentreX()),
+        static_cast<float>(centerArea.getCentreY() + 60) };
+
+    platterImage = Image();
+    labelImage = Image();
+    turntableBounds = {};
+    if (wheelDiameter <= 0)
+        return;
+
+    // Room for the outer borders, which reach past the wheel
+    float outerRadius = wheelDiameter / 2.0f;
+    turntableBounds = Rectangle<float>(2.0f * (outerRadius + 4.0f), 2.0f * (outerRadius + 4.0f))
+        .withCentre(turntableCentre).getSmallestIntegerContainer();
+
+    // Layers are rendered at the display's resolution so the blits stay sharp
+    turntableScale = static_cast<float>(Component::getApproximateScaleFactorForComponent(this));
+    platterImage = Image(Image::ARGB,
+        roundToInt(turntableBounds.getWidth() * turntableScale),
+        roundToInt(turntableBounds.getHeight() * turntableScale), true);
+
+    // Platter layer, drawn in component coordinates
+    {
+        Graphics g(platterImage);
+        g.addTransform(AffineTransform::translation(static_cast<float>(-turntableBounds.getX()), static_cast<float>(-turntableBounds.getY()))
+            .scaled(turntableScale));
+
+        float centerX = turntableCentre.x;
+        float centerY = turntableCentre.y;
+
+        // Draw the main turntable circle.
+        g.setColour(Colours::black);
+        g.fillEllipse(centerX - wheelDiameter / 2, centerY - wheelDiameter / 2, wheelDiameter, wheelDiameter);
+        // Draw the outer border of the turntable.
+        g.setColour(Colours::darkgrey);
+        g.drawEllipse(centerX - wheelDiameter / 2, centerY - wheelDiameter / 2, wheelDiameter, wheelDiameter, 3.0f);
+        // Draw an additional border.
+        g.setColour(Colours::red);
+        g.drawEllipse(centerX - wheelDiameter / 2 - 2, centerY - wheelDiameter / 2 - 2, wheelDiameter + 4, wheelDiameter + 4, 2.0f);
+
+        // Draw inner circles for turntable
+        for (int j = 1; j <= numTurntableRings; j++)
+        {
+            float radius = outerRadius - j * (outerRadius / (numTurntableRings + 1));
+            float diameter = radius * 2.0f;
+            float x = centerX - radius;
+            float y = centerY - radius;
+            g.setColour(Colours::grey);
+            g.drawEllipse(x, y, diameter, diameter, 1.0f);
+        }
+    }
+
+    //Draw L or R in turntable, on its own layer so it can be rotated
+    if (!deckLabel.isEmpty())
+    {
+        float innerRadius = outerRadius - numTurntableRings * (outerRadius / (numTurntableRings + 1));
+        float innerDiameter = innerRadius * 2.0f;
+        labelBounds = Rectangle<int>(static_cast<int>(turntableCentre.x - innerRadius),
+            static_cast<int>(turntableCentre.y - innerRadius),
+            static_cast<int>(innerDiameter),
+            static_cast<int>(innerDiameter));
+        if (labelBounds.isEmpty())
+            return;
+
+        labelImage = Image(Image::ARGB,
+            roundToInt(labelBounds.getWidth() * turntableScale),
+            roundToInt(labelBounds.getHeight() * turntableScale), true);
+
+        Graphics g(labelImage);
+        g.addTransform(AffineTransform::scale(turntableScale));
+        g.setColour(Colours::red);
+        Font labelFont(innerDiameter * 0.8f, Font::bold);
+        g.setFont(labelFont);
+        g.drawFittedText(deckLabel, labelBounds.withZeroOrigin(), Justification::centred, 1);
+    }
 }
 
 void DeckGUI::buttonClicked(Button* button)
@@ -155,6 +279,7 @@ void DeckGUI::buttonClicked(Button* button)
     {
         std::cout << "Play button was clicked\n";
         player->start();
+        frameScheduler.wake();
     }
     else if (button == &stopButton)
     {
@@ -174,6 +299,134 @@ void DeckGUI::buttonClicked(Button* button)
                 }
             });
     }
+    else if (button == &keyLockButton)
+    {
+        // Keep the pitch when the speed changes
+        player->setKeyLock(keyLockButton.getToggleState());
+    }
+    else if (button == &cueButton)
+    {
+        // Playing, the deck returns to the cue point, on the beat if quantized. Stopped, the
+        // cue point moves to the playhead, snapped to the nearest beat if quantized
+        if (player->isPlaying())
+        {
+            player->jumpTo(cuePoint);
+        }
+        else
+        {
+            cuePoint = player->getCurrentPosition();
+            if (player->isQuantizeEnabled())
+                cuePoint = jmax(0.0, player->getBeatGrid().getNearestBeatTime(cuePoint));
+
+            player->setPosition(cuePoint);
+        }
+        frameScheduler.wake();
+    }
+    else if (button == &syncButton)
+    {
+        // Lock tempo and phase to the master clock
+        player->setSyncEnabled(syncButton.getToggleState());
+    }
+    else if (button == &quantizeButton)
+    {
+        // Start and cue on the beat
+        player->setQuantizeEnabled(quantizeButton.getToggleState());
+    }
+    else if (button == &loopInButton)
+    {
+        player->setLoopIn();
+    }
+    else if (button == &loopOutButton)
+    {
+        player->setLoopOut();
+    }
+    else if (button == &loopButton)
+    {
+        // A beat loop from the current beat, or out of the loop if already in one
+        if (player->isLooping())
+            player->exitLoop();
+        else
+            player->setBeatLoop(beatLoopLength);
+    }
+    else if (button == &loopHalveButton)
+    {
+        player->resizeLoop(0.5);
+    }
+    else if (button == &loopDoubleButton)
+    {
+        player->resizeLoop(2.0);
+    }
+    else
+    {
+        for (size_t i = 0; i < hotCueButtons.size(); ++i)
+            if (button == &hotCueButtons[i])
+                hotCueClicked(static_cast<int>(i));
+    }
+}
+
+void DeckGUI::trackAnalysed(const File& file, const TrackAnalysis& analysis)
+{
+    if (file == loadedFile)
+        player->setBeatGrid(analysis.beatGrid);
+}
+
+void DeckGUI::tracksImported(int /*firstNewTrack*/, const std::vector<int>& /*updatedTracks*/)
+{
+    if (hotCuesUnsaved && libraryStore.findTrack(loadedFile) >= 0)
+        saveHotCues();
+}
+
+void DeckGUI::hotCueClicked(int index)
+{
+    if (loadedFile == File())
+        return;
+
+    if (ModifierKeys::currentModifiers.isShiftDown())
+    {
+        player->clearHotCue(index);
+    }
+    else if (player->getHotCues().isSet(index))
+    {
+        player->triggerHotCue(index);
+        frameScheduler.wake();
+        return;
+    }
+    else
+    {
+        // A new cue goes at the playhead, snapped to the nearest beat if quantized
+        double position = player->getCurrentPosition();
+        if (player->isQuantizeEnabled())
+            position = jmax(0.0, player->getBeatGrid().getNearestBeatTime(position));
+
+        player->setHotCue(index, position);
+    }
+
+    saveHotCues();
+    updateHotCueButtons();
+}
+
+void DeckGUI::saveHotCues()
+{
+    const int row = libraryStore.findTrack(loadedFile);
+    if (row >= 0)
+    {
+        libraryStore.setHotCues(row, player->getHotCues());
+        hotCuesUnsaved = false;
+        return;
+    }
+
+    // A track loaded from outside the library is imported, and the cues saved once it is in
+    if (!hotCuesUnsaved)
+        libraryImporter.import({ loadedFile });
+
+    hotCuesUnsaved = true;
+}
+
+void DeckGUI::updateHotCueButtons()
+{
+    const auto& hotCues = player->getHotCues();
+    for (size_t i = 0; i < hotCueButtons.size(); ++i)
+        hotCueButtons[i].setToggleState(hotCues.isSet(static_cast<int>(i)), dontSendNotification);
 }
 
 bool DeckGUI::isInterestedInFileDrag(const StringArray& files)
@@ -185,35 +438,71 @@ bool DeckGUI::isInterestedInFileDrag(const StringArray& files)
 void DeckGUI::filesDropped(const StringArray& files, int x, int y)
 {
     std::cout << "DeckGUI::filesDropped" << std::endl;
-    if (files.size() == 1)
+    if (files.size() == 1 && File(files[0]).existsAsFile())
     {
-        File file{ files[0] };
-        if (file.existsAsFile())
-            loadFile(file);
+        loadFile(File(files[0]));
+        return;
     }
+
+    // Several files or a folder go into the library instead
+    Array<File> filesToImport;
+    for (const auto& path : files)
+        filesToImport.add(File(path));
+
+    libraryImporter.import(filesToImport);
 }
 
-void DeckGUI::timerCallback()
+bool DeckGUI::advanceFrame(double frameTimeMs)
 {
     // Update waveform position relative to playback position
     waveformDisplay.setPositionRelative(player->getPositionRelative());
 
+    // The loop can end without the button, such as on a seek out of it
+    loopButton.setToggleState(player->isLooping(), dontSendNotification);
+
+    // While scratching, the platter's speed since the last frame is the record's rate
+    if (draggingTurntable && player->isScratching())
+    {
+        if (lastScratchFrameTime >= 0.0 && frameTimeMs > lastScratchFrameTime)
+        {
+            const double revolutions = (accumulatedDeltaAngle - scratchAngle) / MathConstants<double>::twoPi;
+            player->setScratchVelocity(revolutions * secondsPerRevolution * 1000.0 / (frameTimeMs - lastScratchFrameTime));
+        }
+        scratchAngle = accumulatedDeltaAngle;
+        lastScratchFrameTime = frameTimeMs;
+    }
+
+    // The border only cycles while the deck plays, so a stopped deck is completely still
+    double currentTime = frameTimeMs;
+    if (!player->isPlaying())
+    {
+        lastColorUpdateTime = currentTime - colourFade * 1000.0;
+        return draggingTurntable || player->isStartPending();
+    }
+
     // Color transition for the border
-    double currentTime = Time::getMillisecondCounterHiRes();
     if (currentTime - lastColorUpdateTime >= 1000.0)
     {
         currentColorIndex = (currentColorIndex + 1) % static_cast<int>(colorList.size());
         lastColorUpdateTime = currentTime;
     }
-    repaint();
+    colourFade = static_cast<float>(jlimit(0.0, 1000.0, currentTime - lastColorUpdateTime) / 1000.0);
+
+    // Only the border and bars change colour. Repainting just those leaves the children
+    // alone; the zoomed waveform is a client of the scheduler itself
+    const int barHeight = getHeight() / 30;
+    repaint(0, 0, getWidth(), barHeight);
+    repaint(0, getHeight() - barHeight, getWidth(), barHeight);
+    repaint(0, 0, 4, getHeight());
+    repaint(getWidth() - 4, 0, 4, getHeight());
+    return true;
 }
 
 void DeckGUI::mouseDown(const MouseEvent& event)
 {
     auto centerArea = getLocalBounds().reduced(10);
     auto wheelDiameter = jmin(centerArea.getWidth(), centerArea.getHeight()) - 20;
-    Point<float> center(static_cast<float>(centerArea.getCentreX()),
-        static_cast<float>(centerArea.getCentreY()));
+    Point<float> center = turntableCentre;
     float distance = event.position.getDistanceFrom(center);
     // Start dragging if the click is within the turntable
     if (distance <= wheelDiameter / 2.0f)
@@ -223,6 +512,15 @@ void DeckGUI::mouseDown(const MouseEvent& event)
         lastMouseAngle = std::atan2(event.position.y - center.getY(), event.position.x - center.getX());
         accumulatedDeltaAngle = 0.0;
         initialTrackPosition = player->getCurrentPosition();
+
+        // In vinyl mode the hand holds the record, which then follows the platter
+        if (vinylButton.getToggleState())
+        {
+            scratchAngle = 0.0;
+            lastScratchFrameTime = -1.0;
+            player->beginScratch();
+            frameScheduler.wake();
+        }
     }
 }
 
@@ -230,9 +528,7 @@ void DeckGUI::mouseDrag(const MouseEvent& event)
 {
     if (draggingTurntable)
     {
-        auto centerArea = getLocalBounds().reduced(10);
-        Point<float> center(static_cast<float>(centerArea.getCentreX()),
-            static_cast<float>(centerArea.getCentreY()));
+        Point<float> center = turntableCentre;
         // Calculate the current angle of the mouse relative to the center
         float currentMouseAngle = std::atan2(event.position.y - center.getY(), event.position.x - center.getX());
         float deltaAngle = currentMouseAngle - lastMouseAngle;
@@ -246,22 +542,34 @@ void DeckGUI::mouseDrag(const MouseEvent& event)
         accumulatedDeltaAngle += deltaAngle;
         lastMouseAngle = currentMouseAngle;
         rotationAngle += deltaAngle;
+        frameScheduler.wake();
+
+        // A scratch takes the platter's speed each frame; only the turntable is drawn here
+        if (player->isScratching())
+        {
+            repaint(turntableBounds);
+            return;
+        }
 
         // Calculate the corresponding track offset
-        double secondsPerRadian = 5.0 / (2.0 * MathConstants<double>::pi);
+        double secondsPerRadian = secondsPerRevolution / (2.0 * MathConstants<double>::pi);
         double offset = accumulatedDeltaAngle * secondsPerRadian;
         double newPosition = initialTrackPosition + offset;
         double trackLength = player->getTrackLength();
         // Clamp the new position in track length.
         newPosition = jlimit(0.0, trackLength, newPosition);
         player->setPosition(newPosition);
-        repaint();
+        // Only the turntable has moved
+        repaint(turntableBounds);
     }
 }
 
 void DeckGUI::mouseUp(const MouseEvent& /*event*/)
 {
-    // End dragging of turntable
+    // End dragging of turntable, letting go of the record
+    if (draggingTurntable && player->isScratching())
+        player->endScratch();
+
     draggingTurntable = false;
 }
 
@@ -269,8 +577,59 @@ void DeckGUI::loadFile(const File& file)
 {
     if (file.existsAsFile())
     {
-        // Load file into both audio player and waveform display
-        player->loadURL(juce::URL(file));
-        waveformDisplay.loadURL(juce::URL(file));
+        // Open the file on the loader thread; the player swaps it in once it is ready
+        waveformDisplay.setLoadProgress(0.0f);
+
+        // Find its beat grid in the background (nothing happens if it is already known)
+        trackAnalyzer.analyse(file);
+
+        Component::SafePointer<DeckGUI> safeThis(this);
+        trackLoader.loadTrack(*player, juce::URL(file),
+            [safeThis](float progress)
+            {
+                if (safeThis != nullptr)
+                    safeThis->waveformDisplay.setLoadProgress(progress);
+            },
+            [safeThis](DeckTrack::Ptr track)
+            {
+                if (safeThis != nullptr)
+                    safeThis->trackLoaded(track);
+            });
     }
 }
+
+void DeckGUI::trackLoaded(DeckTrack::Ptr track)
+{
+    loadedFile = File();
+    cuePoint = 0.0;
+    hotCuesUnsaved = false;
+
+    if (track == nullptr)
+    {
+        std::cout << "DeckGUI::trackLoaded could not open file" << std::endl;
+        waveformDisplay.loadReader(nullptr, 0);
+        scrollingWaveform.setPeaks(nullptr);
+        return;
+    }
+
+    // The grid is known already if the track has been analysed before; otherwise it comes
+    // to trackAnalysed
+    loadedFile = track->getURL().getLocalFile();
+    BeatGrid grid;
+    if (trackAnalyzer.getBeatGrid(loadedFile, grid))
+        player->setBeatGrid(grid);
+
+    // Hot cues come back from the library
+    const int row = libraryStore.findTrack(loadedFile);
+    if (row >= 0)
+        player->setHotCues(libraryStore.getHotCues(row));
+    updateHotCueButtons();
+
+    // Hand the spare reader to the waveform so it does not reopen the file. Keying the
+    // peaks by the file's contents, found while loading, lets a known track's waveform
+    // come from the store
+    waveformDisplay.loadReader(track->releasePreviewReader().release(), track->getContentKey());
+
+    // The zoomed view draws from the same peaks as the overview
+    scrollingWaveform.setPeaks(waveformDisplay.getPeaks());
+}
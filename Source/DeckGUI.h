@@ -2,41 +2,63 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "DJAudioPlayer.h"
+#include "FrameScheduler.h"
+#include "LibraryImporter.h"
+#include "LibraryStore.h"
+#include "ScrollingWaveform.h"
+#include "TrackAnalyzer.h"
+#include "TrackLoader.h"
 #include "WaveformDisplay.h"
+#include <array>
 
 // Constructs DeckGUI object
 class DeckGUI : public Component,
     public Button::Listener,
     public FileDragAndDropTarget,
-    public Timer
+    public FrameScheduler::Client,
+    public TrackAnalyzer::Listener,
+    public LibraryImporter::Listener
 {
 public:
     // Constructs DeckGUI
     DeckGUI(DJAudioPlayer* player,
         AudioFormatManager& formatManagerToUse,
-        AudioThumbnailCache& cacheToUse,
+        FrameScheduler& schedulerToUse,
+        WaveformCache& cacheToUse,
+        TrackLoader& loaderToUse,
+        TrackAnalyzer& analyzerToUse,
+        LibraryImporter& importerToUse,
+        LibraryStore& libraryToUse,
         const String& deckLabel = String());
 
-    // Destroys DeckGUI, stopping any running timers
+    // Destroys DeckGUI, leaving the frame scheduler
     ~DeckGUI();
 
     // Draws components
     void paint(Graphics&) override;
 
-    // Resizes child components: waveform display + control buttons
+    // Resizes child components: waveform displays + control buttons
     void resized() override;
 
-    // Button click event for DeckGUI buttons: play, stop, load
+    // Button click event for DeckGUI buttons: play, stop, load, key lock, cue, sync, quantize,
+    // the loop controls and the hot cues
     void buttonClicked(Button*) override;
 
+    // Hands the loaded track's beat grid to the player once its analysis is done
+    void trackAnalysed(const File& file, const TrackAnalysis& analysis) override;
+
+    // Saves hot cues set on a track from outside the library once it has been imported
+    void tracksImported(int firstNewTrack, const std::vector<int>& updatedTracks) override;
+
     // Indicates file drag-and-drop events
     bool isInterestedInFileDrag(const StringArray& files) override;
 
-    // Handles files dropped onto component
+    // Loads a single dropped file; several files or a folder are imported into the library
     void filesDropped(const StringArray& files, int x, int y) override;
 
-    // Timer callback
-    void timerCallback() override;
+    // Moves the playhead and border colour on to the frame time. Returns false once the
+    // deck is stopped and nothing on it moves
+    bool advanceFrame(double frameTimeMs) override;
 
     // Handles mousePress for turntable
     void mouseDown(const MouseEvent& event) override;
@@ -47,21 +69,74 @@ public:
     // Handles mouseRelease events for turntable
     void mouseUp(const MouseEvent& event) override;
 
-    // Loads audio file
+    // Loads audio file in the background
     void loadFile(const File& file);
 
 private:
+    // Renders the turntable layers for the current size. Paint only blits them
+    void renderTurntableLayers();
+
+    // Called on the message thread once a background load has finished
+    void trackLoaded(DeckTrack::Ptr track);
+
+    // Sets, jumps to or, with shift held, clears a hot cue
+    void hotCueClicked(int index);
+
+    // Stores the player's hot cues with the loaded track in the library
+    void saveHotCues();
+
+    // Lights the buttons of the hot cues that are set
+    void updateHotCueButtons();
+
     TextButton playButton{ "PLAY" };
     TextButton stopButton{ "STOP" };
     TextButton loadButton{ "LOAD" };
+    TextButton keyLockButton{ "KEY LOCK" };
+    TextButton cueButton{ "CUE" };
+    TextButton syncButton{ "SYNC" };
+    TextButton quantizeButton{ "QUANT" };
+    TextButton vinylButton{ "VINYL" };
+    TextButton loopInButton{ "IN" };
+    TextButton loopOutButton{ "OUT" };
+    TextButton loopButton{ "LOOP" };
+    TextButton loopHalveButton{ "1/2" };
+    TextButton loopDoubleButton{ "X2" };
+
+    // Length of the LOOP button's loop, in beats
+    static constexpr double beatLoopLength = 4.0;
+
+    std::array<TextButton, HotCues::maxCues> hotCueButtons;
 
     FileChooser fChooser{ "Select a file..." };
     WaveformDisplay waveformDisplay;
+    ScrollingWaveform scrollingWaveform;
+    WaveformCache& waveformCache;
+    FrameScheduler& frameScheduler;
     DJAudioPlayer* player;
+    TrackLoader& trackLoader;
+    TrackAnalyzer& trackAnalyzer;
+    LibraryImporter& libraryImporter;
+    LibraryStore& libraryStore;
 
     // Deck label for L and R of turntable
     String deckLabel;
 
+    // Track on the deck and its cue point in seconds
+    File loadedFile;
+    double cuePoint = 0.0;
+
+    // True while hot cues wait for the loaded track to be imported into the library
+    bool hotCuesUnsaved = false;
+
+    // Cached turntable layers and where they go; the label layer is the one that rotates
+    static constexpr int numTurntableRings = 5;
+    Image platterImage;
+    Image labelImage;
+    Rectangle<int> turntableBounds;
+    Rectangle<int> labelBounds;
+    Point<float> turntableCentre;
+    float turntableScale = 1.0f;
+
     // Rotation angle of turntable (radian)
     float rotationAngle = 0.0f;
 
@@ -69,6 +144,14 @@ private:
     float lastMouseAngle = 0.0f;
     double accumulatedDeltaAngle = 0.0; 
 
+    // Seconds of the track in one turn of the platter
+    static constexpr double secondsPerRevolution = 5.0;
+
+    // Rotation already turned into a scratch velocity, and the frame it was measured at;
+    // below 0 until the first frame of a scratch
+    double scratchAngle = 0.0;
+    double lastScratchFrameTime = -1.0;
+
     // Stores the track position (in seconds)
     double initialTrackPosition = 0.0;
 
@@ -77,6 +160,7 @@ private:
     // Variables for color change of the border outline
     int currentColorIndex = 0;
     double lastColorUpdateTime = 0.0;
+    float colourFade = 0.0f;
     std::vector<Colour> colorList;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckGUI)
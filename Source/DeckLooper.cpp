@@ -0,0 +1,278 @@
+#include "DeckLooper.h"
+#include <cmath>
+
+namespace
+{
+    // Shortest loop, so a seam's crossfade never overlaps the next one
+    constexpr int64 minLoopLength = 2 * DeckLooper::fadeLength;
+
+    // Longest loop, leaving room in memory for the audio read past its end at each seam
+    constexpr int64 maxLoopLength = DeckLooper::historySize - 2 * DeckLooper::fadeLength;
+}
+
+//------------------------------------------------------------------------------
+DeckLooper::DeckLooper()
+    : history(2, historySize),
+    fadeBuffer(2, fadeLength)
+{
+    history.clear();
+    fadeBuffer.clear();
+
+    // Raised cosine: the two gains always sum to one
+    for (int i = 0; i < fadeLength; ++i)
+        fadeInGains[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(MathConstants<float>::pi * (i + 0.5f) / fadeLength);
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::seek(DeckTrack& track, int64 newPosition) noexcept
+{
+    newPosition = jmax<int64>(0, newPosition);
+
+    // Leaving the loop ends it
+    if (isLooping() && (newPosition < getLoopStart() || newPosition >= getLoopEnd()))
+        clearLoop();
+
+    track.setNextReadPosition(newPosition);
+    historyStart = historyEnd = position = newPosition;
+    fadeRemaining = 0;
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::continueWith(DeckTrack& track) noexcept
+{
+    track.setNextReadPosition(historyEnd);
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::jump(DeckTrack& track, int64 target, const AudioBuffer<float>* preroll) noexcept
+{
+    target = jmax<int64>(0, target);
+
+    if (isLooping() && (target < getLoopStart() || target >= getLoopEnd()))
+        clearLoop();
+
+    // The outgoing audio is taken up front, as the recording it comes from may not
+    // survive the jump. It is recorded or where the track reads next, so this never seeks
+    fadeRemaining = 0;
+    if (position >= historyStart && position <= historyEnd)
+    {
+        auto outgoing = position;
+        readFrom(track, outgoing, fadeBuffer, 0, fadeLength);
+        fadeRemaining = fadeLength;
+    }
+
+    // Recorded audio is played from memory. Otherwise the preroll is recorded in place of
+    // the track's audio, and the track seeks past it so it has time to refill
+    if (!isRecorded(target, fadeLength))
+    {
+        historyStart = historyEnd = target;
+
+        if (preroll != nullptr)
+            copyToHistory(*preroll, 0, preroll->getNumSamples());
+
+        track.setNextReadPosition(historyEnd);
+    }
+
+    position = target;
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::read(DeckTrack& track, const AudioSourceChannelInfo& bufferToFill) noexcept
+{
+    if (bufferToFill.buffer == nullptr)
+        return;
+
+    auto& dest = *bufferToFill.buffer;
+    const int numChannels = jmin(dest.getNumChannels(), history.getNumChannels());
+
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        int num = bufferToFill.numSamples - done;
+
+        // At the loop end the playhead goes back by whole loops
+        const int64 start = getLoopStart();
+        const int64 end = getLoopEnd();
+        if (end > 0)
+        {
+            if (position >= end)
+            {
+                jump(track, start + (position - start) % (end - start));
+                continue;
+            }
+
+            num = static_cast<int>(jmin<int64>(num, end - position));
+        }
+
+        if (fadeRemaining > 0)
+            num = jmin(num, fadeRemaining);
+
+        const int destStart = bufferToFill.startSample + done;
+        readFrom(track, position, dest, destStart, num);
+
+        // Mix in the outgoing audio, fading out as the new audio fades in
+        if (fadeRemaining > 0)
+        {
+            const int firstGain = fadeLength - fadeRemaining;
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* out = dest.getWritePointer(ch, destStart);
+                const auto* outgoing = fadeBuffer.getReadPointer(ch, firstGain);
+                for (int i = 0; i < num; ++i)
+                {
+                    const float fadeIn = fadeInGains[static_cast<size_t>(firstGain + i)];
+                    out[i] = out[i] * fadeIn + outgoing[i] * (1.0f - fadeIn);
+                }
+            }
+
+            fadeRemaining -= num;
+        }
+
+        done += num;
+    }
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::peek(DeckTrack& track, int64 start, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept
+{
+    if (start < historyStart)
+    {
+        const int silent = static_cast<int>(jmin<int64>(numSamples, historyStart - start));
+        dest.clear(destStart, silent);
+        start += silent;
+        destStart += silent;
+        numSamples -= silent;
+    }
+
+    // Ahead of the recording the track reads on up to start, recorded as it goes, with
+    // dest standing in as somewhere to put it
+    while (numSamples > 0 && historyEnd < start)
+    {
+        auto pos = historyEnd;
+        readFrom(track, pos, dest, destStart, static_cast<int>(jmin<int64>(numSamples, start - historyEnd)));
+    }
+
+    if (numSamples > 0)
+        readFrom(track, start, dest, destStart, numSamples);
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::setPosition(DeckTrack& track, int64 newPosition) noexcept
+{
+    newPosition = jmax<int64>(0, newPosition);
+    fadeRemaining = 0;
+
+    if (newPosition >= historyStart && newPosition <= historyEnd)
+    {
+        position = newPosition;
+    }
+    else
+    {
+        track.setNextReadPosition(newPosition);
+        historyStart = historyEnd = position = newPosition;
+    }
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::setLoop(int64 start, int64 end) noexcept
+{
+    start = jmax<int64>(0, start);
+    const int64 length = jlimit(minLoopLength, maxLoopLength, end - start);
+
+    // Published end last, so a reader that sees the loop sees its start
+    loopStart.store(start, std::memory_order_relaxed);
+    loopEnd.store(start + length, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::setLoopLength(int64 length) noexcept
+{
+    if (isLooping())
+        setLoop(getLoopStart(), getLoopStart() + length);
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::clearLoop() noexcept
+{
+    loopEnd.store(-1, std::memory_order_relaxed);
+    loopStart.store(-1, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+bool DeckLooper::isRecorded(int64 start, int64 numSamples) const noexcept
+{
+    return start >= historyStart && start + numSamples <= historyEnd;
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::readFrom(DeckTrack& track, int64& pos, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept
+{
+    while (numSamples > 0)
+    {
+        // Fresh audio: the track is already there, and what it reads is recorded
+        if (pos == historyEnd)
+        {
+            track.getNextAudioBlock(AudioSourceChannelInfo(&dest, destStart, numSamples));
+            copyToHistory(dest, destStart, numSamples);
+            pos += numSamples;
+            return;
+        }
+
+        // Nothing recorded here, so the track has to go to it after all
+        if (!isRecorded(pos, 1))
+        {
+            track.setNextReadPosition(pos);
+            historyStart = historyEnd = pos;
+            continue;
+        }
+
+        const int num = static_cast<int>(jmin<int64>(numSamples, historyEnd - pos));
+        copyFromHistory(pos, dest, destStart, num);
+        pos += num;
+        destStart += num;
+        numSamples -= num;
+    }
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::copyFromHistory(int64 start, AudioBuffer<float>& dest, int destStart, int numSamples) const noexcept
+{
+    const int numChannels = jmin(dest.getNumChannels(), history.getNumChannels());
+
+    // The ring may wrap within the range
+    const int offset = static_cast<int>(start % historySize);
+    const int first = jmin(numSamples, historySize - offset);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        dest.copyFrom(ch, destStart, history, ch, offset, first);
+        if (first < numSamples)
+            dest.copyFrom(ch, destStart + first, history, ch, 0, numSamples - first);
+    }
+}
+
+//------------------------------------------------------------------------------
+void DeckLooper::copyToHistory(const AudioBuffer<float>& source, int sourceStart, int numSamples) noexcept
+{
+    const int numChannels = jmin(source.getNumChannels(), history.getNumChannels());
+
+    // Only the newest historySize samples fit
+    if (numSamples > historySize)
+    {
+        sourceStart += numSamples - historySize;
+        historyEnd += numSamples - historySize;
+        numSamples = historySize;
+    }
+
+    const int offset = static_cast<int>(historyEnd % historySize);
+    const int first = jmin(numSamples, historySize - offset);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        history.copyFrom(ch, offset, source, ch, sourceStart, first);
+        if (first < numSamples)
+            history.copyFrom(ch, 0, source, ch, sourceStart + first, numSamples - first);
+    }
+
+    historyEnd += numSamples;
+    historyStart = jmax(historyStart, historyEnd - historySize);
+}
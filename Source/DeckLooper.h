@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckTrack.h"
+#include <array>
+#include <atomic>
+
+// DeckLooper reads a deck's track and plays its loops from memory. Everything read from
+// the track also goes into a ring of recent audio, so once the playhead has passed through
+// a loop every later pass comes from RAM and the track's reader is never sent back: a
+// streaming decoder is only ever read forwards. The track always sits where the recorded
+// audio ends, so leaving a loop, or doubling it, plays on from memory up to that point
+// and then carries on from the track without a seek.
+//
+// Jumps, such as a loop wrapping or being halved or a hot cue, crossfade the outgoing and
+// incoming audio over a few milliseconds, so seams never click. A jump outside the
+// recorded audio can bring a preroll, the audio decoded ahead from the target: it is
+// played from memory while the track seeks to where it ends. Positions are in the
+// track's own samples. Audio thread only, apart from the loop getters
+class DeckLooper
+{
+public:
+    // Longest loop that fits in memory, in track samples
+    static constexpr int historySize = 1 << 20;
+
+    // Length of the crossfade at a seam, in track samples
+    static constexpr int fadeLength = 256;
+
+    // Constructs a looper, allocating the ring of recent audio. Not for the audio thread
+    DeckLooper();
+
+    // Forgets the recorded audio and moves the playhead and the track to position. A seek
+    // outside the loop ends it
+    void seek(DeckTrack& track, int64 position) noexcept;
+
+    // Moves the playhead, crossfading from the audio it leaves. A target that has not been
+    // recorded is played from preroll if one is given, holding the audio from the target
+    // on, and otherwise the track seeks to it. A jump outside the loop ends it
+    void jump(DeckTrack& track, int64 target, const AudioBuffer<float>* preroll = nullptr) noexcept;
+
+    // Takes a replacement for the same file, which carries on where the old track was.
+    // The recorded audio stays valid
+    void continueWith(DeckTrack& track) noexcept;
+
+    // Fills the block from memory or the track, wrapping at the loop end
+    void read(DeckTrack& track, const AudioSourceChannelInfo& bufferToFill) noexcept;
+
+    // Reads audio from start into dest without moving the playhead, for a scratch that
+    // plays the audio itself. Recorded audio comes from memory and audio past the
+    // recording from the track, which reads on to it. Audio from before the recording is
+    // silence: the track is never sent back for it
+    void peek(DeckTrack& track, int64 start, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept;
+
+    // Moves the playhead without a crossfade, for a scratch handing back the point it
+    // reached. A position outside the recording seeks. The loop stays set
+    void setPosition(DeckTrack& track, int64 newPosition) noexcept;
+
+    // Returns the playhead, in track samples
+    int64 getPosition() const noexcept { return position; }
+
+    // Loops from start to end, within the length memory holds. A playhead already past
+    // the end wraps into the loop at the next read
+    void setLoop(int64 start, int64 end) noexcept;
+
+    // Changes the loop's length, keeping its start. A playhead past the new end wraps
+    // into the loop, which crossfades like any other seam
+    void setLoopLength(int64 length) noexcept;
+
+    // Stops looping. The playhead carries on through the loop end
+    void clearLoop() noexcept;
+
+    // Returns true while a loop is set
+    bool isLooping() const noexcept { return loopEnd.load(std::memory_order_relaxed) > 0; }
+
+    // Returns the loop start in track samples, or -1. Any thread
+    int64 getLoopStart() const noexcept { return loopStart.load(std::memory_order_relaxed); }
+
+    // Returns the loop end in track samples, or -1. Any thread
+    int64 getLoopEnd() const noexcept { return loopEnd.load(std::memory_order_relaxed); }
+
+private:
+    // Returns true if the audio from start for numSamples has been recorded
+    bool isRecorded(int64 start, int64 numSamples) const noexcept;
+
+    // Reads from pos onwards into dest, from memory where recorded and otherwise from the
+    // track, recording what it reads. pos moves on by numSamples
+    void readFrom(DeckTrack& track, int64& pos, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept;
+
+    // Copies recorded audio into dest
+    void copyFromHistory(int64 start, AudioBuffer<float>& dest, int destStart, int numSamples) const noexcept;
+
+    // Records audio just read from the track
+    void copyToHistory(const AudioBuffer<float>& source, int sourceStart, int numSamples) noexcept;
+
+    // Recent audio, indexed by track sample modulo historySize. Samples from historyStart
+    // to historyEnd are valid, and the track reads from historyEnd next
+    AudioBuffer<float> history;
+    int64 historyStart = 0;
+    int64 historyEnd = 0;
+
+    int64 position = 0;
+
+    // Loop, published for the message thread; the end is -1 when not looping
+    std::atomic<int64> loopStart{ -1 };
+    std::atomic<int64> loopEnd{ -1 };
+
+    // Crossfade in progress: the outgoing audio, taken when the jump was made
+    int fadeRemaining = 0;
+    AudioBuffer<float> fadeBuffer;
+    std::array<float, fadeLength> fadeInGains;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckLooper)
+};
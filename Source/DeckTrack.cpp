@@ -0,0 +1,222 @@
+#include "DeckTrack.h"
+#include "AnalysisStore.h"
+#include "IndexedMp3Reader.h"
+#include "MappedAudioSource.h"
+
+namespace
+{
+    // Creates a reader for the URL, or nullptr if no registered format understands it
+    AudioFormatReader* createReader(AudioFormatManager& formatManager, const URL& url)
+    {
+        if (url.isLocalFile())
+            return formatManager.createReaderFor(url.getLocalFile());
+
+        return formatManager.createReaderFor(url.createInputStream(false));
+    }
+
+    // Plays a decoded cache entry straight from memory. Holding the entry keeps it from
+    // being evicted while the track is loaded
+    class CachedAudioSource : public PositionableAudioSource
+    {
+    public:
+        explicit CachedAudioSource(DecodedTrackCache::Entry::Ptr entryToPlay)
+            : entry(std::move(entryToPlay))
+        {
+        }
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+
+        void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override
+        {
+            const auto& audio = entry->getAudio();
+            const int available = static_cast<int>(jlimit((int64) 0, (int64) bufferToFill.numSamples,
+                audio.getNumSamples() - position));
+
+            for (int ch = 0; ch < bufferToFill.buffer->getNumChannels(); ++ch)
+            {
+                if (ch < audio.getNumChannels() && available > 0)
+                    bufferToFill.buffer->copyFrom(ch, bufferToFill.startSample, audio, ch, static_cast<int>(position), available);
+                else
+                    bufferToFill.buffer->clear(ch, bufferToFill.startSample, available);
+            }
+
+            // Silence past the end of the track
+            if (available < bufferToFill.numSamples)
+                bufferToFill.buffer->clear(bufferToFill.startSample + available, bufferToFill.numSamples - available);
+
+            position += bufferToFill.numSamples;
+        }
+
+        void setNextReadPosition(int64 newPosition) override { position = jmax((int64) 0, newPosition); }
+        int64 getNextReadPosition() const override { return position; }
+        int64 getTotalLength() const override { return entry->getAudio().getNumSamples(); }
+        bool isLooping() const override { return false; }
+
+    private:
+        DecodedTrackCache::Entry::Ptr entry;
+        int64 position = 0;
+    };
+
+    // Wraps a reader for streaming playback, decoding ahead on the deck's I/O thread if it has one
+    std::unique_ptr<PositionableAudioSource> createStreamingSource(AudioFormatReader* reader,
+        const DeckTrack::LoadSettings& settings)
+    {
+        std::unique_ptr<PositionableAudioSource> readerSource(new AudioFormatReaderSource(reader, true));
+
+        if (settings.readAheadThread == nullptr)
+            return readerSource;
+
+        const auto bufferSamples = roundToInt(settings.readAheadSeconds * reader->sampleRate);
+        return std::make_unique<ReadAheadBuffer>(std::move(readerSource), *settings.readAheadThread,
+            bufferSamples, settings.readAheadCounters);
+    }
+}
+
+DeckTrack::DeckTrack(const URL& trackURL, std::unique_ptr<PositionableAudioSource> source,
+    double sampleRate, bool isFromCache)
+    : url(trackURL),
+    sourceSampleRate(sampleRate),
+    lengthInSamples(source->getTotalLength()),
+    cached(isFromCache),
+    playbackSource(std::move(source))
+{
+    readAhead = dynamic_cast<ReadAheadBuffer*>(playbackSource.get());
+    mapped = dynamic_cast<MappedAudioSource*>(playbackSource.get()) != nullptr;
+}
+
+DeckTrack::~DeckTrack()
+{
+}
+
+// Opens the track and runs a block through it so the decoder and OS cache are warm
+DeckTrack::Ptr DeckTrack::open(AudioFormatManager& formatManager,
+    const URL& url,
+    const LoadSettings& settings,
+    const ProgressCallback& progress)
+{
+    auto keepGoing = [&progress](float amount) { return progress == nullptr || progress(amount); };
+
+    Ptr track;
+
+    // The store knows an unchanged file by its path; any other is read to find its key
+    const uint64 contentKey = settings.analysisStore != nullptr && url.isLocalFile()
+        ? settings.analysisStore->getKey(url.getLocalFile()) : 0;
+
+    // Tracks already in the decoded cache play from memory without touching the decoder
+    if (settings.cache != nullptr && url.isLocalFile())
+        if (auto entry = settings.cache->find(url.getLocalFile()))
+            track = new DeckTrack(url, std::make_unique<CachedAudioSource>(entry), entry->getSampleRate(), true);
+
+    // Uncompressed files play straight from a memory map, prefetched on the I/O thread
+    if (track == nullptr && settings.useMemoryMapping && url.isLocalFile())
+    {
+        if (auto mappedSource = MappedAudioSource::create(formatManager, url.getLocalFile(),
+            settings.readAheadThread, settings.readAheadSeconds))
+        {
+            const auto sampleRate = mappedSource->getSampleRate();
+            track = new DeckTrack(url, std::move(mappedSource), sampleRate, false);
+        }
+    }
+
+    // Otherwise (compressed formats) probe the file and open a streaming reader. An MP3
+    // with a frame index seeks through it, so a seek decodes a few frames at most
+    if (track == nullptr)
+    {
+        std::shared_ptr<const Mp3FrameIndex> frameIndex;
+        std::unique_ptr<AudioFormatReader> reader;
+        if (settings.analysisStore != nullptr && url.isLocalFile())
+        {
+            frameIndex = Mp3FrameIndex::findOrBuild(formatManager, url.getLocalFile(), contentKey, *settings.analysisStore);
+            reader = IndexedMp3Reader::create(formatManager, url.getLocalFile(), frameIndex);
+        }
+
+        if (reader == nullptr)
+        {
+            frameIndex = nullptr;
+            reader.reset(createReader(formatManager, url));
+        }
+
+        if (reader == nullptr)
+            return nullptr;
+
+        const auto sampleRate = reader->sampleRate;
+        track = new DeckTrack(url, createStreamingSource(reader.release(), settings), sampleRate, false);
+        track->frameIndex = std::move(frameIndex);
+    }
+
+    track->contentKey = contentKey;
+    if (!keepGoing(0.3f))
+        return nullptr;
+
+    // A second reader lets the waveform scan the file without touching the playback reader
+    track->previewReader.reset(createReader(formatManager, url));
+    if (!keepGoing(0.5f))
+        return nullptr;
+
+    track->prepare(settings.blockSize);
+    if (!keepGoing(0.6f))
+        return nullptr;
+
+    // Let the I/O thread get half a buffer ahead before the deck can start
+    if (track->readAhead != nullptr)
+    {
+        track->readAhead->waitForData(track->readAhead->getBufferSize() / 2, 2000);
+        if (!keepGoing(0.8f))
+            return nullptr;
+    }
+
+    // Prime the decoder, then rewind
+    AudioBuffer<float> scratch(2, jmax(1, settings.blockSize));
+    track->getNextAudioBlock(AudioSourceChannelInfo(scratch));
+    track->setNextReadPosition(0);
+
+    if (!keepGoing(1.0f))
+        return nullptr;
+
+    return track;
+}
+
+// Wraps a cache entry; cheap, as nothing is read from disk
+DeckTrack::Ptr DeckTrack::fromCache(const URL& url,
+    DecodedTrackCache::Entry::Ptr entry,
+    const LoadSettings& settings)
+{
+    Ptr track(new DeckTrack(url, std::make_unique<CachedAudioSource>(entry), entry->getSampleRate(), true));
+    if (settings.analysisStore != nullptr && url.isLocalFile())
+        track->contentKey = settings.analysisStore->findKey(url.getLocalFile());
+
+    track->prepare(settings.blockSize);
+    return track;
+}
+
+// Prepares the playback source; may allocate
+void DeckTrack::prepare(int blockSize)
+{
+    playbackSource->prepareToPlay(blockSize, sourceSampleRate);
+}
+
+void DeckTrack::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    playbackSource->getNextAudioBlock(bufferToFill);
+}
+
+void DeckTrack::setNextReadPosition(int64 newPosition)
+{
+    playbackSource->setNextReadPosition(newPosition);
+}
+
+int64 DeckTrack::getNextReadPosition() const
+{
+    return playbackSource->getNextReadPosition();
+}
+
+double DeckTrack::getLengthInSeconds() const noexcept
+{
+    return sourceSampleRate > 0.0 ? static_cast<double>(lengthInSamples) / sourceSampleRate : 0.0;
+}
+
+std::unique_ptr<AudioFormatReader> DeckTrack::releasePreviewReader()
+{
+    return std::move(previewReader);
+}
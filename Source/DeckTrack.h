@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DecodedTrackCache.h"
+#include "Mp3FrameIndex.h"
+#include "ReadAheadBuffer.h"
+#include <functional>
+#include <memory>
+
+class AnalysisStore;
+
+// DeckTrack is a fully opened and primed track, ready to be handed to a deck's audio thread.
+// It owns the playback source: a decoded cache entry, a memory-mapped WAV/AIFF, or a
+// streaming reader, optionally behind a read-ahead buffer. Audio comes out at the file's
+// own sample rate; the deck's FusedResampler converts it to the device rate. Tracks are
+// built off the audio thread and never reopened once live
+class DeckTrack : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<DeckTrack>;
+
+    // Called with load progress (0 to 1). Returning false abandons the load
+    using ProgressCallback = std::function<bool(float)>;
+
+    // How a deck wants its tracks opened
+    struct LoadSettings
+    {
+        int blockSize = 512;
+
+        // Decoding runs ahead of the playhead on this thread; nullptr decodes on the audio thread
+        TimeSliceThread* readAheadThread = nullptr;
+        double readAheadSeconds = 2.0;
+        ReadAheadBuffer::Counters* readAheadCounters = nullptr;
+
+        // Decoded tracks shared between decks; nullptr disables caching
+        DecodedTrackCache* cache = nullptr;
+
+        // Play WAV/AIFF from a memory map instead of a stream
+        bool useMemoryMapping = true;
+
+        // Keeps the frame indexes MP3s seek with, building one on first load if the
+        // analyser has not, and gives each track its content key; nullptr seeks through
+        // JUCE's reader alone
+        AnalysisStore* analysisStore = nullptr;
+    };
+
+    // Opens, probes and primes the track at the URL. Returns nullptr if it can't be read
+    // or the load was abandoned. Blocks on disk I/O, so never call from the audio thread
+    static Ptr open(AudioFormatManager& formatManager,
+        const URL& url,
+        const LoadSettings& settings,
+        const ProgressCallback& progress = nullptr);
+
+    // Creates a track that plays a decoded cache entry from memory
+    static Ptr fromCache(const URL& url,
+        DecodedTrackCache::Entry::Ptr entry,
+        const LoadSettings& settings);
+
+    // Destructor
+    ~DeckTrack() override;
+
+    // Prepares the playback source. Not for the audio thread
+    void prepare(int blockSize);
+
+    // Reads the next block at the file's sample rate. Audio thread only once live
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill);
+
+    // Moves the read position (in source samples)
+    void setNextReadPosition(int64 newPosition);
+
+    // Returns the read position in source samples
+    int64 getNextReadPosition() const;
+
+    // Returns the track length in source samples
+    int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+
+    // Returns the sample rate of the file
+    double getSampleRate() const noexcept { return sourceSampleRate; }
+
+    // Returns the track length in seconds
+    double getLengthInSeconds() const noexcept;
+
+    // Returns the URL the track was opened from
+    const URL& getURL() const noexcept { return url; }
+
+    // Hands over the spare reader opened for the waveform preview (message thread, once)
+    std::unique_ptr<AudioFormatReader> releasePreviewReader();
+
+    // Returns the read-ahead buffer, or nullptr if the track decodes on the audio thread
+    const ReadAheadBuffer* getReadAheadBuffer() const noexcept { return readAhead; }
+
+    // Returns true if the track plays from the decoded cache
+    bool isCached() const noexcept { return cached; }
+
+    // Returns true if the track plays from a memory-mapped file
+    bool isMemoryMapped() const noexcept { return mapped; }
+
+    // Returns the key of the file's contents in the analysis store, or 0 if the track was
+    // opened without a store
+    uint64 getContentKey() const noexcept { return contentKey; }
+
+    // Returns the frame index the track seeks with, or nullptr if it has none
+    std::shared_ptr<const Mp3FrameIndex> getFrameIndex() const noexcept { return frameIndex; }
+
+    // Marks the track as a replacement for the deck's current one (the same file), so the
+    // deck carries on from its current position. Set before handing the track to a deck
+    void setContinuesPlayback(bool shouldContinue) noexcept { continues = shouldContinue; }
+
+    // Returns true if the track picks up the deck's current position
+    bool continuesPlayback() const noexcept { return continues; }
+
+private:
+    DeckTrack(const URL& url, std::unique_ptr<PositionableAudioSource> source,
+        double sampleRate, bool isFromCache);
+
+    URL url;
+    double sourceSampleRate = 0.0;
+    int64 lengthInSamples = 0;
+    bool cached = false;
+    bool mapped = false;
+    bool continues = false;
+
+    // Either the reader source itself or a ReadAheadBuffer wrapping it
+    std::unique_ptr<PositionableAudioSource> playbackSource;
+    ReadAheadBuffer* readAhead = nullptr;
+    std::unique_ptr<AudioFormatReader> previewReader;
+
+    // Worked out while opening, so the message thread never reads the file to find it
+    uint64 contentKey = 0;
+
+    // Lets an MP3 streaming reader seek straight to the frame it needs
+    std::shared_ptr<const Mp3FrameIndex> frameIndex;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckTrack)
+};
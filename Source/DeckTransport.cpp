@@ -0,0 +1,217 @@
+#include "DeckTransport.h"
+
+DeckTransport::DeckTransport()
+{
+}
+
+DeckTransport::~DeckTransport()
+{
+    stopTimer();
+}
+
+// Audio is not running here, so the active track can be prepared directly
+void DeckTransport::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    deviceSampleRate = sampleRate;
+    deviceBlockSize = samplesPerBlockExpected;
+
+    if (activeTrack != nullptr)
+        activeTrack->prepare(samplesPerBlockExpected);
+}
+
+void DeckTransport::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    idle();
+
+    if (activeTrack == nullptr || !playing.load())
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    looper.read(*activeTrack, bufferToFill);
+
+    const auto position = looper.getPosition();
+    playPosition = position;
+
+    // Stop at the end of the track, as AudioTransportSource did
+    if (position >= activeTrack->getLengthInSamples())
+        playing = false;
+}
+
+void DeckTransport::releaseResources()
+{
+}
+
+void DeckTransport::idle() noexcept
+{
+    takePendingTrack();
+
+    const auto seek = seekRequest.exchange(-1);
+    if (seek >= 0 && activeTrack != nullptr)
+    {
+        looper.seek(*activeTrack, seek);
+        playPosition = seek;
+    }
+}
+
+void DeckTransport::takePendingTrack() noexcept
+{
+    // Only take a new track when there is room to hand the old one back
+    if (retiredFifo.getFreeSpace() == 0)
+        return;
+
+    auto* next = pendingTrack.exchange(nullptr);
+    if (next == nullptr)
+        return;
+
+    if (activeTrack != nullptr)
+    {
+        const auto scope = retiredFifo.write(1);
+        if (scope.blockSize1 > 0)
+            retiredTracks[static_cast<size_t>(scope.startIndex1)] = activeTrack;
+        else
+            retiredTracks[static_cast<size_t>(scope.startIndex2)] = activeTrack;
+    }
+
+    activeTrack = next;
+
+    // A replacement for the same file carries on where the old one was, and its loop and
+    // the audio already in memory still apply
+    if (activeTrack->continuesPlayback())
+    {
+        looper.continueWith(*activeTrack);
+        return;
+    }
+
+    looper.clearLoop();
+    looper.seek(*activeTrack, 0);
+    playPosition = 0;
+}
+
+void DeckTransport::setTrack(DeckTrack::Ptr newTrack)
+{
+    // A brand new track stops the deck and starts from the top
+    if (newTrack == nullptr || !newTrack->continuesPlayback())
+    {
+        playing = false;
+        seekRequest = -1;
+        playPosition = 0;
+    }
+
+    currentTrack = newTrack;
+    if (newTrack == nullptr)
+        return;
+
+    liveTracks.add(newTrack);
+
+    // A track that was still pending never reached the audio thread, so it can go now
+    if (auto* superseded = pendingTrack.exchange(newTrack.get()))
+        liveTracks.removeObject(superseded);
+
+    startTimer(250);
+}
+
+void DeckTransport::timerCallback()
+{
+    const auto scope = retiredFifo.read(retiredFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i)
+        liveTracks.removeObject(retiredTracks[static_cast<size_t>(scope.startIndex1 + i)]);
+    for (int i = 0; i < scope.blockSize2; ++i)
+        liveTracks.removeObject(retiredTracks[static_cast<size_t>(scope.startIndex2 + i)]);
+
+    // Only the active track is left, so nothing more will be retired until the next load
+    if (liveTracks.size() <= 1 && pendingTrack.load() == nullptr)
+        stopTimer();
+}
+
+void DeckTransport::start() noexcept
+{
+    playing = true;
+}
+
+void DeckTransport::stop() noexcept
+{
+    playing = false;
+}
+
+bool DeckTransport::isPlaying() const noexcept
+{
+    return playing.load();
+}
+
+void DeckTransport::setPosition(double posInSecs) noexcept
+{
+    if (currentTrack == nullptr)
+        return;
+
+    const auto target = static_cast<int64>(jmax(0.0, posInSecs) * currentTrack->getSampleRate());
+    seekRequest = jmin(target, currentTrack->getLengthInSamples());
+    playPosition = seekRequest.load();
+}
+
+void DeckTransport::setPositionNow(double posInSecs, const AudioBuffer<float>* preroll) noexcept
+{
+    if (activeTrack == nullptr)
+        return;
+
+    const auto target = static_cast<int64>(jmax(0.0, posInSecs) * activeTrack->getSampleRate());
+    const auto position = jmin(target, activeTrack->getLengthInSamples());
+    looper.jump(*activeTrack, position, preroll);
+    playPosition = position;
+}
+
+void DeckTransport::peek(int64 start, AudioBuffer<float>& dest, int numSamples) noexcept
+{
+    if (activeTrack != nullptr)
+        looper.peek(*activeTrack, start, dest, 0, numSamples);
+    else
+        dest.clear(0, numSamples);
+}
+
+void DeckTransport::movePlayheadNow(int64 position) noexcept
+{
+    if (activeTrack == nullptr)
+        return;
+
+    position = jlimit<int64>(0, activeTrack->getLengthInSamples(), position);
+    looper.setPosition(*activeTrack, position);
+    playPosition = position;
+}
+
+void DeckTransport::setLoop(int64 start, int64 end) noexcept
+{
+    if (activeTrack != nullptr)
+        looper.setLoop(start, jmin(end, activeTrack->getLengthInSamples()));
+}
+
+void DeckTransport::setLoopLength(int64 length) noexcept
+{
+    looper.setLoopLength(length);
+}
+
+void DeckTransport::clearLoop() noexcept
+{
+    looper.clearLoop();
+}
+
+double DeckTransport::getCurrentPosition() const noexcept
+{
+    if (currentTrack == nullptr || currentTrack->getSampleRate() <= 0.0)
+        return 0.0;
+
+    return static_cast<double>(playPosition.load()) / currentTrack->getSampleRate();
+}
+
+double DeckTransport::getActiveSampleRate() const noexcept
+{
+    if (activeTrack != nullptr && activeTrack->getSampleRate() > 0.0)
+        return activeTrack->getSampleRate();
+
+    return deviceSampleRate.load();
+}
+
+double DeckTransport::getLengthInSeconds() const noexcept
+{
+    return currentTrack != nullptr ? currentTrack->getLengthInSeconds() : 0.0;
+}
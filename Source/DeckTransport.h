@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckLooper.h"
+#include "DeckTrack.h"
+#include <array>
+#include <atomic>
+
+// DeckTransport plays the deck's current DeckTrack and handles start, stop, seeking and
+// looping, reading through a DeckLooper so loops play from memory.
+// New tracks are handed to the audio thread through an atomic pointer swap. The audio
+// thread passes tracks it has finished with back through a FIFO, and they are released
+// on the message thread, so the audio thread never locks, allocates or frees.
+class DeckTransport : public AudioSource,
+    private Timer
+{
+public:
+    // Constructs an empty transport
+    DeckTransport();
+
+    // Destructor. Audio must have stopped
+    ~DeckTransport() override;
+
+    // Prepares the active track for the device
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+    // Reads the next block from the active track at its own sample rate, or silence when stopped
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    // Releases audio resources
+    void releaseResources() override;
+
+    // Takes a pending track and applies a pending seek without producing any audio, for
+    // a stopped deck that skips getNextAudioBlock. Audio thread only
+    void idle() noexcept;
+
+    // Queues a prepared track for the audio thread and stops playback, unless the track is
+    // marked as continuing playback. Message thread only
+    void setTrack(DeckTrack::Ptr newTrack);
+
+    // Returns the most recently set track, or nullptr. Message thread only
+    DeckTrack* getTrack() const noexcept { return currentTrack.get(); }
+
+    // Starts playback
+    void start() noexcept;
+
+    // Stops playback
+    void stop() noexcept;
+
+    // Returns true while playing
+    bool isPlaying() const noexcept;
+
+    // Requests a seek, applied at the start of the next audio block
+    void setPosition(double posInSecs) noexcept;
+
+    // Moves the active track's playhead straight away, for seeks timed by the audio
+    // thread itself, crossfading from the audio it leaves. preroll, if given, holds the
+    // track's audio from the new position on and plays while the track seeks. Audio thread only
+    void setPositionNow(double posInSecs, const AudioBuffer<float>* preroll = nullptr) noexcept;
+
+    // Reads the active track's audio from start, in its own samples, without moving the
+    // playhead. Recent audio comes from the looper's memory, so reading backwards never
+    // seeks. Audio thread only
+    void peek(int64 start, AudioBuffer<float>& dest, int numSamples) noexcept;
+
+    // Moves the playhead without a crossfade, for a scratch that has been playing the
+    // audio itself. Audio thread only
+    void movePlayheadNow(int64 position) noexcept;
+
+    // Returns the track the audio thread is playing, or nullptr. Audio thread only
+    const DeckTrack* getActiveTrack() const noexcept { return activeTrack; }
+
+    // Loops the active track from start to end, in its own samples. Audio thread only
+    void setLoop(int64 start, int64 end) noexcept;
+
+    // Changes the loop's length, keeping its start. Audio thread only
+    void setLoopLength(int64 length) noexcept;
+
+    // Stops looping. Audio thread only
+    void clearLoop() noexcept;
+
+    // Returns true while a loop is set
+    bool isLooping() const noexcept { return looper.isLooping(); }
+
+    // Returns the loop start in the track's samples, or -1
+    int64 getLoopStart() const noexcept { return looper.getLoopStart(); }
+
+    // Returns the loop end in the track's samples, or -1
+    int64 getLoopEnd() const noexcept { return looper.getLoopEnd(); }
+
+    // Returns the position the active track reads from next, in its own samples
+    int64 getNextReadPosition() const noexcept { return playPosition.load(); }
+
+    // Returns the playback position in seconds
+    double getCurrentPosition() const noexcept;
+
+    // Returns the length of the current track in seconds
+    double getLengthInSeconds() const noexcept;
+
+    // Returns the sample rate of the track the audio thread is playing, or the device
+    // rate if there is none. Audio thread only
+    double getActiveSampleRate() const noexcept;
+
+    // Returns the device sample rate last passed to prepareToPlay
+    double getDeviceSampleRate() const noexcept { return deviceSampleRate.load(); }
+
+    // Returns the block size last passed to prepareToPlay
+    int getBlockSize() const noexcept { return deviceBlockSize.load(); }
+
+private:
+    // Releases tracks the audio thread has finished with
+    void timerCallback() override;
+
+    // Swaps in a pending track if there is one. Audio thread only
+    void takePendingTrack() noexcept;
+
+    // Tracks the audio thread may be holding, kept alive by the message thread
+    ReferenceCountedArray<DeckTrack> liveTracks;
+    DeckTrack::Ptr currentTrack;
+
+    // Hand-off from the message thread to the audio thread
+    std::atomic<DeckTrack*> pendingTrack{ nullptr };
+
+    // Track owned by the audio thread
+    DeckTrack* activeTrack = nullptr;
+
+    // Reads the active track, playing loops from memory. Audio thread only
+    DeckLooper looper;
+
+    // Hand-back from the audio thread to the message thread
+    static constexpr int retiredCapacity = 16;
+    AbstractFifo retiredFifo{ retiredCapacity };
+    std::array<DeckTrack*, retiredCapacity> retiredTracks{};
+
+    std::atomic<bool> playing{ false };
+    std::atomic<int64> seekRequest{ -1 };
+    std::atomic<int64> playPosition{ 0 };
+
+    std::atomic<double> deviceSampleRate{ 44100.0 };
+    std::atomic<int> deviceBlockSize{ 512 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckTransport)
+};
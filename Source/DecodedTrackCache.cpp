@@ -0,0 +1,162 @@
+#include "DecodedTrackCache.h"
+
+//==============================================================================
+DecodedTrackCache::Entry::Entry(const String& entryKey, double rate, int numChannels, int numSamples)
+    : key(entryKey),
+    sampleRate(rate),
+    audio(numChannels, numSamples)
+{
+}
+
+size_t DecodedTrackCache::Entry::getSizeInBytes() const noexcept
+{
+    return bytesFor(audio.getNumSamples(), audio.getNumChannels());
+}
+
+//==============================================================================
+DecodedTrackCache::DecodedTrackCache(size_t memoryBudgetBytes)
+    : memoryBudget(memoryBudgetBytes)
+{
+}
+
+DecodedTrackCache::~DecodedTrackCache()
+{
+}
+
+String DecodedTrackCache::makeKey(const File& file)
+{
+    return file.getFullPathName()
+        + "|" + String(file.getSize())
+        + "|" + String(file.getLastModificationTime().toMilliseconds());
+}
+
+size_t DecodedTrackCache::bytesFor(int64 lengthInSamples, int numChannels) noexcept
+{
+    return static_cast<size_t>(jmax((int64) 0, lengthInSamples)) * static_cast<size_t>(jmax(2, numChannels)) * sizeof(float);
+}
+
+DecodedTrackCache::Entry::Ptr DecodedTrackCache::find(const File& file)
+{
+    const ScopedLock sl(lock);
+    return findLocked(makeKey(file));
+}
+
+DecodedTrackCache::Entry::Ptr DecodedTrackCache::findLocked(const String& key)
+{
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        if (entries.getUnchecked(i)->key == key)
+        {
+            Entry::Ptr entry(entries.getUnchecked(i));
+            entries.move(i, -1);
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+DecodedTrackCache::Entry::Ptr DecodedTrackCache::decode(AudioFormatManager& formatManager,
+    const File& file, const ProgressCallback& progress)
+{
+    const auto key = makeKey(file);
+
+    if (auto existing = find(file))
+        return existing;
+
+    std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr
+        || reader->lengthInSamples <= 0
+        || reader->lengthInSamples > std::numeric_limits<int>::max()
+        || !canHold(reader->lengthInSamples, static_cast<int>(reader->numChannels)))
+        return nullptr;
+
+    // Decode outside the lock; mono files are spread over both channels
+    const int numChannels = jmax(2, static_cast<int>(reader->numChannels));
+    const int numSamples = static_cast<int>(reader->lengthInSamples);
+    Entry::Ptr entry(new Entry(key, reader->sampleRate, numChannels, numSamples));
+
+    const int chunk = 65536;
+    for (int pos = 0; pos < numSamples; pos += chunk)
+    {
+        const int num = jmin(chunk, numSamples - pos);
+        reader->read(&entry->audio, pos, num, pos, true, true);
+
+        if (progress != nullptr && !progress(static_cast<float>(pos + num) / static_cast<float>(numSamples)))
+            return nullptr;
+    }
+
+    const ScopedLock sl(lock);
+
+    // Another thread may have finished the same file meanwhile
+    if (auto existing = findLocked(key))
+        return existing;
+
+    evictUntilFits(entry->getSizeInBytes());
+    if (memoryUsed + entry->getSizeInBytes() <= memoryBudget)
+    {
+        entries.add(entry);
+        memoryUsed += entry->getSizeInBytes();
+    }
+
+    return entry;
+}
+
+bool DecodedTrackCache::canHold(int64 lengthInSamples, int numChannels) const
+{
+    const ScopedLock sl(lock);
+    return getPinnedBytes() + bytesFor(lengthInSamples, numChannels) <= memoryBudget;
+}
+
+size_t DecodedTrackCache::getPinnedBytes() const
+{
+    size_t pinned = 0;
+    for (auto* entry : entries)
+        if (entry->getReferenceCount() > 1)
+            pinned += entry->getSizeInBytes();
+
+    return pinned;
+}
+
+void DecodedTrackCache::evictUntilFits(size_t extraBytes)
+{
+    // Only entries held by nothing but the cache can go
+    for (int i = 0; i < entries.size() && memoryUsed + extraBytes > memoryBudget;)
+    {
+        auto* entry = entries.getUnchecked(i);
+        if (entry->getReferenceCount() == 1)
+        {
+            memoryUsed -= entry->getSizeInBytes();
+            entries.remove(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void DecodedTrackCache::setMemoryBudget(size_t newBudgetBytes)
+{
+    const ScopedLock sl(lock);
+    memoryBudget = newBudgetBytes;
+    evictUntilFits(0);
+}
+
+size_t DecodedTrackCache::getMemoryBudget() const
+{
+    const ScopedLock sl(lock);
+    return memoryBudget;
+}
+
+size_t DecodedTrackCache::getMemoryUsed() const
+{
+    const ScopedLock sl(lock);
+    return memoryUsed;
+}
+
+int DecodedTrackCache::getNumEntries() const
+{
+    const ScopedLock sl(lock);
+    return entries.size();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <functional>
+
+// DecodedTrackCache keeps fully decoded PCM for recently loaded tracks, shared by every deck.
+// Entries are reference counted: a deck playing from an entry holds a reference, and only
+// entries nobody else holds are evicted, least recently used first, when the memory budget
+// would be exceeded. Used from the loader and message threads, never the audio thread
+class DecodedTrackCache
+{
+public:
+    // One decoded file
+    class Entry : public ReferenceCountedObject
+    {
+    public:
+        using Ptr = ReferenceCountedObjectPtr<Entry>;
+
+        // Returns the decoded audio (always at least two channels)
+        const AudioBuffer<float>& getAudio() const noexcept { return audio; }
+
+        // Returns the sample rate of the file
+        double getSampleRate() const noexcept { return sampleRate; }
+
+        // Returns the memory used by the samples
+        size_t getSizeInBytes() const noexcept;
+
+    private:
+        friend class DecodedTrackCache;
+        Entry(const String& key, double sampleRate, int numChannels, int numSamples);
+
+        String key;
+        double sampleRate;
+        AudioBuffer<float> audio;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Entry)
+    };
+
+    // Called with decode progress (0 to 1). Returning false abandons the decode
+    using ProgressCallback = std::function<bool(float)>;
+
+    // Constructs an empty cache with the given budget
+    explicit DecodedTrackCache(size_t memoryBudgetBytes);
+
+    // Destructor
+    ~DecodedTrackCache();
+
+    // Returns the decoded file if it is cached and unchanged on disk, or nullptr
+    Entry::Ptr find(const File& file);
+
+    // Returns the cached file, decoding and caching it first if needed. Returns nullptr if
+    // it can't be read, won't fit in the budget, or the decode was abandoned
+    Entry::Ptr decode(AudioFormatManager& formatManager, const File& file,
+        const ProgressCallback& progress = nullptr);
+
+    // Returns true if a file of this length could be cached right now
+    bool canHold(int64 lengthInSamples, int numChannels) const;
+
+    // Sets the memory budget, evicting unused entries if it shrank
+    void setMemoryBudget(size_t newBudgetBytes);
+
+    // Returns the memory budget in bytes
+    size_t getMemoryBudget() const;
+
+    // Returns the memory held by cached entries in bytes
+    size_t getMemoryUsed() const;
+
+    // Returns the number of cached files
+    int getNumEntries() const;
+
+private:
+    // Identifies a file together with its size and modification time
+    static String makeKey(const File& file);
+
+    // Bytes an entry of this shape would take
+    static size_t bytesFor(int64 lengthInSamples, int numChannels) noexcept;
+
+    // Returns the entry for key and moves it to the most recently used end. Lock held
+    Entry::Ptr findLocked(const String& key);
+
+    // Drops unused entries, oldest first, until extraBytes more would fit. Lock held
+    void evictUntilFits(size_t extraBytes);
+
+    // Bytes held by entries currently in use elsewhere. Lock held
+    size_t getPinnedBytes() const;
+
+    CriticalSection lock;
+
+    // Least recently used first
+    ReferenceCountedArray<Entry> entries;
+    size_t memoryBudget;
+    size_t memoryUsed = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodedTrackCache)
+};
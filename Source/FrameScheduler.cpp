@@ -0,0 +1,278 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+
+namespace
+{
+    // A frame this much later than the refresh interval missed at least one refresh
+    constexpr double lateFactor = 1.5;
+
+    // Gaps longer than this are the display pausing (minimised, asleep), not missed frames
+    constexpr double pauseMs = 250.0;
+
+    // How often the clients are checked while idle
+    constexpr int idleCheckIntervalMs = 250;
+}
+
+//------------------------------------------------------------------------------
+FrameScheduler::ScopedPaintTimer::ScopedPaintTimer(Client& clientToTime)
+    : client(clientToTime),
+    startMs(Time::getMillisecondCounterHiRes())
+{
+}
+
+//------------------------------------------------------------------------------
+FrameScheduler::ScopedPaintTimer::~ScopedPaintTimer()
+{
+    const double elapsed = Time::getMillisecondCounterHiRes() - startMs;
+    ++client.numPaints;
+    client.totalPaintMs += elapsed;
+    client.maxPaintMs = jmax(client.maxPaintMs, elapsed);
+}
+
+//------------------------------------------------------------------------------
+FrameScheduler::FrameScheduler(Component& hostToFollow)
+    : host(hostToFollow)
+{
+    frames.reserve(maxFrameRecords);
+    wake();
+}
+
+//------------------------------------------------------------------------------
+FrameScheduler::~FrameScheduler()
+{
+    // Every client should have removed itself by now
+    jassert(clients.empty());
+    cancelPendingUpdate();
+    stopTimer();
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::addClient(Client* client, const String& name)
+{
+    jassert(client != nullptr);
+    if (std::find(clients.begin(), clients.end(), client) != clients.end())
+        return;
+
+    client->clientName = name;
+    clients.push_back(client);
+    wake();
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::removeClient(Client* client)
+{
+    clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::wake()
+{
+    suspendPending = false;
+    cancelPendingUpdate();
+
+    if (vBlankAttachment != nullptr)
+        return;
+
+    stopTimer();
+
+    // The gap since the last frame was idle time, not a missed frame
+    lastFrameMs = 0.0;
+    vBlankAttachment = std::make_unique<VBlankAttachment>(&host, [this] { onVBlank(); });
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::suspend()
+{
+    // Usually called from the attachment's own callback, so it is let go afterwards
+    suspendPending = true;
+    triggerAsyncUpdate();
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::handleAsyncUpdate()
+{
+    if (!suspendPending)
+        return;
+
+    suspendPending = false;
+    vBlankAttachment.reset();
+    startTimer(idleCheckIntervalMs);
+}
+
+//------------------------------------------------------------------------------
+bool FrameScheduler::isHostHidden() const
+{
+    auto* peer = host.getPeer();
+    return peer == nullptr || peer->isMinimised() || !host.isShowing();
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::timerCallback()
+{
+    if (!isHostHidden() && advanceClients(Time::getMillisecondCounterHiRes()))
+        wake();
+}
+
+//------------------------------------------------------------------------------
+bool FrameScheduler::advanceClients(double frameTimeMs)
+{
+    bool animating = false;
+
+    // From a copy, so a client may add or remove clients, itself included, from its
+    // callback without another being skipped. One removed before its turn is left out
+    advancing.assign(clients.begin(), clients.end());
+    for (auto* client : advancing)
+    {
+        if (std::find(clients.begin(), clients.end(), client) == clients.end())
+            continue;
+
+        const double start = Time::getMillisecondCounterHiRes();
+        animating = client->advanceFrame(frameTimeMs) || animating;
+        client->totalAdvanceMs += Time::getMillisecondCounterHiRes() - start;
+    }
+
+    return animating;
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::onVBlank()
+{
+    // Nothing can be seen, so nothing needs drawing
+    if (isHostHidden())
+    {
+        suspend();
+        return;
+    }
+
+    const double now = Time::getMillisecondCounterHiRes();
+    const double interval = lastFrameMs > 0.0 ? now - lastFrameMs : 0.0;
+    const bool timed = interval > 0.0 && interval < pauseMs;
+    lastFrameMs = now;
+
+    if (timed)
+    {
+        // Follow the display's refresh rate using the frames that arrived on time
+        if (interval < refreshIntervalMs * lateFactor)
+            refreshIntervalMs += 0.05 * (interval - refreshIntervalMs);
+        else
+            missedFrames += jmax(1, roundToInt(interval / refreshIntervalMs) - 1);
+    }
+
+    const bool animating = advanceClients(now);
+
+    if (timed)
+    {
+        const FrameRecord record{ interval, Time::getMillisecondCounterHiRes() - now };
+        if (frames.size() < maxFrameRecords)
+            frames.push_back(record);
+        else
+            frames[nextFrame] = record;
+
+        nextFrame = (nextFrame + 1) % maxFrameRecords;
+        ++numFrames;
+    }
+
+    // Everything is still, so stop waking up every refresh
+    if (!animating)
+        suspend();
+    else
+        suspendPending = false;
+}
+
+//------------------------------------------------------------------------------
+FrameScheduler::Stats FrameScheduler::getStats() const
+{
+    Stats stats;
+    stats.numFrames = numFrames;
+    stats.missedFrames = missedFrames;
+    stats.refreshIntervalMs = refreshIntervalMs;
+
+    if (!frames.empty())
+    {
+        std::vector<double> intervals;
+        intervals.reserve(frames.size());
+
+        double totalInterval = 0.0;
+        double totalAdvance = 0.0;
+        for (const auto& frame : frames)
+        {
+            intervals.push_back(frame.intervalMs);
+            totalInterval += frame.intervalMs;
+            totalAdvance += frame.advanceMs;
+            stats.worstFrameMs = jmax(stats.worstFrameMs, frame.intervalMs);
+        }
+
+        const auto count = static_cast<double>(frames.size());
+        stats.meanFrameMs = totalInterval / count;
+        stats.meanAdvanceMs = totalAdvance / count;
+
+        const auto rank = static_cast<size_t>(0.99 * (count - 1.0));
+        std::nth_element(intervals.begin(), intervals.begin() + static_cast<std::ptrdiff_t>(rank), intervals.end());
+        stats.percentile99FrameMs = intervals[rank];
+    }
+
+    for (const auto* client : clients)
+    {
+        ClientStats clientStats;
+        clientStats.name = client->clientName;
+        clientStats.numPaints = client->numPaints;
+        clientStats.maxPaintMs = client->maxPaintMs;
+        if (client->numPaints > 0)
+            clientStats.meanPaintMs = client->totalPaintMs / static_cast<double>(client->numPaints);
+        if (numFrames > 0)
+            clientStats.meanAdvanceMs = client->totalAdvanceMs / static_cast<double>(numFrames);
+
+        stats.clients.push_back(clientStats);
+    }
+
+    return stats;
+}
+
+//------------------------------------------------------------------------------
+void FrameScheduler::resetStats()
+{
+    frames.clear();
+    nextFrame = 0;
+    numFrames = 0;
+    missedFrames = 0;
+    lastFrameMs = 0.0;
+
+    for (auto* client : clients)
+    {
+        client->numPaints = 0;
+        client->totalPaintMs = 0.0;
+        client->maxPaintMs = 0.0;
+        client->totalAdvanceMs = 0.0;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool FrameScheduler::exportStats(const File& file) const
+{
+    const auto stats = getStats();
+    String csv;
+
+    csv << "frames," << stats.numFrames << "\n"
+        << "missed_frames," << stats.missedFrames << "\n"
+        << "refresh_interval_ms," << String(stats.refreshIntervalMs, 3) << "\n"
+        << "mean_frame_ms," << String(stats.meanFrameMs, 3) << "\n"
+        << "p99_frame_ms," << String(stats.percentile99FrameMs, 3) << "\n"
+        << "worst_frame_ms," << String(stats.worstFrameMs, 3) << "\n"
+        << "\n"
+        << "client,paints,mean_paint_ms,max_paint_ms,mean_advance_ms\n";
+
+    for (const auto& client : stats.clients)
+        csv << client.name << "," << client.numPaints << "," << String(client.meanPaintMs, 3) << ","
+            << String(client.maxPaintMs, 3) << "," << String(client.meanAdvanceMs, 3) << "\n";
+
+    // Recent frames, oldest first
+    csv << "\nframe,interval_ms,advance_ms\n";
+    const size_t oldest = frames.size() < maxFrameRecords ? 0 : nextFrame;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        const auto& frame = frames[(oldest + i) % frames.size()];
+        csv << static_cast<int64>(i) << "," << String(frame.intervalMs, 3) << "," << String(frame.advanceMs, 3) << "\n";
+    }
+
+    return file.replaceWithText(csv);
+}
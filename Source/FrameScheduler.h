@@ -0,0 +1,154 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <memory>
+#include <vector>
+
+// FrameScheduler drives every animated component from the display's vertical blank.
+// Once per refresh it asks each registered client to advance to the frame time; clients
+// invalidate just the regions that changed, and JUCE folds all of those into the single
+// paint pass that follows. It also records how long frames take, how long each client
+// spends painting and how many refreshes were missed, for the stats overlay and export.
+//
+// When no client is animating, or the window is minimised, the scheduler lets go of the
+// vertical blank and the UI stops waking up 60 times a second. It then checks the clients
+// a few times a second, and wake() brings it back at once
+class FrameScheduler : private Timer,
+    private AsyncUpdater
+{
+public:
+    // A component animated by the scheduler
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        // Moves the animation on to frameTimeMs (from Time::getMillisecondCounterHiRes)
+        // and repaints whatever changed. Called on the message thread once per frame, and
+        // a few times a second while the scheduler is idle. Returns true while the client
+        // is animating and needs the next frame
+        virtual bool advanceFrame(double frameTimeMs) = 0;
+
+    private:
+        friend class FrameScheduler;
+
+        String clientName;
+        int64 numPaints = 0;
+        double totalPaintMs = 0.0;
+        double maxPaintMs = 0.0;
+        double totalAdvanceMs = 0.0;
+    };
+
+    // Times a client's paint call for the stats. Put one at the top of paint()
+    class ScopedPaintTimer
+    {
+    public:
+        explicit ScopedPaintTimer(Client& clientToTime);
+        ~ScopedPaintTimer();
+
+    private:
+        Client& client;
+        const double startMs;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedPaintTimer)
+    };
+
+    // Paint and advance time of one client
+    struct ClientStats
+    {
+        String name;
+        int64 numPaints = 0;
+        double meanPaintMs = 0.0;
+        double maxPaintMs = 0.0;
+        double meanAdvanceMs = 0.0;
+    };
+
+    // Summary of the recent frames
+    struct Stats
+    {
+        int64 numFrames = 0;
+        int64 missedFrames = 0;
+        double refreshIntervalMs = 0.0;
+        double meanFrameMs = 0.0;
+        double worstFrameMs = 0.0;
+        double percentile99FrameMs = 0.0;
+        double meanAdvanceMs = 0.0;
+        std::vector<ClientStats> clients;
+    };
+
+    // Constructs FrameScheduler, following the refresh of the display host is on
+    explicit FrameScheduler(Component& host);
+
+    // Destructor
+    ~FrameScheduler();
+
+    // Starts calling a client every frame. The name labels it in the stats
+    void addClient(Client* client, const String& name);
+
+    // Stops calling a client. Call before the client is destroyed
+    void removeClient(Client* client);
+
+    // Resumes frames straight away if idle. Call when something starts an animation
+    void wake();
+
+    // Returns true while following the vertical blank
+    bool isRunning() const noexcept { return vBlankAttachment != nullptr && !suspendPending; }
+
+    // Returns a summary of the recent frames and every client
+    Stats getStats() const;
+
+    // Clears the recorded stats
+    void resetStats();
+
+    // Writes the recent frame times and the client summary to a CSV file
+    bool exportStats(const File& file) const;
+
+private:
+    // Called at every vertical blank
+    void onVBlank();
+
+    // Checks whether any client has started animating while idle
+    void timerCallback() override;
+
+    // Calls every client. Returns true if any of them is animating
+    bool advanceClients(double frameTimeMs);
+
+    // Lets go of the vertical blank and starts checking the clients slowly
+    void suspend();
+
+    // Completes a suspend outside the vertical blank callback
+    void handleAsyncUpdate() override;
+
+    // Returns true if the window is minimised or hidden
+    bool isHostHidden() const;
+
+    // Timing of one frame
+    struct FrameRecord
+    {
+        double intervalMs = 0.0;
+        double advanceMs = 0.0;
+    };
+
+    // Frames kept for the percentile and the export, about 17 s at 60 Hz
+    static constexpr size_t maxFrameRecords = 1024;
+
+    std::vector<Client*> clients;
+
+    // The clients being advanced this frame, copied so the list can change under them
+    std::vector<Client*> advancing;
+
+    // Ring of recent frames
+    std::vector<FrameRecord> frames;
+    size_t nextFrame = 0;
+
+    int64 numFrames = 0;
+    int64 missedFrames = 0;
+    double lastFrameMs = 0.0;
+    double refreshIntervalMs = 1000.0 / 60.0;
+
+    Component& host;
+    std::unique_ptr<VBlankAttachment> vBlankAttachment;
+    bool suspendPending = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameScheduler)
+};
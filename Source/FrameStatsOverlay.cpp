@@ -0,0 +1,99 @@
+#include "FrameStatsOverlay.h"
+
+namespace
+{
+    constexpr double updateIntervalMs = 250.0;
+    constexpr int lineHeight = 14;
+}
+
+//------------------------------------------------------------------------------
+FrameStatsOverlay::FrameStatsOverlay(FrameScheduler& schedulerToShow)
+    : scheduler(schedulerToShow)
+{
+    addAndMakeVisible(exportButton);
+    addAndMakeVisible(resetButton);
+    exportButton.addListener(this);
+    resetButton.addListener(this);
+
+    scheduler.addClient(this, "Stats overlay");
+}
+
+//------------------------------------------------------------------------------
+FrameStatsOverlay::~FrameStatsOverlay()
+{
+    scheduler.removeClient(this);
+}
+
+//------------------------------------------------------------------------------
+void FrameStatsOverlay::paint(Graphics& g)
+{
+    const FrameScheduler::ScopedPaintTimer paintTimer(*this);
+
+    g.fillAll(Colours::black.withAlpha(0.8f));
+    g.setColour(Colours::white);
+    g.setFont(Font(Font::getDefaultMonospacedFontName(), 12.0f, Font::plain));
+
+    auto area = getLocalBounds().reduced(6);
+    area.removeFromBottom(24);
+    for (const auto& line : lines)
+        g.drawText(line, area.removeFromTop(lineHeight), Justification::centredLeft, false);
+}
+
+//------------------------------------------------------------------------------
+void FrameStatsOverlay::resized()
+{
+    auto buttonArea = getLocalBounds().reduced(6).removeFromBottom(20);
+    exportButton.setBounds(buttonArea.removeFromLeft(buttonArea.getWidth() / 2).reduced(2, 0));
+    resetButton.setBounds(buttonArea.reduced(2, 0));
+}
+
+//------------------------------------------------------------------------------
+void FrameStatsOverlay::buttonClicked(Button* button)
+{
+    if (button == &exportButton)
+    {
+        const auto file = getExportFile();
+        if (scheduler.exportStats(file))
+            std::cout << "Frame stats exported to " << file.getFullPathName() << std::endl;
+        else
+            std::cout << "Could not export frame stats to " << file.getFullPathName() << std::endl;
+    }
+    else if (button == &resetButton)
+    {
+        scheduler.resetStats();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool FrameStatsOverlay::advanceFrame(double frameTimeMs)
+{
+    if (!isVisible())
+        return false;
+
+    if (frameTimeMs - lastUpdateMs < updateIntervalMs)
+        return true;
+
+    lastUpdateMs = frameTimeMs;
+    const auto stats = scheduler.getStats();
+
+    lines.clearQuick();
+    lines.add("Refresh " + String(1000.0 / jmax(1.0, stats.refreshIntervalMs), 1) + " Hz, "
+        + String(stats.numFrames) + " frames, " + String(stats.missedFrames) + " missed");
+    lines.add("Frame mean " + String(stats.meanFrameMs, 2) + " ms, p99 " + String(stats.percentile99FrameMs, 2)
+        + " ms, worst " + String(stats.worstFrameMs, 2) + " ms");
+    lines.add("Advance mean " + String(stats.meanAdvanceMs, 3) + " ms");
+
+    for (const auto& client : stats.clients)
+        lines.add(client.name.paddedRight(' ', 16) + " paint " + String(client.meanPaintMs, 3) + " / "
+            + String(client.maxPaintMs, 3) + " ms x" + String(client.numPaints));
+
+    repaint();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+File FrameStatsOverlay::getExportFile()
+{
+    return File::getSpecialLocation(File::userDocumentsDirectory)
+        .getNonexistentChildFile("OtoDecks-frame-stats", ".csv");
+}
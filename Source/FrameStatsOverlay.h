@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "FrameScheduler.h"
+
+// FrameStatsOverlay shows the frame scheduler's stats over the UI: frame times, missed
+// frames and each animated component's paint time. Refreshed four times a second, with
+// a button that exports the full record to a CSV file
+class FrameStatsOverlay : public Component,
+    public FrameScheduler::Client,
+    public Button::Listener
+{
+public:
+    // Constructs FrameStatsOverlay, registering with the scheduler
+    explicit FrameStatsOverlay(FrameScheduler& scheduler);
+
+    // Destructor
+    ~FrameStatsOverlay() override;
+
+    // Draws the stats as text
+    void paint(Graphics& g) override;
+
+    // Places the export and reset buttons
+    void resized() override;
+
+    // Exports or resets the stats
+    void buttonClicked(Button* button) override;
+
+    // Refreshes the text while visible. Keeps frames coming while shown, so the stats
+    // measure a running UI
+    bool advanceFrame(double frameTimeMs) override;
+
+    // Returns the file the stats are exported to
+    static File getExportFile();
+
+private:
+    FrameScheduler& scheduler;
+    TextButton exportButton{ "EXPORT" };
+    TextButton resetButton{ "RESET" };
+
+    StringArray lines;
+    double lastUpdateMs = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameStatsOverlay)
+};
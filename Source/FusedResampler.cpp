@@ -0,0 +1,289 @@
+#include "FusedResampler.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+ #define OTODECKS_RS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define OTODECKS_RS_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define OTODECKS_RS_NEON 1
+#endif
+
+namespace
+{
+    // Sum of a[i] * b[i] over n samples, n a multiple of 8
+    inline float dotProduct(const float* a, const float* b, int n) noexcept
+    {
+       #if OTODECKS_RS_AVX
+        __m256 sum = _mm256_setzero_ps();
+        for (int i = 0; i < n; i += 8)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+
+        const __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        const __m128 pair = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+       #elif OTODECKS_RS_SSE
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (int i = 0; i < n; i += 8)
+        {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+
+        const __m128 sum = _mm_add_ps(sum0, sum1);
+        const __m128 pair = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+       #elif OTODECKS_RS_NEON
+        float32x4_t sum0 = vdupq_n_f32(0.0f);
+        float32x4_t sum1 = vdupq_n_f32(0.0f);
+        for (int i = 0; i < n; i += 8)
+        {
+            sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+            sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+
+        const float32x4_t sum = vaddq_f32(sum0, sum1);
+        const float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        return vget_lane_f32(vpadd_f32(pair, pair), 0);
+       #else
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < n; i += 4)
+            for (int k = 0; k < 4; ++k)
+                sum[k] += a[i + k] * b[i + k];
+
+        return sum[0] + sum[1] + sum[2] + sum[3];
+       #endif
+    }
+}
+
+FusedResampler::FusedResampler(AudioSource* inputSource, int channels)
+    : input(inputSource),
+    numChannels(jmax(1, channels))
+{
+    getSincTable();
+}
+
+FusedResampler::~FusedResampler()
+{
+}
+
+String FusedResampler::getInterpolatorName(Interpolator type)
+{
+    switch (type)
+    {
+    case Interpolator::linear:   return "linear";
+    case Interpolator::lagrange: return "lagrange";
+    case Interpolator::sinc:
+    default:                     return "polyphase sinc";
+    }
+}
+
+const char* FusedResampler::getInstructionSetName() noexcept
+{
+   #if OTODECKS_RS_AVX
+    return "AVX";
+   #elif OTODECKS_RS_SSE
+    return "SSE2";
+   #elif OTODECKS_RS_NEON
+    return "NEON";
+   #else
+    return "scalar";
+   #endif
+}
+
+const std::vector<float>& FusedResampler::getSincTable()
+{
+    // Blackman-windowed sinc, one row of taps per phase (plus one, so phases can be
+    // interpolated) and one set of phases per cutoff band
+    static const std::vector<float> table = []
+    {
+        std::vector<float> taps(static_cast<size_t>(numBands * (sincPhases + 1) * sincTaps));
+
+        for (int b = 0; b < numBands; ++b)
+        {
+            const double cutoff = 0.9 / std::exp2(static_cast<double>(b) / bandsPerOctave);
+
+            for (int p = 0; p <= sincPhases; ++p)
+            {
+                float* row = taps.data() + (b * (sincPhases + 1) + p) * sincTaps;
+                const double fraction = static_cast<double>(p) / sincPhases;
+                double sum = 0.0;
+
+                for (int k = 0; k < sincTaps; ++k)
+                {
+                    const double d = k - (halfTaps - 1) - fraction;
+                    const double x = MathConstants<double>::pi * cutoff * d;
+                    const double sinc = d == 0.0 ? 1.0 : std::sin(x) / x;
+                    const double w = MathConstants<double>::pi * d / halfTaps;
+                    const double window = std::abs(d) >= halfTaps ? 0.0 : 0.42 + 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w);
+
+                    row[k] = static_cast<float>(sinc * window);
+                    sum += row[k];
+                }
+
+                // Unity gain at DC for every phase
+                for (int k = 0; k < sincTaps; ++k)
+                    row[k] = static_cast<float>(row[k] / sum);
+            }
+        }
+
+        return taps;
+    }();
+
+    return table;
+}
+
+void FusedResampler::setRatio(double newRatio) noexcept
+{
+    ratio = jlimit(1.0e-3, maxRatio, newRatio);
+
+    // Pick the widest band that still filters out what would alias
+    band = ratio <= 1.0 ? 0 : jmin(numBands - 1, static_cast<int>(std::ceil(std::log2(ratio) * bandsPerOctave - 1.0e-9)));
+}
+
+void FusedResampler::flushBuffers() noexcept
+{
+    // Zeros before the first sample stand in for history
+    history.clear();
+    historyLength = halfTaps;
+    position = static_cast<double>(halfTaps);
+}
+
+void FusedResampler::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    maxBlockSize = jmax(1, samplesPerBlockExpected);
+    history.setSize(numChannels, static_cast<int>(std::ceil(maxBlockSize * maxRatio)) + 2 * sincTaps + 8);
+    flushBuffers();
+
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void FusedResampler::releaseResources()
+{
+    input->releaseResources();
+}
+
+void FusedResampler::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    if (bufferToFill.buffer == nullptr || maxBlockSize == 0)
+        return;
+
+    // Larger blocks than prepared for are split so the history never overflows
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int num = jmin(maxBlockSize, bufferToFill.numSamples - done);
+        processChunk(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, num));
+        done += num;
+    }
+}
+
+void FusedResampler::processChunk(const AudioSourceChannelInfo& bufferToFill) noexcept
+{
+    const int numSamples = bufferToFill.numSamples;
+    const auto lastPosition = position + ratio * (numSamples - 1);
+    fillInput(static_cast<int>(lastPosition) + halfTaps + 2);
+
+    auto* buffer = bufferToFill.buffer;
+    const int channelsToProcess = jmin(numChannels, buffer->getNumChannels());
+
+    for (int ch = 0; ch < channelsToProcess; ++ch)
+        interpolate(history.getReadPointer(ch), buffer->getWritePointer(ch, bufferToFill.startSample), numSamples, position);
+
+    for (int ch = channelsToProcess; ch < buffer->getNumChannels(); ++ch)
+        buffer->clear(ch, bufferToFill.startSample, numSamples);
+
+    position += ratio * numSamples;
+}
+
+void FusedResampler::fillInput(int end) noexcept
+{
+    // Keep only the history the filters can still reach
+    const int drop = jmin(historyLength, static_cast<int>(position) - halfTaps);
+    if (drop > 0)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            float* data = history.getWritePointer(ch);
+            std::memmove(data, data + drop, sizeof(float) * static_cast<size_t>(historyLength - drop));
+        }
+
+        historyLength -= drop;
+        position -= drop;
+        end -= drop;
+    }
+
+    end = jmin(end, history.getNumSamples());
+    if (end > historyLength)
+    {
+        input->getNextAudioBlock(AudioSourceChannelInfo(&history, historyLength, end - historyLength));
+        historyLength = end;
+    }
+}
+
+void FusedResampler::interpolate(const float* in, float* out, int numSamples, double start) const noexcept
+{
+    double pos = start;
+
+    // Whole-sample steps at unity ratio need no interpolation at all
+    if (ratio == 1.0 && pos == std::floor(pos))
+    {
+        std::memcpy(out, in + static_cast<int>(pos), sizeof(float) * static_cast<size_t>(numSamples));
+        return;
+    }
+
+    switch (interpolator)
+    {
+    case Interpolator::linear:
+        for (int i = 0; i < numSamples; ++i, pos += ratio)
+        {
+            const int index = static_cast<int>(pos);
+            const float f = static_cast<float>(pos - index);
+            out[i] = in[index] + f * (in[index + 1] - in[index]);
+        }
+        break;
+
+    case Interpolator::lagrange:
+        for (int i = 0; i < numSamples; ++i, pos += ratio)
+        {
+            // Third-order Lagrange through the samples at -1, 0, 1 and 2
+            const int index = static_cast<int>(pos);
+            const float f = static_cast<float>(pos - index);
+            const float* x = in + index;
+            const float fm1 = f - 1.0f;
+            const float fm2 = f - 2.0f;
+            const float fp1 = f + 1.0f;
+
+            out[i] = -f * fm1 * fm2 * (1.0f / 6.0f) * x[-1]
+                + fp1 * fm1 * fm2 * 0.5f * x[0]
+                - fp1 * f * fm2 * 0.5f * x[1]
+                + fp1 * f * fm1 * (1.0f / 6.0f) * x[2];
+        }
+        break;
+
+    case Interpolator::sinc:
+    default:
+    {
+        const float* bandTaps = getSincTable().data() + band * (sincPhases + 1) * sincTaps;
+
+        for (int i = 0; i < numSamples; ++i, pos += ratio)
+        {
+            const int index = static_cast<int>(pos);
+            const double phase = (pos - index) * sincPhases;
+            const int p = static_cast<int>(phase);
+            const float f = static_cast<float>(phase - p);
+
+            // Blend the two nearest phases of the filter
+            const float* x = in + index - (halfTaps - 1);
+            const float a = dotProduct(x, bandTaps + p * sincTaps, sincTaps);
+            const float b = dotProduct(x, bandTaps + (p + 1) * sincTaps, sincTaps);
+            out[i] = a + f * (b - a);
+        }
+        break;
+    }
+    }
+}
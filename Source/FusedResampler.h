@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <vector>
+
+// FusedResampler converts a source to the device rate and applies the deck's speed in a
+// single interpolation stage. The ratio (input samples per output sample) combines the
+// file-to-device rate ratio and the speed, so each output sample is interpolated once.
+// Three interpolators are available: linear, 4-point Lagrange, and a 32-tap polyphase
+// windowed sinc whose cutoff follows the ratio and whose dot products use SIMD
+class FusedResampler : public AudioSource
+{
+public:
+    // Interpolators, cheapest first
+    enum class Interpolator
+    {
+        linear,
+        lagrange,
+        sinc
+    };
+
+    // Largest ratio supported; higher ratios are clamped
+    static constexpr double maxRatio = 16.0;
+
+    // Constructs a resampler pulling from input, which is not owned
+    FusedResampler(AudioSource* input, int numChannels = 2);
+
+    // Destructor
+    ~FusedResampler() override;
+
+    // Sets how many input samples are consumed per output sample. Audio thread only
+    void setRatio(double newRatio) noexcept;
+
+    // Returns the current ratio
+    double getRatio() const noexcept { return ratio; }
+
+    // Selects the interpolator. Audio thread only
+    void setInterpolator(Interpolator newInterpolator) noexcept { interpolator = newInterpolator; }
+
+    // Returns the selected interpolator
+    Interpolator getInterpolator() const noexcept { return interpolator; }
+
+    // Returns how far the input has been read ahead of the next output sample, in input
+    // samples. Audio thread only
+    double getBufferedInput() const noexcept { return historyLength - position; }
+
+    // Drops the buffered input history, e.g. after a seek
+    void flushBuffers() noexcept;
+
+    // Allocates the input history for blocks of up to samplesPerBlockExpected and prepares the input
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+    // Releases the input's resources
+    void releaseResources() override;
+
+    // Fills the block with resampled audio
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    // Returns a display name for an interpolator
+    static String getInterpolatorName(Interpolator type);
+
+    // Returns the instruction set used by the sinc dot products
+    static const char* getInstructionSetName() noexcept;
+
+private:
+    // Sinc filter shape
+    static constexpr int sincTaps = 32;
+    static constexpr int halfTaps = sincTaps / 2;
+    static constexpr int sincPhases = 128;
+
+    // Cutoff bands, spaced evenly in octaves: band b suits ratios up to 2^(b / bandsPerOctave),
+    // so the last one reaches maxRatio
+    static constexpr int bandsPerOctave = 6;
+    static constexpr int numBands = 4 * bandsPerOctave + 1;
+
+    // Returns the shared filter table, built on first use
+    static const std::vector<float>& getSincTable();
+
+    // Produces up to one prepared block of output
+    void processChunk(const AudioSourceChannelInfo& bufferToFill) noexcept;
+
+    // Drops spent history and pulls from the input until end samples are buffered
+    void fillInput(int end) noexcept;
+
+    // Interpolates one channel at positions start, start + ratio, ...
+    void interpolate(const float* in, float* out, int numSamples, double start) const noexcept;
+
+    AudioSource* input;
+    const int numChannels;
+
+    AudioBuffer<float> history;
+    int historyLength = 0;
+    int maxBlockSize = 0;
+
+    // Read position within history; the integer part indexes a sample
+    double position = 0.0;
+    double ratio = 1.0;
+    int band = 0;
+    Interpolator interpolator = Interpolator::sinc;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FusedResampler)
+};
@@ -0,0 +1,245 @@
+#include "HotCueBank.h"
+#include "IndexedMp3Reader.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // How often decoded prerolls are published and finished ones freed
+    constexpr int publishIntervalMs = 50;
+
+    // How long the I/O thread leaves the bank alone when there is nothing to decode
+    constexpr int idleWaitMs = 500;
+
+    // Creates a reader for the track's file, or nullptr if no registered format
+    // understands it. An MP3 with a frame index goes straight to the cue's frame
+    AudioFormatReader* createReader(AudioFormatManager& formatManager, const DeckTrack& track)
+    {
+        const auto& url = track.getURL();
+        if (auto frameIndex = track.getFrameIndex())
+            if (auto reader = IndexedMp3Reader::create(formatManager, url.getLocalFile(), frameIndex))
+                return reader.release();
+
+        if (url.isLocalFile())
+            return formatManager.createReaderFor(url.getLocalFile());
+
+        return formatManager.createReaderFor(url.createInputStream(false));
+    }
+}
+
+//------------------------------------------------------------------------------
+HotCueBank::HotCueBank(AudioFormatManager& formatManagerToUse, TimeSliceThread* threadToUse)
+    : formatManager(formatManagerToUse),
+    thread(threadToUse)
+{
+    for (auto& pending : pendingPrerolls)
+        pending = nullptr;
+
+    if (thread != nullptr)
+        thread->addTimeSliceClient(this);
+}
+
+//------------------------------------------------------------------------------
+HotCueBank::~HotCueBank()
+{
+    // Waits for a decode in progress to finish
+    if (thread != nullptr)
+        thread->removeTimeSliceClient(this);
+
+    stopTimer();
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::setCue(int index, DeckTrack::Ptr track, int64 position)
+{
+    if (thread == nullptr || track == nullptr || track->getReadAheadBuffer() == nullptr
+        || !isPositiveAndBelow(index, HotCues::maxCues))
+        return;
+
+    // The buffer is allocated here, so the I/O thread only decodes into it
+    auto preroll = std::make_unique<Preroll>();
+    preroll->track = track;
+    preroll->position = jmax<int64>(0, position);
+    preroll->audio.setSize(2, static_cast<int>(std::ceil(prerollSeconds * track->getSampleRate())));
+
+    {
+        const ScopedLock sl(lock);
+        clearCue(index);
+        requests.push_back({ index, generation, std::move(preroll) });
+    }
+
+    thread->moveToFrontOfQueue(this);
+    startTimer(publishIntervalMs);
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::clearCue(int index)
+{
+    const ScopedLock sl(lock);
+    requests.erase(std::remove_if(requests.begin(), requests.end(),
+        [index](const Request& request) { return request.index == index; }),
+        requests.end());
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::reset()
+{
+    // Waiting and decoded prerolls are dropped here, on the message thread
+    std::vector<Request> dropped;
+    {
+        const ScopedLock sl(lock);
+        dropped.swap(requests);
+        for (auto& request : decoded)
+            dropped.push_back(std::move(request));
+        decoded.clear();
+    }
+
+    // Published prerolls the audio thread has not taken yet never reached it
+    for (auto& pending : pendingPrerolls)
+        if (auto* preroll = pending.exchange(nullptr))
+            livePrerolls.removeObject(preroll);
+
+    ++generation;
+    resetRequested = true;
+    startTimer(publishIntervalMs);
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::update() noexcept
+{
+    if (!resetRequested.load())
+        return;
+
+    for (auto& preroll : activePrerolls)
+    {
+        if (preroll == nullptr)
+            continue;
+
+        // What doesn't fit is handed back on a later block
+        if (retiredFifo.getFreeSpace() == 0)
+            return;
+
+        retire(preroll);
+        preroll = nullptr;
+    }
+
+    resetRequested = false;
+}
+
+//------------------------------------------------------------------------------
+const HotCueBank::Preroll* HotCueBank::find(const DeckTrack* track, int64 position) noexcept
+{
+    takePending();
+
+    for (const auto* preroll : activePrerolls)
+        if (preroll != nullptr && preroll->track.get() == track && preroll->position == position)
+            return preroll;
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::takePending() noexcept
+{
+    for (size_t i = 0; i < activePrerolls.size(); ++i)
+    {
+        // Only take a new preroll when there is room to hand the old one back
+        if (retiredFifo.getFreeSpace() == 0)
+            return;
+
+        auto* next = pendingPrerolls[i].exchange(nullptr);
+        if (next == nullptr)
+            continue;
+
+        if (activePrerolls[i] != nullptr)
+            retire(activePrerolls[i]);
+
+        activePrerolls[i] = next;
+    }
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::retire(Preroll* preroll) noexcept
+{
+    const auto scope = retiredFifo.write(1);
+    if (scope.blockSize1 > 0)
+        retiredPrerolls[static_cast<size_t>(scope.startIndex1)] = preroll;
+    else
+        retiredPrerolls[static_cast<size_t>(scope.startIndex2)] = preroll;
+}
+
+//------------------------------------------------------------------------------
+int HotCueBank::useTimeSlice()
+{
+    Request request;
+    {
+        const ScopedLock sl(lock);
+        if (requests.empty())
+            return idleWaitMs;
+
+        request = std::move(requests.front());
+        requests.erase(requests.begin());
+    }
+
+    // The reader stays open while cues are set on the same track
+    auto& preroll = *request.preroll;
+    const auto& url = preroll.track->getURL();
+    if (reader == nullptr || readerURL != url)
+    {
+        reader.reset(createReader(formatManager, *preroll.track));
+        readerURL = url;
+    }
+
+    int numSamples = 0;
+    if (reader != nullptr)
+    {
+        numSamples = static_cast<int>(jlimit<int64>(0, preroll.audio.getNumSamples(), reader->lengthInSamples - preroll.position));
+        if (numSamples > 0)
+            reader->read(&preroll.audio, 0, numSamples, preroll.position, true, true);
+    }
+
+    preroll.audio.setSize(2, numSamples, true, false, true);
+
+    // Handed back whether or not it decoded, so the track is only ever released on the
+    // message thread
+    const ScopedLock sl(lock);
+    decoded.push_back(std::move(request));
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void HotCueBank::timerCallback()
+{
+    std::vector<Request> finished;
+    {
+        const ScopedLock sl(lock);
+        finished.swap(decoded);
+    }
+
+    for (auto& request : finished)
+    {
+        if (request.preroll->audio.getNumSamples() == 0 || request.generation != generation)
+            continue;
+
+        // A preroll still pending never reached the audio thread, so it can go now
+        auto* preroll = livePrerolls.add(request.preroll.release());
+        if (auto* superseded = pendingPrerolls[static_cast<size_t>(request.index)].exchange(preroll))
+            livePrerolls.removeObject(superseded);
+    }
+
+    const auto scope = retiredFifo.read(retiredFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i)
+        livePrerolls.removeObject(retiredPrerolls[static_cast<size_t>(scope.startIndex1 + i)]);
+    for (int i = 0; i < scope.blockSize2; ++i)
+        livePrerolls.removeObject(retiredPrerolls[static_cast<size_t>(scope.startIndex2 + i)]);
+
+    // Prerolls the audio thread takes later are freed the next time the timer runs. After
+    // a reset it runs until the audio thread has handed every one back; the flag is read
+    // first, as the audio thread clears it only once they are all in the FIFO
+    if (resetRequested.load() || retiredFifo.getNumReady() > 0)
+        return;
+
+    const ScopedLock sl(lock);
+    if (requests.empty() && decoded.empty())
+        stopTimer();
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckTrack.h"
+#include "HotCues.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// HotCueBank keeps a second of decoded audio from each of a deck's hot cues, so a jump to
+// a cue plays from memory straight away while the track's streaming reader seeks and
+// refills behind it. Each preroll is decoded on the disk I/O thread with a reader of its
+// own, so the track's reader never moves.
+//
+// Finished prerolls are handed to the audio thread through an atomic pointer swap, and
+// the audio thread passes the ones it replaces back through a FIFO to be freed on the
+// message thread, as DeckTransport does with tracks. Only tracks that stream through a
+// read-ahead buffer get prerolls: cached and memory-mapped tracks already seek instantly
+class HotCueBank : private TimeSliceClient,
+    private Timer
+{
+public:
+    // Decoded audio from a cue onwards
+    struct Preroll
+    {
+        // Track the audio was decoded from, and where in it the audio starts
+        DeckTrack::Ptr track;
+        int64 position = 0;
+
+        AudioBuffer<float> audio;
+    };
+
+    // How much audio is decoded from each cue: enough for the read-ahead buffer to refill
+    static constexpr double prerollSeconds = 1.0;
+
+    // Constructs a bank decoding on thread. With no thread there are no prerolls
+    HotCueBank(AudioFormatManager& formatManager, TimeSliceThread* thread);
+
+    // Destructor. Audio must have stopped
+    ~HotCueBank() override;
+
+    // Decodes the audio from position in track, in its own samples, for the cue at
+    // index, replacing whatever the cue had. Message thread only
+    void setCue(int index, DeckTrack::Ptr track, int64 position);
+
+    // Forgets any preroll still waiting to be decoded for the cue at index. Message thread only
+    void clearCue(int index);
+
+    // Forgets every cue, for a new track. Prerolls the audio thread holds are handed back
+    // on its next block, so the old track is not kept alive. Message thread only
+    void reset();
+
+    // Hands back every preroll after a reset. Audio thread only, once per block
+    void update() noexcept;
+
+    // Returns the preroll starting at position in track, or nullptr if there is none.
+    // It stays valid until the next call. Audio thread only
+    const Preroll* find(const DeckTrack* track, int64 position) noexcept;
+
+private:
+    // A preroll for the cue at index, waiting to be decoded or just decoded
+    struct Request
+    {
+        int index = 0;
+        int generation = 0;
+        std::unique_ptr<Preroll> preroll;
+    };
+
+    // Decodes one waiting preroll. Runs on the I/O thread
+    int useTimeSlice() override;
+
+    // Publishes decoded prerolls and frees the ones the audio thread has finished with
+    void timerCallback() override;
+
+    // Swaps in newly published prerolls. Audio thread only
+    void takePending() noexcept;
+
+    // Passes a preroll the audio thread has finished with back to the message thread.
+    // The FIFO must have room. Audio thread only
+    void retire(Preroll* preroll) noexcept;
+
+    AudioFormatManager& formatManager;
+    TimeSliceThread* thread;
+
+    // Waiting and decoded prerolls, shared by the message and I/O threads
+    CriticalSection lock;
+    std::vector<Request> requests;
+    std::vector<Request> decoded;
+
+    // I/O thread: the reader of the file being decoded from
+    std::unique_ptr<AudioFormatReader> reader;
+    URL readerURL;
+
+    // Prerolls the audio thread may be holding, kept alive by the message thread
+    OwnedArray<Preroll> livePrerolls;
+
+    // Hand-off from the message thread to the audio thread
+    std::array<std::atomic<Preroll*>, HotCues::maxCues> pendingPrerolls{};
+
+    // Prerolls owned by the audio thread
+    std::array<Preroll*, HotCues::maxCues> activePrerolls{};
+
+    // Hand-back from the audio thread to the message thread
+    static constexpr int retiredCapacity = 2 * HotCues::maxCues;
+    AbstractFifo retiredFifo{ retiredCapacity };
+    std::array<Preroll*, retiredCapacity> retiredPrerolls{};
+
+    // Counts resets, so a preroll being decoded when one happens is dropped. Message thread only
+    int generation = 0;
+
+    // Set by reset until the audio thread has handed back every active preroll
+    std::atomic<bool> resetRequested{ false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HotCueBank)
+};
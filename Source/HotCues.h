@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// HotCues holds a track's hot cues: up to eight positions a deck can jump to straight
+// away. It is stored with the track in the library, so it is plain data: a fixed array
+// of times with -1 where no cue is set
+struct HotCues
+{
+    static constexpr int maxCues = 8;
+
+    // Time of each cue in seconds, or -1 where none is set
+    double seconds[maxCues] = { -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+
+    // Returns true if the cue at index is set
+    bool isSet(int index) const noexcept
+    {
+        return isPositiveAndBelow(index, maxCues) && seconds[index] >= 0.0;
+    }
+
+    // Returns the time of the cue at index, or -1 if it is not set
+    double get(int index) const noexcept
+    {
+        return isSet(index) ? seconds[index] : -1.0;
+    }
+
+    // Sets the cue at index to a time in seconds
+    void set(int index, double timeSeconds) noexcept
+    {
+        if (isPositiveAndBelow(index, maxCues))
+            seconds[index] = jmax(0.0, timeSeconds);
+    }
+
+    // Clears the cue at index
+    void clear(int index) noexcept
+    {
+        if (isPositiveAndBelow(index, maxCues))
+            seconds[index] = -1.0;
+    }
+
+    // Returns true if no cue is set
+    bool isEmpty() const noexcept
+    {
+        for (int i = 0; i < maxCues; ++i)
+            if (isSet(i))
+                return false;
+
+        return true;
+    }
+
+    bool operator==(const HotCues& other) const noexcept
+    {
+        for (int i = 0; i < maxCues; ++i)
+            if (get(i) != other.get(i))
+                return false;
+
+        return true;
+    }
+
+    bool operator!=(const HotCues& other) const noexcept { return !operator==(other); }
+};
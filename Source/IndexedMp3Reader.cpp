@@ -0,0 +1,114 @@
+#include "IndexedMp3Reader.h"
+
+namespace
+{
+    // A seek no further ahead than this decodes through to its target rather than
+    // reopening the decoder, which would decode as much again in warm-up
+    constexpr int64 maxSkipSamples = 4 * Mp3FrameIndex::samplesPerFrame;
+}
+
+//------------------------------------------------------------------------------
+std::unique_ptr<AudioFormatReader> IndexedMp3Reader::create(AudioFormatManager& formatManager,
+    const File& file, std::shared_ptr<const Mp3FrameIndex> index)
+{
+    auto* format = formatManager.findFormatForFileExtension(".mp3");
+    if (format == nullptr || index == nullptr || !index->isUsable())
+        return nullptr;
+
+    auto reader = std::make_unique<IndexedMp3Reader>(*format, file, std::move(index));
+    if (reader->fileStream == nullptr)
+        return nullptr;
+
+    return reader;
+}
+
+//------------------------------------------------------------------------------
+IndexedMp3Reader::IndexedMp3Reader(AudioFormat& mp3FormatToUse, const File& file,
+    std::shared_ptr<const Mp3FrameIndex> indexToUse)
+    : AudioFormatReader(nullptr, mp3FormatToUse.getFormatName()),
+    mp3Format(mp3FormatToUse),
+    index(std::move(indexToUse)),
+    fileStream(file.createInputStream()),
+    skipBuffer(2, Mp3FrameIndex::samplesPerFrame)
+{
+    sampleRate = index->getSampleRate();
+    numChannels = static_cast<unsigned int>(index->getNumChannels());
+    bitsPerSample = 32;
+    usesFloatingPointData = true;
+    lengthInSamples = index->getLengthInSamples();
+}
+
+//------------------------------------------------------------------------------
+IndexedMp3Reader::~IndexedMp3Reader()
+{
+    // The decoder's stream reads from the file stream, so it goes first
+    decoder.reset();
+}
+
+//------------------------------------------------------------------------------
+bool IndexedMp3Reader::readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+    int64 startSampleInFile, int numSamples)
+{
+    clearSamplesBeyondAvailableLength(destChannels, numDestChannels, startOffsetInDestBuffer,
+        startSampleInFile, numSamples, lengthInSamples);
+
+    if (numSamples <= 0)
+        return true;
+
+    const bool reachable = decoder != nullptr && startSampleInFile >= nextSample
+        && startSampleInFile - nextSample <= maxSkipSamples;
+
+    if (!(reachable ? skipTo(startSampleInFile) : openDecoderAt(startSampleInFile)))
+    {
+        for (int ch = 0; ch < numDestChannels; ++ch)
+            if (destChannels[ch] != nullptr)
+                zeromem(destChannels[ch] + startOffsetInDestBuffer, sizeof(int) * static_cast<size_t>(numSamples));
+
+        return false;
+    }
+
+    const bool ok = decoder->readSamples(destChannels, numDestChannels, startOffsetInDestBuffer,
+        nextSample - decoderStart, numSamples);
+    nextSample += numSamples;
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+bool IndexedMp3Reader::openDecoderAt(int64 sample)
+{
+    const int first = index->getDecodeStartFrame(index->getFrameForSample(sample));
+
+    // Each decoder reads the file through a stream starting at its first frame; the
+    // whole file, tags and all, when that is the start
+    decoder.reset();
+    nextSample = -1;
+    if (fileStream == nullptr)
+        return false;
+
+    const int64 offset = first > 0 ? index->getFrameOffset(first) : 0;
+    decoder.reset(mp3Format.createReaderFor(new SubregionStream(fileStream.get(), offset, -1, false), true));
+    if (decoder == nullptr)
+        return false;
+
+    decoderStart = index->getFirstSampleWhenStartingAt(first);
+    nextSample = decoderStart;
+    jassert(decoderStart <= sample);
+    return skipTo(sample);
+}
+
+//------------------------------------------------------------------------------
+bool IndexedMp3Reader::skipTo(int64 sample)
+{
+    auto* const* skipChannels = reinterpret_cast<int* const*>(skipBuffer.getArrayOfWritePointers());
+
+    while (nextSample < sample)
+    {
+        const int num = static_cast<int>(jmin<int64>(skipBuffer.getNumSamples(), sample - nextSample));
+        if (!decoder->readSamples(skipChannels, skipBuffer.getNumChannels(), 0, nextSample - decoderStart, num))
+            return false;
+
+        nextSample += num;
+    }
+
+    return true;
+}
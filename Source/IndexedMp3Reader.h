@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Mp3FrameIndex.h"
+#include <memory>
+
+// IndexedMp3Reader reads an MP3 through JUCE's decoder but seeks with an Mp3FrameIndex.
+// JUCE's reader only learns where frames are by parsing its way to them, so a seek far
+// into a file it has not yet read goes through every frame before it. This reader looks
+// the frame up instead, opens the decoder a few warm-up frames before it on a stream that
+// starts there, and throws away the samples before the one asked for. Any seek costs at
+// most the warm-up frames plus one, and lands on the samples a full decode gives: an
+// index is only used once seeks near the start and at points spread to the end of the
+// file have matched a straight decode. Sequential reads go straight through to the decoder
+class IndexedMp3Reader : public AudioFormatReader
+{
+public:
+    // Creates a reader for file using index, or returns nullptr if the format manager
+    // has no MP3 format or the file can't be opened
+    static std::unique_ptr<AudioFormatReader> create(AudioFormatManager& formatManager,
+        const File& file, std::shared_ptr<const Mp3FrameIndex> index);
+
+    // Constructs a reader that decodes file with mp3Format, seeking through index
+    IndexedMp3Reader(AudioFormat& mp3Format, const File& file, std::shared_ptr<const Mp3FrameIndex> index);
+
+    // Destructor
+    ~IndexedMp3Reader() override;
+
+    // Reads from the decoder, reopening it near startSampleInFile when it is not already there
+    bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+        int64 startSampleInFile, int numSamples) override;
+
+private:
+    // Opens the decoder at the warm-up frames before sample and reads up to it. Returns
+    // false if the decoder could not be opened
+    bool openDecoderAt(int64 sample);
+
+    // Decodes and throws away samples until the decoder reaches sample
+    bool skipTo(int64 sample);
+
+    AudioFormat& mp3Format;
+    std::shared_ptr<const Mp3FrameIndex> index;
+
+    // The file, shared by each decoder in turn through a stream over the part it reads
+    std::unique_ptr<FileInputStream> fileStream;
+    std::unique_ptr<AudioFormatReader> decoder;
+
+    // The sample the decoder produced first, and the one it produces next
+    int64 decoderStart = 0;
+    int64 nextSample = -1;
+
+    // Somewhere to put the samples skipped after a seek
+    AudioBuffer<float> skipBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(IndexedMp3Reader)
+};
@@ -0,0 +1,498 @@
+#include "LibraryImporter.h"
+
+namespace
+{
+    // Files probed by one job; enough to outweigh queueing it, few enough to spread a
+    // large folder over every worker
+    constexpr size_t probeBatchSize = 16;
+
+    // First rescan after startup, then how often remembered folders are rescanned
+    constexpr int firstRescanDelayMs = 10000;
+    constexpr int rescanIntervalMs = 2 * 60 * 1000;
+
+    // Longest text frame read from a tag; anything longer isn't a title
+    constexpr int64 maxTagTextSize = 1024;
+
+    // Text of an ID3 frame: an encoding byte, then Latin-1, UTF-16 or UTF-8 text,
+    // possibly several values separated by nulls of which the first is kept
+    String decodeId3Text(const MemoryBlock& frame)
+    {
+        if (frame.getSize() < 2)
+            return {};
+
+        const auto* data = static_cast<const uint8*>(frame.getData());
+        const auto encoding = data[0];
+        const auto* text = data + 1;
+        auto size = frame.getSize() - 1;
+        String result;
+
+        if (encoding == 3)
+        {
+            size_t length = 0;
+            while (length < size && text[length] != 0)
+                ++length;
+
+            return String::fromUTF8(reinterpret_cast<const char*>(text), static_cast<int>(length)).trim();
+        }
+
+        if (encoding == 0)
+        {
+            for (size_t i = 0; i < size && text[i] != 0; ++i)
+                result += static_cast<juce_wchar>(text[i]);
+
+            return result.trim();
+        }
+
+        // UTF-16, big-endian unless a byte order mark says otherwise
+        bool bigEndian = true;
+        if (size >= 2 && ((text[0] == 0xff && text[1] == 0xfe) || (text[0] == 0xfe && text[1] == 0xff)))
+        {
+            bigEndian = text[0] == 0xfe;
+            text += 2;
+            size -= 2;
+        }
+
+        auto unit = [text, bigEndian](size_t i)
+        {
+            return static_cast<uint32>(bigEndian ? (text[i] << 8) | text[i + 1] : (text[i + 1] << 8) | text[i]);
+        };
+
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            auto c = unit(i);
+            if (c == 0)
+                break;
+
+            // Characters outside the basic plane come as a surrogate pair
+            if (c >= 0xd800 && c < 0xdc00 && i + 3 < size)
+            {
+                c = 0x10000 + ((c - 0xd800) << 10) + (unit(i + 2) - 0xdc00);
+                i += 2;
+            }
+
+            result += static_cast<juce_wchar>(c);
+        }
+
+        return result.trim();
+    }
+
+    // Reads the title and artist from an ID3v2 tag at the start of a file, or an ID3v1
+    // tag at the end. Fields the tags don't have are left alone
+    void readId3Tags(const File& file, String& title, String& artist)
+    {
+        FileInputStream in(file);
+        if (!in.openedOk())
+            return;
+
+        uint8 header[10] = {};
+        if (in.read(header, 10) == 10 && header[0] == 'I' && header[1] == 'D' && header[2] == '3')
+        {
+            const int version = header[3];
+            const auto syncsafe = [](const uint8* b)
+            {
+                return (static_cast<int64>(b[0] & 0x7f) << 21) | (static_cast<int64>(b[1] & 0x7f) << 14)
+                    | (static_cast<int64>(b[2] & 0x7f) << 7) | static_cast<int64>(b[3] & 0x7f);
+            };
+            const auto tagEnd = 10 + syncsafe(header + 6);
+
+            // Skip the extended header; its size counts itself from version 4 on
+            if ((header[5] & 0x40) != 0 && version >= 3)
+            {
+                uint8 size[4] = {};
+                in.read(size, 4);
+                const auto extendedSize = version >= 4 ? syncsafe(size) : (static_cast<int64>(size[0]) << 24
+                    | static_cast<int64>(size[1]) << 16 | static_cast<int64>(size[2]) << 8 | size[3]) + 4;
+                in.setPosition(10 + extendedSize);
+            }
+
+            // Version 2.2 frames have three-letter names and three-byte sizes
+            const int idSize = version == 2 ? 3 : 4;
+            const int frameHeaderSize = version == 2 ? 6 : 10;
+            const char* const titleId = version == 2 ? "TT2" : "TIT2";
+            const char* const artistId = version == 2 ? "TP1" : "TPE1";
+
+            while (in.getPosition() + frameHeaderSize <= tagEnd && (title.isEmpty() || artist.isEmpty()))
+            {
+                uint8 frameHeader[10] = {};
+                if (in.read(frameHeader, frameHeaderSize) != frameHeaderSize || frameHeader[0] == 0)
+                    break;
+
+                int64 size = 0;
+                if (version == 2)
+                    size = static_cast<int64>(frameHeader[3]) << 16 | static_cast<int64>(frameHeader[4]) << 8 | frameHeader[5];
+                else if (version >= 4)
+                    size = syncsafe(frameHeader + 4);
+                else
+                    size = static_cast<int64>(frameHeader[4]) << 24 | static_cast<int64>(frameHeader[5]) << 16
+                        | static_cast<int64>(frameHeader[6]) << 8 | frameHeader[7];
+
+                const auto frameStart = in.getPosition();
+                if (size <= 0 || frameStart + size > tagEnd)
+                    break;
+
+                const String id(reinterpret_cast<const char*>(frameHeader), static_cast<size_t>(idSize));
+                const bool isTitle = id == titleId;
+                if ((isTitle || id == artistId) && size <= maxTagTextSize)
+                {
+                    MemoryBlock frame;
+                    in.readIntoMemoryBlock(frame, static_cast<ssize_t>(size));
+                    const auto text = decodeId3Text(frame);
+                    if (text.isNotEmpty())
+                        (isTitle ? title : artist) = text;
+                }
+
+                // Cover art and the rest are skipped without being read
+                in.setPosition(frameStart + size);
+            }
+
+            if (title.isNotEmpty() && artist.isNotEmpty())
+                return;
+        }
+
+        // ID3v1: 128 bytes at the end, fixed-width Latin-1 fields
+        if (in.getTotalLength() < 128 || !in.setPosition(in.getTotalLength() - 128))
+            return;
+
+        uint8 tag[128] = {};
+        if (in.read(tag, 128) != 128 || tag[0] != 'T' || tag[1] != 'A' || tag[2] != 'G')
+            return;
+
+        auto field = [&tag](int start)
+        {
+            String text;
+            for (int i = start; i < start + 30 && tag[i] != 0; ++i)
+                text += static_cast<juce_wchar>(tag[i]);
+            return text.trim();
+        };
+
+        if (title.isEmpty())
+            title = field(3);
+        if (artist.isEmpty())
+            artist = field(33);
+    }
+}
+
+// Lists one folder: queues a job for each subfolder and probe jobs for the audio files
+// that are new or have changed since the crawl started
+class LibraryImporter::FolderJob : public ThreadPoolJob
+{
+public:
+    FolderJob(LibraryImporter& owner, const File& folderToList, std::shared_ptr<const KnownTimes> knownTimes)
+        : ThreadPoolJob("Library folder"),
+        importer(owner),
+        folder(folderToList),
+        known(std::move(knownTimes))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        std::vector<File> files;
+        for (const auto& entry : RangedDirectoryIterator(folder, false, "*",
+                 File::findFilesAndDirectories | File::ignoreHiddenFiles))
+        {
+            if (shouldExit())
+                break;
+
+            const auto& child = entry.getFile();
+            if (entry.isDirectory())
+            {
+                // Links could lead back up the tree
+                if (!child.isSymbolicLink())
+                    importer.addFolder(child, known);
+                continue;
+            }
+
+            if (!importer.isAudioFile(child))
+                continue;
+
+            // The listing already carries the modification time, so an unchanged file
+            // costs nothing more
+            const auto found = known->find(LibraryStore::hashPath(child));
+            if (found != known->end() && found->second == entry.getModificationTime().toMilliseconds())
+                continue;
+
+            files.push_back(child);
+            if (files.size() == probeBatchSize)
+            {
+                importer.addFiles(std::move(files));
+                files.clear();
+            }
+        }
+
+        if (!files.empty() && !shouldExit())
+            importer.addFiles(std::move(files));
+
+        importer.jobFinished();
+        return jobHasFinished;
+    }
+
+private:
+    LibraryImporter& importer;
+    File folder;
+    std::shared_ptr<const KnownTimes> known;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FolderJob)
+};
+
+// Reads the length and tags of a batch of files
+class LibraryImporter::ProbeJob : public ThreadPoolJob
+{
+public:
+    ProbeJob(LibraryImporter& owner, std::vector<File> filesToProbe)
+        : ThreadPoolJob("Library probe"),
+        importer(owner),
+        files(std::move(filesToProbe))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        for (const auto& file : files)
+        {
+            if (shouldExit())
+                break;
+
+            LibraryStore::Track track;
+            if (importer.probe(file, track))
+                importer.trackFound(track);
+        }
+
+        importer.jobFinished();
+        return jobHasFinished;
+    }
+
+private:
+    LibraryImporter& importer;
+    std::vector<File> files;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProbeJob)
+};
+
+//------------------------------------------------------------------------------
+LibraryImporter::LibraryImporter(AudioFormatManager& formatManagerToUse, LibraryStore& libraryToFill,
+    const File& foldersFileToUse)
+    : formatManager(formatManagerToUse),
+    library(libraryToFill),
+    foldersFile(foldersFileToUse),
+    pool(jmax(1, SystemStats::getNumCpus()), 0, Thread::Priority::low)
+{
+    if (foldersFile.existsAsFile())
+    {
+        foldersFile.readLines(folders);
+        folders.removeEmptyStrings();
+    }
+
+    startTimer(firstRescanDelayMs);
+}
+
+//------------------------------------------------------------------------------
+LibraryImporter::~LibraryImporter()
+{
+    stopTimer();
+    pool.removeAllJobs(true, 5000);
+    cancelPendingUpdate();
+}
+
+//------------------------------------------------------------------------------
+File LibraryImporter::getDefaultFoldersFile()
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory)
+        .getChildFile("OtoDecks")
+        .getChildFile("LibraryFolders.txt");
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::import(const Array<File>& filesAndFolders)
+{
+    // Remember new folders for the rescans
+    const int numFolders = folders.size();
+    for (const auto& file : filesAndFolders)
+        if (file.isDirectory())
+            folders.addIfNotAlreadyThere(file.getFullPathName());
+
+    if (folders.size() != numFolders)
+    {
+        foldersFile.getParentDirectory().createDirectory();
+        foldersFile.replaceWithText(folders.joinIntoString("\n"));
+    }
+
+    start(filesAndFolders);
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::rescan()
+{
+    // A crawl still running covers the same ground
+    if (isImporting())
+        return;
+
+    Array<File> files;
+    for (const auto& folder : folders)
+        files.add(File(folder));
+
+    start(files);
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::start(const Array<File>& filesAndFolders)
+{
+    // Snapshot of what the library holds, read by the jobs
+    auto known = std::make_shared<KnownTimes>();
+    known->reserve(static_cast<size_t>(library.getNumTracks()));
+    for (int i = 0; i < library.getNumTracks(); ++i)
+        known->emplace(library.getPathHash(i), library.getModificationTime(i));
+
+    std::vector<File> files;
+    for (const auto& file : filesAndFolders)
+    {
+        if (file.isDirectory())
+        {
+            addFolder(file, known);
+        }
+        else if (file.existsAsFile() && isAudioFile(file))
+        {
+            const auto found = known->find(LibraryStore::hashPath(file));
+            if (found == known->end() || found->second != file.getLastModificationTime().toMilliseconds())
+                files.push_back(file);
+        }
+    }
+
+    for (size_t i = 0; i < files.size(); i += probeBatchSize)
+        addFiles(std::vector<File>(files.begin() + static_cast<std::ptrdiff_t>(i),
+            files.begin() + static_cast<std::ptrdiff_t>(jmin(files.size(), i + probeBatchSize))));
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::addFolder(const File& folder, std::shared_ptr<const KnownTimes> known)
+{
+    {
+        const ScopedLock sl(lock);
+        if (!visitedFolders.insert(folder.getFullPathName()).second)
+            return;
+    }
+
+    ++numJobs;
+    pool.addJob(new FolderJob(*this, folder, std::move(known)), true);
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::addFiles(std::vector<File> files)
+{
+    ++numJobs;
+    pool.addJob(new ProbeJob(*this, std::move(files)), true);
+}
+
+//------------------------------------------------------------------------------
+bool LibraryImporter::isAudioFile(const File& file) const
+{
+    return formatManager.findFormatForFileExtension(file.getFileExtension()) != nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool LibraryImporter::probe(const File& file, LibraryStore::Track& track) const
+{
+    std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr)
+        return false;
+
+    // Title and artist from the file name, unless the tags say otherwise
+    track = LibraryStore::describeFile(file);
+    if (reader->sampleRate > 0.0)
+        track.lengthSeconds = static_cast<double>(reader->lengthInSamples) / reader->sampleRate;
+
+    String title = reader->metadataValues[WavAudioFormat::riffInfoTitle];
+    String artist = reader->metadataValues[WavAudioFormat::riffInfoArtist];
+#if JUCE_USE_OGGVORBIS
+    if (title.isEmpty())
+        title = reader->metadataValues[OggVorbisAudioFormat::id3title];
+    if (artist.isEmpty())
+        artist = reader->metadataValues[OggVorbisAudioFormat::id3artist];
+#endif
+
+    // The MP3 reader doesn't parse ID3 tags, so they are read straight from the file
+    if (file.hasFileExtension("mp3") && (title.isEmpty() || artist.isEmpty()))
+        readId3Tags(file, title, artist);
+
+    if (title.trim().isNotEmpty())
+        track.title = title.trim();
+    if (artist.trim().isNotEmpty())
+        track.artist = artist.trim();
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::trackFound(const LibraryStore::Track& track)
+{
+    {
+        const ScopedLock sl(lock);
+        foundTracks.push_back(track);
+    }
+
+    triggerAsyncUpdate();
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::jobFinished()
+{
+    --numJobs;
+    triggerAsyncUpdate();
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::handleAsyncUpdate()
+{
+    std::vector<LibraryStore::Track> tracks;
+    {
+        const ScopedLock sl(lock);
+        tracks.swap(foundTracks);
+
+        // The crawl is over; the next one lists every folder again
+        if (numJobs.load() == 0)
+            visitedFolders.clear();
+    }
+
+    if (tracks.empty())
+        return;
+
+    const int firstNewTrack = library.getNumTracks();
+    std::vector<int> updatedTracks;
+    for (auto& track : tracks)
+    {
+        const int existing = library.findTrack(track.file);
+        if (existing < 0)
+        {
+            library.addTrack(track);
+        }
+        else if (library.getModificationTime(existing) != track.modificationTime)
+        {
+            // The file has changed, so its old analysis no longer applies. The hot cues
+            // were set by the user, so they stay
+            track.hotCues = library.getHotCues(existing);
+            library.updateTrack(existing, track);
+            updatedTracks.push_back(existing);
+        }
+    }
+
+    listeners.call([firstNewTrack, &updatedTracks](Listener& l) { l.tracksImported(firstNewTrack, updatedTracks); });
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::timerCallback()
+{
+    startTimer(rescanIntervalMs);
+    rescan();
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+//------------------------------------------------------------------------------
+void LibraryImporter::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LibraryStore.h"
+#include <atomic>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+// LibraryImporter adds files and whole folders to the library. Folders are crawled on a
+// pool of low-priority worker threads, one job per folder, so the subfolders of a crate
+// are listed in parallel; the audio files found are probed in batches on the same pool
+// for their length and their ID3, Vorbis or RIFF INFO title and artist. Tracks reach the
+// library on the message thread in batches as they are found, so rows stream into the
+// list while the crawl goes on.
+//
+// Imported folders are remembered and rescanned every few minutes. A rescan compares the
+// modification time of every file with the one the library holds and only probes files
+// that are new or have changed, so re-importing a crate costs one directory listing per
+// folder. Message thread only, apart from the jobs
+class LibraryImporter : private AsyncUpdater,
+    private Timer
+{
+public:
+    // Hears about imported tracks on the message thread
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+
+        // Called after a batch of tracks has reached the library. New tracks run from
+        // firstNewTrack to the end; updatedTracks were listed already and have been
+        // re-read because their files changed
+        virtual void tracksImported(int firstNewTrack, const std::vector<int>& updatedTracks) = 0;
+    };
+
+    // Constructs LibraryImporter, adding to library and remembering folders in foldersFile
+    LibraryImporter(AudioFormatManager& formatManager, LibraryStore& library, const File& foldersFile);
+
+    // Destructor. Abandons the crawl and waits for running jobs to stop
+    ~LibraryImporter() override;
+
+    // Returns the folder list file used by the application
+    static File getDefaultFoldersFile();
+
+    // Imports files, and every audio file under folders. Folders are remembered
+    void import(const Array<File>& filesAndFolders);
+
+    // Looks through every remembered folder again for new and changed files
+    void rescan();
+
+    // Returns true while folders are being crawled or files probed
+    bool isImporting() const noexcept { return numJobs.load() > 0; }
+
+    // Registers a listener for imported tracks
+    void addListener(Listener* listener);
+
+    // Unregisters a listener
+    void removeListener(Listener* listener);
+
+private:
+    class FolderJob;
+    class ProbeJob;
+
+    // Modification times the library held when a crawl started, by path hash
+    using KnownTimes = std::unordered_map<uint64, int64>;
+
+    // Starts a crawl over files and folders
+    void start(const Array<File>& filesAndFolders);
+
+    // Queues a folder unless this crawl has already listed it. Any thread
+    void addFolder(const File& folder, std::shared_ptr<const KnownTimes> known);
+
+    // Queues files to probe. Any thread
+    void addFiles(std::vector<File> files);
+
+    // Returns true if a file has an extension one of the formats reads. Any thread
+    bool isAudioFile(const File& file) const;
+
+    // Reads a file's length and tags. Returns false if it can't be read. Any thread
+    bool probe(const File& file, LibraryStore::Track& track) const;
+
+    // Hands a probed track over to the message thread. Any thread
+    void trackFound(const LibraryStore::Track& track);
+
+    // Called by each job as it ends. Any thread
+    void jobFinished();
+
+    // Moves the tracks found so far into the library
+    void handleAsyncUpdate() override;
+
+    // Starts the periodic rescan
+    void timerCallback() override;
+
+    AudioFormatManager& formatManager;
+    LibraryStore& library;
+    const File foldersFile;
+    StringArray folders;
+
+    std::atomic<int> numJobs{ 0 };
+
+    // Folders listed by the current crawl and tracks waiting for the message thread
+    CriticalSection lock;
+    std::set<String> visitedFolders;
+    std::vector<LibraryStore::Track> foundTracks;
+
+    ListenerList<Listener> listeners;
+
+    // Last, so its jobs stop before anything they use goes
+    ThreadPool pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryImporter)
+};
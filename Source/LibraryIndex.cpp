@@ -0,0 +1,582 @@
+#include "LibraryIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+    // Most sort keys kept; older ones are dropped
+    constexpr size_t maxSortKeys = 3;
+
+    // Sort value of a missing tempo, key or length; comesBefore puts those rows last
+    constexpr float unknownValue = std::numeric_limits<float>::max();
+    constexpr int8 unknownKey = std::numeric_limits<int8>::max();
+
+    // Longest run of characters indexed; longer words are checked against the text
+    constexpr size_t maxGramLength = 3;
+
+    // Slots for every one- and two-byte gram
+    constexpr size_t numShortGrams = 256 + 65536;
+
+    // Words never span a space or the newline between title and artist
+    inline bool isSeparator(char c) noexcept
+    {
+        return c == ' ' || c == '\n' || c == '\t';
+    }
+
+    // First eight bytes of a string, big-endian, so comparing them orders like the string
+    inline uint64 prefixOf(std::string_view s) noexcept
+    {
+        uint64 prefix = 0;
+        for (size_t i = 0; i < 8; ++i)
+            prefix = (prefix << 8) | (i < s.size() ? static_cast<uint8>(s[i]) : 0u);
+        return prefix;
+    }
+
+    // Orders keys around the Camelot wheel, so harmonically close keys sort together:
+    // 1A, 1B, 2A, 2B and so on
+    inline int8 keySortValue(int key) noexcept
+    {
+        if (key < 0 || key >= 24)
+            return unknownKey;
+
+        const bool minor = key >= 12;
+        const int major = minor ? (key % 12 + 3) % 12 : key;
+        const int camelot = (major * 7 + 7) % 12 + 1;
+        return static_cast<int8>(camelot * 2 + (minor ? 0 : 1));
+    }
+
+    template <typename T>
+    inline int compareValues(T a, T b) noexcept
+    {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+LibraryIndex::LibraryIndex(const LibraryStore& libraryToIndex)
+    : library(libraryToIndex)
+{
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::build()
+{
+    const int numTracks = library.getNumTracks();
+    shortGrams.resize(numShortGrams);
+    trigrams.reserve(1 << 16);
+    textStarts.reserve(static_cast<size_t>(numTracks));
+    artistStarts.reserve(static_cast<size_t>(numTracks));
+    textEnds.reserve(static_cast<size_t>(numTracks));
+    titlePrefixes.reserve(static_cast<size_t>(numTracks));
+    artistPrefixes.reserve(static_cast<size_t>(numTracks));
+
+    for (int track = 0; track < numTracks; ++track)
+        indexTrack(track);
+
+    // Library order until a sort is chosen
+    order.resize(static_cast<size_t>(numTracks));
+    std::iota(order.begin(), order.end(), 0);
+    orderPosition = order;
+    built = true;
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::indexTrack(int track)
+{
+    jassert(static_cast<size_t>(track) == textStarts.size());
+
+    textStarts.push_back(0);
+    artistStarts.push_back(0);
+    textEnds.push_back(0);
+    titlePrefixes.push_back(0);
+    artistPrefixes.push_back(0);
+    readText(track);
+
+    bpms.push_back(unknownValue);
+    lengths.push_back(unknownValue);
+    keys.push_back(unknownKey);
+    readValues(track);
+
+    // Tracks arrive in ascending order, so every list stays sorted
+    const auto index = static_cast<size_t>(track);
+    forEachGram(textStarts[index], textEnds[index], [track](std::vector<int>& tracks)
+        {
+            if (tracks.empty() || tracks.back() != track)
+                tracks.push_back(track);
+        });
+}
+
+//------------------------------------------------------------------------------
+bool LibraryIndex::readText(int track)
+{
+    const auto index = static_cast<size_t>(track);
+    const auto title = library.getTitle(track).toLowerCase().toStdString();
+    const auto artist = library.getArtist(track).toLowerCase().toStdString();
+
+    // A new track has no text yet; every track that has holds at least two newlines
+    if (textEnds[index] > textStarts[index]
+        && text.compare(textStarts[index], artistStarts[index] - textStarts[index] - 1, title) == 0
+        && text.compare(artistStarts[index], textEnds[index] - artistStarts[index] - 1, artist) == 0)
+        return false;
+
+    textStarts[index] = static_cast<uint32>(text.size());
+    text += title;
+    text += '\n';
+    artistStarts[index] = static_cast<uint32>(text.size());
+    text += artist;
+    text += '\n';
+    textEnds[index] = static_cast<uint32>(text.size());
+
+    titlePrefixes[index] = prefixOf(title);
+    artistPrefixes[index] = prefixOf(artist);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+template <typename Fn>
+void LibraryIndex::forEachGram(size_t start, size_t end, Fn&& fn)
+{
+    for (auto i = start; i < end; ++i)
+    {
+        for (size_t length = 1; length <= maxGramLength && i + length <= end; ++length)
+        {
+            if (isSeparator(text[i + length - 1]))
+                break;
+
+            fn(getGram(text.data() + i, length));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+uint32 LibraryIndex::getGramKey(const char* gram, size_t length) noexcept
+{
+    uint32 key = 0;
+    for (size_t i = 0; i < length; ++i)
+        key = (key << 8) | static_cast<uint8>(gram[i]);
+
+    // One-byte grams take the first 256 slots and two-byte grams the rest
+    return length == 2 ? 256 + key : key;
+}
+
+//------------------------------------------------------------------------------
+std::vector<int>& LibraryIndex::getGram(const char* gram, size_t length)
+{
+    const auto key = getGramKey(gram, length);
+    return length < maxGramLength ? shortGrams[key] : trigrams[key];
+}
+
+//------------------------------------------------------------------------------
+const std::vector<int>* LibraryIndex::findGram(const char* gram, size_t length) const
+{
+    const auto key = getGramKey(gram, length);
+    if (length < maxGramLength)
+        return &shortGrams[key];
+
+    const auto found = trigrams.find(key);
+    return found != trigrams.end() ? &found->second : nullptr;
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::readValues(int track)
+{
+    const auto index = static_cast<size_t>(track);
+    const float bpm = library.getBpm(track);
+    const auto length = static_cast<float>(library.getLengthSeconds(track));
+
+    bpms[index] = bpm > 0.0f ? bpm : unknownValue;
+    lengths[index] = length > 0.0f ? length : unknownValue;
+    keys[index] = keySortValue(library.getKey(track));
+}
+
+//------------------------------------------------------------------------------
+std::string_view LibraryIndex::getText(int track) const noexcept
+{
+    const auto index = static_cast<size_t>(track);
+    return std::string_view(text.data() + textStarts[index], textEnds[index] - textStarts[index]);
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::setSearch(const String& newText)
+{
+    const auto lower = newText.toLowerCase().toStdString();
+    if (lower == searchText)
+        return;
+
+    if (!built)
+        build();
+
+    // Adding to the end of the text can only drop rows, never bring new ones in
+    const bool narrowing = !searchWords.empty() && lower.compare(0, searchText.size(), searchText) == 0;
+    searchText = lower;
+
+    searchWords.clear();
+    for (size_t i = 0; i < searchText.size();)
+    {
+        while (i < searchText.size() && isSeparator(searchText[i]))
+            ++i;
+
+        const auto start = i;
+        while (i < searchText.size() && !isSeparator(searchText[i]))
+            ++i;
+
+        if (i > start)
+            searchWords.push_back(searchText.substr(start, i - start));
+    }
+
+    if (searchWords.empty())
+    {
+        matchingTracks.clear();
+        view.clear();
+        return;
+    }
+
+    matchingTracks = findMatches(narrowing ? &matchingTracks : nullptr);
+    updateView();
+}
+
+//------------------------------------------------------------------------------
+std::vector<int> LibraryIndex::findMatches(const std::vector<int>* previous) const
+{
+    // Every track holding a word holds each of its trigrams, so the rarest gram of the
+    // query bounds the tracks worth checking. A short word is a gram itself
+    const std::vector<int>* rarest = nullptr;
+    for (const auto& word : searchWords)
+    {
+        const auto length = jmin(word.size(), maxGramLength);
+        for (size_t i = 0; i + length <= word.size(); ++i)
+        {
+            const auto* tracks = findGram(word.data() + i, length);
+            if (tracks == nullptr || tracks->empty())
+                return {};
+
+            if (rarest == nullptr || tracks->size() < rarest->size())
+                rarest = tracks;
+        }
+    }
+
+    // A single word no longer than a gram matches exactly the tracks listed for it
+    if (searchWords.size() == 1 && searchWords.front().size() <= maxGramLength)
+        return *rarest;
+
+    const std::vector<int>* candidates = rarest;
+    if (previous != nullptr && previous->size() < candidates->size())
+        candidates = previous;
+
+    std::vector<int> result;
+    for (const int track : *candidates)
+        if (matches(track))
+            result.push_back(track);
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+bool LibraryIndex::matches(int track) const
+{
+    const auto trackText = getText(track);
+    for (const auto& word : searchWords)
+        if (trackText.find(word) == std::string_view::npos)
+            return false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::sortBy(Field field, bool forwards)
+{
+    if (!built)
+        build();
+
+    sortKeys.erase(std::remove_if(sortKeys.begin(), sortKeys.end(),
+        [field](const SortKey& key) { return key.field == field; }), sortKeys.end());
+    sortKeys.insert(sortKeys.begin(), SortKey{ field, forwards });
+    if (sortKeys.size() > maxSortKeys)
+        sortKeys.resize(maxSortKeys);
+
+    sortAll();
+    updateView();
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::sortAll()
+{
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](int a, int b) { return comesBefore(a, b); });
+    renumber(0, order.size());
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::renumber(size_t start, size_t end)
+{
+    for (auto i = start; i < end; ++i)
+        orderPosition[static_cast<size_t>(order[i])] = static_cast<int>(i);
+}
+
+//------------------------------------------------------------------------------
+bool LibraryIndex::comesBefore(int a, int b) const
+{
+    for (const auto& key : sortKeys)
+    {
+        const int result = compare(key.field, a, b);
+        if (result == 0)
+            continue;
+
+        // Rows without a value go last whichever way the column is sorted
+        const bool unknownA = isUnknown(key.field, a);
+        if (unknownA != isUnknown(key.field, b))
+            return !unknownA;
+
+        return key.forwards ? result < 0 : result > 0;
+    }
+
+    // Library order breaks the remaining ties, so every track has exactly one place
+    return a < b;
+}
+
+//------------------------------------------------------------------------------
+int LibraryIndex::compare(Field field, int a, int b) const
+{
+    const auto ia = static_cast<size_t>(a);
+    const auto ib = static_cast<size_t>(b);
+
+    switch (field)
+    {
+    case Field::title:
+    case Field::artist:
+    {
+        const bool title = field == Field::title;
+        const auto& prefixes = title ? titlePrefixes : artistPrefixes;
+        if (prefixes[ia] != prefixes[ib])
+            return compareValues(prefixes[ia], prefixes[ib]);
+
+        // Same first eight bytes; compare the rest from the text
+        auto part = [this, title](int track)
+        {
+            const auto trackText = getText(track);
+            const auto split = artistStarts[static_cast<size_t>(track)] - textStarts[static_cast<size_t>(track)];
+            return title ? trackText.substr(0, split - 1) : trackText.substr(split, trackText.size() - split - 1);
+        };
+        return part(a).compare(part(b));
+    }
+    case Field::bpm:
+        return compareValues(bpms[ia], bpms[ib]);
+    case Field::key:
+        return compareValues(keys[ia], keys[ib]);
+    case Field::length:
+        return compareValues(lengths[ia], lengths[ib]);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::tracksAdded(int firstTrack, int numTracks)
+{
+    // Read with everything else on first use
+    if (!built || numTracks <= 0)
+        return;
+
+    jassert(static_cast<size_t>(firstTrack) == order.size());
+    const auto oldSize = order.size();
+    for (int track = firstTrack; track < firstTrack + numTracks; ++track)
+    {
+        indexTrack(track);
+        order.push_back(track);
+        orderPosition.push_back(static_cast<int>(order.size()) - 1);
+
+        if (!searchWords.empty() && matches(track))
+            matchingTracks.push_back(track);
+    }
+
+    // Sort the new tracks among themselves, then merge them in with one pass
+    if (!sortKeys.empty())
+    {
+        auto comparator = [this](int a, int b) { return comesBefore(a, b); };
+        const auto middle = order.begin() + static_cast<std::ptrdiff_t>(oldSize);
+        std::sort(middle, order.end(), comparator);
+
+        const auto first = std::upper_bound(order.begin(), middle, *std::min_element(middle, order.end(), comparator), comparator);
+        std::inplace_merge(first, middle, order.end(), comparator);
+        renumber(static_cast<size_t>(first - order.begin()), order.size());
+    }
+
+    updateView();
+}
+
+//------------------------------------------------------------------------------
+bool LibraryIndex::isUnknown(Field field, int track) const noexcept
+{
+    const auto index = static_cast<size_t>(track);
+
+    switch (field)
+    {
+    case Field::bpm:    return bpms[index] == unknownValue;
+    case Field::key:    return keys[index] == unknownKey;
+    case Field::length: return lengths[index] == unknownValue;
+    default:            return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool LibraryIndex::trackChanged(int track)
+{
+    if (!built || !isPositiveAndBelow(track, static_cast<int>(order.size())))
+        return false;
+
+    const auto index = static_cast<size_t>(track);
+    const auto oldBpm = bpms[index];
+    const auto oldLength = lengths[index];
+    const auto oldKey = keys[index];
+    readValues(track);
+
+    if (bpms[index] == oldBpm && lengths[index] == oldLength && keys[index] == oldKey)
+        return false;
+
+    // Take the track out and put it back where its new values belong
+    const auto oldPosition = static_cast<size_t>(orderPosition[index]);
+    order.erase(order.begin() + static_cast<std::ptrdiff_t>(oldPosition));
+    const auto position = std::lower_bound(order.begin(), order.end(), track,
+        [this](int a, int b) { return comesBefore(a, b); });
+    const auto newPosition = static_cast<size_t>(position - order.begin());
+    order.insert(position, track);
+
+    if (newPosition == oldPosition)
+        return false;
+
+    renumber(jmin(oldPosition, newPosition), jmax(oldPosition, newPosition) + 1);
+    if (!searchWords.empty())
+        updateView();
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::tracksUpdated(const std::vector<int>& tracks)
+{
+    // Read with everything else on first use
+    if (!built)
+        return;
+
+    std::vector<int> updated;
+    for (const int track : tracks)
+        if (isPositiveAndBelow(track, static_cast<int>(order.size())))
+            updated.push_back(track);
+
+    std::sort(updated.begin(), updated.end());
+    updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+    if (updated.empty())
+        return;
+
+    // The tracks leaving and joining each gram list, so every list touched is filtered
+    // and merged once however many of the tracks share it
+    struct GramChange
+    {
+        std::vector<int> removed;
+        std::vector<int> added;
+    };
+    std::unordered_map<std::vector<int>*, GramChange> gramChanges;
+
+    for (const int track : updated)
+    {
+        const auto index = static_cast<size_t>(track);
+        readValues(track);
+
+        const auto oldStart = textStarts[index];
+        const auto oldEnd = textEnds[index];
+        if (!readText(track))
+            continue;
+
+        forEachGram(oldStart, oldEnd, [&](std::vector<int>& list) { gramChanges[&list].removed.push_back(track); });
+        forEachGram(textStarts[index], textEnds[index], [&](std::vector<int>& list) { gramChanges[&list].added.push_back(track); });
+    }
+
+    for (auto& entry : gramChanges)
+    {
+        auto& list = *entry.first;
+        auto& removed = entry.second.removed;
+        auto& added = entry.second.added;
+        removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+        added.erase(std::unique(added.begin(), added.end()), added.end());
+
+        list.erase(std::remove_if(list.begin(), list.end(),
+            [&removed](int track) { return std::binary_search(removed.begin(), removed.end(), track); }), list.end());
+        const auto middle = static_cast<std::ptrdiff_t>(list.size());
+        list.insert(list.end(), added.begin(), added.end());
+        std::inplace_merge(list.begin(), list.begin() + middle, list.end());
+    }
+
+    auto isUpdated = [&updated](int track) { return std::binary_search(updated.begin(), updated.end(), track); };
+
+    // Take the tracks out, sort them among themselves and merge them back in one pass
+    if (!sortKeys.empty())
+    {
+        auto comparator = [this](int a, int b) { return comesBefore(a, b); };
+        order.erase(std::remove_if(order.begin(), order.end(), isUpdated), order.end());
+        const auto middle = static_cast<std::ptrdiff_t>(order.size());
+        order.insert(order.end(), updated.begin(), updated.end());
+        std::sort(order.begin() + middle, order.end(), comparator);
+        std::inplace_merge(order.begin(), order.begin() + middle, order.end(), comparator);
+        renumber(0, order.size());
+    }
+
+    if (!searchWords.empty())
+    {
+        matchingTracks.erase(std::remove_if(matchingTracks.begin(), matchingTracks.end(), isUpdated), matchingTracks.end());
+        const auto middle = static_cast<std::ptrdiff_t>(matchingTracks.size());
+        for (const int track : updated)
+            if (matches(track))
+                matchingTracks.push_back(track);
+
+        std::inplace_merge(matchingTracks.begin(), matchingTracks.begin() + middle, matchingTracks.end());
+        updateView();
+    }
+}
+
+//------------------------------------------------------------------------------
+void LibraryIndex::updateView()
+{
+    if (searchWords.empty())
+        return;
+
+    // A few matches are quicker to sort by position; many are quicker to pick out of the
+    // order in one pass
+    view = matchingTracks;
+    if (view.size() * 8 < order.size())
+    {
+        std::sort(view.begin(), view.end(),
+            [this](int a, int b) { return orderPosition[static_cast<size_t>(a)] < orderPosition[static_cast<size_t>(b)]; });
+        return;
+    }
+
+    std::vector<uint8> matched(order.size(), 0);
+    for (const int track : matchingTracks)
+        matched[static_cast<size_t>(track)] = 1;
+
+    view.clear();
+    for (const int track : order)
+        if (matched[static_cast<size_t>(track)] != 0)
+            view.push_back(track);
+}
+
+//------------------------------------------------------------------------------
+int LibraryIndex::getNumRows() const noexcept
+{
+    if (!built)
+        return library.getNumTracks();
+
+    return static_cast<int>(searchWords.empty() ? order.size() : view.size());
+}
+
+//------------------------------------------------------------------------------
+int LibraryIndex::getTrack(int row) const noexcept
+{
+    if (!built)
+        return isPositiveAndBelow(row, library.getNumTracks()) ? row : -1;
+
+    const auto& rows = searchWords.empty() ? order : view;
+    return isPositiveAndBelow(row, static_cast<int>(rows.size())) ? rows[static_cast<size_t>(row)] : -1;
+}
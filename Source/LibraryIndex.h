@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LibraryStore.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// LibraryIndex filters and orders the rows of a LibraryStore for the track list. Search
+// text is matched against title and artist through an index of every run of one to three
+// characters (the trigrams and the shorter grams): each maps to the rows containing it,
+// so a query only checks the few rows that share its rarest trigram, a word of up to
+// three letters is answered from its list outright, and a query that extends the last
+// one only narrows the last results. The sort order is kept as a permutation of every
+// row; a search walks it, and a track added or re-analysed is moved to its place rather
+// than the whole order re-sorted.
+//
+// Nothing is read from the store until the first search or sort, so a library that is
+// only scrolled through keeps its lazy loading. Message thread only
+class LibraryIndex
+{
+public:
+    // Fields the rows can be sorted by
+    enum class Field
+    {
+        title,
+        artist,
+        bpm,
+        key,
+        length
+    };
+
+    // Constructs LibraryIndex over the rows of a library
+    explicit LibraryIndex(const LibraryStore& library);
+
+    // Shows only the rows whose title or artist contains every word of the text, ignoring
+    // case. An empty text shows every row
+    void setSearch(const String& text);
+
+    // Makes field the primary sort key. The keys chosen before it break ties
+    void sortBy(Field field, bool forwards);
+
+    // Call after tracks have been added to the end of the library
+    void tracksAdded(int firstTrack, int numTracks);
+
+    // Call after a track's analysis has changed. Returns true if its row moved
+    bool trackChanged(int track);
+
+    // Reads tracks again, keeping the search and sort. Call after their titles or
+    // artists have changed. Only the gram lists they were or are now in are touched, and
+    // they are merged back into the order in one pass
+    void tracksUpdated(const std::vector<int>& tracks);
+
+    // Returns the number of rows shown
+    int getNumRows() const noexcept;
+
+    // Returns the library track shown in a row, or -1
+    int getTrack(int row) const noexcept;
+
+private:
+    // One level of the sort
+    struct SortKey
+    {
+        Field field;
+        bool forwards;
+    };
+
+    // Reads every track from the library
+    void build();
+
+    // Adds a track's text and values to the index
+    void indexTrack(int track);
+
+    // Appends a track's title and artist to the text, unless they are already there, and
+    // points the track at them. Returns true if the text was appended
+    bool readText(int track);
+
+    // Calls fn with the list of every gram in text[start, end), once per occurrence
+    template <typename Fn>
+    void forEachGram(size_t start, size_t end, Fn&& fn);
+
+    // Returns the slot of a one- or two-byte gram, or the hash key of a trigram
+    static uint32 getGramKey(const char* gram, size_t length) noexcept;
+
+    // Returns the tracks holding a gram, adding the gram if new
+    std::vector<int>& getGram(const char* gram, size_t length);
+
+    // Returns the tracks holding a gram, or nullptr
+    const std::vector<int>* findGram(const char* gram, size_t length) const;
+
+    // Reads a track's tempo, key and length
+    void readValues(int track);
+
+    // Returns true if a comes before b in the current order
+    bool comesBefore(int a, int b) const;
+
+    // Compares two tracks on one field, returning <0, 0 or >0
+    int compare(Field field, int a, int b) const;
+
+    // Returns true if a track has no value yet for a tempo, key or length field
+    bool isUnknown(Field field, int track) const noexcept;
+
+    // Sorts every track into order
+    void sortAll();
+
+    // Renumbers orderPosition for order[start] to order[end]
+    void renumber(size_t start, size_t end);
+
+    // Returns the tracks whose text holds every search word, taking candidates from the
+    // trigram index or from the last results
+    std::vector<int> findMatches(const std::vector<int>* previous) const;
+
+    // Returns true if a track's text holds every search word
+    bool matches(int track) const;
+
+    // Lays out the shown rows from the matches and the order
+    void updateView();
+
+    // Returns the lower-case text of a track: its title, a newline and its artist
+    std::string_view getText(int track) const noexcept;
+
+    const LibraryStore& library;
+    bool built = false;
+
+    // Lower-case title and artist of every track, end to end. A track whose text changes
+    // gets new text at the end; the old bytes stay unused
+    std::string text;
+    std::vector<uint32> textStarts;
+    std::vector<uint32> artistStarts;
+    std::vector<uint32> textEnds;
+
+    // First eight bytes of each title and artist, for quick comparisons
+    std::vector<uint64> titlePrefixes;
+    std::vector<uint64> artistPrefixes;
+
+    // Sort values of every track
+    std::vector<float> bpms;
+    std::vector<float> lengths;
+    std::vector<int8> keys;
+
+    // Tracks holding each gram, in ascending order. One- and two-byte grams have a slot
+    // each; trigrams are hashed
+    std::vector<std::vector<int>> shortGrams;
+    std::unordered_map<uint32, std::vector<int>> trigrams;
+
+    // Every track in sort order, and the position of each track in it
+    std::vector<SortKey> sortKeys;
+    std::vector<int> order;
+    std::vector<int> orderPosition;
+
+    // Lower-case search text and its words
+    std::string searchText;
+    std::vector<std::string> searchWords;
+
+    // Tracks matching the search, ascending, and the same tracks in sort order
+    std::vector<int> matchingTracks;
+    std::vector<int> view;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryIndex)
+};
@@ -0,0 +1,776 @@
+#include "LibraryStore.h"
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+    constexpr uint32 fileMagic = 0x424c544f; // "OTLB"
+
+    // Hot cues are stored as they are laid out in memory
+    static_assert(std::is_trivially_copyable<HotCues>::value, "HotCues must be plain data");
+
+    // Changes are written out this long after the last one
+    constexpr int saveDelayMs = 5000;
+
+    // Rounds a size up to the 8 byte alignment of columns
+    inline uint64 padded(uint64 size) noexcept
+    {
+        return (size + 7) & ~static_cast<uint64>(7);
+    }
+
+    // Writes zeros up to the next 8 byte boundary
+    void writePadding(OutputStream& out)
+    {
+        static const char zeros[8] = {};
+        const auto position = static_cast<uint64>(out.getPosition());
+        out.write(zeros, static_cast<size_t>(padded(position) - position));
+    }
+}
+
+// Start of the file: where each column begins. Values are in the machine's byte order;
+// a library from a machine with the other order fails the magic check
+struct LibraryStore::FileHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 numTracks;
+    uint32 numColumns;
+    uint64 fileSize;
+    uint64 columnOffsets[LibraryStore::numColumns];
+};
+
+// Writes a copy of the rows to a temporary file next to the library
+class LibraryStore::SaveJob : public ThreadPoolJob
+{
+public:
+    SaveJob(LibraryStore& owner, const Rows& rowsToSave)
+        : ThreadPoolJob("Library save"),
+        store(&owner),
+        rows(rowsToSave),
+        temp(std::make_shared<TemporaryFile>(owner.file))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        const bool written = write(rows, temp->getFile(), [this] { return shouldExit(); });
+
+        // The copy lets go of the old map before the file under it is replaced
+        rows = Rows();
+
+        auto weakStore = store;
+        auto writtenFile = temp;
+        MessageManager::callAsync([weakStore, writtenFile, written]()
+            {
+                if (auto* owner = weakStore.get())
+                    owner->saveWritten(*writtenFile, written);
+            });
+
+        return jobHasFinished;
+    }
+
+private:
+    WeakReference<LibraryStore> store;
+    Rows rows;
+    std::shared_ptr<TemporaryFile> temp;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SaveJob)
+};
+
+//------------------------------------------------------------------------------
+LibraryStore::LibraryStore(const File& libraryFile)
+    : file(libraryFile)
+{
+    open();
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::~LibraryStore()
+{
+    stopTimer();
+
+    // A save still running is abandoned; everything it was writing is still held here
+    pool.removeAllJobs(true, 5000);
+    if (savingAddedTracks >= 0)
+        unsaved = true;
+
+    if (unsaved)
+    {
+        TemporaryFile temp(file);
+        if (write(rows, temp.getFile(), [] { return false; }))
+            replaceFile(temp, rows.addedTracks.size(), {});
+    }
+}
+
+//------------------------------------------------------------------------------
+File LibraryStore::getDefaultFile()
+{
+    return File::getSpecialLocation(File::userApplicationDataDirectory)
+        .getChildFile("OtoDecks")
+        .getChildFile("Library.bin");
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Track LibraryStore::describeFile(const File& trackFile)
+{
+    Track track;
+    track.file = trackFile;
+    track.title = trackFile.getFileNameWithoutExtension();
+    track.modificationTime = trackFile.getLastModificationTime().toMilliseconds();
+
+    // Files are commonly named "Artist - Title"
+    if (track.title.contains(" - "))
+    {
+        track.artist = track.title.upToFirstOccurrenceOf(" - ", false, false).trim();
+        track.title = track.title.fromFirstOccurrenceOf(" - ", false, false).trim();
+    }
+
+    return track;
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<MemoryMappedFile> LibraryStore::mapLibrary(const File& libraryFile, FileHeader& header)
+{
+    auto mappedFile = std::make_shared<MemoryMappedFile>(libraryFile, MemoryMappedFile::readOnly);
+    const auto mappedSize = static_cast<uint64>(mappedFile->getSize());
+
+    bool valid = mappedFile->getData() != nullptr && mappedSize >= sizeof(FileHeader);
+    if (valid)
+    {
+        std::memcpy(&header, mappedFile->getData(), sizeof(FileHeader));
+        valid = header.magic == fileMagic && header.version == formatVersion
+            && header.numColumns == numColumns && header.fileSize == mappedSize
+            && header.numTracks <= static_cast<uint32>(std::numeric_limits<int>::max());
+    }
+
+    // Every column must lie inside the file
+    for (int column = 0; valid && column < numColumns; ++column)
+    {
+        const auto offset = header.columnOffsets[column];
+        valid = offset % 8 == 0 && offset >= sizeof(FileHeader) && offset <= mappedSize
+            && getColumnSize(static_cast<Column>(column), header.numTracks) <= mappedSize - offset;
+    }
+
+    if (!valid)
+        return nullptr;
+
+    return mappedFile;
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::open()
+{
+    if (!file.existsAsFile())
+        return;
+
+    FileHeader header{};
+    rows.mappedFile = mapLibrary(file, header);
+    if (rows.mappedFile == nullptr)
+    {
+        // Keep the unreadable file for inspection rather than overwriting it
+        const auto aside = file.getParentDirectory().getNonexistentChildFile(file.getFileNameWithoutExtension() + "-unreadable",
+            file.getFileExtension());
+        std::cout << "LibraryStore: " << file.getFullPathName() << " is not a valid library, moved to "
+            << aside.getFullPathName() << std::endl;
+        file.moveFileTo(aside);
+        return;
+    }
+
+    rows.numStoredTracks = static_cast<int>(header.numTracks);
+    std::memcpy(rows.columnOffsets, header.columnOffsets, sizeof(rows.columnOffsets));
+}
+
+//------------------------------------------------------------------------------
+int LibraryStore::getNumTracks() const noexcept
+{
+    return rows.getNumTracks();
+}
+
+//------------------------------------------------------------------------------
+int LibraryStore::Rows::getNumTracks() const noexcept
+{
+    return numStoredTracks + static_cast<int>(addedTracks.size());
+}
+
+//------------------------------------------------------------------------------
+const void* LibraryStore::Rows::getColumn(Column column) const noexcept
+{
+    return addBytesToPointer(mappedFile->getData(), columnOffsets[column]);
+}
+
+//------------------------------------------------------------------------------
+uint64 LibraryStore::getCellSize(Column column) noexcept
+{
+    switch (column)
+    {
+    case lengthColumn:
+    case bpmColumn:
+    case loudnessColumn:
+        return sizeof(float);
+    case keyColumn:
+        return sizeof(int8);
+    case stateColumn:
+        return sizeof(uint8);
+    case modifiedColumn:
+        return sizeof(int64);
+    case hotCuesColumn:
+        return sizeof(HotCues);
+    case pathHashColumn:
+        return sizeof(uint64);
+    case pathTableColumn:
+        return sizeof(uint32);
+    case titleColumn:
+    case artistColumn:
+    case pathColumn:
+        return sizeof(StringRef);
+    default:
+        return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+uint64 LibraryStore::getColumnSize(Column column, uint32 numTracks) noexcept
+{
+    const uint64 numCells = column == pathTableColumn ? getPathTableSize(numTracks) : numTracks;
+    return getCellSize(column) * numCells;
+}
+
+//------------------------------------------------------------------------------
+uint32 LibraryStore::getPathTableSize(uint32 numTracks) noexcept
+{
+    // Capped at 2^31 slots, which still leaves one free for every row an int can number
+    uint32 size = 1;
+    while (size < 2 * static_cast<uint64>(numTracks) && size < (1u << 31))
+        size <<= 1;
+    return size;
+}
+
+//------------------------------------------------------------------------------
+String LibraryStore::Rows::readString(Column column, int index) const
+{
+    const auto ref = static_cast<const StringRef*>(getColumn(column))[index];
+    const auto stringsSize = static_cast<uint64>(mappedFile->getSize()) - columnOffsets[stringsColumn];
+    if (static_cast<uint64>(ref.offset) + ref.length > stringsSize)
+        return {};
+
+    const auto* text = static_cast<const char*>(getColumn(stringsColumn)) + ref.offset;
+    return String::fromUTF8(text, static_cast<int>(ref.length));
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Metadata LibraryStore::Rows::readMetadata(int index) const
+{
+    Metadata metadata;
+    metadata.lengthSeconds = static_cast<const float*>(getColumn(lengthColumn))[index];
+    metadata.bpm = static_cast<const float*>(getColumn(bpmColumn))[index];
+    metadata.loudnessLufs = static_cast<const float*>(getColumn(loudnessColumn))[index];
+    metadata.key = static_cast<const int8*>(getColumn(keyColumn))[index];
+    metadata.analysisState = static_cast<AnalysisState>(static_cast<const uint8*>(getColumn(stateColumn))[index]);
+    metadata.modificationTime = static_cast<const int64*>(getColumn(modifiedColumn))[index];
+    return metadata;
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Metadata LibraryStore::Rows::getMetadata(int index) const
+{
+    jassert(isPositiveAndBelow(index, getNumTracks()));
+
+    if (const auto* track = findChangedTrack(index))
+        return LibraryStore::getMetadata(*track);
+
+    return readMetadata(index);
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Metadata LibraryStore::getMetadata(const Track& track)
+{
+    Metadata metadata;
+    metadata.lengthSeconds = static_cast<float>(track.lengthSeconds);
+    metadata.bpm = track.bpm;
+    metadata.loudnessLufs = track.loudnessLufs;
+    metadata.key = static_cast<int8>(track.key);
+    metadata.analysisState = track.analysisState;
+    metadata.modificationTime = track.modificationTime;
+    return metadata;
+}
+
+//------------------------------------------------------------------------------
+const LibraryStore::Track* LibraryStore::Rows::findChangedTrack(int index) const
+{
+    if (index >= numStoredTracks)
+        return &addedTracks[static_cast<size_t>(index - numStoredTracks)];
+
+    if (changedTracks.empty())
+        return nullptr;
+
+    const auto found = changedTracks.find(index);
+    return found != changedTracks.end() ? &found->second : nullptr;
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Track& LibraryStore::getChangedTrack(int index)
+{
+    if (index >= rows.numStoredTracks)
+        return rows.addedTracks[static_cast<size_t>(index - rows.numStoredTracks)];
+
+    const auto found = rows.changedTracks.find(index);
+    if (found != rows.changedTracks.end())
+        return found->second;
+
+    return rows.changedTracks.emplace(index, getTrack(index)).first->second;
+}
+
+//------------------------------------------------------------------------------
+String LibraryStore::getTitle(int index) const
+{
+    if (const auto* track = rows.findChangedTrack(index))
+        return track->title;
+
+    return rows.readString(titleColumn, index);
+}
+
+//------------------------------------------------------------------------------
+String LibraryStore::getArtist(int index) const
+{
+    if (const auto* track = rows.findChangedTrack(index))
+        return track->artist;
+
+    return rows.readString(artistColumn, index);
+}
+
+//------------------------------------------------------------------------------
+File LibraryStore::getFile(int index) const
+{
+    if (const auto* track = rows.findChangedTrack(index))
+        return track->file;
+
+    const auto path = rows.readString(pathColumn, index);
+    return path.isNotEmpty() ? File(path) : File();
+}
+
+//------------------------------------------------------------------------------
+double LibraryStore::getLengthSeconds(int index) const
+{
+    return rows.getMetadata(index).lengthSeconds;
+}
+
+//------------------------------------------------------------------------------
+float LibraryStore::getBpm(int index) const
+{
+    return rows.getMetadata(index).bpm;
+}
+
+//------------------------------------------------------------------------------
+int LibraryStore::getKey(int index) const
+{
+    return rows.getMetadata(index).key;
+}
+
+//------------------------------------------------------------------------------
+float LibraryStore::getLoudness(int index) const
+{
+    return rows.getMetadata(index).loudnessLufs;
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::AnalysisState LibraryStore::getAnalysisState(int index) const
+{
+    return rows.getMetadata(index).analysisState;
+}
+
+//------------------------------------------------------------------------------
+int64 LibraryStore::getModificationTime(int index) const
+{
+    return rows.getMetadata(index).modificationTime;
+}
+
+//------------------------------------------------------------------------------
+HotCues LibraryStore::getHotCues(int index) const
+{
+    return rows.getHotCues(index);
+}
+
+//------------------------------------------------------------------------------
+HotCues LibraryStore::Rows::getHotCues(int index) const
+{
+    if (const auto* track = findChangedTrack(index))
+        return track->hotCues;
+
+    HotCues hotCues;
+    std::memcpy(&hotCues, static_cast<const HotCues*>(getColumn(hotCuesColumn)) + index, sizeof(HotCues));
+    return hotCues;
+}
+
+//------------------------------------------------------------------------------
+LibraryStore::Track LibraryStore::getTrack(int index) const
+{
+    if (const auto* changedTrack = rows.findChangedTrack(index))
+        return *changedTrack;
+
+    const auto metadata = rows.readMetadata(index);
+    Track track;
+    track.title = getTitle(index);
+    track.artist = getArtist(index);
+    track.file = getFile(index);
+    track.lengthSeconds = metadata.lengthSeconds;
+    track.bpm = metadata.bpm;
+    track.key = metadata.key;
+    track.loudnessLufs = metadata.loudnessLufs;
+    track.analysisState = metadata.analysisState;
+    track.modificationTime = metadata.modificationTime;
+    track.hotCues = getHotCues(index);
+    return track;
+}
+
+//------------------------------------------------------------------------------
+uint64 LibraryStore::getPathHash(int index) const
+{
+    return rows.getPathHash(index);
+}
+
+//------------------------------------------------------------------------------
+uint64 LibraryStore::Rows::getPathHash(int index) const
+{
+    if (const auto* track = findChangedTrack(index))
+        return hashPath(track->file);
+
+    return static_cast<const uint64*>(getColumn(pathHashColumn))[index];
+}
+
+//------------------------------------------------------------------------------
+uint64 LibraryStore::hashPath(const File& fileToHash)
+{
+    return static_cast<uint64>(fileToHash.getFullPathName().hashCode64());
+}
+
+//------------------------------------------------------------------------------
+int LibraryStore::findTrack(const File& fileToFind) const
+{
+    const auto hash = hashPath(fileToFind);
+
+    const auto added = addedPathIndex.find(hash);
+    if (added != addedPathIndex.end() && getFile(added->second) == fileToFind)
+        return added->second;
+
+    if (rows.numStoredTracks == 0)
+        return -1;
+
+    // Open addressing: each slot holds a row plus one, or 0 when empty, and a file's
+    // probe starts at the slot picked by the low bits of its hash
+    const auto* table = static_cast<const uint32*>(rows.getColumn(pathTableColumn));
+    const auto* hashes = static_cast<const uint64*>(rows.getColumn(pathHashColumn));
+    const auto tableSize = getPathTableSize(static_cast<uint32>(rows.numStoredTracks));
+    auto slot = static_cast<uint32>(hash) & (tableSize - 1);
+
+    for (uint32 probes = 0; probes < tableSize && table[slot] != 0; ++probes)
+    {
+        const auto row = static_cast<int>(table[slot] - 1);
+        if (row < rows.numStoredTracks && hashes[row] == hash && getFile(row) == fileToFind)
+            return row;
+
+        slot = (slot + 1) & (tableSize - 1);
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+int LibraryStore::addTrack(const Track& track)
+{
+    const int existing = findTrack(track.file);
+    if (existing >= 0)
+        return existing;
+
+    const int index = getNumTracks();
+    rows.addedTracks.push_back(track);
+    addedPathIndex.emplace(hashPath(track.file), index);
+    changed(index);
+    return index;
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::setAnalysis(int index, const TrackAnalysis& analysis)
+{
+    if (!isPositiveAndBelow(index, getNumTracks()))
+        return;
+
+    auto& track = getChangedTrack(index);
+    if (analysis.lengthSeconds > 0.0)
+        track.lengthSeconds = analysis.lengthSeconds;
+    track.bpm = static_cast<float>(analysis.beatGrid.bpm);
+    track.key = analysis.hasKey() ? analysis.key : -1;
+    track.loudnessLufs = analysis.loudnessLufs;
+    track.analysisState = AnalysisState::analysed;
+    changed(index);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::setAnalysisFailed(int index)
+{
+    if (!isPositiveAndBelow(index, getNumTracks()) || getAnalysisState(index) == AnalysisState::failed)
+        return;
+
+    getChangedTrack(index).analysisState = AnalysisState::failed;
+    changed(index);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::setHotCues(int index, const HotCues& hotCues)
+{
+    if (!isPositiveAndBelow(index, getNumTracks()) || getHotCues(index) == hotCues)
+        return;
+
+    getChangedTrack(index).hotCues = hotCues;
+    changed(index);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::updateTrack(int index, const Track& track)
+{
+    if (!isPositiveAndBelow(index, getNumTracks()))
+        return;
+
+    // The path index and the analysis are keyed by the file
+    jassert(track.file == getFile(index));
+    getChangedTrack(index) = track;
+    changed(index);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::changed(int index)
+{
+    unsaved = true;
+    if (savingAddedTracks >= 0)
+        changedWhileSaving.insert(index);
+
+    startTimer(saveDelayMs);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::timerCallback()
+{
+    stopTimer();
+
+    // One save at a time; whatever changes meanwhile goes out with the next
+    if (!unsaved || savingAddedTracks >= 0)
+        return;
+
+    unsaved = false;
+    savingAddedTracks = static_cast<int>(rows.addedTracks.size());
+    pool.addJob(new SaveJob(*this, rows), true);
+}
+
+//------------------------------------------------------------------------------
+void LibraryStore::saveWritten(TemporaryFile& temp, bool written)
+{
+    const auto numSavedTracks = static_cast<size_t>(savingAddedTracks);
+    const auto changedSince = std::move(changedWhileSaving);
+    savingAddedTracks = -1;
+    changedWhileSaving.clear();
+
+    // On failure every row the copy held is still in memory and goes out with the next save
+    if (!written || !replaceFile(temp, numSavedTracks, changedSince))
+        unsaved = true;
+
+    if (!changedSince.empty())
+        startTimer(saveDelayMs);
+}
+
+//------------------------------------------------------------------------------
+bool LibraryStore::write(const Rows& rowsToWrite, const File& target, const std::function<bool()>& shouldStop)
+{
+    const int numTracks = rowsToWrite.getNumTracks();
+    // Rows held in memory give their own strings; the rest are copied from the map
+    auto stringCell = [](Column column, const Track& track) -> String
+    {
+        return column == titleColumn ? track.title
+            : column == artistColumn ? track.artist
+            : track.file.getFullPathName();
+    };
+    auto stringLength = [&](Column column, int index) -> uint32
+    {
+        if (const auto* track = rowsToWrite.findChangedTrack(index))
+            return static_cast<uint32>(stringCell(column, *track).getNumBytesAsUTF8());
+
+        return static_cast<const StringRef*>(rowsToWrite.getColumn(column))[index].length;
+    };
+
+    // Strings are stored column by column: every title, then every artist, then every path
+    uint64 stringColumnBytes[3] = {};
+    for (int column = titleColumn; column <= pathColumn; ++column)
+        for (int i = 0; i < numTracks; ++i)
+            stringColumnBytes[column - titleColumn] += stringLength(static_cast<Column>(column), i);
+
+    if (stringColumnBytes[0] + stringColumnBytes[1] + stringColumnBytes[2] > std::numeric_limits<uint32>::max())
+        return false;
+
+    FileHeader header{};
+    header.magic = fileMagic;
+    header.version = formatVersion;
+    header.numTracks = static_cast<uint32>(numTracks);
+    header.numColumns = numColumns;
+
+    uint64 offset = padded(sizeof(FileHeader));
+    for (int column = 0; column < stringsColumn; ++column)
+    {
+        header.columnOffsets[column] = offset;
+        offset = padded(offset + getColumnSize(static_cast<Column>(column), header.numTracks));
+    }
+    header.columnOffsets[stringsColumn] = offset;
+    header.fileSize = offset + stringColumnBytes[0] + stringColumnBytes[1] + stringColumnBytes[2];
+
+    target.getParentDirectory().createDirectory();
+    {
+        FileOutputStream out(target);
+        if (!out.openedOk())
+            return false;
+
+        out.write(&header, sizeof(header));
+
+        // Numeric columns, one pass over the rows each
+        auto writeColumn = [&](Column column, auto&& cell)
+        {
+            writePadding(out);
+            jassert(static_cast<uint64>(out.getPosition()) == header.columnOffsets[column]);
+            for (int i = 0; i < numTracks; ++i)
+            {
+                const auto value = cell(rowsToWrite.getMetadata(i), i);
+                out.write(&value, sizeof(value));
+            }
+        };
+
+        writeColumn(lengthColumn, [](const Metadata& m, int) { return m.lengthSeconds; });
+        writeColumn(bpmColumn, [](const Metadata& m, int) { return m.bpm; });
+        writeColumn(loudnessColumn, [](const Metadata& m, int) { return m.loudnessLufs; });
+        writeColumn(keyColumn, [](const Metadata& m, int) { return m.key; });
+        writeColumn(stateColumn, [](const Metadata& m, int) { return static_cast<uint8>(m.analysisState); });
+        writeColumn(modifiedColumn, [](const Metadata& m, int) { return m.modificationTime; });
+
+        // Hot cues are kept out of Metadata, which sorting reads for every row
+        writePadding(out);
+        for (int i = 0; i < numTracks; ++i)
+        {
+            const auto hotCues = rowsToWrite.getHotCues(i);
+            out.write(&hotCues, sizeof(hotCues));
+        }
+
+        if (shouldStop())
+            return false;
+
+        // The path table is filled in as the hashes are written
+        const auto tableSize = getPathTableSize(header.numTracks);
+        std::vector<uint32> pathTable(tableSize, 0);
+
+        writePadding(out);
+        for (int i = 0; i < numTracks; ++i)
+        {
+            const auto hash = rowsToWrite.getPathHash(i);
+            out.write(&hash, sizeof(hash));
+
+            auto slot = static_cast<uint32>(hash) & (tableSize - 1);
+            while (pathTable[slot] != 0)
+                slot = (slot + 1) & (tableSize - 1);
+            pathTable[slot] = static_cast<uint32>(i + 1);
+        }
+
+        writePadding(out);
+        out.write(pathTable.data(), pathTable.size() * sizeof(uint32));
+
+        // String references, numbered through the string block
+        uint64 stringOffset = 0;
+        for (int column = titleColumn; column <= pathColumn; ++column)
+        {
+            writePadding(out);
+            for (int i = 0; i < numTracks; ++i)
+            {
+                const StringRef ref{ static_cast<uint32>(stringOffset), stringLength(static_cast<Column>(column), i) };
+                out.write(&ref, sizeof(ref));
+                stringOffset += ref.length;
+            }
+        }
+
+        writePadding(out);
+        for (int column = titleColumn; column <= pathColumn; ++column)
+        {
+            if (shouldStop())
+                return false;
+
+            for (int i = 0; i < numTracks; ++i)
+            {
+                if (const auto* track = rowsToWrite.findChangedTrack(i))
+                {
+                    const auto text = stringCell(static_cast<Column>(column), *track);
+                    out.write(text.toUTF8().getAddress(), text.getNumBytesAsUTF8());
+                }
+                else
+                {
+                    const auto ref = static_cast<const StringRef*>(rowsToWrite.getColumn(static_cast<Column>(column)))[i];
+                    out.write(static_cast<const char*>(rowsToWrite.getColumn(stringsColumn)) + ref.offset, ref.length);
+                }
+            }
+        }
+
+        out.flush();
+        if (out.getStatus().failed() || static_cast<uint64>(out.getPosition()) != header.fileSize)
+            return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool LibraryStore::replaceFile(TemporaryFile& temp, size_t numSavedTracks, const std::unordered_set<int>& changedSince)
+{
+    const int numTracks = rows.numStoredTracks + static_cast<int>(numSavedTracks);
+
+    // Checked before anything is replaced, so a bad write never costs the working library
+    FileHeader header{};
+    if (mapLibrary(temp.getFile(), header) == nullptr || header.numTracks != static_cast<uint32>(numTracks))
+        return false;
+
+   #if JUCE_WINDOWS
+    // Windows won't replace a file that is mapped. Elsewhere the current map keeps
+    // reading the old file until the new one is mapped
+    rows.mappedFile.reset();
+   #endif
+
+    if (!temp.overwriteTargetFileWithTemporary())
+    {
+       #if JUCE_WINDOWS
+        // The old file is untouched, so mapping it again gives back the same rows
+        if (rows.numStoredTracks > 0)
+            rows.mappedFile = mapLibrary(file, header);
+        jassert(rows.numStoredTracks == 0 || rows.mappedFile != nullptr);
+       #endif
+        return false;
+    }
+
+    // The file was readable a moment ago under its temporary name
+    auto newMap = mapLibrary(file, header);
+    if (newMap == nullptr || header.numTracks != static_cast<uint32>(numTracks))
+    {
+        jassertfalse;
+        return false;
+    }
+
+    // Rows changed since the copy was taken stay in memory; the rest now come from the
+    // new file, with the same row numbers
+    std::unordered_map<int, Track> stillChanged;
+    for (const int index : changedSince)
+        if (index < numTracks)
+            if (const auto* track = rows.findChangedTrack(index))
+                stillChanged.emplace(index, *track);
+
+    rows.addedTracks.erase(rows.addedTracks.begin(), rows.addedTracks.begin() + static_cast<std::ptrdiff_t>(numSavedTracks));
+    rows.changedTracks = std::move(stillChanged);
+    rows.mappedFile = std::move(newMap);
+    rows.numStoredTracks = numTracks;
+    std::memcpy(rows.columnOffsets, header.columnOffsets, sizeof(rows.columnOffsets));
+
+    addedPathIndex.clear();
+    for (size_t i = 0; i < rows.addedTracks.size(); ++i)
+        addedPathIndex.emplace(hashPath(rows.addedTracks[i].file), numTracks + static_cast<int>(i));
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "HotCues.h"
+#include "TrackAnalysis.h"
+#include <functional>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// LibraryStore is the track collection: one row per track with its title, artist, path,
+// length, tempo, key, loudness, analysis state and hot cues, kept between runs. The file
+// stores each of those as a column (an array with one entry per track) followed by one
+// block of string bytes, and is read through a memory map. Opening only checks the
+// header, a cell is read straight out of the column when it is asked for, and a file is
+// found through a table of path hashes saved with the columns, so startup time and memory
+// stay the same whether the library holds ten tracks or a hundred thousand.
+//
+// Tracks added or updated and analysis results arriving after opening are held in memory.
+// A few seconds after the last change a copy of them is written out with the rest of the
+// file on a background thread, and the new file takes the old one's place back on the
+// message thread. Whatever is still unsaved is written when the store is destroyed.
+// Message thread only
+class LibraryStore : private Timer
+{
+public:
+    // Bumped whenever the layout of the file changes. A library written with another
+    // version is set aside and a new one started
+    static constexpr uint32 formatVersion = 4;
+
+    // How far a track's analysis has got
+    enum class AnalysisState : uint8
+    {
+        pending = 0,
+        analysed = 1,
+        failed = 2 // The file could not be found
+    };
+
+    // Everything stored about one track
+    struct Track
+    {
+        String title;
+        String artist;
+        File file;
+        double lengthSeconds = 0.0;
+        float bpm = 0.0f;
+        int key = -1;
+        float loudnessLufs = TrackAnalysis::silenceLufs;
+        AnalysisState analysisState = AnalysisState::pending;
+
+        // When the file was last modified, in milliseconds since 1970, or 0 if unknown
+        int64 modificationTime = 0;
+
+        HotCues hotCues;
+    };
+
+    // Opens the library, creating it if it does not exist
+    explicit LibraryStore(const File& libraryFile);
+
+    // Destructor. Writes out any unsaved changes
+    ~LibraryStore() override;
+
+    // Returns the library file used by the application
+    static File getDefaultFile();
+
+    // Returns a new row for a file, with a title and artist taken from its name
+    static Track describeFile(const File& file);
+
+    // Returns the number of tracks
+    int getNumTracks() const noexcept;
+
+    // Column accessors. Each reads one cell; strings are decoded on demand
+    String getTitle(int index) const;
+    String getArtist(int index) const;
+    File getFile(int index) const;
+    double getLengthSeconds(int index) const;
+    float getBpm(int index) const;
+    int getKey(int index) const;
+    float getLoudness(int index) const;
+    AnalysisState getAnalysisState(int index) const;
+    int64 getModificationTime(int index) const;
+    HotCues getHotCues(int index) const;
+
+    // Returns every cell of a row
+    Track getTrack(int index) const;
+
+    // Returns the hash of a row's path, without decoding the path
+    uint64 getPathHash(int index) const;
+
+    // Returns the hash the path index uses for a file
+    static uint64 hashPath(const File& file);
+
+    // Returns the row of a file, or -1
+    int findTrack(const File& file) const;
+
+    // Adds a track and returns its row, or returns the existing row of the same file
+    int addTrack(const Track& track);
+
+    // Replaces every cell of a row. The file must stay the same
+    void updateTrack(int index, const Track& track);
+
+    // Fills in a row's length, tempo, key and loudness and marks it analysed
+    void setAnalysis(int index, const TrackAnalysis& analysis);
+
+    // Marks a row whose file could not be analysed
+    void setAnalysisFailed(int index);
+
+    // Replaces a row's hot cues
+    void setHotCues(int index, const HotCues& hotCues);
+
+private:
+    class SaveJob;
+
+    // Numeric cells of a row, as changed since the file was written
+    struct Metadata
+    {
+        float lengthSeconds = 0.0f;
+        float bpm = 0.0f;
+        float loudnessLufs = TrackAnalysis::silenceLufs;
+        int8 key = -1;
+        AnalysisState analysisState = AnalysisState::pending;
+        int64 modificationTime = 0;
+    };
+
+    // Where a string lives in the string block
+    struct StringRef
+    {
+        uint32 offset;
+        uint32 length;
+    };
+
+    // Column indices
+    enum Column
+    {
+        lengthColumn,
+        bpmColumn,
+        loudnessColumn,
+        keyColumn,
+        stateColumn,
+        modifiedColumn,
+        hotCuesColumn,
+        pathHashColumn,
+        pathTableColumn,
+        titleColumn,
+        artistColumn,
+        pathColumn,
+        stringsColumn,
+        numColumns
+    };
+
+    struct FileHeader;
+
+    // The rows of the library: those of the mapped file, and those added or changed since
+    // it was written. A save writes out a copy on the pool's thread
+    struct Rows
+    {
+        // Returns the number of tracks
+        int getNumTracks() const noexcept;
+
+        // Returns the start of a column in the map
+        const void* getColumn(Column column) const noexcept;
+
+        // Reads a string cell out of the map
+        String readString(Column column, int index) const;
+
+        // Returns the numeric cells of a row stored in the file
+        Metadata readMetadata(int index) const;
+
+        // Returns the numeric cells of any row, changed or not
+        Metadata getMetadata(int index) const;
+
+        // Returns a row's hot cues
+        HotCues getHotCues(int index) const;
+
+        // Returns the hash of a row's path
+        uint64 getPathHash(int index) const;
+
+        // Returns a row held in memory because it was added or changed since the file was
+        // written, or nullptr if it is read from the file
+        const Track* findChangedTrack(int index) const;
+
+        std::shared_ptr<MemoryMappedFile> mappedFile;
+        int numStoredTracks = 0;
+        uint64 columnOffsets[numColumns] = {};
+
+        // Rows added since the file was written
+        std::vector<Track> addedTracks;
+
+        // Rows of the file that have changed since it was written
+        std::unordered_map<int, Track> changedTracks;
+    };
+
+    // Starts a save a few seconds after the last change
+    void timerCallback() override;
+
+    // Maps a library file and checks its header. Returns nullptr if it isn't valid
+    static std::shared_ptr<MemoryMappedFile> mapLibrary(const File& libraryFile, FileHeader& header);
+
+    // Maps the file, setting it aside if it isn't a valid library
+    void open();
+
+    // Returns the size of one cell of a column; 0 for the string block
+    static uint64 getCellSize(Column column) noexcept;
+
+    // Returns the size of a column of a file holding a number of tracks
+    static uint64 getColumnSize(Column column, uint32 numTracks) noexcept;
+
+    // Returns the number of slots in the path table: a power of two at least twice the
+    // number of tracks, so probing for a missing file stops at an empty slot quickly
+    static uint32 getPathTableSize(uint32 numTracks) noexcept;
+
+    // Returns the numeric cells of a row held in memory
+    static Metadata getMetadata(const Track& track);
+
+    // Returns a row held in memory, copying it out of the file first if needed
+    Track& getChangedTrack(int index);
+
+    // Marks a row as changed and schedules a save
+    void changed(int index);
+
+    // Writes rows to a file in the library's format. Returns false on failure, or once
+    // shouldStop returns true
+    static bool write(const Rows& rowsToWrite, const File& target, const std::function<bool()>& shouldStop);
+
+    // Called back on the message thread when a save has written its temporary file, or
+    // failed to
+    void saveWritten(TemporaryFile& temp, bool written);
+
+    // Puts a file written from the rows in the library's place and maps it. The first
+    // numSavedTracks added rows, and the changed rows not in changedSince, then come from
+    // the file. Returns false, leaving the rows and their map as they were, on failure
+    bool replaceFile(TemporaryFile& temp, size_t numSavedTracks, const std::unordered_set<int>& changedSince);
+
+    const File file;
+    Rows rows;
+
+    // Row of each path hash among the added rows; the rows of the file are found through
+    // its path table
+    std::unordered_map<uint64, int> addedPathIndex;
+
+    // True when something has changed since the last save started
+    bool unsaved = false;
+
+    // Number of added rows in the copy a save is writing, or -1 when none is running
+    int savingAddedTracks = -1;
+
+    // Rows changed since the copy being written was taken
+    std::unordered_set<int> changedWhileSaving;
+
+    ThreadPool pool{ 1 };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(LibraryStore)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryStore)
+};
@@ -1,5 +1,6 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MainComponent.h"
+#include "Benchmarks.h"
 
 //==============================================================================
 class OtoDecksApplication  : public JUCEApplication
@@ -16,6 +17,14 @@ public:
     {
         // This method is where you should put your application's initialisation code..
 
+        // Headless benchmark run: print results and exit without opening a window
+        if (commandLine.contains("--benchmark"))
+        {
+            Benchmarks::runAll();
+            quit();
+            return;
+        }
+
         mainWindow.reset (new MainWindow (getApplicationName()));
     }
 
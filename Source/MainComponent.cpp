@@ -20,36 +20,48 @@ MainComponent::MainComponent()
     addAndMakeVisible(deckGUI1);
     addAndMakeVisible(deckGUI2);
     addAndMakeVisible(playlistComponent);
+    addChildComponent(statsOverlay);
+    setWantsKeyboardFocus(true);
 
     // Register basic audio formats
     formatManager.registerBasicFormats();
 
-    // Start timer for the background carousel animation at 60 Hz
-    startTimerHz(60);
+    // Decode the pad samples so a hit never touches the disk
+    playlistComponent.loadPadSamples();
+
+    // Start the shared read-ahead thread below the audio and UI threads
+    diskThread.startThread(Thread::Priority::low);
+
+    // Animate the background carousel with the display
+    frameScheduler.addClient(this, "Carousel");
 }
 
 MainComponent::~MainComponent()
 {
-    stopTimer();
+    frameScheduler.removeClient(this);
     shutdownAudio();
+    diskThread.stopThread(2000);
 }
 
 void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-    // Prepare each audio player and the mixer source for playback
+    // Prepare the sync clock, each audio player and the mixer source for playback
+    syncEngine.prepareToPlay(sampleRate);
     player1.prepareToPlay(samplesPerBlockExpected, sampleRate);
     player2.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    drumPlayer.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    sampler.prepareToPlay(samplesPerBlockExpected, sampleRate);
 
     mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    mixerSource.addInputSource(&player1, false);
-    mixerSource.addInputSource(&player2, false);
-    mixerSource.addInputSource(&drumPlayer, false);
+    mixerSource.addInputSource(&player1);
+    mixerSource.addInputSource(&player2);
+    mixerSource.addInputSource(&sampler);
 }
 
 void MainComponent::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
 {
-    // Retrieve the next audio block from mixer
+    // Move the master clock to this block before the decks read it, then retrieve the
+    // next audio block from mixer
+    syncEngine.beginBlock(bufferToFill.numSamples);
     mixerSource.getNextAudioBlock(bufferToFill);
 }
 
@@ -58,12 +70,14 @@ void MainComponent::releaseResources()
     // Release resources for all audio players and mixer
     player1.releaseResources();
     player2.releaseResources();
-    drumPlayer.releaseResources();
+    sampler.releaseResources();
     mixerSource.releaseResources();
 }
 
 void MainComponent::paint(Graphics& g)
 {
+    const FrameScheduler::ScopedPaintTimer paintTimer(*this);
+
     // Background colour
     g.fillAll(Colours::black);
 
@@ -99,12 +113,38 @@ void MainComponent::resized()
     deckGUI1.setBounds(margin, margin, deckWidth, height);
     playlistComponent.setBounds(margin + deckWidth, margin, playlistWidth, height);
     deckGUI2.setBounds(margin + deckWidth + playlistWidth, margin, deckWidth, height);
+
+    // Stats overlay in the top right corner, over the right deck
+    statsOverlay.setBounds(getWidth() - margin - 340, margin, 340, 200);
 }
 
-void MainComponent::timerCallback()
+bool MainComponent::keyPressed(const KeyPress& key)
 {
-    // Update scroll offset for the carousel background
-    float speed = 1.5f;
+    if (key == KeyPress('f', ModifierKeys::commandModifier | ModifierKeys::shiftModifier, 0))
+    {
+        statsOverlay.setVisible(!statsOverlay.isVisible());
+        statsOverlay.toFront(false);
+        frameScheduler.wake();
+        return true;
+    }
+
+    return false;
+}
+
+bool MainComponent::advanceFrame(double frameTimeMs)
+{
+    // Nothing is playing, so the background holds still and the UI can go idle
+    if (!player1.isPlaying() && !player2.isPlaying())
+    {
+        lastFrameMs = 0.0;
+        return false;
+    }
+
+    // Update scroll offset for the carousel background, 1.5 pixels per 60 Hz frame
+    // whatever the display's actual refresh rate
+    const double elapsedMs = lastFrameMs > 0.0 ? jmin(100.0, frameTimeMs - lastFrameMs) : 0.0;
+    lastFrameMs = frameTimeMs;
+    float speed = 1.5f * static_cast<float>(elapsedMs * 60.0 / 1000.0);
     scrollOffset += speed;
 
     // Determine the width of a cycle
@@ -116,5 +156,15 @@ void MainComponent::timerCallback()
     if (scrollOffset >= cycleWidth)
         scrollOffset -= cycleWidth;
 
-    repaint();
+    // The carousel only shows in the gaps between the decks and playlist, so only those
+    // are repainted
+    RectangleList<int> gaps(getLocalBounds());
+    gaps.subtract(deckGUI1.getBounds());
+    gaps.subtract(deckGUI2.getBounds());
+    gaps.subtract(playlistComponent.getBounds());
+
+    for (const auto& gap : gaps)
+        repaint(gap);
+
+    return true;
 }
@@ -1,13 +1,24 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "AnalysisStore.h"
 #include "DJAudioPlayer.h"
 #include "DeckGUI.h"
+#include "FrameScheduler.h"
+#include "FrameStatsOverlay.h"
+#include "LibraryImporter.h"
+#include "LibraryStore.h"
 #include "PlaylistComponent.h"
+#include "SamplerEngine.h"
+#include "SilenceAwareMixer.h"
+#include "SyncEngine.h"
+#include "TrackAnalyzer.h"
+#include "TrackLoader.h"
+#include "WaveformCache.h"
 
 // MainComponent sets overall UI and audio routing
 class MainComponent : public AudioAppComponent,
-    private Timer
+    public FrameScheduler::Client
 {
 public:
     // Constructs MainComponent + initializes audio channels and child components
@@ -31,9 +42,13 @@ public:
     // Lays out child components
     void resized() override;
 
+    // Ctrl/Cmd+Shift+F shows or hides the frame stats overlay
+    bool keyPressed(const KeyPress& key) override;
+
+    // Updates the carousel scroll. The carousel only moves while a deck is playing
+    bool advanceFrame(double frameTimeMs) override;
+
 private:
-    // Timer callback: updates the carousel scroll
-    void timerCallback() override;
 
     // Carousel background 
     Colour colours[10] =
@@ -51,24 +66,63 @@ private:
     };
 
     float scrollOffset = 0.0f;
+    double lastFrameMs = 0.0;
+
+    // Animates every component once per display refresh. Declared before the decks so
+    // it outlives them
+    FrameScheduler frameScheduler{ *this };
 
     AudioFormatManager formatManager;
-    AudioThumbnailCache thumbCache{ 100 };
+
+    // Low-priority thread that decodes ahead of the playhead for both decks. Declared
+    // before the loader, analyser and library, so a load still running as they are
+    // destroyed can register and remove its clients on a live thread
+    TimeSliceThread diskThread{ "Disk I/O" };
+
+    // Analysis and waveforms of every track seen so far, kept between runs
+    AnalysisStore analysisStore{ AnalysisStore::getDefaultFile() };
+    WaveformCache waveformCache{ analysisStore };
+
+    // Background track loading shared by both decks
+    TrackLoader trackLoader{ formatManager };
+
+    // Track analysis on one worker per core
+    TrackAnalyzer trackAnalyzer{ formatManager, analysisStore };
+
+    // Every track in the collection, kept between runs
+    LibraryStore libraryStore{ LibraryStore::getDefaultFile() };
+
+    // Folder and multi-file import into the library, with periodic rescans
+    LibraryImporter libraryImporter{ formatManager, libraryStore, LibraryImporter::getDefaultFoldersFile() };
+
+    // Decoded tracks shared by every player, up to 1 GB
+    DecodedTrackCache trackCache{ static_cast<size_t>(1) << 30 };
+
+    // Master tempo clock the decks sync and quantize to. Declared before the players,
+    // which register with it
+    SyncEngine syncEngine;
 
     // Primary players and decks
-    DJAudioPlayer player1{ formatManager };
-    DeckGUI deckGUI1{ &player1, formatManager, thumbCache, "L" };
+    DJAudioPlayer player1{ formatManager, &diskThread, &trackCache, &syncEngine, &analysisStore };
+    DeckGUI deckGUI1{ &player1, formatManager, frameScheduler, waveformCache, trackLoader, trackAnalyzer, libraryImporter,
+        libraryStore, "L" };
+
+    DJAudioPlayer player2{ formatManager, &diskThread, &trackCache, &syncEngine, &analysisStore };
+    DeckGUI deckGUI2{ &player2, formatManager, frameScheduler, waveformCache, trackLoader, trackAnalyzer, libraryImporter,
+        libraryStore, "R" };
 
-    DJAudioPlayer player2{ formatManager };
-    DeckGUI deckGUI2{ &player2, formatManager, thumbCache, "R" };
+    // Sample pads, decoded into memory at startup
+    SamplerEngine sampler{ formatManager, 16 };
 
-    // Drum player
-    DJAudioPlayer drumPlayer{ formatManager };
+    // Sums the decks and sampler, skipping whichever are silent
+    SilenceAwareMixer mixerSource;
 
-    MixerAudioSource mixerSource;
+    // Pointers to players, decks, sampler, analyser, library and importer
+    PlaylistComponent playlistComponent{ &player1, &player2, &deckGUI1, &deckGUI2, &sampler, &trackAnalyzer,
+        &libraryStore, &libraryImporter };
 
-    // Pointers to players, decks, and drum player
-    PlaylistComponent playlistComponent{ &player1, &player2, &deckGUI1, &deckGUI2, &drumPlayer };
+    // Frame time and paint time per component, hidden until asked for
+    FrameStatsOverlay statsOverlay{ frameScheduler };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
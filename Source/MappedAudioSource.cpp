@@ -0,0 +1,110 @@
+#include "MappedAudioSource.h"
+
+std::unique_ptr<MappedAudioSource> MappedAudioSource::create(AudioFormatManager& formatManager,
+    const File& file,
+    TimeSliceThread* prefetchThread,
+    double prefetchSeconds)
+{
+    // Only uncompressed formats (WAV, AIFF) can hand out a memory-mapped reader
+    auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+    if (reader == nullptr || !reader->mapEntireFile() || reader->getMappedSection().isEmpty())
+        return nullptr;
+
+    const auto prefetch = roundToInt(prefetchSeconds * reader->sampleRate);
+    return std::unique_ptr<MappedAudioSource>(new MappedAudioSource(std::move(reader), prefetchThread, prefetch));
+}
+
+MappedAudioSource::MappedAudioSource(std::unique_ptr<MemoryMappedAudioFormatReader> mappedReader,
+    TimeSliceThread* prefetchThread,
+    int samplesToPrefetch)
+    : reader(std::move(mappedReader)),
+    thread(prefetchThread),
+    prefetchSamples(samplesToPrefetch),
+    samplesPerPage(jmax(1, 4096 / jmax(1, static_cast<int>(reader->numChannels * reader->bitsPerSample / 8))))
+{
+    if (thread != nullptr)
+        thread->addTimeSliceClient(this);
+}
+
+MappedAudioSource::~MappedAudioSource()
+{
+    if (thread != nullptr)
+        thread->removeTimeSliceClient(this);
+}
+
+double MappedAudioSource::getSampleRate() const noexcept
+{
+    return reader->sampleRate;
+}
+
+void MappedAudioSource::prepareToPlay(int, double)
+{
+}
+
+void MappedAudioSource::releaseResources()
+{
+}
+
+void MappedAudioSource::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    const auto start = position.load(std::memory_order_relaxed);
+
+    // Reads convert straight out of the mapped file. The mapped reader can't read past the
+    // end, so the rest of the block is filled with silence here
+    const int numSamples = bufferToFill.numSamples;
+    const int available = static_cast<int>(jmax<int64>(0, jmin<int64>(numSamples, reader->lengthInSamples - start)));
+    if (available > 0)
+        reader->read(bufferToFill.buffer, bufferToFill.startSample, available, start, true, true);
+    if (available < numSamples)
+        bufferToFill.buffer->clear(bufferToFill.startSample + available, numSamples - available);
+
+    position.store(start + bufferToFill.numSamples, std::memory_order_relaxed);
+}
+
+void MappedAudioSource::setNextReadPosition(int64 newPosition)
+{
+    position.store(jmax((int64) 0, newPosition), std::memory_order_relaxed);
+}
+
+int64 MappedAudioSource::getNextReadPosition() const
+{
+    return position.load(std::memory_order_relaxed);
+}
+
+int64 MappedAudioSource::getTotalLength() const
+{
+    return reader->lengthInSamples;
+}
+
+bool MappedAudioSource::isLooping() const
+{
+    return false;
+}
+
+int MappedAudioSource::useTimeSlice()
+{
+    const auto playhead = position.load(std::memory_order_relaxed);
+
+    // Start again after a seek outside the window already touched
+    if (playhead < prefetchStart || playhead > prefetchedUpTo)
+    {
+        prefetchStart = playhead;
+        prefetchedUpTo = playhead;
+    }
+
+    const auto target = jmin(playhead + prefetchSamples, reader->lengthInSamples);
+    if (prefetchedUpTo >= target)
+        return 20;
+
+    // Touch one sample per page, a bounded number of pages per slice
+    const auto end = jmin(target, prefetchedUpTo + static_cast<int64>(samplesPerPage) * 256);
+    for (auto p = prefetchedUpTo; p < end; p += samplesPerPage)
+        reader->touchSample(p);
+
+    prefetchedUpTo = end;
+    return 0;
+}
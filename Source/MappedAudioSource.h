@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+// MappedAudioSource plays an uncompressed file (WAV/AIFF) straight from a memory map.
+// A seek is just a new read offset into the mapped file, with no stream to reopen.
+// The pages ahead of the playhead are touched on the shared I/O thread, so the audio
+// thread does not take page faults on first read
+class MappedAudioSource : public PositionableAudioSource,
+    private TimeSliceClient
+{
+public:
+    // Maps the file if its format supports memory-mapped reading, otherwise returns nullptr.
+    // prefetchThread may be nullptr, in which case pages are faulted in on demand
+    static std::unique_ptr<MappedAudioSource> create(AudioFormatManager& formatManager,
+        const File& file,
+        TimeSliceThread* prefetchThread,
+        double prefetchSeconds);
+
+    // Destructor. Unregisters from the prefetch thread
+    ~MappedAudioSource() override;
+
+    // Returns the sample rate of the file
+    double getSampleRate() const noexcept;
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override;
+    bool isLooping() const override;
+
+private:
+    MappedAudioSource(std::unique_ptr<MemoryMappedAudioFormatReader> reader,
+        TimeSliceThread* prefetchThread,
+        int prefetchSamples);
+
+    // Touches pages ahead of the playhead. Runs on the prefetch thread
+    int useTimeSlice() override;
+
+    std::unique_ptr<MemoryMappedAudioFormatReader> reader;
+    TimeSliceThread* thread;
+    const int prefetchSamples;
+    const int samplesPerPage;
+
+    std::atomic<int64> position{ 0 };
+
+    // Prefetch thread state
+    int64 prefetchStart = -1;
+    int64 prefetchedUpTo = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MappedAudioSource)
+};
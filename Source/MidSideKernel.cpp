@@ -0,0 +1,149 @@
+#include "MidSideKernel.h"
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+ #define OTODECKS_MS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define OTODECKS_MS_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define OTODECKS_MS_NEON 1
+#endif
+
+namespace MidSideKernel
+{
+
+Coefficients fromVocalMix(float vocalMix, float gain) noexcept
+{
+    // midGain rises 0 -> 1 over [0, 0.5], sideGain falls 1 -> 0 over [0.5, 1]
+    const float midGain = jmin(1.0f, 2.0f * vocalMix);
+    const float sideGain = jmin(1.0f, 2.0f - 2.0f * vocalMix);
+
+    Coefficients c;
+    c.direct = gain * 0.5f * (midGain + sideGain);
+    c.cross = gain * 0.5f * (midGain - sideGain);
+    return c;
+}
+
+void processScalar(float* left, float* right, int numSamples,
+    Coefficients start, Coefficients end) noexcept
+{
+    const float step = numSamples > 0 ? 1.0f / static_cast<float>(numSamples) : 0.0f;
+    const float directStep = (end.direct - start.direct) * step;
+    const float crossStep = (end.cross - start.cross) * step;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float direct = start.direct + directStep * static_cast<float>(i);
+        const float cross = start.cross + crossStep * static_cast<float>(i);
+        const float L = left[i];
+        const float R = right[i];
+        left[i] = direct * L + cross * R;
+        right[i] = cross * L + direct * R;
+    }
+}
+
+void process(float* left, float* right, int numSamples,
+    Coefficients start, Coefficients end) noexcept
+{
+    if (numSamples <= 0)
+        return;
+
+    // Neutral mix: no cross term, so only a (possibly constant) gain remains
+    if (start.cross == 0.0f && end.cross == 0.0f && start.direct == end.direct)
+    {
+        if (start.direct != 1.0f)
+        {
+            FloatVectorOperations::multiply(left, start.direct, numSamples);
+            FloatVectorOperations::multiply(right, start.direct, numSamples);
+        }
+        return;
+    }
+
+    const float step = 1.0f / static_cast<float>(numSamples);
+    const float directStep = (end.direct - start.direct) * step;
+    const float crossStep = (end.cross - start.cross) * step;
+    int i = 0;
+
+   #if OTODECKS_MS_AVX
+    {
+        const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        __m256 direct = _mm256_add_ps(_mm256_set1_ps(start.direct), _mm256_mul_ps(lane, _mm256_set1_ps(directStep)));
+        __m256 cross = _mm256_add_ps(_mm256_set1_ps(start.cross), _mm256_mul_ps(lane, _mm256_set1_ps(crossStep)));
+        const __m256 directInc = _mm256_set1_ps(directStep * 8.0f);
+        const __m256 crossInc = _mm256_set1_ps(crossStep * 8.0f);
+
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            const __m256 L = _mm256_loadu_ps(left + i);
+            const __m256 R = _mm256_loadu_ps(right + i);
+            _mm256_storeu_ps(left + i, _mm256_add_ps(_mm256_mul_ps(direct, L), _mm256_mul_ps(cross, R)));
+            _mm256_storeu_ps(right + i, _mm256_add_ps(_mm256_mul_ps(cross, L), _mm256_mul_ps(direct, R)));
+            direct = _mm256_add_ps(direct, directInc);
+            cross = _mm256_add_ps(cross, crossInc);
+        }
+    }
+   #elif OTODECKS_MS_SSE
+    {
+        const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        __m128 direct = _mm_add_ps(_mm_set1_ps(start.direct), _mm_mul_ps(lane, _mm_set1_ps(directStep)));
+        __m128 cross = _mm_add_ps(_mm_set1_ps(start.cross), _mm_mul_ps(lane, _mm_set1_ps(crossStep)));
+        const __m128 directInc = _mm_set1_ps(directStep * 4.0f);
+        const __m128 crossInc = _mm_set1_ps(crossStep * 4.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const __m128 L = _mm_loadu_ps(left + i);
+            const __m128 R = _mm_loadu_ps(right + i);
+            _mm_storeu_ps(left + i, _mm_add_ps(_mm_mul_ps(direct, L), _mm_mul_ps(cross, R)));
+            _mm_storeu_ps(right + i, _mm_add_ps(_mm_mul_ps(cross, L), _mm_mul_ps(direct, R)));
+            direct = _mm_add_ps(direct, directInc);
+            cross = _mm_add_ps(cross, crossInc);
+        }
+    }
+   #elif OTODECKS_MS_NEON
+    {
+        const float laneValues[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+        const float32x4_t lane = vld1q_f32(laneValues);
+        float32x4_t direct = vmlaq_n_f32(vdupq_n_f32(start.direct), lane, directStep);
+        float32x4_t cross = vmlaq_n_f32(vdupq_n_f32(start.cross), lane, crossStep);
+        const float32x4_t directInc = vdupq_n_f32(directStep * 4.0f);
+        const float32x4_t crossInc = vdupq_n_f32(crossStep * 4.0f);
+
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            const float32x4_t L = vld1q_f32(left + i);
+            const float32x4_t R = vld1q_f32(right + i);
+            vst1q_f32(left + i, vmlaq_f32(vmulq_f32(direct, L), cross, R));
+            vst1q_f32(right + i, vmlaq_f32(vmulq_f32(cross, L), direct, R));
+            direct = vaddq_f32(direct, directInc);
+            cross = vaddq_f32(cross, crossInc);
+        }
+    }
+   #endif
+
+    // Remaining samples (or the whole block without SIMD)
+    if (i < numSamples)
+    {
+        Coefficients tailStart;
+        tailStart.direct = start.direct + directStep * static_cast<float>(i);
+        tailStart.cross = start.cross + crossStep * static_cast<float>(i);
+        processScalar(left + i, right + i, numSamples - i, tailStart, end);
+    }
+}
+
+const char* getInstructionSetName() noexcept
+{
+   #if OTODECKS_MS_AVX
+    return "AVX";
+   #elif OTODECKS_MS_SSE
+    return "SSE2";
+   #elif OTODECKS_MS_NEON
+    return "NEON";
+   #else
+    return "scalar";
+   #endif
+}
+
+}
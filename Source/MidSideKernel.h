@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// MidSideKernel applies the "Vocal Mix" mid/side blend and deck gain to a stereo block.
+// The blend is folded into two coefficients per block:
+//   L' = direct * L + cross * R
+//   R' = cross * L + direct * R
+// which are ramped linearly from the start to the end of the block.
+namespace MidSideKernel
+{
+    // Coefficients for one end of a block
+    struct Coefficients
+    {
+        float direct = 1.0f;
+        float cross = 0.0f;
+    };
+
+    // Works out block coefficients for a vocal mix (0 to 1) and gain without branching
+    Coefficients fromVocalMix(float vocalMix, float gain) noexcept;
+
+    // Processes a block in place, ramping coefficients from start to end.
+    // Returns immediately when both ends are the identity (neutral mix at unity gain)
+    void process(float* left, float* right, int numSamples,
+        Coefficients start, Coefficients end) noexcept;
+
+    // Plain scalar version of process, kept for platforms without SIMD and for benchmarking
+    void processScalar(float* left, float* right, int numSamples,
+        Coefficients start, Coefficients end) noexcept;
+
+    // Returns the name of the instruction set process() was compiled for
+    const char* getInstructionSetName() noexcept;
+}
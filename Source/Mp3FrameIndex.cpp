@@ -0,0 +1,398 @@
+#include "Mp3FrameIndex.h"
+#include "AnalysisStore.h"
+#include "IndexedMp3Reader.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Bitrates of MPEG-1 Layer III in kbit/s by header index; 0 is free format
+    constexpr int bitrates[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 };
+
+    // Sample rates of MPEG-1 by header index
+    constexpr int sampleRates[4] = { 44100, 48000, 32000, 0 };
+
+    // Furthest back a frame's main data can start, in bytes
+    constexpr int maxReservoirBytes = 511;
+
+    // Frames always decoded before the first one kept: one whose output is thrown away
+    // and one for the overlap of the frame after it
+    constexpr int minWarmupFrames = 2;
+
+    // Furthest the first frame header may be from the end of the ID3 tag
+    constexpr size_t maxLeadingJunk = 32768;
+
+    // Frames decoded from the start to check seeks against, and the seeks made into them
+    constexpr int calibrationFrames = 96;
+    constexpr int firstProbeFrame = 8;
+    constexpr int probeSpacing = 7;
+    constexpr int probeOffset = 331;
+    constexpr float calibrationTolerance = 1.0e-4f;
+
+    // Seeks checked past the stretch decoded from the start, spread evenly to the end
+    constexpr int numSpreadProbes = 4;
+
+    // Frames a second reader decodes straight through before each of those seeks. The
+    // decoder only carries a reservoir's worth of bytes and one frame's overlap from
+    // frame to frame, so after this many its output is what a full decode gives
+    constexpr int referenceLeadFrames = 24;
+
+    // The fields of one frame header
+    struct Header
+    {
+        int size = 0;
+        int sampleRateIndex = 0;
+        bool mono = false;
+        bool crc = false;
+    };
+
+    // Parses an MPEG-1 Layer III header. Free format and reserved values are rejected
+    bool parseHeader(uint32 word, Header& header) noexcept
+    {
+        if ((word >> 21) != 0x7ff              // Frame sync
+            || ((word >> 19) & 3) != 3         // MPEG-1
+            || ((word >> 17) & 3) != 1)        // Layer III
+            return false;
+
+        const int bitrate = bitrates[(word >> 12) & 15];
+        const int rate = sampleRates[(word >> 10) & 3];
+        if (bitrate == 0 || rate == 0)
+            return false;
+
+        header.size = 144000 * bitrate / rate + static_cast<int>((word >> 9) & 1);
+        header.sampleRateIndex = static_cast<int>((word >> 10) & 3);
+        header.mono = ((word >> 6) & 3) == 3;
+        header.crc = ((word >> 16) & 1) == 0;
+        return true;
+    }
+
+    // Returns true if the bytes after the last frame are a tag rather than more audio
+    bool isTrailingTag(const uint8* data, size_t size) noexcept
+    {
+        auto startsWith = [data, size](const char* text)
+        {
+            const auto length = std::strlen(text);
+            return size >= length && std::memcmp(data, text, length) == 0;
+        };
+
+        return startsWith("TAG") || startsWith("APETAGEX") || startsWith("LYRICSBEGIN");
+    }
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<const Mp3FrameIndex> Mp3FrameIndex::findOrBuild(AudioFormatManager& formatManager,
+    const File& file, uint64 key, AnalysisStore& store)
+{
+    if (!file.hasFileExtension("mp3") || key == 0)
+        return nullptr;
+
+    auto index = std::make_shared<Mp3FrameIndex>();
+    if (!store.findFrameIndex(key, *index))
+    {
+        // A file that can't be indexed is stored with an empty index, so it is only tried once
+        index->build(formatManager, file);
+        store.storeFrameIndex(key, *index);
+    }
+
+    if (!index->isUsable())
+        return nullptr;
+
+    return index;
+}
+
+//------------------------------------------------------------------------------
+bool Mp3FrameIndex::build(AudioFormatManager& formatManager, const File& file)
+{
+    frames.clear();
+    frameOffsets.clear();
+
+    {
+        MemoryMappedFile mapped(file, MemoryMappedFile::readOnly);
+        if (mapped.getData() == nullptr
+            || !scan(static_cast<const uint8*>(mapped.getData()), mapped.getSize()))
+        {
+            frames.clear();
+            frameOffsets.clear();
+            return false;
+        }
+    }
+
+    if (!calibrate(formatManager, file))
+    {
+        frames.clear();
+        frameOffsets.clear();
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool Mp3FrameIndex::scan(const uint8* data, size_t size)
+{
+    // An ID3v2 tag comes first, its size stored seven bits to a byte
+    size_t pos = 0;
+    if (size >= 10 && std::memcmp(data, "ID3", 3) == 0)
+    {
+        pos = 10 + ((static_cast<size_t>(data[6] & 0x7f) << 21) | (static_cast<size_t>(data[7] & 0x7f) << 14)
+            | (static_cast<size_t>(data[8] & 0x7f) << 7) | static_cast<size_t>(data[9] & 0x7f));
+        if ((data[5] & 0x10) != 0)
+            pos += 10;
+    }
+
+    // The first frame is the first header followed by another, past any padding
+    Header first;
+    const size_t searchEnd = jmin(size, pos + maxLeadingJunk);
+    for (; pos + 4 <= searchEnd; ++pos)
+    {
+        Header next;
+        if (parseHeader(ByteOrder::bigEndianInt(data + pos), first)
+            && pos + static_cast<size_t>(first.size) + 4 <= size
+            && parseHeader(ByteOrder::bigEndianInt(data + pos + static_cast<size_t>(first.size)), next))
+            break;
+    }
+
+    if (pos + 4 > searchEnd)
+        return false;
+
+    const int64 firstOffset = static_cast<int64>(pos);
+    sampleRate = sampleRates[first.sampleRateIndex];
+    numChannels = first.mono ? 1 : 2;
+
+    // Every frame follows straight on from the one before, in the same layout
+    Header header;
+    while (pos + 6 <= size && parseHeader(ByteOrder::bigEndianInt(data + pos), header))
+    {
+        if (header.sampleRateIndex != first.sampleRateIndex || header.mono != first.mono
+            || pos + static_cast<size_t>(header.size) > size)
+            break;
+
+        // The side information starts with the nine bits saying where the main data begins,
+        // and everything after it is main data
+        const size_t side = pos + 4 + (header.crc ? 2 : 0);
+        const int sideBytes = header.mono ? 17 : 32;
+        if (static_cast<int>(side - pos) + sideBytes > header.size)
+            break;
+
+        Frame frame;
+        frame.size = static_cast<uint16>(header.size);
+        frame.mainDataBytes = static_cast<uint16>(header.size - static_cast<int>(side - pos) - sideBytes);
+        frame.reservoirBytes = static_cast<uint16>((data[side] << 1) | (data[side + 1] >> 7));
+        frames.push_back(frame);
+
+        pos += static_cast<size_t>(header.size);
+    }
+
+    // Anything but a tag after the last frame means the run was broken
+    if (frames.empty() || (size - pos > static_cast<size_t>(frames.back().size) && !isTrailingTag(data + pos, size - pos)))
+        return false;
+
+    computeOffsets(firstOffset);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void Mp3FrameIndex::computeOffsets(int64 firstOffset)
+{
+    frameOffsets.resize(frames.size());
+
+    int64 offset = firstOffset;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        frameOffsets[i] = offset;
+        offset += frames[i].size;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool Mp3FrameIndex::calibrate(AudioFormatManager& formatManager, const File& file)
+{
+    auto* format = formatManager.findFormatForFileExtension(".mp3");
+    std::unique_ptr<AudioFormatReader> reference(formatManager.createReaderFor(file));
+    if (format == nullptr || reference == nullptr)
+        return false;
+
+    // The start of the track decoded straight through, stopping short of the end, which
+    // the reference reader only estimates
+    const int numReferenceFrames = jmin(calibrationFrames, getNumFrames() - 2);
+    if (numReferenceFrames <= firstProbeFrame + 2)
+        return false;
+
+    AudioBuffer<float> expected(2, numReferenceFrames * samplesPerFrame);
+    reference->read(&expected, 0, expected.getNumSamples(), 0, true, true);
+
+    // Seeks part way into frames across the decoded stretch, each reading a frame's worth
+    AudioBuffer<float> actual(2, samplesPerFrame);
+    auto matches = [&](IndexedMp3Reader& reader)
+    {
+        for (int frame = firstProbeFrame; frame + 2 < numReferenceFrames; frame += probeSpacing)
+        {
+            const int start = frame * samplesPerFrame + probeOffset;
+            reader.read(&actual, 0, samplesPerFrame, start, true, true);
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const float* a = actual.getReadPointer(ch);
+                const float* e = expected.getReadPointer(ch, start);
+                for (int i = 0; i < samplesPerFrame; ++i)
+                    if (std::abs(a[i] - e[i]) > calibrationTolerance)
+                        return false;
+            }
+        }
+
+        return true;
+    };
+
+    // Seeks spread over the rest of the file, each checked against a second reader that
+    // arrives at the same sample by decoding straight through from well before it
+    const int firstSpreadFrame = numReferenceFrames + referenceLeadFrames;
+    const int lastSpreadFrame = getNumFrames() - 3;
+    AudioBuffer<float> lead(2, referenceLeadFrames * samplesPerFrame);
+    AudioBuffer<float> straightThrough(2, samplesPerFrame);
+    auto matchesLater = [&](IndexedMp3Reader& reader, IndexedMp3Reader& straight)
+    {
+        for (int probe = 1; probe <= numSpreadProbes && firstSpreadFrame < lastSpreadFrame; ++probe)
+        {
+            const int frame = firstSpreadFrame + (lastSpreadFrame - firstSpreadFrame) * probe / (numSpreadProbes + 1);
+            const auto start = static_cast<int64>(frame) * samplesPerFrame + probeOffset;
+            straight.read(&lead, 0, lead.getNumSamples(), start - lead.getNumSamples(), true, true);
+            straight.read(&straightThrough, 0, samplesPerFrame, start, true, true);
+            reader.read(&actual, 0, samplesPerFrame, start, true, true);
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const float* a = actual.getReadPointer(ch);
+                const float* e = straightThrough.getReadPointer(ch);
+                for (int i = 0; i < samplesPerFrame; ++i)
+                    if (std::abs(a[i] - e[i]) > calibrationTolerance)
+                        return false;
+            }
+        }
+
+        return true;
+    };
+
+    // JUCE's decoder may or may not produce audio for a VBR header frame, and for a frame
+    // whose main data it never saw; each arrangement is tried until one lines up
+    for (int leading = 0; leading <= 1; ++leading)
+    {
+        for (const bool drops : { false, true })
+        {
+            leadingFrames = leading;
+            dropsUnprimedFrame = drops;
+
+            // The readers borrow this index: a shared_ptr with no owner leaves it alone
+            const std::shared_ptr<const Mp3FrameIndex> borrowed(std::shared_ptr<const Mp3FrameIndex>(), this);
+            IndexedMp3Reader reader(*format, file, borrowed);
+            if (!matches(reader))
+                continue;
+
+            // Once the start lines up, the rest of the file has to as well
+            IndexedMp3Reader straightReader(*format, file, borrowed);
+            return matchesLater(reader, straightReader);
+        }
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int64 Mp3FrameIndex::getLengthInSamples() const noexcept
+{
+    return static_cast<int64>(jmax(0, getNumFrames() - leadingFrames)) * samplesPerFrame;
+}
+
+//------------------------------------------------------------------------------
+int Mp3FrameIndex::getFrameForSample(int64 sample) const noexcept
+{
+    const auto frame = sample / samplesPerFrame + leadingFrames;
+    return static_cast<int>(jlimit<int64>(0, jmax(0, getNumFrames() - 1), frame));
+}
+
+//------------------------------------------------------------------------------
+int Mp3FrameIndex::getDecodeStartFrame(int frame) const noexcept
+{
+    // The frame before the one kept must decode cleanly too, so the reservoir of every frame
+    // from there on has to be main data the decoder read after the frame it throws away.
+    // Reservoirs count main data only, not headers or side information
+    auto coversReservoirs = [this, frame](int first)
+    {
+        int available = 0;
+        for (int i = first + 1; i < frame - 1; ++i)
+            available += frames[static_cast<size_t>(i)].mainDataBytes;
+
+        // Once as much is held as any frame can reach back, the frames after are covered too
+        for (int i = frame - 1; i < getNumFrames() && available < maxReservoirBytes; ++i)
+        {
+            if (frames[static_cast<size_t>(i)].reservoirBytes > available)
+                return false;
+
+            available += frames[static_cast<size_t>(i)].mainDataBytes;
+        }
+
+        return true;
+    };
+
+    int first = frame - minWarmupFrames;
+    while (first > leadingFrames && !coversReservoirs(first))
+        --first;
+
+    // Near the start the decoder simply opens the whole file
+    return first > leadingFrames ? first : 0;
+}
+
+//------------------------------------------------------------------------------
+int64 Mp3FrameIndex::getFirstSampleWhenStartingAt(int frame) const noexcept
+{
+    if (frame <= 0)
+        return 0;
+
+    const bool dropped = dropsUnprimedFrame && frames[static_cast<size_t>(frame)].reservoirBytes > 0;
+    return static_cast<int64>(frame - leadingFrames + (dropped ? 1 : 0)) * samplesPerFrame;
+}
+
+//------------------------------------------------------------------------------
+void Mp3FrameIndex::writeTo(OutputStream& out) const
+{
+    out.writeInt(formatVersion);
+    out.writeDouble(sampleRate);
+    out.writeInt(numChannels);
+    out.writeInt(leadingFrames);
+    out.writeInt(dropsUnprimedFrame ? 1 : 0);
+    out.writeInt(getNumFrames());
+    out.writeInt64(frameOffsets.empty() ? 0 : frameOffsets.front());
+    out.write(frames.data(), frames.size() * sizeof(Frame));
+}
+
+//------------------------------------------------------------------------------
+bool Mp3FrameIndex::loadFrom(const void* data, size_t size)
+{
+    constexpr size_t headerSize = 4 + 8 + 4 + 4 + 4 + 4 + 8;
+    if (data == nullptr || size < headerSize)
+        return false;
+
+    MemoryInputStream in(data, headerSize, false);
+    if (in.readInt() != formatVersion)
+        return false;
+
+    const double newSampleRate = in.readDouble();
+    const int newNumChannels = in.readInt();
+    const int newLeadingFrames = in.readInt();
+    const bool newDrops = in.readInt() != 0;
+    const int numFrames = in.readInt();
+    const int64 firstOffset = in.readInt64();
+
+    if (numFrames < 0 || newLeadingFrames < 0 || firstOffset < 0
+        || size != headerSize + static_cast<size_t>(numFrames) * sizeof(Frame))
+        return false;
+
+    sampleRate = newSampleRate;
+    numChannels = newNumChannels;
+    leadingFrames = newLeadingFrames;
+    dropsUnprimedFrame = newDrops;
+
+    frames.resize(static_cast<size_t>(numFrames));
+    std::memcpy(frames.data(), static_cast<const char*>(data) + headerSize, frames.size() * sizeof(Frame));
+    computeOffsets(firstOffset);
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <memory>
+#include <vector>
+
+class AnalysisStore;
+
+// Mp3FrameIndex records where every frame of an MP3 starts, so a reader can jump to the
+// frame holding any sample instead of parsing its way there from the start of the file.
+// It is built once per file by walking the frame headers, then checked against a full
+// decode so a seek through it lands on exactly the samples JUCE's own reader produces.
+// The index is kept in the AnalysisStore with the track's other data.
+//
+// Only constant-layout MPEG-1 Layer III files are indexed, which is what JUCE's reader
+// expects: 1152 samples in every frame and no junk between frames. Anything else gets an
+// empty index, and plays through the ordinary reader
+class Mp3FrameIndex
+{
+public:
+    // Samples decoded from each MPEG-1 Layer III frame
+    static constexpr int samplesPerFrame = 1152;
+
+    // Bumped whenever the stored layout changes
+    static constexpr int formatVersion = 2;
+
+    // Constructs an empty index
+    Mp3FrameIndex() = default;
+
+    // Returns the index the store holds under key for file, building and storing it if
+    // there is none yet. Returns nullptr if the file is not an MP3 that can be indexed.
+    // Reads the whole file the first time, so never call it from the audio or message thread
+    static std::shared_ptr<const Mp3FrameIndex> findOrBuild(AudioFormatManager& formatManager,
+        const File& file, uint64 key, AnalysisStore& store);
+
+    // Walks the frames of file and checks the result against a full decode. Returns false,
+    // leaving the index empty, if the file can't be indexed
+    bool build(AudioFormatManager& formatManager, const File& file);
+
+    // Returns true if the index describes a file it can seek in
+    bool isUsable() const noexcept { return !frames.empty(); }
+
+    // Returns the number of frames, including any the decoder produces no audio for
+    int getNumFrames() const noexcept { return static_cast<int>(frames.size()); }
+
+    // Returns the byte offset of a frame in the file
+    int64 getFrameOffset(int frame) const noexcept { return frameOffsets[static_cast<size_t>(frame)]; }
+
+    // Returns the length of the decoded audio in samples
+    int64 getLengthInSamples() const noexcept;
+
+    // Returns the sample rate of the file
+    double getSampleRate() const noexcept { return sampleRate; }
+
+    // Returns the number of channels in the file
+    int getNumChannels() const noexcept { return numChannels; }
+
+    // Returns the frame holding a sample of the decoded audio
+    int getFrameForSample(int64 sample) const noexcept;
+
+    // Returns the frame a decoder should start from to produce frame cleanly: far enough
+    // back for the bit reservoir of every frame it keeps, plus one for the overlap
+    int getDecodeStartFrame(int frame) const noexcept;
+
+    // Returns the sample of the decoded audio that a decoder opened at the start of frame
+    // produces first
+    int64 getFirstSampleWhenStartingAt(int frame) const noexcept;
+
+    // Writes the index, to be read back by loadFrom
+    void writeTo(OutputStream& out) const;
+
+    // Replaces the contents with an index written by writeTo. Returns false if the data
+    // is not a valid index
+    bool loadFrom(const void* data, size_t size);
+
+private:
+    // One frame: its size in bytes, how many of them are main data, and how far back in
+    // the main data before it its own starts
+    struct Frame
+    {
+        uint16 size = 0;
+        uint16 mainDataBytes = 0;
+        uint16 reservoirBytes = 0;
+    };
+
+    // Reads the frame headers from the file's bytes. Returns false if they do not form
+    // an unbroken run of constant-layout frames
+    bool scan(const uint8* data, size_t size);
+
+    // Fills in the byte offset of every frame from the first one and the frame sizes
+    void computeOffsets(int64 firstOffset);
+
+    // Finds how JUCE's decoder lines up with the frames by comparing seeks against a full
+    // decode. Returns false if no arrangement matches
+    bool calibrate(AudioFormatManager& formatManager, const File& file);
+
+    std::vector<Frame> frames;
+    std::vector<int64> frameOffsets;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+
+    // Frames at the start of the file that decode to nothing, such as a VBR header frame
+    int leadingFrames = 0;
+
+    // True if a decoder opened part way through drops its first frame when that frame's
+    // main data starts in an earlier one
+    bool dropsUnprimedFrame = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Mp3FrameIndex)
+};
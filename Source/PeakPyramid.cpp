@@ -0,0 +1,303 @@
+#include "PeakPyramid.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Layout version of writeTo
+    constexpr int formatVersion = 1;
+
+    // Entries are copied to and from the store as raw bytes
+    static_assert(sizeof(PeakPyramid::Peak) == 3, "Peak must be tightly packed");
+
+    inline int8 quantiseSample(float value) noexcept
+    {
+        return static_cast<int8>(jlimit(-127, 127, roundToInt(value * 127.0f)));
+    }
+
+    inline uint8 quantiseLevel(double value) noexcept
+    {
+        return static_cast<uint8>(jlimit(0, 255, roundToInt(value * 255.0)));
+    }
+}
+
+PeakPyramid::PeakPyramid()
+{
+}
+
+PeakPyramid::~PeakPyramid()
+{
+}
+
+std::vector<size_t> PeakPyramid::getLevelSizes(int64 length)
+{
+    std::vector<size_t> sizes;
+    auto size = static_cast<size_t>((jmax(static_cast<int64>(1), length) + baseSamplesPerPeak - 1) / baseSamplesPerPeak);
+    sizes.push_back(size);
+
+    while (size > 1)
+    {
+        size = (size + 1) / 2;
+        sizes.push_back(size);
+    }
+
+    return sizes;
+}
+
+void PeakPyramid::startBuild(int64 newLengthInSamples, double newSampleRate)
+{
+    lengthInSamples = newLengthInSamples;
+    sampleRate = newSampleRate;
+
+    levelSizes = getLevelSizes(lengthInSamples);
+    levelOffsets.clear();
+
+    size_t total = 0;
+    for (const auto size : levelSizes)
+    {
+        levelOffsets.push_back(total);
+        total += size;
+    }
+
+    peaks.assign(total, Peak());
+    numBasePeaksDone.store(0, std::memory_order_release);
+    complete.store(false, std::memory_order_release);
+
+    accumulatedMin = accumulatedMax = 0.0f;
+    accumulatedSquares = 0.0;
+    accumulatedSamples = 0;
+}
+
+void PeakPyramid::addSamples(const AudioBuffer<float>& buffer, int numSamples)
+{
+    const int numChannels = buffer.getNumChannels();
+    if (numChannels == 0)
+        return;
+
+    const double squareScale = 1.0 / numChannels;
+
+    for (int start = 0; start < numSamples;)
+    {
+        // Up to the end of the entry being accumulated
+        const int num = jmin(numSamples - start, baseSamplesPerPeak - accumulatedSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* data = buffer.getReadPointer(ch, start);
+            const auto range = FloatVectorOperations::findMinAndMax(data, num);
+
+            if (accumulatedSamples == 0 && ch == 0)
+            {
+                accumulatedMin = range.getStart();
+                accumulatedMax = range.getEnd();
+            }
+            else
+            {
+                accumulatedMin = jmin(accumulatedMin, range.getStart());
+                accumulatedMax = jmax(accumulatedMax, range.getEnd());
+            }
+
+            double squares = 0.0;
+            for (int i = 0; i < num; ++i)
+                squares += data[i] * data[i];
+
+            accumulatedSquares += squares * squareScale;
+        }
+
+        accumulatedSamples += num;
+        start += num;
+
+        if (accumulatedSamples == baseSamplesPerPeak)
+            commitBasePeak();
+    }
+}
+
+void PeakPyramid::finishBuild()
+{
+    if (accumulatedSamples > 0)
+        commitBasePeak();
+
+    // The last entry of each level may have had only one child when it was made
+    for (int level = 1; level < getNumLevels(); ++level)
+        combineChildren(level, levelSizes[static_cast<size_t>(level)] - 1);
+
+    numBasePeaksDone.store(levelSizes.empty() ? 0 : levelSizes[0], std::memory_order_release);
+    complete.store(true, std::memory_order_release);
+}
+
+void PeakPyramid::commitBasePeak() noexcept
+{
+    const size_t index = numBasePeaksDone.load(std::memory_order_relaxed);
+    if (levelSizes.empty() || index >= levelSizes[0])
+        return;
+
+    auto& peak = peaks[index];
+    peak.minimum = quantiseSample(accumulatedMin);
+    peak.maximum = quantiseSample(accumulatedMax);
+    peak.rms = quantiseLevel(std::sqrt(accumulatedSquares / accumulatedSamples));
+
+    accumulatedMin = accumulatedMax = 0.0f;
+    accumulatedSquares = 0.0;
+    accumulatedSamples = 0;
+
+    // Each entry that finishes a pair completes the entry above it
+    size_t child = index;
+    for (int level = 1; level < getNumLevels() && (child & 1) == 1; ++level)
+    {
+        child >>= 1;
+        combineChildren(level, child);
+    }
+
+    numBasePeaksDone.store(index + 1, std::memory_order_release);
+}
+
+void PeakPyramid::combineChildren(int level, size_t index) noexcept
+{
+    const auto childLevel = static_cast<size_t>(level - 1);
+    const size_t first = index * 2;
+    const size_t last = jmin(first + 1, levelSizes[childLevel] - 1);
+    const Peak* children = peaks.data() + levelOffsets[childLevel];
+
+    Peak combined = children[first];
+    double squares = static_cast<double>(combined.rms) * combined.rms;
+
+    if (last != first)
+    {
+        combined.minimum = jmin(combined.minimum, children[last].minimum);
+        combined.maximum = jmax(combined.maximum, children[last].maximum);
+        squares = 0.5 * (squares + static_cast<double>(children[last].rms) * children[last].rms);
+    }
+
+    combined.rms = static_cast<uint8>(jlimit(0, 255, roundToInt(std::sqrt(squares))));
+    peaks[levelOffsets[static_cast<size_t>(level)] + index] = combined;
+}
+
+float PeakPyramid::getProgress() const noexcept
+{
+    if (isComplete())
+        return 1.0f;
+
+    return levelSizes.empty() ? 0.0f
+        : static_cast<float>(numBasePeaksDone.load(std::memory_order_acquire)) / static_cast<float>(levelSizes[0]);
+}
+
+int64 PeakPyramid::getNumSamplesDone() const noexcept
+{
+    if (isComplete())
+        return lengthInSamples;
+
+    const auto done = static_cast<int64>(numBasePeaksDone.load(std::memory_order_acquire)) * baseSamplesPerPeak;
+    return jmin(lengthInSamples, done);
+}
+
+int PeakPyramid::getLevelFor(double samplesPerPixel) const noexcept
+{
+    if (samplesPerPixel <= baseSamplesPerPeak)
+        return 0;
+
+    const int level = static_cast<int>(std::floor(std::log2(samplesPerPixel / baseSamplesPerPeak)));
+    return jlimit(0, jmax(0, getNumLevels() - 1), level);
+}
+
+bool PeakPyramid::getPeak(int level, double startSample, double endSample, Peak& result) const noexcept
+{
+    if (!isPositiveAndBelow(level, getNumLevels()))
+        return false;
+
+    // Entries whose children are all done, or the whole level once the build is complete
+    const auto levelIndex = static_cast<size_t>(level);
+    const size_t available = isComplete() ? levelSizes[levelIndex]
+                                          : numBasePeaksDone.load(std::memory_order_acquire) >> level;
+
+    const double samplesPerPeak = static_cast<double>(baseSamplesPerPeak) * static_cast<double>(static_cast<size_t>(1) << level);
+    const auto first = static_cast<int64>(std::floor(startSample / samplesPerPeak));
+    const auto last = jmax(first, static_cast<int64>(std::ceil(endSample / samplesPerPeak)) - 1);
+
+    if (last < 0 || first >= static_cast<int64>(available))
+        return false;
+
+    const auto from = static_cast<size_t>(jmax(static_cast<int64>(0), first));
+    const auto to = static_cast<size_t>(jmin(last, static_cast<int64>(available) - 1));
+    const Peak* entries = peaks.data() + levelOffsets[levelIndex];
+
+    result = entries[from];
+    int maxRms = result.rms;
+    for (size_t i = from + 1; i <= to; ++i)
+    {
+        result.minimum = jmin(result.minimum, entries[i].minimum);
+        result.maximum = jmax(result.maximum, entries[i].maximum);
+        maxRms = jmax(maxRms, static_cast<int>(entries[i].rms));
+    }
+
+    result.rms = static_cast<uint8>(maxRms);
+    return true;
+}
+
+void PeakPyramid::draw(Graphics& g, Rectangle<int> area, double startSample, double samplesPerPixel,
+    Colour peakColour, Colour rmsColour) const
+{
+    if (samplesPerPixel <= 0.0 || area.isEmpty())
+        return;
+
+    const int level = getLevelFor(samplesPerPixel);
+    const float centre = static_cast<float>(area.getCentreY());
+    const float halfHeight = 0.5f * static_cast<float>(area.getHeight());
+    const float sampleScale = halfHeight / 127.0f;
+    const float levelScale = halfHeight / 255.0f;
+
+    // Two passes so each colour is only set once
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        g.setColour(pass == 0 ? peakColour : rmsColour);
+
+        for (int x = 0; x < area.getWidth(); ++x)
+        {
+            const double start = startSample + x * samplesPerPixel;
+            Peak peak;
+            if (!getPeak(level, start, start + samplesPerPixel, peak))
+                continue;
+
+            const float top = pass == 0 ? centre - peak.maximum * sampleScale : centre - peak.rms * levelScale;
+            const float bottom = pass == 0 ? centre - peak.minimum * sampleScale : centre + peak.rms * levelScale;
+            g.drawVerticalLine(area.getX() + x, top, jmax(top + 1.0f, bottom));
+        }
+    }
+}
+
+void PeakPyramid::writeTo(OutputStream& out) const
+{
+    jassert(isComplete());
+
+    out.writeInt(formatVersion);
+    out.writeDouble(sampleRate);
+    out.writeInt64(lengthInSamples);
+    out.write(peaks.data(), peaks.size() * sizeof(Peak));
+}
+
+bool PeakPyramid::loadFrom(const void* data, size_t size)
+{
+    constexpr size_t headerSize = 4 + 8 + 8;
+    if (data == nullptr || size < headerSize)
+        return false;
+
+    MemoryInputStream in(data, headerSize, false);
+    if (in.readInt() != formatVersion)
+        return false;
+
+    const double newSampleRate = in.readDouble();
+    const int64 newLength = in.readInt64();
+    if (newSampleRate <= 0.0 || newLength <= 0)
+        return false;
+
+    startBuild(newLength, newSampleRate);
+    if (size != headerSize + peaks.size() * sizeof(Peak))
+    {
+        startBuild(0, 0.0);
+        return false;
+    }
+
+    std::memcpy(peaks.data(), static_cast<const char*>(data) + headerSize, peaks.size() * sizeof(Peak));
+    numBasePeaksDone.store(levelSizes[0], std::memory_order_release);
+    complete.store(true, std::memory_order_release);
+    return true;
+}
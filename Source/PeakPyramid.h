@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+#include <vector>
+
+// PeakPyramid is a multi-resolution summary of a track for drawing waveforms. Level 0
+// holds the minimum, maximum and RMS level of every baseSamplesPerPeak samples, and each
+// level above it halves the resolution of the one below, like the mipmaps of a texture.
+// All levels are built together in one streaming pass. Drawing picks the level whose
+// resolution is just finer than a pixel, so each column reads at most a few entries and
+// painting costs the same whatever the track length or zoom.
+//
+// The pyramid can be drawn while it is still being built: one thread adds samples and
+// any number of threads read what has been finished so far
+class PeakPyramid
+{
+public:
+    // One entry: the extremes and RMS level of a run of samples, scaled to 8 bits
+    struct Peak
+    {
+        int8 minimum = 0;
+        int8 maximum = 0;
+        uint8 rms = 0;
+    };
+
+    // Samples summarised by each entry of level 0
+    static constexpr int baseSamplesPerPeak = 128;
+
+    // Constructs an empty pyramid
+    PeakPyramid();
+
+    // Destructor
+    ~PeakPyramid();
+
+    // Allocates every level for a track of the given length and starts a build
+    void startBuild(int64 lengthInSamples, double sampleRate);
+
+    // Adds the next samples of the track, mixing all channels of the buffer
+    void addSamples(const AudioBuffer<float>& buffer, int numSamples);
+
+    // Completes the last entries of each level once every sample has been added
+    void finishBuild();
+
+    // Returns true once every sample has been added
+    bool isComplete() const noexcept { return complete.load(std::memory_order_acquire); }
+
+    // Returns the fraction of the track summarised so far, from 0 to 1
+    float getProgress() const noexcept;
+
+    // Returns how many samples from the start of the track have been summarised so far
+    int64 getNumSamplesDone() const noexcept;
+
+    // Returns the length of the track in samples
+    int64 getLengthInSamples() const noexcept { return lengthInSamples; }
+
+    // Returns the sample rate of the track
+    double getSampleRate() const noexcept { return sampleRate; }
+
+    // Returns the number of levels
+    int getNumLevels() const noexcept { return static_cast<int>(levelOffsets.size()); }
+
+    // Returns the combined entry for the samples from start to end, read from the given
+    // level. Returns false if that part of the track has not been summarised yet
+    bool getPeak(int level, double startSample, double endSample, Peak& result) const noexcept;
+
+    // Returns the coarsest level that still has at least one entry per samplesPerPixel
+    int getLevelFor(double samplesPerPixel) const noexcept;
+
+    // Draws columns of the waveform into area, starting at startSample and advancing
+    // samplesPerPixel per column. Peaks are drawn in peakColour with the RMS level over
+    // them in rmsColour
+    void draw(Graphics& g, Rectangle<int> area, double startSample, double samplesPerPixel,
+        Colour peakColour, Colour rmsColour) const;
+
+    // Writes a complete pyramid to a stream
+    void writeTo(OutputStream& out) const;
+
+    // Replaces the contents with a pyramid written by writeTo. Returns false if the data
+    // is not a valid pyramid
+    bool loadFrom(const void* data, size_t size);
+
+private:
+    // Number of entries needed at each level for a track of this length
+    static std::vector<size_t> getLevelSizes(int64 lengthInSamples);
+
+    // Combines the two entries below an entry of a level above 0
+    void combineChildren(int level, size_t index) noexcept;
+
+    // Writes the entry being accumulated into level 0 and the levels it completes
+    void commitBasePeak() noexcept;
+
+    int64 lengthInSamples = 0;
+    double sampleRate = 0.0;
+
+    // Every level in one block, level 0 first
+    std::vector<Peak> peaks;
+    std::vector<size_t> levelOffsets;
+    std::vector<size_t> levelSizes;
+
+    // Level 0 entries written so far, published to readers
+    std::atomic<size_t> numBasePeaksDone{ 0 };
+    std::atomic<bool> complete{ false };
+
+    // The level 0 entry being accumulated. Builder only
+    float accumulatedMin = 0.0f;
+    float accumulatedMax = 0.0f;
+    double accumulatedSquares = 0.0;
+    int accumulatedSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakPyramid)
+};
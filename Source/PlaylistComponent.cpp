@@ -27,59 +27,14 @@ void CustomButton::paintButton(juce::Graphics& g, bool isMouseOverButton, bool i
     g.drawText(getButtonText(), textArea, juce::Justification::centred, true);
 }
 
-//==============================================================================
-// TrackButtonsComponent methods
-
-// Constructor: initializes buttons for a given row
-PlaylistComponent::TrackButtonsComponent::TrackButtonsComponent(int row, PlaylistComponent* parentComp)
-    : rowId(row), parent(parentComp)
-{
-    // Set button texts
-    leftButton.setButtonText("Left");
-    rightButton.setButtonText("Right");
-
-    // Add buttons as child components
-    addAndMakeVisible(leftButton);
-    addAndMakeVisible(rightButton);
-
-    // Register this component as listener for buttons
-    leftButton.addListener(this);
-    rightButton.addListener(this);
-}
-
-// Lays out buttons side by side
-void PlaylistComponent::TrackButtonsComponent::resized()
-{
-    auto bounds = getLocalBounds();
-    // Place leftButton on the left half and rightButton on the other half
-    leftButton.setBounds(bounds.removeFromLeft(bounds.getWidth() / 2).reduced(2));
-    rightButton.setBounds(bounds.reduced(2));
-}
-
-void PlaylistComponent::TrackButtonsComponent::setRowId(int row)
-{
-    rowId = row;
-}
-
-// Handle clicks on the left/right buttons
-void PlaylistComponent::TrackButtonsComponent::buttonClicked(juce::Button* button)
-{
-    if (parent != nullptr)
-    {
-        if (button == &leftButton)
-            parent->assignTrackToDeck(rowId, true);   // Assign track to left deck.
-        else if (button == &rightButton)
-            parent->assignTrackToDeck(rowId, false);  // Assign track to right deck.
-    }
-}
-
 //==============================================================================
 // PlaylistComponent methods
 
 // Constructor: sets up the playlist, initializes track data and configures UI elements
 PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     DeckGUI* leftGUI, DeckGUI* rightGUI,
-    DJAudioPlayer* drumPlayerIn)
+    SamplerEngine* samplerIn, TrackAnalyzer* analyzerIn,
+    LibraryStore* libraryIn, LibraryImporter* importerIn)
     : volSlider1("Volume L"),
     speedSlider1("Speed L"),
     posSlider1("Vocal Mix L"),
@@ -90,8 +45,22 @@ PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     deck2(d2),
     leftDeckGUI(leftGUI),
     rightDeckGUI(rightGUI),
-    drumPlayer(drumPlayerIn)
+    sampler(samplerIn),
+    analyzer(analyzerIn),
+    library(libraryIn),
+    libraryIndex(*libraryIn),
+    importer(importerIn)
 {
+    // Vocal shots cut each other off, as do the siren and airhorn
+    padSlots = { {
+        { &bottomButton1, "Drum 1.wav", 0, -1 },
+        { &bottomButton2, "Vocal Sample 1.mp3", 1, -1 },
+        { &bottomButton3, "Siren.mp3", 2, -1 },
+        { &bottomButton4, "Drum 4.wav", 0, -1 },
+        { &bottomButton5, "Glasses Up.mp3", 1, -1 },
+        { &bottomButton6, "Airhorn.mp3", 2, -1 }
+    } };
+
     // Determine the assets directory
     juce::File sourceDir(String(__FILE__));
     sourceDir = sourceDir.getParentDirectory();
@@ -101,30 +70,20 @@ PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     juce::File song1 = assetsDir.getChildFile("Song1.mp3");
     juce::File song2 = assetsDir.getChildFile("Song2.mp3");
 
-    // Check if song1 exists and stores its title and file
-    if (song1.existsAsFile())
-    {
-        trackTitles.push_back("Die with a smile");
-        trackFiles.push_back(song1);
-    }
-    //if song1 doesnt exits goes to default
-    else
+    // Add the bundled songs to the library the first time they are found
+    if (song1.existsAsFile() && library->findTrack(song1) < 0)
     {
-        trackTitles.push_back("Track 1");
-        trackFiles.push_back(juce::File());
+        auto track = LibraryStore::describeFile(song1);
+        track.title = "Die with a smile";
+        addTrack(track);
     }
 
-    // Similarly check and store song2
-    if (song2.existsAsFile())
+    // Similarly check and add song2
+    if (song2.existsAsFile() && library->findTrack(song2) < 0)
     {
-        trackTitles.push_back("Not like us");
-        trackFiles.push_back(song2);
-    }
-    //Similarly goes to default if doesnt exits
-    else
-    {
-        trackTitles.push_back("Track 2");
-        trackFiles.push_back(juce::File());
+        auto track = LibraryStore::describeFile(song2);
+        track.title = "Not like us";
+        addTrack(track);
     }
 
     // Configure and display header label
@@ -136,6 +95,12 @@ PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     addAndMakeVisible(loadButton);
     loadButton.addListener(this);
 
+    // Search box filters the track list as each key is typed
+    searchBox.setTextToShowWhenEmpty("Search title or artist", juce::Colours::grey);
+    searchBox.onTextChange = [this] { updateSearch(); };
+    searchBox.onEscapeKey = [this] { searchBox.clear(); updateSearch(); };
+    addAndMakeVisible(searchBox);
+
     // Set up bottom buttons and register listeners for them
     addAndMakeVisible(bottomButton1); bottomButton1.addListener(this);
     addAndMakeVisible(bottomButton2); bottomButton2.addListener(this);
@@ -180,13 +145,17 @@ PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     speedSlider2.setLookAndFeel(&customKnobLookAndFeel);
     posSlider2.setLookAndFeel(&customKnobLookAndFeel);
 
-    // Configure table component for displaying the tracks
-    tableComponent.getHeader().addColumn("Track title", 1, 150);
-    tableComponent.getHeader().addColumn("Assign", 2, 200);
+    // Configure table component for displaying the tracks; every column but Assign sorts
+    tableComponent.getHeader().addColumn("Title", 1, 110);
+    tableComponent.getHeader().addColumn("Artist", 5, 80);
+    tableComponent.getHeader().addColumn("BPM", 3, 45);
+    tableComponent.getHeader().addColumn("Key", 4, 35);
+    tableComponent.getHeader().addColumn("Time", 6, 45);
+    tableComponent.getHeader().addColumn("Assign", 2, 100, 30, -1,
+        juce::TableHeaderComponent::defaultFlags & ~juce::TableHeaderComponent::sortable);
+    tableComponent.getHeader().setStretchToFitActive(true);
     tableComponent.setModel(this);
     addAndMakeVisible(tableComponent);
-    // Hide header for cleaner look
-    tableComponent.getHeader().setVisible(false);
 
     // For bottom buttons 
     addAndMakeVisible(bottomPlaceholder);
@@ -212,11 +181,19 @@ PlaylistComponent::PlaylistComponent(DJAudioPlayer* d1, DJAudioPlayer* d2,
     crossfaderLabel.setJustificationType(juce::Justification::centred);
     crossfaderLabel.setColour(juce::Label::textColourId, juce::Colours::white);
     addAndMakeVisible(crossfaderLabel);
+
+    // Tracks are analysed as their rows are first drawn; results fill in the BPM column
+    analyzer->addListener(this);
+    importer->addListener(this);
 }
 
 // Destructor to avoid dangling pointers
 PlaylistComponent::~PlaylistComponent()
 {
+    cancelPendingUpdate();
+    analyzer->removeListener(this);
+    importer->removeListener(this);
+
     volSlider1.setLookAndFeel(nullptr);
     speedSlider1.setLookAndFeel(nullptr);
     posSlider1.setLookAndFeel(nullptr);
@@ -250,6 +227,9 @@ void PlaylistComponent::resized()
     headerLabel.setBounds(headerArea.removeFromLeft(headerArea.getWidth() * 0.5));
     loadButton.setBounds(headerArea.reduced(5));
 
+    // Search box sits between the header and the table
+    searchBox.setBounds(topSection.removeFromTop(26).reduced(5, 2));
+
     // The table component occupies the remainder of the top section
     tableComponent.setBounds(topSection);
 
@@ -299,7 +279,7 @@ void PlaylistComponent::resized()
 // Returns the number of rows in the track list for the table
 int PlaylistComponent::getNumRows()
 {
-    return static_cast<int>(trackTitles.size());
+    return libraryIndex.getNumRows();
 }
 
 // Paints the background of each table row
@@ -308,25 +288,105 @@ void PlaylistComponent::paintRowBackground(juce::Graphics& g, int rowNumber, int
     g.fillAll(rowIsSelected ? juce::Colours::orange : juce::Colours::darkgrey);
 }
 
-// Paints the contents of a table cell; draws track titles
+// Paints the contents of a table cell; draws titles, artists, tempo, key and length from the
+// library, and the assign buttons. Text is shaped once per track and reused until the track
+// changes, so scrolling only draws glyphs
 void PlaylistComponent::paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected)
 {
-    if (columnId == 1)
-        g.drawText(trackTitles[rowNumber], 2, 0, width - 4, height, juce::Justification::centredLeft, true);
-}
+    const int track = libraryIndex.getTrack(rowNumber);
+    if (track < 0)
+        return;
 
-// Updates the component used for the "Assign" cell
-juce::Component* PlaylistComponent::refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, juce::Component* existingComponentToUpdate)
-{
-    if (columnId == 2)
+    const juce::Rectangle<int> textArea(2, 0, width - 4, height);
+
+    if (columnId == 1 || columnId == 5)
     {
-        // Creates a new TrackButtonsComponent if none exists
-        if (existingComponentToUpdate == nullptr)
-            existingComponentToUpdate = new TrackButtonsComponent(rowNumber, this);
-        else if (auto* comp = dynamic_cast<TrackButtonsComponent*>(existingComponentToUpdate))
-            comp->setRowId(rowNumber);  // Update the row ID if reusing an existing component.
+        rowText.draw(g, track, columnId, textArea, juce::Justification::centredLeft,
+            [&] { return columnId == 1 ? library->getTitle(track) : library->getArtist(track); });
+    }
+    // Length, known once the file has been probed or analysed
+    else if (columnId == 6)
+    {
+        rowText.draw(g, track, columnId, textArea, juce::Justification::centredRight, [&]
+        {
+            const int seconds = juce::roundToInt(library->getLengthSeconds(track));
+            return seconds > 0 ? juce::String(seconds / 60) + ":" + juce::String(seconds % 60).paddedLeft('0', 2) : juce::String("...");
+        });
+    }
+    // Tempo and key, or a placeholder until the analysis has finished
+    else if (columnId == 3 || columnId == 4)
+    {
+        rowText.draw(g, track, columnId, textArea, juce::Justification::centredRight, [&]
+        {
+            const auto state = library->getAnalysisState(track);
+            if (state == LibraryStore::AnalysisState::failed)
+                return juce::String("-");
+
+            if (state != LibraryStore::AnalysisState::analysed)
+            {
+                // Only rows that have been seen are analysed, so a large library costs
+                // nothing until it is scrolled through. The placeholder is shaped once;
+                // trackAnalysed drops it when the result arrives
+                tracksToAnalyse.push_back(track);
+                triggerAsyncUpdate();
+                return juce::String("...");
+            }
+
+            if (columnId == 3)
+                return library->getBpm(track) > 0.0f ? juce::String(library->getBpm(track), 1) : juce::String("-");
+
+            return library->getKey(track) >= 0 ? TrackAnalysis::getKeyName(library->getKey(track)) : juce::String("-");
+        });
     }
-    return existingComponentToUpdate;
+    // Two buttons painted in every row, rather than a pair of components per row;
+    // cellClicked works out which was hit
+    else if (columnId == 2)
+    {
+        const auto& lf = tableComponent.getLookAndFeel();
+        const juce::Rectangle<int> leftButton(0, 0, width / 2, height);
+        const juce::Rectangle<int> rightButton(width / 2, 0, width - width / 2, height);
+
+        g.setColour(lf.findColour(juce::TextButton::buttonColourId));
+        g.fillRoundedRectangle(leftButton.reduced(2).toFloat(), 3.0f);
+        g.fillRoundedRectangle(rightButton.reduced(2).toFloat(), 3.0f);
+
+        // The labels are the same in every row, so they are shaped once
+        g.setColour(lf.findColour(juce::TextButton::textColourOffId));
+        rowText.draw(g, -1, columnId, leftButton, juce::Justification::centred, [] { return juce::String("Left"); });
+        rowText.draw(g, -2, columnId, rightButton, juce::Justification::centred, [] { return juce::String("Right"); });
+    }
+}
+
+// Loads a row's track onto the left or right deck from its painted assign buttons
+void PlaylistComponent::cellClicked(int rowNumber, int columnId, const juce::MouseEvent& e)
+{
+    if (columnId != 2)
+        return;
+
+    const auto cell = tableComponent.getCellPosition(columnId, rowNumber, true);
+    const auto position = e.getEventRelativeTo(&tableComponent).getPosition();
+    if (cell.contains(position))
+        assignTrackToDeck(rowNumber, position.x < cell.getCentreX());
+}
+
+// Re-sorts the rows by the clicked column; the column sorted before it breaks ties
+void PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
+{
+    if (newSortColumnId == 1)
+        libraryIndex.sortBy(LibraryIndex::Field::title, isForwards);
+    else if (newSortColumnId == 5)
+        libraryIndex.sortBy(LibraryIndex::Field::artist, isForwards);
+    else if (newSortColumnId == 3)
+        libraryIndex.sortBy(LibraryIndex::Field::bpm, isForwards);
+    else if (newSortColumnId == 4)
+        libraryIndex.sortBy(LibraryIndex::Field::key, isForwards);
+    else if (newSortColumnId == 6)
+        libraryIndex.sortBy(LibraryIndex::Field::length, isForwards);
+    else
+        return;
+
+    tableComponent.updateContent();
+    tableComponent.repaint();
 }
 
 // Handles button click event for load and bottom button
@@ -335,148 +395,47 @@ void PlaylistComponent::buttonClicked(juce::Button* button)
     // If the load button is clicked, open a file chooser
     if (button == &loadButton)
     {
-        auto* chooser = new juce::FileChooser("Select an audio file...",
+        auto* chooser = new juce::FileChooser("Select audio files or folders...",
             juce::File::getSpecialLocation(juce::File::userMusicDirectory),
             "*.wav;*.mp3;*.aiff");
-        chooser->launchAsync(juce::FileBrowserComponent::openMode,
+        chooser->launchAsync(juce::FileBrowserComponent::openMode
+                | juce::FileBrowserComponent::canSelectFiles
+                | juce::FileBrowserComponent::canSelectDirectories
+                | juce::FileBrowserComponent::canSelectMultipleItems,
             [this, chooser](const juce::FileChooser& fc)
             {
+                const auto results = fc.getResults();
                 juce::File audioFile = fc.getResult();
-                if (audioFile.existsAsFile())
+                if (results.size() == 1 && audioFile.existsAsFile())
                 {
                     // Load selected file to left deck and add it to the track list
                     leftDeckGUI->loadFile(audioFile);
-                    trackTitles.push_back(audioFile.getFileName().toStdString());
-                    trackFiles.push_back(audioFile);
-                    tableComponent.updateContent();
+                    addTrack(LibraryStore::describeFile(audioFile));
+                    analyzer->analyse(audioFile);
+                }
+                // Several files or a folder are crawled into the library in the background
+                else if (!results.isEmpty())
+                {
+                    importer->import(results);
                 }
                 delete chooser;
             });
     }
-    // For bottom buttons, load and play corresponding sounds from assets folder
-    else if (button == &bottomButton1)
-    {
-        // Determine the file path for bottom buttons
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Drum 1.wav");
-
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
-        {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
-        }
-    }
-    else if (button == &bottomButton2)
-    {
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Vocal Sample 1.mp3");
-
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
-        {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
-        }
-    }
-    else if (button == &bottomButton3)
-    {
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Siren.mp3");
-
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
-        {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
-        }
-    }
-    else if (button == &bottomButton4)
+    else
     {
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Drum 4.wav");
-
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
+        // For bottom buttons, trigger the matching sampler pad
+        for (auto& slot : padSlots)
         {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
-        }
-    }
-    else if (button == &bottomButton5)
-    {
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Glasses Up.mp3");
+            if (slot.button != button)
+                continue;
 
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
-        {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
+            if (slot.padIndex >= 0)
+                sampler->trigger(slot.padIndex);
+            else
+                std::cout << "Sound file not found!" << std::endl;
+            return;
         }
-    }
-    else if (button == &bottomButton6)
-    {
-        juce::File sourceDir(String(__FILE__));
-        sourceDir = sourceDir.getParentDirectory();
-        juce::File assetsDir = sourceDir.getChildFile("assets");
-        juce::File soundFile = assetsDir.getChildFile("Airhorn.mp3");
 
-        DBG("Sound file path: " << soundFile.getFullPathName());
-        if (soundFile.existsAsFile())
-        {
-            drumPlayer->loadURL(juce::URL(soundFile));
-            drumPlayer->setGain(1.0);
-            drumPlayer->start();
-        }
-        else
-        {
-            DBG("Sound file not found at: " << soundFile.getFullPathName());
-            std::cout << "Sound file not found!" << std::endl;
-        }
-    }
-    else
-    {
         std::cout << "Other button clicked." << std::endl;
     }
 }
@@ -498,6 +457,111 @@ void PlaylistComponent::sliderValueChanged(juce::Slider* slider)
         deck2->setVocalMix(slider->getValue());
 }
 
+// Stores a listed track's analysis in the library and repaints the track list
+void PlaylistComponent::trackAnalysed(const juce::File& file, const TrackAnalysis& analysis)
+{
+    const int track = library->findTrack(file);
+    if (track >= 0)
+    {
+        library->setAnalysis(track, analysis);
+        libraryIndex.trackChanged(track);
+        rowText.forgetRow(track);
+        tableComponent.repaint();
+    }
+}
+
+// Analyses a track, or applies the result the analyser already holds for its file
+void PlaylistComponent::requestAnalysis(int track)
+{
+    const auto file = library->getFile(track);
+    TrackAnalysis analysis;
+
+    if (!file.existsAsFile())
+    {
+        library->setAnalysisFailed(track);
+        libraryIndex.trackChanged(track);
+        rowText.forgetRow(track);
+        tableComponent.repaint();
+    }
+    // A file analysed on a deck before it was imported won't be announced again
+    else if (analyzer->getAnalysis(file, analysis))
+    {
+        trackAnalysed(file, analysis);
+    }
+    else
+    {
+        analyzer->analyse(file);
+    }
+}
+
+// Requests analysis of the rows queued while painting, once each
+void PlaylistComponent::handleAsyncUpdate()
+{
+    auto tracks = std::move(tracksToAnalyse);
+    tracksToAnalyse.clear();
+
+    for (const int track : tracks)
+        if (juce::isPositiveAndBelow(track, library->getNumTracks())
+            && library->getAnalysisState(track) == LibraryStore::AnalysisState::pending)
+            requestAnalysis(track);
+}
+
+// Lists tracks the importer has added, and re-reads the ones it has updated
+void PlaylistComponent::tracksImported(int firstNewTrack, const std::vector<int>& updatedTracks)
+{
+    libraryIndex.tracksAdded(firstNewTrack, library->getNumTracks() - firstNewTrack);
+
+    // A changed file needs analysing again, and its title may have changed
+    for (const int track : updatedTracks)
+    {
+        analyzer->forget(library->getFile(track));
+        rowText.forgetRow(track);
+    }
+
+    libraryIndex.tracksUpdated(updatedTracks);
+
+    tableComponent.updateContent();
+    tableComponent.repaint();
+}
+
+// Accepts any drag of files or folders onto the track list
+bool PlaylistComponent::isInterestedInFileDrag(const juce::StringArray& files)
+{
+    return !files.isEmpty();
+}
+
+// Imports every dropped file and folder
+void PlaylistComponent::filesDropped(const juce::StringArray& files, int x, int y)
+{
+    juce::Array<juce::File> filesToImport;
+    for (const auto& path : files)
+        filesToImport.add(juce::File(path));
+
+    importer->import(filesToImport);
+}
+
+// Adds a track to the library, and to the list if it wasn't there already
+int PlaylistComponent::addTrack(const LibraryStore::Track& track)
+{
+    const int numTracks = library->getNumTracks();
+    const int row = library->addTrack(track);
+    if (row == numTracks)
+    {
+        libraryIndex.tracksAdded(row, 1);
+        tableComponent.updateContent();
+    }
+
+    return row;
+}
+
+// Filters the list to the search box text; rows keep their shaped text, as it is cached by track
+void PlaylistComponent::updateSearch()
+{
+    libraryIndex.setSearch(searchBox.getText());
+    tableComponent.updateContent();
+    tableComponent.repaint();
+}
+
 // Updates gain of each deck based on slider positions
 void PlaylistComponent::updateGains()
 {
@@ -509,29 +573,47 @@ void PlaylistComponent::updateGains()
     deck2->setGain(rightVol * crossVal);
 }
 
+// Decodes each bottom button's sample from the assets folder into the sampler
+void PlaylistComponent::loadPadSamples()
+{
+    juce::File sourceDir(String(__FILE__));
+    juce::File assetsDir = sourceDir.getParentDirectory().getChildFile("assets");
+
+    for (auto& slot : padSlots)
+    {
+        juce::File soundFile = assetsDir.getChildFile(slot.fileName);
+        if (soundFile.existsAsFile())
+            slot.padIndex = sampler->addPad(soundFile, 1.0f, slot.chokeGroup);
+        else
+            DBG("Sound file not found at: " << soundFile.getFullPathName());
+    }
+}
+
 // Assigns a track from the track list to the left or right deck
 void PlaylistComponent::assignTrackToDeck(int row, bool assignLeft)
 {
-    // Validate that the row index is within the available track list
-    if (row >= 0 && row < static_cast<int>(trackFiles.size()))
+    // Validate that the row shows a track from the library
+    const int track = libraryIndex.getTrack(row);
+    if (track >= 0)
     {
-        juce::File file = trackFiles[row];
+        juce::File file = library->getFile(track);
+        const auto title = library->getTitle(track).toStdString();
         if (file.existsAsFile())
         {
             if (assignLeft)
             {
                 leftDeckGUI->loadFile(file);
-                std::cout << "Assigned track " << trackTitles[row] << " to left deck." << std::endl;
+                std::cout << "Assigned track " << title << " to left deck." << std::endl;
             }
             else
             {
                 rightDeckGUI->loadFile(file);
-                std::cout << "Assigned track " << trackTitles[row] << " to right deck." << std::endl;
+                std::cout << "Assigned track " << title << " to right deck." << std::endl;
             }
         }
         else
         {
-            std::cout << "No valid file for track " << trackTitles[row] << std::endl;
+            std::cout << "No valid file for track " << title << std::endl;
         }
     }
 }
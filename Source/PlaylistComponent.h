@@ -5,6 +5,13 @@
 #include <string>
 #include "DJAudioPlayer.h"
 #include "DeckGUI.h"
+#include "SamplerEngine.h"
+#include "TrackAnalyzer.h"
+#include "LibraryImporter.h"
+#include "LibraryIndex.h"
+#include "LibraryStore.h"
+#include "RowTextCache.h"
+#include <array>
 #include <cmath> // For std::cos and std::sin
 
 // CustomButton with original design.
@@ -93,13 +100,20 @@ public:
 class PlaylistComponent : public juce::Component,
     public juce::TableListBoxModel,
     public juce::Button::Listener,
-    public juce::Slider::Listener
+    public juce::Slider::Listener,
+    public juce::FileDragAndDropTarget,
+    public TrackAnalyzer::Listener,
+    public LibraryImporter::Listener,
+    private juce::AsyncUpdater
 {
 public:
-    // Constructs a PlaylistComponent with pointers to the players and deck GUIs.
+    // Constructs a PlaylistComponent with pointers to the players, deck GUIs, sample pads,
+    // the analyser that fills in each track's tempo and key, the library it lists and the
+    // importer that adds folders to it.
     PlaylistComponent(DJAudioPlayer* deck1, DJAudioPlayer* deck2,
         DeckGUI* leftGUI, DeckGUI* rightGUI,
-        DJAudioPlayer* drumPlayer);
+        SamplerEngine* sampler, TrackAnalyzer* analyzer,
+        LibraryStore* library, LibraryImporter* importer);
     // Destructor.
     ~PlaylistComponent() override;
 
@@ -114,41 +128,35 @@ public:
     void paintRowBackground(juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override;
     // Paints a cell in the table.
     void paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
-    // Provides or refreshes a component for a cell.
-    juce::Component* refreshComponentForCell(int rowNumber, int columnId, bool isRowSelected, juce::Component* existingComponentToUpdate) override;
+    // Loads the track onto a deck when one of a row's painted assign buttons is clicked.
+    void cellClicked(int rowNumber, int columnId, const juce::MouseEvent& e) override;
+    // Re-sorts the rows when a column header is clicked.
+    void sortOrderChanged(int newSortColumnId, bool isForwards) override;
 
     // Handles button click events.
     void buttonClicked(juce::Button* button) override;
     // Handles slider value changes.
     void sliderValueChanged(juce::Slider* slider) override;
+    // Stores a track's tempo and key in the library once its analysis has finished.
+    void trackAnalysed(const juce::File& file, const TrackAnalysis& analysis) override;
+    // Shows tracks as the importer adds them to the library.
+    void tracksImported(int firstNewTrack, const std::vector<int>& updatedTracks) override;
+
+    // Accepts dragged files and folders.
+    bool isInterestedInFileDrag(const juce::StringArray& files) override;
+    // Imports dropped files and folders into the library.
+    void filesDropped(const juce::StringArray& files, int x, int y) override;
 
     // Assigns the track from the given row to a deck (left if assignLeft is true).
     void assignTrackToDeck(int row, bool assignLeft);
 
-    // Inner class for track assignment buttons.
-    class TrackButtonsComponent : public juce::Component,
-        public juce::Button::Listener
-    {
-    public:
-        // Constructs TrackButtonsComponent for the specified row and parent component.
-        TrackButtonsComponent(int row, PlaylistComponent* parentComp);
-        // Lays out the button components.
-        void resized() override;
-        // Updates the row ID for this component.
-        void setRowId(int row);
-        // Handles button click events.
-        void buttonClicked(juce::Button* button) override;
-    private:
-        int rowId;
-        juce::TextButton leftButton{ "Left" };
-        juce::TextButton rightButton{ "Right" };
-        PlaylistComponent* parent = nullptr;
-    };
+    // Decodes the pad samples from the assets folder into the sampler. Call once the
+    // audio formats are registered.
+    void loadPadSamples();
 
 private:
     juce::TableListBox tableComponent;
-    std::vector<std::string> trackTitles;
-    std::vector<juce::File> trackFiles;
+    juce::TextEditor searchBox;
 
     juce::Label headerLabel;
     juce::TextButton loadButton{ "Load" };
@@ -192,14 +200,44 @@ private:
     CustomButton bottomButton5{ "Glasses Up" };
     CustomButton bottomButton6{ "Airhorn" };
 
+    // Sample file, choke group and sampler pad for each bottom button
+    struct PadSlot
+    {
+        CustomButton* button;
+        const char* fileName;
+        int chokeGroup;
+        int padIndex;
+    };
+    std::array<PadSlot, 6> padSlots;
+
     DJAudioPlayer* deck1;
     DJAudioPlayer* deck2;
     DeckGUI* leftDeckGUI;
     DeckGUI* rightDeckGUI;
-    DJAudioPlayer* drumPlayer; // Dedicated drum player
+    SamplerEngine* sampler; // Plays the bottom button samples
+    TrackAnalyzer* analyzer; // Finds the tempo and key of listed tracks
+    LibraryStore* library; // Every track listed, kept between runs
+    LibraryIndex libraryIndex; // Search and sort order of the listed tracks
+    LibraryImporter* importer; // Crawls folders into the library
+    RowTextCache rowText{ 256 }; // Shaped cell text of the rows drawn lately, by track
+    std::vector<int> tracksToAnalyse; // Pending rows seen by the last paint
 
     // Updates the gain values based on slider positions
     void updateGains();
 
+    // Adds a track to the library and the list, returning its library row
+    int addTrack(const LibraryStore::Track& track);
+
+    // Shows the rows matching the search box
+    void updateSearch();
+
+    // Fills in a pending track's analysis: straight away if the analyser already has it,
+    // otherwise once it has been analysed. A missing file is marked as failed
+    void requestAnalysis(int track);
+
+    // Requests analysis of the pending rows the last paint drew. Answers can change the
+    // library and the row order, so they never arrive during a paint
+    void handleAsyncUpdate() override;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlaylistComponent)
 };
@@ -0,0 +1,189 @@
+#include "ReadAheadBuffer.h"
+
+ReadAheadBuffer::ReadAheadBuffer(std::unique_ptr<PositionableAudioSource> sourceToUse,
+    TimeSliceThread& threadToUse,
+    int bufferSizeSamples,
+    Counters* countersToUse)
+    : source(std::move(sourceToUse)),
+    thread(threadToUse),
+    bufferSize(jmax(4 * chunkSize, bufferSizeSamples)),
+    keepBehind(bufferSize / 4),
+    totalLength(source->getTotalLength()),
+    counters(countersToUse),
+    ring(2, bufferSize)
+{
+    ring.clear();
+    thread.addTimeSliceClient(this);
+}
+
+ReadAheadBuffer::~ReadAheadBuffer()
+{
+    thread.removeTimeSliceClient(this);
+}
+
+uint64 ReadAheadBuffer::pack(uint32 gen, int64 position) noexcept
+{
+    // 24 bits of generation, 40 bits of position (about 290 days at 44.1 kHz)
+    return (static_cast<uint64>(gen & 0xffffffu) << 40) | (static_cast<uint64>(position) & 0xffffffffffull);
+}
+
+uint32 ReadAheadBuffer::generationOf(uint64 packed) noexcept
+{
+    return static_cast<uint32>(packed >> 40);
+}
+
+int64 ReadAheadBuffer::positionOf(uint64 packed) noexcept
+{
+    return static_cast<int64>(packed & 0xffffffffffull);
+}
+
+Range<int64> ReadAheadBuffer::getValidRange() const noexcept
+{
+    const auto gen = generation.load(std::memory_order_acquire) & 0xffffffu;
+    const auto end = fillEnd.load(std::memory_order_acquire);
+    const auto start = fillStart.load(std::memory_order_acquire);
+
+    if (generationOf(end) != gen || generationOf(start) != gen)
+        return {};
+
+    // Anything a full ring behind the fill (plus the chunk in flight), or further behind the
+    // read position than keepBehind, may already have been overwritten
+    const auto lowest = jmax(positionOf(start),
+        positionOf(end) + chunkSize - bufferSize,
+        readPosition.load(std::memory_order_relaxed) - keepBehind);
+    return { jmin(lowest, positionOf(end)), positionOf(end) };
+}
+
+bool ReadAheadBuffer::waitForData(int numSamples, int timeoutMs) const
+{
+    const auto deadline = Time::getMillisecondCounter() + static_cast<uint32>(timeoutMs);
+    const auto wanted = jmin(static_cast<int64>(numSamples), totalLength - readPosition.load());
+
+    while (getNumBufferedSamples() < wanted)
+    {
+        if (Time::getMillisecondCounter() >= deadline)
+            return false;
+
+        Thread::sleep(2);
+    }
+
+    return true;
+}
+
+int ReadAheadBuffer::getNumBufferedSamples() const noexcept
+{
+    const auto range = getValidRange();
+    const auto position = readPosition.load(std::memory_order_relaxed);
+    return range.contains(position) ? static_cast<int>(range.getEnd() - position) : 0;
+}
+
+void ReadAheadBuffer::prepareToPlay(int, double)
+{
+}
+
+void ReadAheadBuffer::releaseResources()
+{
+}
+
+void ReadAheadBuffer::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    const auto position = readPosition.load(std::memory_order_relaxed);
+    const auto range = getValidRange();
+    const int numSamples = bufferToFill.numSamples;
+
+    // Copy whatever part of the block is buffered
+    int available = 0;
+    if (range.contains(position))
+        available = static_cast<int>(jmin(static_cast<int64>(numSamples), range.getEnd() - position));
+
+    const int numChannels = jmin(bufferToFill.buffer->getNumChannels(), ring.getNumChannels());
+    const int ringIndex = static_cast<int>(position % bufferSize);
+    const int firstPart = jmin(available, bufferSize - ringIndex);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        bufferToFill.buffer->copyFrom(ch, bufferToFill.startSample, ring, ch, ringIndex, firstPart);
+        if (available > firstPart)
+            bufferToFill.buffer->copyFrom(ch, bufferToFill.startSample + firstPart, ring, ch, 0, available - firstPart);
+    }
+
+    for (int ch = numChannels; ch < bufferToFill.buffer->getNumChannels(); ++ch)
+        bufferToFill.buffer->clear(ch, bufferToFill.startSample, available);
+
+    // The rest is an underrun, unless it lies past the end of the track
+    if (available < numSamples)
+    {
+        bufferToFill.buffer->clear(bufferToFill.startSample + available, numSamples - available);
+
+        const auto missing = jmin(static_cast<int64>(numSamples - available), totalLength - (position + available));
+        if (missing > 0 && counters != nullptr)
+        {
+            counters->underruns.fetch_add(1, std::memory_order_relaxed);
+            counters->samplesMissed.fetch_add(missing, std::memory_order_relaxed);
+        }
+    }
+
+    readPosition.store(position + numSamples, std::memory_order_release);
+}
+
+void ReadAheadBuffer::setNextReadPosition(int64 newPosition)
+{
+    const auto range = getValidRange();
+    readPosition.store(newPosition, std::memory_order_release);
+
+    // Seeks inside the buffered window keep the data; anything else refills
+    if (!range.contains(newPosition))
+        generation.fetch_add(1, std::memory_order_release);
+}
+
+int64 ReadAheadBuffer::getNextReadPosition() const
+{
+    return readPosition.load(std::memory_order_relaxed);
+}
+
+int64 ReadAheadBuffer::getTotalLength() const
+{
+    return totalLength;
+}
+
+bool ReadAheadBuffer::isLooping() const
+{
+    return false;
+}
+
+int ReadAheadBuffer::useTimeSlice()
+{
+    const auto gen = generation.load(std::memory_order_acquire) & 0xffffffu;
+    const auto playhead = readPosition.load(std::memory_order_acquire);
+
+    // Restart the fill after a seek, or when an underrun let the playhead overtake it.
+    // The start is published before the end, and read in the opposite order
+    if (gen != producerGeneration || producerEnd < playhead)
+    {
+        producerGeneration = gen;
+        producerEnd = playhead;
+        source->setNextReadPosition(producerEnd);
+        fillStart.store(pack(gen, producerEnd), std::memory_order_release);
+        fillEnd.store(pack(gen, producerEnd), std::memory_order_release);
+    }
+
+    // Never overwrite anything the audio thread might still read
+    const auto limit = jmin(playhead + bufferSize - keepBehind, totalLength);
+    const auto toRead = static_cast<int>(jmin(static_cast<int64>(chunkSize), limit - producerEnd));
+
+    if (toRead <= 0)
+        return 20;
+
+    const int ringIndex = static_cast<int>(producerEnd % bufferSize);
+    const int firstPart = jmin(toRead, bufferSize - ringIndex);
+
+    source->getNextAudioBlock(AudioSourceChannelInfo(&ring, ringIndex, firstPart));
+    if (toRead > firstPart)
+        source->getNextAudioBlock(AudioSourceChannelInfo(&ring, 0, toRead - firstPart));
+
+    producerEnd += toRead;
+    fillEnd.store(pack(gen, producerEnd), std::memory_order_release);
+
+    // Keep going straight away while there is room
+    return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+// ReadAheadBuffer decodes a source ahead of the playhead on a shared I/O thread.
+// The audio thread only copies from a ring buffer. Seeks that land inside the buffered
+// window are served straight away; other seeks start a refill from the new position.
+// When the ring runs dry the missing samples are played as silence and counted.
+//
+// The I/O thread is the only one touching the wrapped source. Ranges it publishes are
+// tagged with the seek generation they belong to, so no locks are shared with the
+// audio thread.
+class ReadAheadBuffer : public PositionableAudioSource,
+    private TimeSliceClient
+{
+public:
+    // Underrun counters, usually shared by every track a deck plays
+    struct Counters
+    {
+        std::atomic<int64> underruns{ 0 };
+        std::atomic<int64> samplesMissed{ 0 };
+    };
+
+    // Wraps source and starts filling from position 0 on the given thread.
+    // counters may be nullptr
+    ReadAheadBuffer(std::unique_ptr<PositionableAudioSource> source,
+        TimeSliceThread& thread,
+        int bufferSizeSamples,
+        Counters* counters);
+
+    // Destructor. Unregisters from the I/O thread
+    ~ReadAheadBuffer() override;
+
+    // Blocks until at least numSamples are buffered or the timeout passes. Not for the audio thread
+    bool waitForData(int numSamples, int timeoutMs) const;
+
+    // Returns how many samples are buffered ahead of the read position
+    int getNumBufferedSamples() const noexcept;
+
+    // Returns the ring size in samples
+    int getBufferSize() const noexcept { return bufferSize; }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(int64 newPosition) override;
+    int64 getNextReadPosition() const override;
+    int64 getTotalLength() const override;
+    bool isLooping() const override;
+
+private:
+    // Fills the ring ahead of the read position. Runs on the I/O thread
+    int useTimeSlice() override;
+
+    // Packs a generation tag and a sample position into one atomic word
+    static uint64 pack(uint32 generation, int64 position) noexcept;
+    static uint32 generationOf(uint64 packed) noexcept;
+    static int64 positionOf(uint64 packed) noexcept;
+
+    // Returns the buffered range for the current generation, or an empty range
+    Range<int64> getValidRange() const noexcept;
+
+    std::unique_ptr<PositionableAudioSource> source;
+    TimeSliceThread& thread;
+    const int bufferSize;
+    const int keepBehind;
+    const int64 totalLength;
+    Counters* counters;
+
+    AudioBuffer<float> ring;
+
+    // Written by the audio thread
+    std::atomic<int64> readPosition{ 0 };
+    std::atomic<uint32> generation{ 0 };
+
+    // Written by the I/O thread, tagged with the generation they were filled for
+    std::atomic<uint64> fillStart{ 0 };
+    std::atomic<uint64> fillEnd{ 0 };
+
+    // I/O thread state
+    uint32 producerGeneration = ~0u;
+    int64 producerEnd = 0;
+
+    static constexpr int chunkSize = 8192;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReadAheadBuffer)
+};
@@ -0,0 +1,100 @@
+#include "RowTextCache.h"
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+RowTextCache::RowTextCache(size_t maxRowsToKeep)
+    : maxRows(jmax<size_t>(1, maxRowsToKeep))
+{
+    rows.reserve(maxRows + 1);
+}
+
+//------------------------------------------------------------------------------
+const GlyphArrangement* RowTextCache::find(const Font& currentFont, int row, int column,
+    Rectangle<int> area, Justification justification)
+{
+    // Glyphs shaped with another font are no use
+    if (currentFont != font)
+    {
+        clear();
+        font = currentFont;
+        return nullptr;
+    }
+
+    auto found = rows.find(row);
+    if (found == rows.end())
+        return nullptr;
+
+    // The row is drawn again, so it goes to the front
+    auto& cached = found->second;
+    drawOrder.splice(drawOrder.begin(), drawOrder, cached.lastDrawn);
+
+    for (auto& cell : cached.cells)
+    {
+        if (cell.column == column)
+        {
+            if (cell.area == area && cell.justification == justification)
+                return &cell.glyphs;
+
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+const GlyphArrangement& RowTextCache::add(int row, int column, Rectangle<int> area,
+    Justification justification, const String& text)
+{
+    auto found = rows.find(row);
+    if (found == rows.end())
+    {
+        // Make room by dropping the row drawn longest ago
+        if (rows.size() >= maxRows)
+        {
+            rows.erase(drawOrder.back());
+            drawOrder.pop_back();
+        }
+
+        drawOrder.push_front(row);
+        found = rows.emplace(row, Row{ {}, drawOrder.begin() }).first;
+    }
+
+    auto& cells = found->second.cells;
+    auto cell = std::find_if(cells.begin(), cells.end(),
+        [column](const Cell& c) { return c.column == column; });
+
+    if (cell == cells.end())
+        cell = cells.insert(cells.end(), Cell{ column, area, justification, {} });
+
+    cell->area = area;
+    cell->justification = justification;
+
+    // The same layout Graphics::drawText does, with an ellipsis where the text is cut
+    cell->glyphs.clear();
+    cell->glyphs.addCurtailedLineOfText(font, text, 0.0f, 0.0f, static_cast<float>(area.getWidth()), true);
+    cell->glyphs.justifyGlyphs(0, cell->glyphs.getNumGlyphs(),
+        static_cast<float>(area.getX()), static_cast<float>(area.getY()),
+        static_cast<float>(area.getWidth()), static_cast<float>(area.getHeight()),
+        justification);
+
+    return cell->glyphs;
+}
+
+//------------------------------------------------------------------------------
+void RowTextCache::forgetRow(int row)
+{
+    auto found = rows.find(row);
+    if (found == rows.end())
+        return;
+
+    drawOrder.erase(found->second.lastDrawn);
+    rows.erase(found);
+}
+
+//------------------------------------------------------------------------------
+void RowTextCache::clear()
+{
+    rows.clear();
+    drawOrder.clear();
+}
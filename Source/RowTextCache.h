@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// RowTextCache keeps the text of recently painted table rows shaped into glyphs, so a row
+// that is repainted or scrolled back into view draws its glyphs straight away instead of
+// reading its text from the library and laying it out again. Each row holds its cells by
+// column; a cell is shaped again only if its size, justification or font changes, and
+// the rows drawn least recently are dropped once the cache is full. Message thread only
+class RowTextCache
+{
+public:
+    // Constructs RowTextCache holding up to maxRows rows
+    explicit RowTextCache(size_t maxRows);
+
+    // Draws a cell's text into area with the current font and colour, as Graphics::drawText
+    // would. getText is only called when the cell has to be shaped. Negative rows can hold
+    // text that every row shares
+    template <typename GetText>
+    void draw(Graphics& g, int row, int column, Rectangle<int> area,
+        Justification justification, GetText&& getText)
+    {
+        if (auto* glyphs = find(g.getCurrentFont(), row, column, area, justification))
+            glyphs->draw(g);
+        else
+            add(row, column, area, justification, getText()).draw(g);
+    }
+
+    // Drops a row's cells, so they are shaped again from fresh text
+    void forgetRow(int row);
+
+    // Drops every row
+    void clear();
+
+private:
+    // One column of a row, shaped to fit its area
+    struct Cell
+    {
+        int column;
+        Rectangle<int> area;
+        Justification justification;
+        GlyphArrangement glyphs;
+    };
+
+    // Cells of a row, and its place in the drawing order
+    struct Row
+    {
+        std::vector<Cell> cells;
+        std::list<int>::iterator lastDrawn;
+    };
+
+    // Returns a cell's glyphs if they were shaped for this font, area and justification
+    const GlyphArrangement* find(const Font& font, int row, int column,
+        Rectangle<int> area, Justification justification);
+
+    // Shapes a cell's text and keeps it, returning the glyphs
+    const GlyphArrangement& add(int row, int column, Rectangle<int> area,
+        Justification justification, const String& text);
+
+    const size_t maxRows;
+    Font font;
+
+    std::unordered_map<int, Row> rows;
+
+    // Rows with the most recently drawn first
+    std::list<int> drawOrder;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RowTextCache)
+};
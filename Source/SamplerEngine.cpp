@@ -0,0 +1,292 @@
+#include "SamplerEngine.h"
+
+SamplerEngine::SamplerEngine(AudioFormatManager& formatManagerToUse, int maxVoices)
+    : formatManager(formatManagerToUse),
+    voices(static_cast<size_t>(jmax(1, maxVoices))),
+    tails(voices.size()),
+    polyphony(jmax(1, maxVoices))
+{
+}
+
+SamplerEngine::~SamplerEngine()
+{
+}
+
+int SamplerEngine::addPad(const File& file, float gain, int chokeGroup)
+{
+    const int index = numPads.load();
+    if (index >= maxPads)
+        return -1;
+
+    std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr
+        || reader->lengthInSamples <= 0
+        || reader->lengthInSamples > static_cast<int64>(maxPadSeconds * reader->sampleRate))
+    {
+        std::cout << "Pad sample could not be loaded: " << file.getFullPathName() << std::endl;
+        return -1;
+    }
+
+    // Mono files are spread over both channels
+    auto pad = std::make_unique<Pad>();
+    const int numSamples = static_cast<int>(reader->lengthInSamples);
+    pad->audio.setSize(2, numSamples);
+    reader->read(&pad->audio, 0, numSamples, 0, true, true);
+    pad->sampleRate = reader->sampleRate;
+    pad->gain = jlimit(0.0f, 1.0f, gain);
+    pad->chokeGroup = chokeGroup;
+
+    // The pad is complete before the audio thread can see it
+    pads[static_cast<size_t>(index)] = std::move(pad);
+    numPads.store(index + 1, std::memory_order_release);
+
+    return index;
+}
+
+int SamplerEngine::getNumPads() const noexcept
+{
+    return numPads.load();
+}
+
+void SamplerEngine::setPadGain(int padIndex, float gain) noexcept
+{
+    if (isPositiveAndBelow(padIndex, getNumPads()))
+        pads[static_cast<size_t>(padIndex)]->gain = jlimit(0.0f, 1.0f, gain);
+}
+
+float SamplerEngine::getPadGain(int padIndex) const noexcept
+{
+    if (isPositiveAndBelow(padIndex, getNumPads()))
+        return pads[static_cast<size_t>(padIndex)]->gain.load();
+
+    return 0.0f;
+}
+
+void SamplerEngine::setPadChokeGroup(int padIndex, int chokeGroup) noexcept
+{
+    if (isPositiveAndBelow(padIndex, getNumPads()))
+        pads[static_cast<size_t>(padIndex)]->chokeGroup = chokeGroup;
+}
+
+void SamplerEngine::setPolyphony(int numVoices) noexcept
+{
+    polyphony = jlimit(1, static_cast<int>(voices.size()), numVoices);
+}
+
+int SamplerEngine::getPolyphony() const noexcept
+{
+    return polyphony.load();
+}
+
+void SamplerEngine::trigger(int padIndex, float velocity)
+{
+    if (!isPositiveAndBelow(padIndex, getNumPads()))
+        return;
+
+    // A full queue means the audio thread is not running; the hit is dropped
+    const auto scope = triggerFifo.write(1);
+    const Trigger hit{ padIndex, jlimit(0.0f, 1.0f, velocity) };
+
+    if (scope.blockSize1 > 0)
+        triggers[static_cast<size_t>(scope.startIndex1)] = hit;
+    else if (scope.blockSize2 > 0)
+        triggers[static_cast<size_t>(scope.startIndex2)] = hit;
+}
+
+void SamplerEngine::stopAll() noexcept
+{
+    stopRequested = true;
+}
+
+int SamplerEngine::getNumActiveVoices() const noexcept
+{
+    return activeVoices.load();
+}
+
+void SamplerEngine::prepareToPlay(int, double sampleRate)
+{
+    deviceSampleRate = sampleRate;
+    fadeSamples = jmax(1, roundToInt(fadeSeconds * sampleRate));
+
+    for (auto& voice : voices)
+        voice = Voice();
+
+    for (auto& tail : tails)
+        tail = Voice();
+}
+
+void SamplerEngine::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    bufferToFill.clearActiveBufferRegion();
+    if (bufferToFill.buffer == nullptr || bufferToFill.buffer->getNumChannels() == 0)
+        return;
+
+    if (stopRequested.exchange(false))
+        for (auto& voice : voices)
+            releaseVoice(voice);
+
+    // Voices above a lowered polyphony fade out
+    const int limit = polyphony.load();
+    for (size_t i = static_cast<size_t>(limit); i < voices.size(); ++i)
+        releaseVoice(voices[i]);
+
+    const auto scope = triggerFifo.read(triggerFifo.getNumReady());
+    for (int i = 0; i < scope.blockSize1; ++i)
+        startVoice(triggers[static_cast<size_t>(scope.startIndex1 + i)], bufferToFill);
+    for (int i = 0; i < scope.blockSize2; ++i)
+        startVoice(triggers[static_cast<size_t>(scope.startIndex2 + i)], bufferToFill);
+
+    int active = 0;
+    bool rendered = false;
+    for (auto& voice : voices)
+    {
+        if (voice.pad == nullptr)
+            continue;
+
+        renderVoice(voice, bufferToFill, bufferToFill.numSamples);
+        rendered = true;
+        if (voice.pad != nullptr)
+            ++active;
+    }
+
+    for (auto& tail : tails)
+    {
+        if (tail.pad == nullptr)
+            continue;
+
+        renderVoice(tail, bufferToFill, bufferToFill.numSamples);
+        rendered = true;
+    }
+
+    activeVoices = active;
+    outputSilent.store(!rendered, std::memory_order_relaxed);
+}
+
+void SamplerEngine::releaseResources()
+{
+}
+
+void SamplerEngine::startVoice(const Trigger& hit, const AudioSourceChannelInfo& bufferToFill) noexcept
+{
+    if (!isPositiveAndBelow(hit.padIndex, numPads.load(std::memory_order_acquire)))
+        return;
+
+    const Pad* pad = pads[static_cast<size_t>(hit.padIndex)].get();
+
+    // Cut off anything else in the same choke group
+    const int group = pad->chokeGroup.load();
+    if (group != 0)
+        for (auto& voice : voices)
+            if (voice.pad != nullptr && voice.pad->chokeGroup.load() == group)
+                releaseVoice(voice);
+
+    // Take a free voice, or steal the oldest one
+    const int limit = polyphony.load();
+    Voice* target = nullptr;
+    for (int i = 0; i < limit; ++i)
+    {
+        auto& voice = voices[static_cast<size_t>(i)];
+        if (voice.pad == nullptr)
+        {
+            target = &voice;
+            break;
+        }
+
+        if (target == nullptr || voice.startOrder - target->startOrder > 0x80000000u)
+            target = &voice;
+    }
+
+    // The stolen voice fades out from a tail slot while this one is reused
+    if (target->pad != nullptr)
+        retireVoice(*target, bufferToFill);
+
+    target->pad = pad;
+    target->position = 0.0;
+    target->increment = pad->sampleRate / deviceSampleRate;
+    target->velocity = hit.velocity;
+    target->currentGain = hit.velocity * pad->gain.load();
+    target->fadeRemaining = -1;
+    target->startOrder = nextStartOrder++;
+}
+
+void SamplerEngine::retireVoice(Voice& voice, const AudioSourceChannelInfo& bufferToFill) noexcept
+{
+    releaseVoice(voice);
+
+    // Every tail busy only happens with a burst of hits in one block; the one nearest the
+    // end of its fade makes way, finishing as much of it as this block holds
+    Voice* slot = nullptr;
+    for (auto& tail : tails)
+    {
+        if (tail.pad == nullptr)
+        {
+            slot = &tail;
+            break;
+        }
+
+        if (slot == nullptr || tail.fadeRemaining < slot->fadeRemaining)
+            slot = &tail;
+    }
+
+    if (slot->pad != nullptr)
+        renderVoice(*slot, bufferToFill, jmin(slot->fadeRemaining, bufferToFill.numSamples));
+
+    *slot = voice;
+}
+
+void SamplerEngine::renderVoice(Voice& voice, const AudioSourceChannelInfo& bufferToFill, int numSamples) noexcept
+{
+    const auto& audio = voice.pad->audio;
+    const int lastIndex = audio.getNumSamples() - 1;
+    const float* srcL = audio.getReadPointer(0);
+    const float* srcR = audio.getReadPointer(1);
+
+    auto* buffer = bufferToFill.buffer;
+    float* outL = buffer->getWritePointer(0, bufferToFill.startSample);
+    float* outR = buffer->getNumChannels() > 1 ? buffer->getWritePointer(1, bufferToFill.startSample) : nullptr;
+
+    // Pad gain changes are ramped over the block
+    const float targetGain = voice.velocity * voice.pad->gain.load(std::memory_order_relaxed);
+    const float gainStep = (targetGain - voice.currentGain) / static_cast<float>(jmax(1, numSamples));
+    float gain = voice.currentGain;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const int index = static_cast<int>(voice.position);
+        if (index >= lastIndex || voice.fadeRemaining == 0)
+        {
+            voice.pad = nullptr;
+            return;
+        }
+
+        float amp = gain;
+        if (voice.fadeRemaining > 0)
+            amp *= static_cast<float>(voice.fadeRemaining--) / static_cast<float>(fadeSamples);
+
+        // Linear interpolation covers pads recorded at a different rate from the device
+        const float frac = static_cast<float>(voice.position - index);
+        const float left = srcL[index] + frac * (srcL[index + 1] - srcL[index]);
+        const float right = srcR[index] + frac * (srcR[index + 1] - srcR[index]);
+
+        if (outR != nullptr)
+        {
+            outL[i] += left * amp;
+            outR[i] += right * amp;
+        }
+        else
+        {
+            outL[i] += 0.5f * (left + right) * amp;
+        }
+
+        voice.position += voice.increment;
+        gain += gainStep;
+    }
+
+    voice.currentGain = gain;
+}
+
+void SamplerEngine::releaseVoice(Voice& voice) noexcept
+{
+    if (voice.pad != nullptr && voice.fadeRemaining < 0)
+        voice.fadeRemaining = fadeSamples;
+}
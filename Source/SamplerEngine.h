@@ -0,0 +1,144 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SilenceAwareMixer.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// SamplerEngine plays short one-shot samples ("pads") with several voices at once.
+// Pads are decoded into memory when they are added, and triggers are handed to the audio
+// thread through a lock-free FIFO, so a hit sounds at the start of the next audio block
+// without any disk access. When every voice is busy the oldest one is stolen with a short
+// fade. Pads in the same choke group cut each other off, like open and closed hi-hats
+class SamplerEngine : public SilenceAwareMixer::Source
+{
+public:
+    // Most pads a sampler can hold
+    static constexpr int maxPads = 32;
+
+    // Constructs a sampler with room for maxVoices simultaneous voices
+    explicit SamplerEngine(AudioFormatManager& formatManager, int maxVoices = 16);
+
+    // Destructor
+    ~SamplerEngine() override;
+
+    // Decodes a file into a new pad and returns its index, or -1 if it couldn't be read.
+    // chokeGroup 0 means the pad chokes nothing. Message thread only; safe while playing
+    int addPad(const File& file, float gain = 1.0f, int chokeGroup = 0);
+
+    // Returns the number of pads added so far
+    int getNumPads() const noexcept;
+
+    // Sets the gain of a pad (0 to 1). Applies to voices already playing
+    void setPadGain(int padIndex, float gain) noexcept;
+
+    // Returns the gain of a pad
+    float getPadGain(int padIndex) const noexcept;
+
+    // Sets the choke group of a pad. 0 disables choking
+    void setPadChokeGroup(int padIndex, int chokeGroup) noexcept;
+
+    // Sets how many voices may play at once, up to the number given to the constructor
+    void setPolyphony(int numVoices) noexcept;
+
+    // Returns how many voices may play at once
+    int getPolyphony() const noexcept;
+
+    // Queues a hit on a pad, played from the start of the next audio block. Message thread only
+    void trigger(int padIndex, float velocity = 1.0f);
+
+    // Stops every voice with a short fade
+    void stopAll() noexcept;
+
+    // Returns how many voices were sounding at the end of the last block
+    int getNumActiveVoices() const noexcept;
+
+    // Prepares the voices for the device sample rate
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+    // Mixes every sounding voice into the block
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    // Releases audio resources
+    void releaseResources() override;
+
+    // Returns true if no voice sounded in the last block
+    bool isOutputSilent() const noexcept override { return outputSilent.load(std::memory_order_relaxed); }
+
+private:
+    // One decoded sample and its settings
+    struct Pad
+    {
+        AudioBuffer<float> audio;
+        double sampleRate = 44100.0;
+        std::atomic<float> gain{ 1.0f };
+        std::atomic<int> chokeGroup{ 0 };
+    };
+
+    // One playing instance of a pad. Audio thread only
+    struct Voice
+    {
+        const Pad* pad = nullptr;
+        double position = 0.0;
+        double increment = 1.0;
+        float velocity = 1.0f;
+        float currentGain = 0.0f;
+        int fadeRemaining = -1; // Samples left of a fade-out, -1 when not fading
+        uint32 startOrder = 0;
+    };
+
+    // A queued hit
+    struct Trigger
+    {
+        int padIndex;
+        float velocity;
+    };
+
+    // Applies one queued hit: chokes its group, then starts a free or stolen voice
+    void startVoice(const Trigger& hit, const AudioSourceChannelInfo& bufferToFill) noexcept;
+
+    // Moves a voice about to be reused into a tail slot, where it fades out
+    void retireVoice(Voice& voice, const AudioSourceChannelInfo& bufferToFill) noexcept;
+
+    // Mixes up to numSamples of a voice into the buffer and frees it when it ends
+    void renderVoice(Voice& voice, const AudioSourceChannelInfo& bufferToFill, int numSamples) noexcept;
+
+    // Starts a fade-out on a voice unless it is already fading
+    void releaseVoice(Voice& voice) noexcept;
+
+    AudioFormatManager& formatManager;
+
+    // Pads are only ever appended; numPads publishes each one to the audio thread
+    std::array<std::unique_ptr<Pad>, maxPads> pads;
+    std::atomic<int> numPads{ 0 };
+
+    // Hits waiting for the audio thread
+    static constexpr int triggerCapacity = 64;
+    AbstractFifo triggerFifo{ triggerCapacity };
+    std::array<Trigger, triggerCapacity> triggers{};
+
+    // Voices, allocated up front
+    std::vector<Voice> voices;
+
+    // Stolen voices finishing their fade-out, so it can run on into later blocks
+    std::vector<Voice> tails;
+    std::atomic<int> polyphony;
+    uint32 nextStartOrder = 0;
+
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<int> activeVoices{ 0 };
+    std::atomic<bool> outputSilent{ true };
+
+    double deviceSampleRate = 44100.0;
+    int fadeSamples = 220;
+
+    // Length of the fade used for choked, stolen and stopped voices
+    static constexpr double fadeSeconds = 0.005;
+
+    // Longest file accepted as a pad
+    static constexpr double maxPadSeconds = 60.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplerEngine)
+};
@@ -0,0 +1,114 @@
+#include "ScratchEngine.h"
+#include <cmath>
+
+namespace
+{
+    // Rate within this of its target counts as settled
+    constexpr double settledTolerance = 0.002;
+}
+
+//------------------------------------------------------------------------------
+ScratchEngine::ScratchEngine()
+    // A chunk spans up to chunkSize steps, and the interpolator reads one sample before
+    // and two after each position
+    : window(2, static_cast<int>(std::ceil(chunkSize * maxRatio)) + 4)
+{
+    window.clear();
+}
+
+//------------------------------------------------------------------------------
+void ScratchEngine::prepare(double deviceSampleRate)
+{
+    if (deviceSampleRate > 0.0)
+        sampleRate = deviceSampleRate;
+}
+
+//------------------------------------------------------------------------------
+void ScratchEngine::begin(double startPosition, double startRate) noexcept
+{
+    position = startPosition;
+    rate = targetRate = startRate;
+}
+
+//------------------------------------------------------------------------------
+void ScratchEngine::setTarget(double newTargetRate, double smoothingSeconds) noexcept
+{
+    targetRate = newTargetRate;
+    smoothing = smoothingSeconds > 0.0 ? 1.0 - std::exp(-1.0 / (smoothingSeconds * sampleRate)) : 1.0;
+}
+
+//------------------------------------------------------------------------------
+bool ScratchEngine::hasSettled() const noexcept
+{
+    return std::abs(rate - targetRate) < settledTolerance;
+}
+
+//------------------------------------------------------------------------------
+void ScratchEngine::process(DeckTransport& transport, const AudioSourceChannelInfo& bufferToFill) noexcept
+{
+    if (bufferToFill.buffer == nullptr || transport.getActiveTrack() == nullptr)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    for (int done = 0; done < bufferToFill.numSamples; done += chunkSize)
+        processChunk(transport, *bufferToFill.buffer, bufferToFill.startSample + done,
+            jmin(chunkSize, bufferToFill.numSamples - done));
+
+    transport.movePlayheadNow(static_cast<int64>(position));
+}
+
+//------------------------------------------------------------------------------
+void ScratchEngine::processChunk(DeckTransport& transport, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept
+{
+    // The rate is in track time, so a track at another sample rate moves proportionally
+    const double rateToRatio = transport.getActiveSampleRate() / sampleRate;
+    const double length = static_cast<double>(transport.getActiveTrack()->getLengthInSamples());
+
+    // Where each output sample falls, and the span of the track they cover
+    double lowest = position;
+    double highest = position;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        positions[static_cast<size_t>(i)] = position;
+        lowest = jmin(lowest, position);
+        highest = jmax(highest, position);
+
+        rate += (targetRate - rate) * smoothing;
+        position = jlimit(0.0, length, position + jlimit(-maxRatio, maxRatio, rate * rateToRatio));
+    }
+
+    // The window reaches where the chunk leaves the playhead too, so handing it back to
+    // the looper never lands past the audio it holds
+    lowest = jmin(lowest, position);
+    highest = jmax(highest, position);
+
+    const auto first = static_cast<int64>(std::floor(lowest)) - 1;
+    const auto span = static_cast<int>(static_cast<int64>(std::floor(highest)) + 3 - first);
+    transport.peek(first, window, span);
+
+    const int numChannels = jmin(dest.getNumChannels(), window.getNumChannels());
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const float* in = window.getReadPointer(ch);
+        float* out = dest.getWritePointer(ch, destStart);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            // Third-order Lagrange through the samples at -1, 0, 1 and 2, as the resampler uses
+            const double pos = positions[static_cast<size_t>(i)];
+            const auto index = static_cast<int64>(std::floor(pos));
+            const float f = static_cast<float>(pos - static_cast<double>(index));
+            const float* x = in + (index - first);
+            const float fm1 = f - 1.0f;
+            const float fm2 = f - 2.0f;
+            const float fp1 = f + 1.0f;
+
+            out[i] = -f * fm1 * fm2 * (1.0f / 6.0f) * x[-1]
+                + fp1 * fm1 * fm2 * 0.5f * x[0]
+                - fp1 * f * fm2 * 0.5f * x[1]
+                + fp1 * f * fm1 * (1.0f / 6.0f) * x[2];
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckTransport.h"
+#include "FusedResampler.h"
+#include <array>
+
+// ScratchEngine plays a deck like a record moved by hand. The platter's velocity sets a
+// playback rate, forwards or backwards, and the audio thread follows it with a one-pole
+// smoother, so the rate never steps between the GUI's updates. Audio is read from the
+// window of recent audio the transport's looper keeps in memory and interpolated at
+// each output sample, so the playhead glides at any rate and playing backwards never
+// sends the decoder back. Audio thread only, apart from prepare
+class ScratchEngine
+{
+public:
+    // Output is rendered this many samples at a time
+    static constexpr int chunkSize = 256;
+
+    // Fastest the record plays either way, in track samples per output sample
+    static constexpr double maxRatio = FusedResampler::maxRatio;
+
+    // Constructs an engine, allocating its window of audio. Not for the audio thread
+    ScratchEngine();
+
+    // Sets the device sample rate. Not for the audio thread
+    void prepare(double deviceSampleRate);
+
+    // Starts from position, in track samples, at rate: 1 plays forwards at normal speed
+    void begin(double startPosition, double startRate) noexcept;
+
+    // Moves the playhead without changing the rate, as after a seek
+    void setPosition(double newPosition) noexcept { position = newPosition; }
+
+    // Sets the rate to follow and how quickly: the gap closes by about two thirds in
+    // smoothingSeconds
+    void setTarget(double newTargetRate, double smoothingSeconds) noexcept;
+
+    // Returns true once the rate has reached its target
+    bool hasSettled() const noexcept;
+
+    // Returns the playhead in track samples
+    double getPosition() const noexcept { return position; }
+
+    // Returns the current rate
+    double getRate() const noexcept { return rate; }
+
+    // Renders the block from the transport's active track and moves its playhead along
+    void process(DeckTransport& transport, const AudioSourceChannelInfo& bufferToFill) noexcept;
+
+private:
+    // Renders up to chunkSize samples
+    void processChunk(DeckTransport& transport, AudioBuffer<float>& dest, int destStart, int numSamples) noexcept;
+
+    double sampleRate = 44100.0;
+    double position = 0.0;
+    double rate = 0.0;
+    double targetRate = 0.0;
+
+    // One-pole coefficient per output sample
+    double smoothing = 1.0;
+
+    // Playhead at each output sample of a chunk, and the audio they span
+    std::array<double, chunkSize> positions{};
+    AudioBuffer<float> window;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScratchEngine)
+};
@@ -0,0 +1,210 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ScrollingWaveform.h"
+#include <cmath>
+
+namespace
+{
+    // Position of a track column in the ring, for columns before the track start too
+    inline int wrapColumn(int64 column, int width) noexcept
+    {
+        const auto x = static_cast<int>(column % width);
+        return x < 0 ? x + width : x;
+    }
+
+    const Colour backgroundColour = Colours::lightseagreen.darker(1.0f);
+}
+
+//------------------------------------------------------------------------------
+ScrollingWaveform::ScrollingWaveform(DJAudioPlayer& playerToFollow, FrameScheduler& schedulerToUse,
+    const String& name)
+    : player(playerToFollow),
+    frameScheduler(schedulerToUse)
+{
+    // Every pixel comes from the image, so nothing behind needs repainting
+    setOpaque(true);
+    frameScheduler.addClient(this, name);
+}
+
+//------------------------------------------------------------------------------
+ScrollingWaveform::~ScrollingWaveform()
+{
+    frameScheduler.removeClient(this);
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::paint(Graphics& g)
+{
+    const FrameScheduler::ScopedPaintTimer paintTimer(*this);
+
+    if (peaks == nullptr || image.isNull() || validStart == validEnd)
+    {
+        g.fillAll(backgroundColour);
+        g.setColour(Colours::grey);
+        g.drawRect(getLocalBounds(), 1);
+        return;
+    }
+
+    // The view starts part-way through the ring and wraps round to its start
+    const int width = image.getWidth();
+    const int height = image.getHeight();
+    const int x = wrapColumn(shownFirstColumn, width);
+    {
+        Graphics::ScopedSaveState state(g);
+        g.addTransform(AffineTransform::scale(1.0f / scale));
+        g.drawImage(image, 0, 0, width - x, height, x, 0, width - x, height);
+        if (x > 0)
+            g.drawImage(image, width - x, 0, x, height, 0, 0, x, height);
+    }
+
+    // Fixed playhead over the column holding the current position
+    const float playheadX = static_cast<float>(width / 2) / scale;
+    g.setColour(Colours::lightgreen);
+    g.fillRect(Rectangle<float>(playheadX - 1.0f, 0.0f, 2.0f, static_cast<float>(getHeight())));
+
+    g.setColour(Colours::grey);
+    g.drawRect(getLocalBounds(), 1);
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::resized()
+{
+    // Render at the display's resolution so the waveform stays sharp on high-DPI screens
+    scale = static_cast<float>(Component::getApproximateScaleFactorForComponent(this));
+    const int width = roundToInt(static_cast<float>(getWidth()) * scale);
+    const int height = roundToInt(static_cast<float>(getHeight()) * scale);
+
+    image = width > 0 && height > 0 ? Image(Image::RGB, width, height, false) : Image();
+    invalidate();
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::mouseWheelMove(const MouseEvent& /*event*/, const MouseWheelDetails& wheel)
+{
+    if (wheel.deltaY != 0.0f)
+        setVisibleSeconds(visibleSeconds * (wheel.deltaY > 0.0f ? 0.8 : 1.25));
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::setPeaks(std::shared_ptr<const PeakPyramid> newPeaks)
+{
+    peaks = std::move(newPeaks);
+    invalidate();
+    repaint();
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::setVisibleSeconds(double seconds)
+{
+    seconds = jlimit(1.0, 60.0, seconds);
+    if (seconds != visibleSeconds)
+    {
+        visibleSeconds = seconds;
+        invalidate();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ScrollingWaveform::advanceFrame(double /*frameTimeMs*/)
+{
+    if (peaks == nullptr || image.isNull() || !isShowing())
+        return false;
+
+    const bool animating = player.isPlaying() || !peaks->isComplete();
+
+    // Keep the column under the playhead in the middle of the view
+    const double playheadSample = player.getCurrentPosition() * peaks->getSampleRate();
+    const auto firstColumn = static_cast<int64>(std::floor(playheadSample / getSamplesPerColumn())) - image.getWidth() / 2;
+
+    const bool moved = firstColumn != shownFirstColumn || validStart == validEnd;
+    const bool grown = pendingFrom < validEnd && peaks->getNumSamplesDone() != samplesDoneWhenRendered;
+
+    // A stopped deck with finished peaks costs nothing per frame
+    if (!moved && !grown)
+        return animating;
+
+    updateColumns(firstColumn);
+    repaint();
+    return animating;
+}
+
+//------------------------------------------------------------------------------
+double ScrollingWaveform::getSamplesPerColumn() const
+{
+    return visibleSeconds * peaks->getSampleRate() / jmax(1, image.getWidth());
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::invalidate()
+{
+    validStart = validEnd = 0;
+    pendingFrom = std::numeric_limits<int64>::max();
+
+    // Render the new view at the next frame even if nothing is playing
+    frameScheduler.wake();
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::updateColumns(int64 firstColumn)
+{
+    const int64 endColumn = firstColumn + image.getWidth();
+
+    // Redo columns drawn before their peaks were built, now that more of them exist
+    if (pendingFrom < validEnd && peaks->getNumSamplesDone() != samplesDoneWhenRendered)
+    {
+        const auto from = jmax(pendingFrom, validStart);
+        pendingFrom = std::numeric_limits<int64>::max();
+        renderColumns(from, validEnd);
+    }
+
+    // Keep what is still on screen and render only the columns scrolled into view
+    const auto keptStart = jmax(firstColumn, validStart);
+    const auto keptEnd = jmin(endColumn, validEnd);
+
+    if (keptStart >= keptEnd)
+    {
+        renderColumns(firstColumn, endColumn);
+    }
+    else
+    {
+        if (firstColumn < keptStart)
+            renderColumns(firstColumn, keptStart);
+        if (keptEnd < endColumn)
+            renderColumns(keptEnd, endColumn);
+    }
+
+    validStart = firstColumn;
+    validEnd = endColumn;
+    shownFirstColumn = firstColumn;
+}
+
+//------------------------------------------------------------------------------
+void ScrollingWaveform::renderColumns(int64 first, int64 last)
+{
+    const int width = image.getWidth();
+    const double samplesPerColumn = getSamplesPerColumn();
+    Graphics g(image);
+
+    // A range that wraps past the end of the ring is drawn in two pieces
+    for (auto column = first; column < last;)
+    {
+        const int x = wrapColumn(column, width);
+        const int num = static_cast<int>(jmin(last - column, static_cast<int64>(width - x)));
+        const Rectangle<int> area(x, 0, num, image.getHeight());
+
+        g.setColour(backgroundColour);
+        g.fillRect(area);
+        peaks->draw(g, area, static_cast<double>(column) * samplesPerColumn, samplesPerColumn,
+            Colours::orange, Colours::orange.brighter(0.6f));
+
+        column += num;
+    }
+
+    // Columns past the end of the build so far are left empty until it catches up
+    if (!peaks->isComplete())
+    {
+        samplesDoneWhenRendered = peaks->getNumSamplesDone();
+        const auto doneColumn = static_cast<int64>(std::floor(static_cast<double>(samplesDoneWhenRendered) / samplesPerColumn));
+        if (doneColumn < last)
+            pendingFrom = jmin(pendingFrom, jmax(first, doneColumn));
+    }
+}
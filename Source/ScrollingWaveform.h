@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DJAudioPlayer.h"
+#include "FrameScheduler.h"
+#include "PeakPyramid.h"
+#include <limits>
+#include <memory>
+
+// ScrollingWaveform shows a zoomed-in view of the track that scrolls past a fixed
+// playhead in the centre. The view is rendered into an image used as a ring of columns:
+// column c of the track always lives at x = c modulo the image width. As the track
+// plays, the columns that scrolled off one side are overwritten with the ones exposed on
+// the other, so each frame renders only a few new columns and paints two image blits
+class ScrollingWaveform : public Component,
+    public FrameScheduler::Client
+{
+public:
+    // Constructs ScrollingWaveform following the given player's position, animated by
+    // the scheduler under the given name
+    ScrollingWaveform(DJAudioPlayer& player, FrameScheduler& scheduler, const String& name);
+
+    // Destructor. Leaves the scheduler
+    ~ScrollingWaveform();
+
+    // Blits the rendered columns and draws the playhead
+    void paint(Graphics&) override;
+
+    // Reallocates the image for the new size
+    void resized() override;
+
+    // Zooms in or out with the mouse wheel
+    void mouseWheelMove(const MouseEvent& event, const MouseWheelDetails& wheel) override;
+
+    // Shows the given peaks, or nothing if nullptr
+    void setPeaks(std::shared_ptr<const PeakPyramid> newPeaks);
+
+    // Sets how many seconds of the track fit across the view
+    void setVisibleSeconds(double seconds);
+
+    // Follows the playhead, rendering only what changed. Returns false once the deck is
+    // stopped and the peaks are complete
+    bool advanceFrame(double frameTimeMs) override;
+
+private:
+    // Returns the number of track samples each image column covers
+    double getSamplesPerColumn() const;
+
+    // Marks every column of the image as needing to be rendered
+    void invalidate();
+
+    // Brings the image up to date for a view starting at firstColumn
+    void updateColumns(int64 firstColumn);
+
+    // Renders the columns from first up to (not including) last into the image
+    void renderColumns(int64 first, int64 last);
+
+    DJAudioPlayer& player;
+    FrameScheduler& frameScheduler;
+    std::shared_ptr<const PeakPyramid> peaks;
+    double visibleSeconds = 8.0;
+
+    // Ring of rendered columns, in physical pixels
+    Image image;
+    float scale = 1.0f;
+
+    // Columns of the track held in the image, and the first one being shown
+    int64 validStart = 0;
+    int64 validEnd = 0;
+    int64 shownFirstColumn = 0;
+
+    // First column rendered before its peaks were built, and how far the build had got
+    int64 pendingFrom = std::numeric_limits<int64>::max();
+    int64 samplesDoneWhenRendered = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScrollingWaveform)
+};
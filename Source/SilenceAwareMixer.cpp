@@ -0,0 +1,106 @@
+#include "SilenceAwareMixer.h"
+#include <algorithm>
+
+SilenceAwareMixer::SilenceAwareMixer()
+{
+}
+
+SilenceAwareMixer::~SilenceAwareMixer()
+{
+}
+
+void SilenceAwareMixer::addInputSource(Source* input)
+{
+    const ScopedLock sl(lock);
+    if (input != nullptr && std::find(inputs.begin(), inputs.end(), input) == inputs.end())
+        inputs.push_back(input);
+}
+
+void SilenceAwareMixer::removeInputSource(Source* input)
+{
+    const ScopedLock sl(lock);
+    inputs.erase(std::remove(inputs.begin(), inputs.end(), input), inputs.end());
+}
+
+void SilenceAwareMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    maxBlockSize = jmax(1, samplesPerBlockExpected);
+    tempBuffer.setSize(maxChannels, maxBlockSize);
+
+    const ScopedLock sl(lock);
+    for (auto* input : inputs)
+        input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void SilenceAwareMixer::getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill)
+{
+    // Covers every input, since they all run inside this call
+    const ScopedNoDenormals noDenormals;
+    const ScopedLock sl(lock);
+
+    if (bufferToFill.buffer == nullptr)
+        return;
+
+    if (maxBlockSize == 0)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        outputSilent.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    // Larger blocks than prepared for are split so the mixing buffer never has to grow
+    bool written = false;
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int num = jmin(maxBlockSize, bufferToFill.numSamples - done);
+        written = mixChunk(AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, num)) || written;
+        done += num;
+    }
+
+    outputSilent.store(!written, std::memory_order_relaxed);
+}
+
+bool SilenceAwareMixer::mixChunk(const AudioSourceChannelInfo& bufferToFill)
+{
+    auto* buffer = bufferToFill.buffer;
+    const int numChannels = jlimit(1, maxChannels, buffer->getNumChannels());
+    bool written = false;
+
+    for (auto* input : inputs)
+    {
+        // The first input that makes a sound renders straight into the output; silent
+        // ones have only cleared it
+        if (!written)
+        {
+            input->getNextAudioBlock(bufferToFill);
+            written = !input->isOutputSilent();
+            continue;
+        }
+
+        // Only needed once two inputs are sounding. A view of the prepared buffer with the
+        // output's channels and length, which allocates nothing
+        AudioBuffer<float> mix(tempBuffer.getArrayOfWritePointers(), numChannels, bufferToFill.numSamples);
+        input->getNextAudioBlock(AudioSourceChannelInfo(&mix, 0, bufferToFill.numSamples));
+
+        if (input->isOutputSilent())
+            continue;
+
+        for (int ch = 0; ch < jmin(numChannels, buffer->getNumChannels()); ++ch)
+            buffer->addFrom(ch, bufferToFill.startSample, mix, ch, 0, bufferToFill.numSamples);
+    }
+
+    if (!written)
+        bufferToFill.clearActiveBufferRegion();
+
+    return written;
+}
+
+void SilenceAwareMixer::releaseResources()
+{
+    const ScopedLock sl(lock);
+    for (auto* input : inputs)
+        input->releaseResources();
+
+    tempBuffer.setSize(maxChannels, 0);
+    maxBlockSize = 0;
+}
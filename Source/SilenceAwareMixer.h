@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <vector>
+
+// SilenceAwareMixer sums its inputs like MixerAudioSource, but skips inputs that report
+// their last block was silence: a stopped deck costs the mixer nothing. It also turns on
+// denormal flushing for the whole chain, so decaying filters and reverb tails never fall
+// into slow subnormal arithmetic
+class SilenceAwareMixer : public AudioSource
+{
+public:
+    // An input that can report that it produced nothing but silence
+    class Source : public AudioSource
+    {
+    public:
+        // Returns true if the block just produced was all zeros. Audio thread only
+        virtual bool isOutputSilent() const noexcept = 0;
+    };
+
+    // Constructs an empty mixer
+    SilenceAwareMixer();
+
+    // Destructor
+    ~SilenceAwareMixer() override;
+
+    // Adds an input. The mixer doesn't own it. Adding an input twice has no effect
+    void addInputSource(Source* input);
+
+    // Removes an input
+    void removeInputSource(Source* input);
+
+    // Prepares every input and the mixing buffer
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+
+    // Mixes the inputs that produced sound this block
+    void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override;
+
+    // Releases every input
+    void releaseResources() override;
+
+    // Returns true if every input was silent in the last block
+    bool isOutputSilent() const noexcept { return outputSilent.load(std::memory_order_relaxed); }
+
+private:
+    // Most output channels mixed; any further ones carry the first sounding input only
+    static constexpr int maxChannels = 8;
+
+    // Mixes a block no longer than the one prepared for. Returns true if any input sounded
+    bool mixChunk(const AudioSourceChannelInfo& bufferToFill);
+
+    std::vector<Source*> inputs;
+    CriticalSection lock;
+
+    // Sized in prepareToPlay; the audio thread only ever uses part of it
+    AudioBuffer<float> tempBuffer;
+    int maxBlockSize = 0;
+    std::atomic<bool> outputSilent{ true };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SilenceAwareMixer)
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+// SmoothedParameter carries a control value from the message thread to the audio thread.
+// The target is an atomic written by the GUI; the audio thread pulls it into a
+// SmoothedValue once per block and ramps towards it, so no locks are taken.
+class SmoothedParameter
+{
+public:
+    // Constructs parameter with the given starting value
+    explicit SmoothedParameter(float initialValue)
+        : target(initialValue)
+    {
+        smoothed.setCurrentAndTargetValue(initialValue);
+    }
+
+    // Sets the value to ramp towards. Safe to call from any thread
+    void setTarget(float newValue) noexcept
+    {
+        target.store(newValue, std::memory_order_relaxed);
+    }
+
+    // Returns the most recently requested value
+    float getTarget() const noexcept
+    {
+        return target.load(std::memory_order_relaxed);
+    }
+
+    // Resets ramp length for a new sample rate and jumps to the current target
+    void prepare(double sampleRate, double rampLengthSeconds)
+    {
+        smoothed.reset(sampleRate, rampLengthSeconds);
+        smoothed.setCurrentAndTargetValue(getTarget());
+    }
+
+    // Pulls the latest target into the smoother. Audio thread only
+    void update() noexcept
+    {
+        smoothed.setTargetValue(getTarget());
+    }
+
+    // Returns true while the value is still ramping
+    bool isSmoothing() const noexcept
+    {
+        return smoothed.isSmoothing();
+    }
+
+    // Returns the next per-sample value of the ramp
+    float getNextValue() noexcept
+    {
+        return smoothed.getNextValue();
+    }
+
+    // Advances the ramp by several samples and returns the value reached
+    float skip(int numSamples) noexcept
+    {
+        return smoothed.skip(numSamples);
+    }
+
+    // Returns the value at the current point of the ramp
+    float getCurrentValue() const noexcept
+    {
+        return smoothed.getCurrentValue();
+    }
+
+private:
+    std::atomic<float> target;
+    SmoothedValue<float> smoothed;
+
+    JUCE_DECLARE_NON_COPYABLE(SmoothedParameter)
+};
@@ -0,0 +1,97 @@
+#include "SyncEngine.h"
+#include "DJAudioPlayer.h"
+#include <cmath>
+
+//------------------------------------------------------------------------------
+SyncEngine::SyncEngine()
+{
+}
+
+//------------------------------------------------------------------------------
+void SyncEngine::addDeck(DJAudioPlayer* deck)
+{
+    decks.addIfNotAlreadyThere(deck);
+}
+
+//------------------------------------------------------------------------------
+void SyncEngine::removeDeck(DJAudioPlayer* deck)
+{
+    decks.removeFirstMatchingValue(deck);
+
+    if (master.load() == deck)
+        master = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void SyncEngine::prepareToPlay(double newSampleRate)
+{
+    // The tempo is per sample, so it carries over to the new rate in beats per minute
+    if (newSampleRate > 0.0)
+    {
+        clock.beatsPerSample *= sampleRate / newSampleRate;
+        sampleRate = newSampleRate;
+    }
+
+    clock.running = false;
+    lastBlockSize = 0;
+}
+
+//------------------------------------------------------------------------------
+void SyncEngine::beginBlock(int numSamples) noexcept
+{
+    // Running free, the clock moves on by the block just played
+    clock.beat += clock.beatsPerSample * lastBlockSize;
+
+    DJAudioPlayer* newMaster = nullptr;
+    DJAudioPlayer* firstPlaying = nullptr;
+    for (auto* deck : decks)
+    {
+        if (!deck->isPlaying() || !deck->hasBeatGrid())
+            continue;
+
+        if (firstPlaying == nullptr)
+            firstPlaying = deck;
+
+        if (!deck->isSyncEnabled())
+        {
+            newMaster = deck;
+            break;
+        }
+    }
+
+    if (newMaster != nullptr)
+    {
+        clock.beat = newMaster->getBeatPosition();
+        clock.beatsPerSample = newMaster->getBeatsPerSample();
+    }
+    // Only synced decks are playing. After a pause the clock picks up the phase of the
+    // first to start, keeping its tempo unless it never had one
+    else if (firstPlaying != nullptr && !clock.running)
+    {
+        clock.beat = firstPlaying->getBeatPosition();
+        if (clock.beatsPerSample <= 0.0)
+            clock.beatsPerSample = firstPlaying->getBeatsPerSample();
+    }
+
+    clock.running = firstPlaying != nullptr;
+    lastBlockSize = clock.running ? numSamples : 0;
+
+    master.store(newMaster, std::memory_order_relaxed);
+    bpm.store(clock.beatsPerSample * sampleRate * 60.0, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+double SyncEngine::getTempoMultiple(double clockTempo, double deckTempo) noexcept
+{
+    if (clockTempo <= 0.0 || deckTempo <= 0.0)
+        return 1.0;
+
+    // Within a factor of sqrt(2) either way of the deck's own tempo
+    return std::exp2(std::round(std::log2(deckTempo / clockTempo)));
+}
+
+//------------------------------------------------------------------------------
+double SyncEngine::wrapPhase(double beats) noexcept
+{
+    return beats - std::floor(beats + 0.5);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <atomic>
+
+class DJAudioPlayer;
+
+// SyncEngine is the master tempo clock the decks lock to. Once per audio block, before
+// any deck renders, the clock takes the beat position and tempo of the master deck: the
+// first playing deck with a beat grid that is not itself synced. With no master the clock
+// runs on at its last tempo, so synced decks stay together, and it picks up the phase of
+// the first deck to play after a pause.
+//
+// Decks read the clock on the audio thread to lock their tempo and phase to it and to
+// start on its beats, so no timing decision waits on the message thread
+class SyncEngine
+{
+public:
+    // The clock at the start of the current block
+    struct Clock
+    {
+        // Beats counted in the master's grid, or from wherever the clock last picked up
+        double beat = 0.0;
+
+        // Tempo in beats per device sample, 0 until a deck has given the clock a tempo
+        double beatsPerSample = 0.0;
+
+        // True while a deck with a beat grid is playing
+        bool running = false;
+    };
+
+    // Constructs a clock with no decks
+    SyncEngine();
+
+    // Adds a deck. Decks register themselves, before audio starts
+    void addDeck(DJAudioPlayer* deck);
+
+    // Removes a deck. Audio must have stopped
+    void removeDeck(DJAudioPlayer* deck);
+
+    // Resets the clock for a new device sample rate
+    void prepareToPlay(double sampleRate);
+
+    // Moves the clock on to the start of a block. Call before the decks render it.
+    // Audio thread only
+    void beginBlock(int numSamples) noexcept;
+
+    // Returns the clock for the current block. Audio thread only
+    const Clock& getClock() const noexcept { return clock; }
+
+    // Returns the deck the clock follows, or nullptr if it is running free
+    const DJAudioPlayer* getMaster() const noexcept { return master.load(std::memory_order_relaxed); }
+
+    // Returns the master tempo in beats per minute, 0 if there is none yet
+    double getBpm() const noexcept { return bpm.load(std::memory_order_relaxed); }
+
+    // Returns the power of two that brings a tempo closest to the clock's, so a deck at
+    // half or double the master tempo plays in time rather than twice as fast or slow
+    static double getTempoMultiple(double clockTempo, double deckTempo) noexcept;
+
+    // Returns a beat position's distance from the nearest beat, from -0.5 to 0.5
+    static double wrapPhase(double beats) noexcept;
+
+private:
+    Array<DJAudioPlayer*> decks;
+
+    Clock clock;
+    double sampleRate = 44100.0;
+    int lastBlockSize = 0;
+
+    // Published for the message thread
+    std::atomic<const DJAudioPlayer*> master{ nullptr };
+    std::atomic<double> bpm{ 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SyncEngine)
+};
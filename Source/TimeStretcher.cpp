@@ -0,0 +1,279 @@
+#include "TimeStretcher.h"
+#include <cstring>
+
+TimeStretcher::TimeStretcher()
+{
+}
+
+TimeStretcher::~TimeStretcher()
+{
+}
+
+TimeStretcher::TierSettings TimeStretcher::getTierSettings(Quality tier) noexcept
+{
+    switch (tier)
+    {
+    case Quality::low:    return { 0.030, 0.005, 4, 4 };
+    case Quality::high:   return { 0.050, 0.015, 1, 1 };
+    case Quality::medium:
+    default:              return { 0.040, 0.010, 2, 2 };
+    }
+}
+
+String TimeStretcher::getQualityName(Quality tier)
+{
+    switch (tier)
+    {
+    case Quality::low:    return "low";
+    case Quality::high:   return "high";
+    case Quality::medium:
+    default:              return "medium";
+    }
+}
+
+void TimeStretcher::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    maxBlockSize = jmax(1, maximumBlockSize);
+
+    // Size everything for the most demanding tier
+    const auto largest = getTierSettings(Quality::high);
+    const int maxFrame = roundToInt(largest.frameSeconds * sampleRate) + 2;
+    const int maxSearch = roundToInt(largest.searchSeconds * sampleRate) + 1;
+    const int maxAdvance = static_cast<int>(std::ceil(maxFrame * maxTempo));
+    const int inputCapacity = 2 * (maxFrame + 3 * maxSearch + maxAdvance) + pullSize;
+
+    window.assign(static_cast<size_t>(maxFrame), 0.0f);
+    input.setSize(3, inputCapacity);
+    pullBuffer.setSize(2, pullSize);
+    overlap.setSize(2, maxFrame);
+    output.setSize(2, maxBlockSize + maxFrame);
+
+    configure();
+}
+
+void TimeStretcher::configure() noexcept
+{
+    const auto settings = getTierSettings(quality);
+
+    // Frames overlap by half, so the periodic Hann windows sum to one
+    frameSize = jmin(static_cast<int>(window.size()), roundToInt(settings.frameSeconds * sampleRate)) & ~1;
+    hopSize = frameSize / 2;
+    searchRadius = roundToInt(settings.searchSeconds * sampleRate);
+    searchStep = settings.searchStep;
+    correlationStep = settings.correlationStep;
+
+    for (int i = 0; i < frameSize; ++i)
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(frameSize));
+
+    reset();
+}
+
+void TimeStretcher::reset() noexcept
+{
+    inputStart = 0;
+    inputLength = 0;
+    keepFrom = 0;
+    analysisPosition = 0.0;
+    previousFrameStart = -1;
+    outputRead = 0;
+    outputEnd = 0;
+    overlap.clear();
+}
+
+void TimeStretcher::setQuality(Quality newQuality) noexcept
+{
+    if (newQuality != quality)
+    {
+        quality = newQuality;
+        configure();
+    }
+}
+
+void TimeStretcher::process(AudioSource& source, const AudioSourceChannelInfo& bufferToFill, double tempo) noexcept
+{
+    if (bufferToFill.buffer == nullptr || frameSize == 0)
+        return;
+
+    tempo = jlimit(minTempo, maxTempo, tempo);
+
+    // Larger blocks than prepared for are split so the output buffer never overflows
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int num = jmin(maxBlockSize, bufferToFill.numSamples - done);
+        processChunk(source, AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, num), tempo);
+        done += num;
+    }
+}
+
+void TimeStretcher::processChunk(AudioSource& source, const AudioSourceChannelInfo& bufferToFill, double tempo) noexcept
+{
+    const int numSamples = bufferToFill.numSamples;
+
+    // Move the leftover from the last block (less than one hop) to the front
+    const int remaining = outputEnd - outputRead;
+    for (int ch = 0; ch < 2; ++ch)
+        std::memmove(output.getWritePointer(ch), output.getReadPointer(ch, outputRead), sizeof(float) * static_cast<size_t>(remaining));
+
+    outputRead = 0;
+    outputEnd = remaining;
+
+    while (outputEnd - outputRead < numSamples)
+        produceFrame(source, tempo);
+
+    auto* buffer = bufferToFill.buffer;
+    for (int ch = 0; ch < buffer->getNumChannels(); ++ch)
+        buffer->copyFrom(ch, bufferToFill.startSample, output, jmin(ch, 1), outputRead, numSamples);
+
+    outputRead += numSamples;
+}
+
+void TimeStretcher::produceFrame(AudioSource& source, double tempo) noexcept
+{
+    const auto idealStart = static_cast<int64>(std::llround(analysisPosition));
+    int64 start = idealStart;
+
+    if (previousFrameStart >= 0)
+    {
+        // The samples that naturally followed the previous frame are the target to match
+        const auto naturalStart = previousFrameStart + hopSize;
+        ensureInput(source, jmax(idealStart + searchRadius + frameSize, naturalStart + frameSize - hopSize));
+        start = findBestStart(idealStart, naturalStart);
+    }
+    else
+    {
+        ensureInput(source, idealStart + frameSize);
+    }
+
+    // Overlap-add the windowed frame
+    const int offset = static_cast<int>(start - inputStart);
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        float* ola = overlap.getWritePointer(ch);
+        const float* in = input.getReadPointer(ch, offset);
+        for (int i = 0; i < frameSize; ++i)
+            ola[i] += in[i] * window[static_cast<size_t>(i)];
+    }
+
+    // The first hop is now complete; shift the accumulator along
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        output.copyFrom(ch, outputEnd, overlap, ch, 0, hopSize);
+
+        float* ola = overlap.getWritePointer(ch);
+        std::memmove(ola, ola + hopSize, sizeof(float) * static_cast<size_t>(frameSize - hopSize));
+        FloatVectorOperations::clear(ola + frameSize - hopSize, hopSize);
+    }
+    outputEnd += hopSize;
+
+    previousFrameStart = start;
+    analysisPosition += hopSize * tempo;
+
+    // Older input can't be referenced again
+    keepFrom = jmin(static_cast<int64>(std::llround(analysisPosition)) - searchRadius, start + hopSize);
+}
+
+void TimeStretcher::ensureInput(AudioSource& source, int64 endPosition) noexcept
+{
+    while (inputStart + inputLength < endPosition)
+    {
+        if (inputLength + pullSize > input.getNumSamples())
+        {
+            // Drop history that is no longer needed
+            const int drop = jlimit(0, inputLength, static_cast<int>(keepFrom - inputStart));
+            if (drop == 0)
+            {
+                jassertfalse;
+                return;
+            }
+
+            for (int ch = 0; ch < input.getNumChannels(); ++ch)
+            {
+                float* data = input.getWritePointer(ch);
+                std::memmove(data, data + drop, sizeof(float) * static_cast<size_t>(inputLength - drop));
+            }
+
+            inputStart += drop;
+            inputLength -= drop;
+        }
+
+        source.getNextAudioBlock(AudioSourceChannelInfo(&pullBuffer, 0, pullSize));
+
+        input.copyFrom(0, inputLength, pullBuffer, 0, 0, pullSize);
+        input.copyFrom(1, inputLength, pullBuffer, 1, 0, pullSize);
+        input.copyFrom(2, inputLength, pullBuffer, 0, 0, pullSize, 0.5f);
+        input.addFrom(2, inputLength, pullBuffer, 1, 0, pullSize, 0.5f);
+
+        inputLength += pullSize;
+    }
+}
+
+float TimeStretcher::correlate(const float* reference, const float* candidate, int step) const noexcept
+{
+    const int overlapLength = frameSize - hopSize;
+
+    // Independent partial sums keep several multiply-adds in flight
+    float product[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float energy[4] = { 1.0e-9f, 0.0f, 0.0f, 0.0f };
+
+    int i = 0;
+    for (; i + 3 * step < overlapLength; i += 4 * step)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            const float c = candidate[i + k * step];
+            product[k] += reference[i + k * step] * c;
+            energy[k] += c * c;
+        }
+    }
+
+    for (; i < overlapLength; i += step)
+    {
+        product[0] += reference[i] * candidate[i];
+        energy[0] += candidate[i] * candidate[i];
+    }
+
+    return (product[0] + product[1] + product[2] + product[3])
+        / std::sqrt(energy[0] + energy[1] + energy[2] + energy[3]);
+}
+
+int64 TimeStretcher::findBestStart(int64 idealStart, int64 naturalStart) const noexcept
+{
+    const float* mono = input.getReadPointer(2);
+    const float* reference = mono + (naturalStart - inputStart);
+
+    const auto first = jmax(inputStart, idealStart - searchRadius);
+    const auto last = idealStart + searchRadius;
+
+    // Coarse pass over the whole range
+    int64 best = jmax(first, idealStart);
+    float bestScore = -std::numeric_limits<float>::max();
+    for (auto candidate = first; candidate <= last; candidate += searchStep)
+    {
+        const float score = correlate(reference, mono + (candidate - inputStart), correlationStep);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = candidate;
+        }
+    }
+
+    // Fine pass around the coarse winner, scored at full resolution
+    if (searchStep > 1)
+    {
+        const auto centre = best;
+        bestScore = correlate(reference, mono + (centre - inputStart), 1);
+
+        for (auto candidate = jmax(first, centre - searchStep + 1); candidate <= jmin(last, centre + searchStep - 1); ++candidate)
+        {
+            const float score = correlate(reference, mono + (candidate - inputStart), 1);
+            if (candidate != centre && score > bestScore)
+            {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+    }
+
+    return best;
+}
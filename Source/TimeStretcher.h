@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include <vector>
+
+// TimeStretcher changes tempo without changing pitch (key lock), using WSOLA: windowed
+// frames are taken from the input at the tempo rate and overlap-added at a fixed rate,
+// with each frame's start nudged to wherever it lines up best with the previous one.
+// Every buffer is sized in prepare for the largest quality tier, so processing and
+// switching tiers never allocate on the audio thread
+class TimeStretcher
+{
+public:
+    // Quality/CPU tiers. Higher tiers use longer frames and a finer, wider search
+    enum class Quality
+    {
+        low,
+        medium,
+        high
+    };
+
+    // Tempo range accepted by process
+    static constexpr double minTempo = 0.05;
+    static constexpr double maxTempo = 4.0;
+
+    // Constructs a stretcher that needs prepare before use
+    TimeStretcher();
+
+    // Destructor
+    ~TimeStretcher();
+
+    // Allocates buffers for blocks of up to maximumBlockSize samples. Not on the audio thread
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    // Drops buffered audio, e.g. after a seek. Audio thread only
+    void reset() noexcept;
+
+    // Selects a tier, resetting if it changed. Audio thread only
+    void setQuality(Quality newQuality) noexcept;
+
+    // Returns the selected tier
+    Quality getQuality() const noexcept { return quality; }
+
+    // Fills the block with audio pulled from source, played at tempo times the original
+    // speed. Source is read in stereo at its natural rate
+    void process(AudioSource& source, const AudioSourceChannelInfo& bufferToFill, double tempo) noexcept;
+
+    // Returns how far output lags the input, in samples
+    int getLatencySamples() const noexcept { return frameSize; }
+
+    // Returns a display name for a tier
+    static String getQualityName(Quality tier);
+
+private:
+    // Frame length, search radius and search/correlation strides for a tier
+    struct TierSettings
+    {
+        double frameSeconds;
+        double searchSeconds;
+        int searchStep;
+        int correlationStep;
+    };
+
+    static TierSettings getTierSettings(Quality tier) noexcept;
+
+    // Sets frame, hop and search sizes for the current tier and rebuilds the window
+    void configure() noexcept;
+
+    // Fills a block no longer than the one prepared for
+    void processChunk(AudioSource& source, const AudioSourceChannelInfo& bufferToFill, double tempo) noexcept;
+
+    // Chooses, windows and overlap-adds the next frame, producing hopSize samples
+    void produceFrame(AudioSource& source, double tempo) noexcept;
+
+    // Pulls from source until input holds everything before endPosition
+    void ensureInput(AudioSource& source, int64 endPosition) noexcept;
+
+    // Returns the frame start within the search range that best continues the previous frame
+    int64 findBestStart(int64 idealStart, int64 naturalStart) const noexcept;
+
+    // Returns the normalised correlation between the reference and a candidate frame start
+    float correlate(const float* reference, const float* candidate, int step) const noexcept;
+
+    double sampleRate = 44100.0;
+    int maxBlockSize = 0;
+    Quality quality = Quality::medium;
+
+    // Current tier, in samples
+    int frameSize = 0;
+    int hopSize = 0;
+    int searchRadius = 0;
+    int searchStep = 1;
+    int correlationStep = 1;
+    std::vector<float> window;
+
+    // Input history: left, right and a mono mix used for the search
+    AudioBuffer<float> input;
+    AudioBuffer<float> pullBuffer;
+    int64 inputStart = 0;
+    int inputLength = 0;
+    int64 keepFrom = 0;
+    static constexpr int pullSize = 256;
+
+    // Frame positions in the input, in samples since the last reset
+    double analysisPosition = 0.0;
+    int64 previousFrameStart = -1;
+
+    // Overlap-add accumulator and finished samples waiting to be played
+    AudioBuffer<float> overlap;
+    AudioBuffer<float> output;
+    int outputRead = 0;
+    int outputEnd = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimeStretcher)
+};
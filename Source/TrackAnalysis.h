@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "BeatGrid.h"
+
+// TrackAnalysis holds everything TrackAnalyzer finds out about a track: its length, beat
+// grid, loudness and musical key. A default-constructed analysis knows nothing
+struct TrackAnalysis
+{
+    // Tempo and beat positions
+    BeatGrid beatGrid;
+
+    // Length of the track in seconds, 0 if unknown
+    double lengthSeconds = 0.0;
+
+    // Integrated loudness in LUFS (ITU-R BS.1770 with gating), or silenceLufs if silent
+    float loudnessLufs = silenceLufs;
+
+    // Highest sample magnitude, 0 to 1 for unclipped audio
+    float peak = 0.0f;
+
+    // Key index: 0 to 11 for C major to B major, 12 to 23 for C minor to B minor,
+    // or -1 if no key was found
+    int key = -1;
+
+    // How well the track's pitch content fits the key, from 0 (not at all) to 1
+    float keyConfidence = 0.0f;
+
+    // Loudness reported for silence
+    static constexpr float silenceLufs = -70.0f;
+
+    // Returns true if a key was found
+    bool hasKey() const noexcept { return key >= 0 && key < 24; }
+
+    // Returns the key as a name such as "C#" or "Am", or an empty string if unknown
+    static String getKeyName(int key)
+    {
+        static const char* const names[] = { "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+        if (key < 0 || key >= 24)
+            return {};
+
+        return String(names[key % 12]) + (key >= 12 ? "m" : "");
+    }
+};
@@ -0,0 +1,690 @@
+#include "TrackAnalyzer.h"
+#include <vector>
+
+namespace
+{
+    // Analysis runs on a mono mix decimated to about this rate
+    constexpr double targetAnalysisRate = 22050.0;
+
+    // Spectral frame and hop, in decimated samples
+    constexpr int fftOrder = 10;
+    constexpr int frameSize = 1 << fftOrder;
+    constexpr int hopSize = 256;
+
+    // Bins below this frequency make up the low (kick drum) band
+    constexpr double lowBandHz = 150.0;
+
+    // Tempo search range and prior
+    constexpr double minBpm = 60.0;
+    constexpr double maxBpm = 200.0;
+    constexpr double preferredBpm = 120.0;
+
+    // Key detection uses longer frames than onset detection, to resolve semitones in the
+    // bass, and only looks at the range where most harmonic content lies
+    constexpr int chromaFftOrder = 12;
+    constexpr int chromaFrameSize = 1 << chromaFftOrder;
+    constexpr double minChromaHz = 100.0;
+    constexpr double maxChromaHz = 5000.0;
+
+    // Turns audio into an onset strength envelope, one value per hop: the spectral flux
+    // of the log-compressed magnitude spectrum, for the whole band and for the low band
+    class OnsetDetector
+    {
+    public:
+        explicit OnsetDetector(double analysisRate)
+            : fft(fftOrder),
+            window(static_cast<size_t>(frameSize)),
+            fftData(static_cast<size_t>(2 * frameSize)),
+            previous(static_cast<size_t>(frameSize / 2 + 1), 0.0f),
+            lowBins(jlimit(1, frameSize / 2, roundToInt(lowBandHz * frameSize / analysisRate)))
+        {
+            for (int i = 0; i < frameSize; ++i)
+                window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(frameSize));
+        }
+
+        // Adds decimated mono samples, analysing every complete frame
+        void push(const float* samples, int numSamples)
+        {
+            pendingSamples.insert(pendingSamples.end(), samples, samples + numSamples);
+
+            size_t start = 0;
+            while (pendingSamples.size() - start >= static_cast<size_t>(frameSize))
+            {
+                analyseFrame(pendingSamples.data() + start);
+                start += static_cast<size_t>(hopSize);
+            }
+
+            pendingSamples.erase(pendingSamples.begin(), pendingSamples.begin() + static_cast<std::ptrdiff_t>(start));
+        }
+
+        std::vector<float> flux;
+        std::vector<float> lowFlux;
+
+    private:
+        void analyseFrame(const float* frame)
+        {
+            std::fill(fftData.begin(), fftData.end(), 0.0f);
+            for (int i = 0; i < frameSize; ++i)
+                fftData[static_cast<size_t>(i)] = frame[i] * window[static_cast<size_t>(i)];
+
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            // Only rises in level count as onsets
+            float total = 0.0f;
+            float low = 0.0f;
+            for (int bin = 0; bin <= frameSize / 2; ++bin)
+            {
+                const float magnitude = std::log1p(100.0f * fftData[static_cast<size_t>(bin)]);
+                const float rise = jmax(0.0f, magnitude - previous[static_cast<size_t>(bin)]);
+                previous[static_cast<size_t>(bin)] = magnitude;
+
+                total += rise;
+                if (bin < lowBins)
+                    low += rise;
+            }
+
+            flux.push_back(total);
+            lowFlux.push_back(low);
+        }
+
+        dsp::FFT fft;
+        std::vector<float> window;
+        std::vector<float> fftData;
+        std::vector<float> previous;
+        std::vector<float> pendingSamples;
+        const int lowBins;
+    };
+
+    // Second-order IIR filter in transposed direct form II
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0, z2 = 0.0;
+
+        double process(double x) noexcept
+        {
+            const double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    // Measures integrated loudness as in ITU-R BS.1770: K-weighting, mean square over 400 ms
+    // blocks every 100 ms, then an absolute gate at -70 LUFS and a relative gate 10 LU below
+    // the blocks that pass it. Runs on the decimated channels, which is close enough for
+    // matching levels between tracks
+    class LoudnessMeter
+    {
+    public:
+        explicit LoudnessMeter(double sampleRate)
+            : stepLength(jmax(1, roundToInt(0.1 * sampleRate)))
+        {
+            // Stage 1: high shelf of about +4 dB above 1.5 kHz
+            const double pi = MathConstants<double>::pi;
+            double k = std::tan(pi * 1681.974450955533 / sampleRate);
+            double q = 0.7071752369554196;
+            const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+            const double vb = std::pow(vh, 0.4996667741545416);
+            double a0 = 1.0 + k / q + k * k;
+            const Biquad shelf { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0,
+                (vh - vb * k / q + k * k) / a0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+            // Stage 2: high pass at 38 Hz
+            k = std::tan(pi * 38.13547087602444 / sampleRate);
+            q = 0.5003270373238773;
+            a0 = 1.0 + k / q + k * k;
+            const Biquad highPass { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                shelves[ch] = shelf;
+                highPasses[ch] = highPass;
+            }
+        }
+
+        // Adds samples of both channels
+        void push(const float* left, const float* right, int numSamples)
+        {
+            const float* channels[] = { left, right };
+            for (int i = 0; i < numSamples; ++i)
+            {
+                for (int ch = 0; ch < 2; ++ch)
+                {
+                    const double weighted = highPasses[ch].process(shelves[ch].process(channels[ch][i]));
+                    stepSum += weighted * weighted;
+                }
+
+                if (++stepCount == stepLength)
+                {
+                    steps.push_back(stepSum / stepLength);
+                    stepSum = 0.0;
+                    stepCount = 0;
+                }
+            }
+        }
+
+        // Returns the gated loudness of everything pushed, in LUFS
+        float getIntegratedLoudness() const
+        {
+            // Mean square of each 400 ms block, made of four 100 ms steps
+            std::vector<double> blocks;
+            for (size_t i = 3; i < steps.size(); ++i)
+                blocks.push_back(0.25 * (steps[i - 3] + steps[i - 2] + steps[i - 1] + steps[i]));
+
+            auto toLufs = [](double power) { return -0.691 + 10.0 * std::log10(power); };
+            auto gatedMean = [&blocks, &toLufs](double gateLufs)
+            {
+                double sum = 0.0;
+                int count = 0;
+                for (const auto power : blocks)
+                {
+                    if (power > 0.0 && toLufs(power) > gateLufs)
+                    {
+                        sum += power;
+                        ++count;
+                    }
+                }
+
+                return count > 0 ? sum / count : 0.0;
+            };
+
+            const double absoluteGated = gatedMean(TrackAnalysis::silenceLufs);
+            if (absoluteGated <= 0.0)
+                return TrackAnalysis::silenceLufs;
+
+            const double relativeGated = gatedMean(toLufs(absoluteGated) - 10.0);
+            return relativeGated > 0.0 ? jmax(TrackAnalysis::silenceLufs, static_cast<float>(toLufs(relativeGated)))
+                                       : TrackAnalysis::silenceLufs;
+        }
+
+    private:
+        Biquad shelves[2];
+        Biquad highPasses[2];
+        const int stepLength;
+        double stepSum = 0.0;
+        int stepCount = 0;
+        std::vector<double> steps;
+    };
+
+    // Finds the key by summing the spectrum into the twelve pitch classes over the whole
+    // track and correlating that profile with the Krumhansl-Kessler key profiles
+    class KeyDetector
+    {
+    public:
+        explicit KeyDetector(double analysisRate)
+            : fft(chromaFftOrder),
+            window(static_cast<size_t>(chromaFrameSize)),
+            fftData(static_cast<size_t>(2 * chromaFrameSize)),
+            pitchClasses(static_cast<size_t>(chromaFrameSize / 2), -1)
+        {
+            for (int i = 0; i < chromaFrameSize; ++i)
+                window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(chromaFrameSize));
+
+            // Pitch class of the note nearest to each bin, with C as 0
+            for (int bin = 1; bin < chromaFrameSize / 2; ++bin)
+            {
+                const double hz = bin * analysisRate / chromaFrameSize;
+                if (hz >= minChromaHz && hz <= maxChromaHz)
+                {
+                    const int note = roundToInt(12.0 * std::log2(hz / 440.0)) + 69;
+                    pitchClasses[static_cast<size_t>(bin)] = note % 12;
+                }
+            }
+        }
+
+        // Adds decimated mono samples, analysing every complete frame
+        void push(const float* samples, int numSamples)
+        {
+            pendingSamples.insert(pendingSamples.end(), samples, samples + numSamples);
+
+            size_t start = 0;
+            while (pendingSamples.size() - start >= static_cast<size_t>(chromaFrameSize))
+            {
+                analyseFrame(pendingSamples.data() + start);
+                start += static_cast<size_t>(chromaFrameSize);
+            }
+
+            pendingSamples.erase(pendingSamples.begin(), pendingSamples.begin() + static_cast<std::ptrdiff_t>(start));
+        }
+
+        // Returns the best matching key (see TrackAnalysis::key) and how well it fits
+        int findKey(float& confidence) const
+        {
+            static const double profiles[2][12] =
+            {
+                { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 },
+                { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 }
+            };
+
+            confidence = 0.0f;
+            double total = 0.0;
+            for (const auto energy : chroma)
+                total += energy;
+
+            if (total <= 1.0e-6)
+                return -1;
+
+            // Pearson correlation with each profile rotated to each tonic
+            auto correlate = [](const double* a, const double* b)
+            {
+                double meanA = 0.0, meanB = 0.0;
+                for (int i = 0; i < 12; ++i)
+                {
+                    meanA += a[i] / 12.0;
+                    meanB += b[i] / 12.0;
+                }
+
+                double ab = 0.0, aa = 0.0, bb = 0.0;
+                for (int i = 0; i < 12; ++i)
+                {
+                    ab += (a[i] - meanA) * (b[i] - meanB);
+                    aa += (a[i] - meanA) * (a[i] - meanA);
+                    bb += (b[i] - meanB) * (b[i] - meanB);
+                }
+
+                return aa > 0.0 && bb > 0.0 ? ab / std::sqrt(aa * bb) : 0.0;
+            };
+
+            int bestKey = -1;
+            double bestCorrelation = -2.0;
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                for (int tonic = 0; tonic < 12; ++tonic)
+                {
+                    double rotated[12];
+                    for (int i = 0; i < 12; ++i)
+                        rotated[i] = chroma[static_cast<size_t>((i + tonic) % 12)];
+
+                    const double r = correlate(rotated, profiles[mode]);
+                    if (r > bestCorrelation)
+                    {
+                        bestCorrelation = r;
+                        bestKey = mode * 12 + tonic;
+                    }
+                }
+            }
+
+            confidence = jlimit(0.0f, 1.0f, static_cast<float>(bestCorrelation));
+            return bestKey;
+        }
+
+    private:
+        void analyseFrame(const float* frame)
+        {
+            std::fill(fftData.begin(), fftData.end(), 0.0f);
+            for (int i = 0; i < chromaFrameSize; ++i)
+                fftData[static_cast<size_t>(i)] = frame[i] * window[static_cast<size_t>(i)];
+
+            fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+            for (size_t bin = 0; bin < pitchClasses.size(); ++bin)
+                if (pitchClasses[bin] >= 0)
+                    chroma[static_cast<size_t>(pitchClasses[bin])] += fftData[bin];
+        }
+
+        dsp::FFT fft;
+        std::vector<float> window;
+        std::vector<float> fftData;
+        std::vector<int> pitchClasses;
+        std::vector<float> pendingSamples;
+        double chroma[12] = {};
+    };
+
+    // Removes the slowly varying part of an envelope and keeps what sticks out above it
+    void normaliseEnvelope(std::vector<float>& envelope, int radius)
+    {
+        const int n = static_cast<int>(envelope.size());
+        std::vector<double> prefix(static_cast<size_t>(n) + 1, 0.0);
+        for (int i = 0; i < n; ++i)
+            prefix[static_cast<size_t>(i) + 1] = prefix[static_cast<size_t>(i)] + envelope[static_cast<size_t>(i)];
+
+        std::vector<float> result(envelope.size());
+        for (int i = 0; i < n; ++i)
+        {
+            const int from = jmax(0, i - radius);
+            const int to = jmin(n, i + radius + 1);
+            const auto mean = (prefix[static_cast<size_t>(to)] - prefix[static_cast<size_t>(from)]) / (to - from);
+            result[static_cast<size_t>(i)] = jmax(0.0f, envelope[static_cast<size_t>(i)] - static_cast<float>(mean));
+        }
+
+        envelope.swap(result);
+    }
+
+    // Linearly interpolated envelope value at a fractional frame
+    inline float sampleEnvelope(const std::vector<float>& envelope, double frame) noexcept
+    {
+        const auto index = static_cast<size_t>(frame);
+        if (index + 1 >= envelope.size())
+            return 0.0f;
+
+        const auto fraction = static_cast<float>(frame - static_cast<double>(index));
+        return envelope[index] + fraction * (envelope[index + 1] - envelope[index]);
+    }
+
+    // Sums the envelope along a grid of the given period starting at phase
+    float combScore(const std::vector<float>& envelope, double period, double phase) noexcept
+    {
+        float sum = 0.0f;
+        for (double frame = phase; frame + 1.0 < static_cast<double>(envelope.size()); frame += period)
+            sum += sampleEnvelope(envelope, frame);
+
+        return sum;
+    }
+}
+
+// Decodes one track and analyses it, unless the store already holds its contents
+class TrackAnalyzer::AnalysisJob : public ThreadPoolJob
+{
+public:
+    AnalysisJob(TrackAnalyzer& owner, const File& fileToAnalyse)
+        : ThreadPoolJob("Track analysis"),
+        analyzer(&owner),
+        formatManager(owner.formatManager),
+        store(owner.store),
+        file(fileToAnalyse)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        // The loudness filters decay towards zero in quiet passages
+        const ScopedNoDenormals noDenormals;
+
+        // A moved or copied file is found by its contents and only needs its path stored
+        TrackAnalysis analysis;
+        const auto key = AnalysisStore::computeKey(file);
+        bool found = key != 0 && store.findAnalysis(key, analysis);
+
+        if (!found)
+        {
+            std::unique_ptr<AudioFormatReader> reader(formatManager.createReaderFor(file));
+            if (reader != nullptr)
+            {
+                analysis = TrackAnalyzer::analyseReader(*reader, [this] { return shouldExit(); });
+                found = true;
+            }
+        }
+
+        if (shouldExit())
+            return jobHasFinished;
+
+        if (found)
+            store.storeAnalysis(file, key, analysis);
+
+        // An MP3 also gets the frame index decks seek with, so loading it never has to
+        Mp3FrameIndex::findOrBuild(formatManager, file, key, store);
+
+        auto weakAnalyzer = analyzer;
+        auto analysedFile = file;
+        MessageManager::callAsync([weakAnalyzer, analysedFile, analysis]()
+            {
+                if (auto* owner = weakAnalyzer.get())
+                    owner->jobFinished(analysedFile, analysis);
+            });
+
+        return jobHasFinished;
+    }
+
+private:
+    WeakReference<TrackAnalyzer> analyzer;
+    AudioFormatManager& formatManager;
+    AnalysisStore& store;
+    File file;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisJob)
+};
+
+TrackAnalyzer::TrackAnalyzer(AudioFormatManager& formatManagerToUse, AnalysisStore& storeToUse)
+    : formatManager(formatManagerToUse),
+    store(storeToUse),
+    pool(jmax(1, SystemStats::getNumCpus()), 0, Thread::Priority::low)
+{
+}
+
+TrackAnalyzer::~TrackAnalyzer()
+{
+    pool.removeAllJobs(true, 5000);
+}
+
+void TrackAnalyzer::analyse(const File& file)
+{
+    const auto key = file.getFullPathName();
+    if (!file.existsAsFile() || results.count(key) > 0 || pending.count(key) > 0)
+        return;
+
+    // A known file costs two stat calls and a lookup in the store's map
+    TrackAnalysis stored;
+    if (store.findAnalysis(file, stored))
+    {
+        jobFinished(file, stored);
+        return;
+    }
+
+    pending.insert(key);
+    pool.addJob(new AnalysisJob(*this, file), true);
+}
+
+void TrackAnalyzer::forget(const File& file)
+{
+    results.erase(file.getFullPathName());
+}
+
+bool TrackAnalyzer::getAnalysis(const File& file, TrackAnalysis& result) const
+{
+    const auto found = results.find(file.getFullPathName());
+    if (found == results.end())
+        return false;
+
+    result = found->second;
+    return true;
+}
+
+bool TrackAnalyzer::getBeatGrid(const File& file, BeatGrid& result) const
+{
+    const auto found = results.find(file.getFullPathName());
+    if (found == results.end())
+        return false;
+
+    result = found->second.beatGrid;
+    return true;
+}
+
+void TrackAnalyzer::addListener(Listener* listener)
+{
+    listeners.add(listener);
+}
+
+void TrackAnalyzer::removeListener(Listener* listener)
+{
+    listeners.remove(listener);
+}
+
+void TrackAnalyzer::jobFinished(const File& file, const TrackAnalysis& analysis)
+{
+    const auto key = file.getFullPathName();
+    pending.erase(key);
+    results[key] = analysis;
+
+    listeners.call([&file, &analysis](Listener& l) { l.trackAnalysed(file, analysis); });
+}
+
+TrackAnalysis TrackAnalyzer::analyseReader(AudioFormatReader& reader, const std::function<bool()>& shouldExit)
+{
+    auto stopRequested = [&shouldExit] { return shouldExit != nullptr && shouldExit(); };
+
+    if (reader.sampleRate <= 0.0 || reader.lengthInSamples <= 0)
+        return {};
+
+    // Mix to mono and average down to roughly the analysis rate
+    const int decimation = jmax(1, roundToInt(reader.sampleRate / targetAnalysisRate));
+    const double analysisRate = reader.sampleRate / decimation;
+    const int chunkSize = 65536 - 65536 % decimation;
+
+    OnsetDetector detector(analysisRate);
+    KeyDetector keyDetector(analysisRate);
+    LoudnessMeter loudnessMeter(analysisRate);
+    float peak = 0.0f;
+
+    AudioBuffer<float> chunk(2, chunkSize);
+    const auto decimatedSize = static_cast<size_t>(chunkSize / decimation);
+    std::vector<float> decimatedLeft(decimatedSize), decimatedRight(decimatedSize), mono(decimatedSize);
+
+    for (int64 pos = 0; pos < reader.lengthInSamples; pos += chunkSize)
+    {
+        if (stopRequested())
+            return {};
+
+        const int num = static_cast<int>(jmin(static_cast<int64>(chunkSize), reader.lengthInSamples - pos));
+        reader.read(&chunk, 0, num, pos, true, true);
+        peak = jmax(peak, chunk.getMagnitude(0, num));
+
+        const float* left = chunk.getReadPointer(0);
+        const float* right = chunk.getReadPointer(1);
+        const int numOut = num / decimation;
+        const float scale = 1.0f / static_cast<float>(decimation);
+
+        for (int i = 0; i < numOut; ++i)
+        {
+            float sumLeft = 0.0f, sumRight = 0.0f;
+            for (int k = i * decimation; k < (i + 1) * decimation; ++k)
+            {
+                sumLeft += left[k];
+                sumRight += right[k];
+            }
+
+            decimatedLeft[static_cast<size_t>(i)] = sumLeft * scale;
+            decimatedRight[static_cast<size_t>(i)] = sumRight * scale;
+            mono[static_cast<size_t>(i)] = 0.5f * (sumLeft + sumRight) * scale;
+        }
+
+        detector.push(mono.data(), numOut);
+        keyDetector.push(mono.data(), numOut);
+        loudnessMeter.push(decimatedLeft.data(), decimatedRight.data(), numOut);
+    }
+
+    TrackAnalysis analysis;
+    analysis.lengthSeconds = static_cast<double>(reader.lengthInSamples) / reader.sampleRate;
+    analysis.peak = peak;
+    analysis.loudnessLufs = loudnessMeter.getIntegratedLoudness();
+    analysis.key = keyDetector.findKey(analysis.keyConfidence);
+
+    auto& envelope = detector.flux;
+    auto& lowEnvelope = detector.lowFlux;
+    const double frameRate = analysisRate / hopSize;
+    const int numFrames = static_cast<int>(envelope.size());
+
+    const int minLag = static_cast<int>(std::floor(60.0 * frameRate / maxBpm));
+    const int maxLag = static_cast<int>(std::ceil(60.0 * frameRate / minBpm));
+    if (numFrames < 4 * maxLag)
+        return analysis;
+
+    normaliseEnvelope(envelope, roundToInt(0.25 * frameRate));
+    normaliseEnvelope(lowEnvelope, roundToInt(0.25 * frameRate));
+
+    // Kick drums carry the beat in most dance music, so the low band gets equal say
+    // with the full band once both are scaled to the same average
+    const auto mean = [](const std::vector<float>& v)
+    {
+        double sum = 0.0;
+        for (auto x : v)
+            sum += x;
+        return static_cast<float>(sum / jmax(static_cast<size_t>(1), v.size())) + 1.0e-9f;
+    };
+
+    const float fullScale = 1.0f / mean(envelope);
+    const float lowScale = 1.0f / mean(lowEnvelope);
+    for (size_t i = 0; i < envelope.size(); ++i)
+        envelope[i] = envelope[i] * fullScale + lowEnvelope[i] * lowScale;
+
+    // Coarse tempo: autocorrelation of the envelope, weighted towards common tempos
+    std::vector<double> scores(static_cast<size_t>(maxLag + 2), 0.0);
+    for (int lag = minLag; lag <= maxLag + 1; ++lag)
+    {
+        double sum = 0.0;
+        for (int i = 0; i + lag < numFrames; ++i)
+            sum += envelope[static_cast<size_t>(i)] * envelope[static_cast<size_t>(i + lag)];
+
+        const double bpm = 60.0 * frameRate / lag;
+        const double octaves = std::log2(bpm / preferredBpm) / 0.8;
+        scores[static_cast<size_t>(lag)] = sum / (numFrames - lag) * std::exp(-0.5 * octaves * octaves);
+    }
+
+    int bestLag = minLag;
+    for (int lag = minLag; lag <= maxLag; ++lag)
+        if (scores[static_cast<size_t>(lag)] > scores[static_cast<size_t>(bestLag)])
+            bestLag = lag;
+
+    if (scores[static_cast<size_t>(bestLag)] <= 0.0)
+        return analysis;
+
+    if (stopRequested())
+        return {};
+
+    // Parabolic fit around the peak for a fractional lag
+    double coarsePeriod = bestLag;
+    if (bestLag > minLag)
+    {
+        const double a = scores[static_cast<size_t>(bestLag - 1)];
+        const double b = scores[static_cast<size_t>(bestLag)];
+        const double c = scores[static_cast<size_t>(bestLag + 1)];
+        const double denominator = a - 2.0 * b + c;
+        if (denominator < 0.0)
+            coarsePeriod += jlimit(-0.5, 0.5, 0.5 * (a - c) / denominator);
+    }
+
+    // Fine tempo and phase: the grid that lines up with the most onset energy over the track
+    double bestPeriod = coarsePeriod;
+    double bestPhase = 0.0;
+    float bestScore = -1.0f;
+    double scoreSum = 0.0;
+    int scoreCount = 0;
+
+    for (double period = coarsePeriod * 0.98; period <= coarsePeriod * 1.02; period += coarsePeriod * 0.0005)
+    {
+        if (stopRequested())
+            return {};
+
+        for (double phase = 0.0; phase < period; phase += 0.5)
+        {
+            const float score = combScore(envelope, period, phase) * static_cast<float>(period);
+            scoreSum += score;
+            ++scoreCount;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestPeriod = period;
+                bestPhase = phase;
+            }
+        }
+    }
+
+    // Downbeats: the beat of the bar with the most low-frequency (kick drum) onsets
+    int downbeatOffset = 0;
+    float bestLowScore = -1.0f;
+    for (int offset = 0; offset < 4; ++offset)
+    {
+        const float score = combScore(lowEnvelope, bestPeriod * 4.0, bestPhase + offset * bestPeriod);
+        if (score > bestLowScore)
+        {
+            bestLowScore = score;
+            downbeatOffset = offset;
+        }
+    }
+
+    // Frame times refer to the centre of each analysis window
+    auto frameToSeconds = [analysisRate](double frame) { return (frame * hopSize + frameSize / 2) / analysisRate; };
+
+    auto& grid = analysis.beatGrid;
+    grid.bpm = 60.0 * frameRate / bestPeriod;
+
+    const double beatLength = grid.getBeatLength();
+    grid.firstBeatSeconds = std::fmod(frameToSeconds(bestPhase), beatLength);
+    grid.firstDownbeatSeconds = std::fmod(frameToSeconds(bestPhase + downbeatOffset * bestPeriod), 4.0 * beatLength);
+
+    const double meanScore = scoreCount > 0 ? scoreSum / scoreCount : 0.0;
+    grid.confidence = bestScore > 0.0f ? jlimit(0.0f, 1.0f, static_cast<float>(1.0 - meanScore / bestScore)) : 0.0f;
+
+    return analysis;
+}
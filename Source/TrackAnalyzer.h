@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AnalysisStore.h"
+#include "TrackAnalysis.h"
+#include <functional>
+#include <map>
+#include <set>
+
+// TrackAnalyzer finds the tempo, beat grid, loudness and key of tracks on a pool of
+// low-priority worker threads, one per core, so importing many tracks at once keeps every
+// core busy without holding up the message or audio threads. Tracks are queued from the
+// message thread and each result is announced on the message thread as soon as that track
+// is done. Results are kept in the AnalysisStore, so each version of a file is only ever
+// analysed once
+class TrackAnalyzer
+{
+public:
+    // Receives results on the message thread
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+
+        // Called when a track has been analysed; the grid is invalid if no beat was found
+        virtual void trackAnalysed(const File& file, const TrackAnalysis& analysis) = 0;
+    };
+
+    // Constructs TrackAnalyzer using AudioFormatManager, keeping results in the store
+    TrackAnalyzer(AudioFormatManager& formatManager, AnalysisStore& store);
+
+    // Destructor. Abandons queued tracks and waits for running ones to stop
+    ~TrackAnalyzer();
+
+    // Queues a file for analysis unless it is already analysed or queued. A file the store
+    // already holds is announced before this returns. Message thread only
+    void analyse(const File& file);
+
+    // Forgets the result for a file that has changed on disk, so the next analyse() call
+    // looks at it afresh. Message thread only
+    void forget(const File& file);
+
+    // Copies the analysis of a file into result and returns true if it has been analysed
+    bool getAnalysis(const File& file, TrackAnalysis& result) const;
+
+    // Copies the grid for a file into result and returns true if it has been analysed
+    bool getBeatGrid(const File& file, BeatGrid& result) const;
+
+    // Returns the number of tracks queued or being analysed
+    int getNumPending() const noexcept { return static_cast<int>(pending.size()); }
+
+    // Registers a listener for results
+    void addListener(Listener* listener);
+
+    // Unregisters a listener
+    void removeListener(Listener* listener);
+
+    // Analyses a whole reader. Polls shouldExit, if given, and returns an empty analysis
+    // when it says to stop. Safe on any thread
+    static TrackAnalysis analyseReader(AudioFormatReader& reader,
+        const std::function<bool()>& shouldExit = nullptr);
+
+private:
+    class AnalysisJob;
+
+    // Keeps a finished result and tells the listeners. Message thread only
+    void jobFinished(const File& file, const TrackAnalysis& analysis);
+
+    AudioFormatManager& formatManager;
+    AnalysisStore& store;
+    ThreadPool pool;
+
+    // Results and queued files by full path. Message thread only
+    std::map<String, TrackAnalysis> results;
+    std::set<String> pending;
+
+    ListenerList<Listener> listeners;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(TrackAnalyzer)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackAnalyzer)
+};
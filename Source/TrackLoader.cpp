@@ -0,0 +1,175 @@
+#include "TrackLoader.h"
+
+// State shared by the jobs run for one load request
+class TrackLoader::Job : public ThreadPoolJob
+{
+public:
+    Job(const String& name, TrackLoader& owner, DJAudioPlayer& targetPlayer, const URL& trackURL,
+        const DeckTrack::LoadSettings& loadSettings,
+        std::shared_ptr<std::atomic<int>> latestRequest, int request)
+        : ThreadPoolJob(name),
+        loader(&owner),
+        formatManager(owner.formatManager),
+        player(targetPlayer),
+        url(trackURL),
+        settings(loadSettings),
+        latest(std::move(latestRequest)),
+        requestNumber(request)
+    {
+    }
+
+protected:
+    // True once the loader is shutting down or a newer request has arrived for the player
+    bool isSuperseded() const
+    {
+        return shouldExit() || latest->load() != requestNumber;
+    }
+
+    // Runs fn on the message thread, unless the loader has gone or the request was superseded
+    void postIfCurrent(std::function<void()> fn) const
+    {
+        auto weakLoader = loader;
+        auto latestRequest = latest;
+        auto request = requestNumber;
+
+        MessageManager::callAsync([weakLoader, latestRequest, request, fn]()
+            {
+                if (weakLoader != nullptr && latestRequest->load() == request)
+                    fn();
+            });
+    }
+
+    WeakReference<TrackLoader> loader;
+    AudioFormatManager& formatManager;
+    DJAudioPlayer& player;
+    URL url;
+    DeckTrack::LoadSettings settings;
+    std::shared_ptr<std::atomic<int>> latest;
+    int requestNumber;
+};
+
+// Decodes a streamed track into the cache and swaps the deck over to it in place
+class TrackLoader::CacheJob : public Job
+{
+public:
+    CacheJob(TrackLoader& owner, DJAudioPlayer& targetPlayer, const URL& trackURL,
+        const DeckTrack::LoadSettings& loadSettings,
+        std::shared_ptr<std::atomic<int>> latestRequest, int request)
+        : Job("Track cache", owner, targetPlayer, trackURL, loadSettings, std::move(latestRequest), request)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        if (isSuperseded())
+            return jobHasFinished;
+
+        auto entry = settings.cache->decode(formatManager, url.getLocalFile(),
+            [this](float) { return !isSuperseded(); });
+
+        if (entry == nullptr || isSuperseded())
+            return jobHasFinished;
+
+        auto track = DeckTrack::fromCache(url, entry, settings);
+        track->setContinuesPlayback(true);
+
+        auto* targetPlayer = &player;
+        postIfCurrent([targetPlayer, track]() { targetPlayer->setTrack(track); });
+
+        return jobHasFinished;
+    }
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CacheJob)
+};
+
+// Opens and primes a track, then hands it to the player
+class TrackLoader::LoadJob : public Job
+{
+public:
+    LoadJob(TrackLoader& owner, DJAudioPlayer& targetPlayer, const URL& trackURL,
+        std::shared_ptr<std::atomic<int>> latestRequest, int request,
+        ProgressCallback progressCallback, FinishedCallback finishedCallback)
+        : Job("Track load", owner, targetPlayer, trackURL, targetPlayer.getLoadSettings(),
+            std::move(latestRequest), request),
+        onProgress(std::move(progressCallback)),
+        onFinished(std::move(finishedCallback))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        if (isSuperseded())
+            return jobHasFinished;
+
+        auto track = DeckTrack::open(formatManager, url, settings,
+            [this](float progress)
+            {
+                if (isSuperseded())
+                    return false;
+
+                if (onProgress != nullptr)
+                {
+                    auto callback = onProgress;
+                    postIfCurrent([callback, progress]() { callback(progress); });
+                }
+                return true;
+            });
+
+        if (isSuperseded())
+            return jobHasFinished;
+
+        // Hand the track over on the message thread, unless a newer load has replaced it
+        auto* targetPlayer = &player;
+        auto finished = onFinished;
+
+        postIfCurrent([targetPlayer, finished, track]()
+            {
+                if (track != nullptr)
+                    targetPlayer->setTrack(track);
+
+                if (finished != nullptr)
+                    finished(track);
+            });
+
+        // A streamed track is decoded into the cache next, then swapped for the RAM copy.
+        // Memory-mapped files are already served from the page cache
+        if (track != nullptr && !track->isCached() && !track->isMemoryMapped()
+            && settings.cache != nullptr && url.isLocalFile())
+            if (auto* owner = loader.get())
+                owner->cachePool.addJob(new CacheJob(*owner, player, url, settings, latest, requestNumber), true);
+
+        return jobHasFinished;
+    }
+
+private:
+    ProgressCallback onProgress;
+    FinishedCallback onFinished;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoadJob)
+};
+
+TrackLoader::TrackLoader(AudioFormatManager& formatManagerToUse)
+    : formatManager(formatManagerToUse)
+{
+}
+
+TrackLoader::~TrackLoader()
+{
+    pool.removeAllJobs(true, 5000);
+    cachePool.removeAllJobs(true, 5000);
+}
+
+void TrackLoader::loadTrack(DJAudioPlayer& player, const URL& url,
+    ProgressCallback onProgress, FinishedCallback onFinished)
+{
+    auto& latest = latestRequests[&player];
+    if (latest == nullptr)
+        latest = std::make_shared<std::atomic<int>>(0);
+
+    // Bumping the request number cancels any load still running for this player
+    const int request = ++(*latest);
+
+    pool.addJob(new LoadJob(*this, player, url, latest, request,
+        std::move(onProgress), std::move(onFinished)), true);
+}
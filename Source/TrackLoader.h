@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "DeckTrack.h"
+#include "DJAudioPlayer.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+// TrackLoader opens, probes and primes tracks on a background thread shared by all decks.
+// When a track is ready it is handed to the player's audio thread without locking.
+// Progress and completion are reported on the message thread. If the deck has a decoded
+// track cache, a streamed track is then decoded on a second thread and the deck switches
+// to the RAM copy without interrupting playback
+class TrackLoader
+{
+public:
+    // Called with load progress (0 to 1)
+    using ProgressCallback = std::function<void(float)>;
+
+    // Called with the loaded track, or nullptr if it could not be opened
+    using FinishedCallback = std::function<void(DeckTrack::Ptr)>;
+
+    // Constructs TrackLoader using AudioFormatManager
+    explicit TrackLoader(AudioFormatManager& formatManager);
+
+    // Destructor. Waits for any running load to finish
+    ~TrackLoader();
+
+    // Loads the URL for the player in the background. A newer request for the same
+    // player supersedes an older one, whose callbacks are then never called
+    void loadTrack(DJAudioPlayer& player, const URL& url,
+        ProgressCallback onProgress, FinishedCallback onFinished);
+
+private:
+    class Job;
+    class LoadJob;
+    class CacheJob;
+
+    AudioFormatManager& formatManager;
+    ThreadPool pool{ 1 };
+    ThreadPool cachePool{ 1 };
+
+    // Latest request number for each player. Message thread only
+    std::map<const DJAudioPlayer*, std::shared_ptr<std::atomic<int>>> latestRequests;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(TrackLoader)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TrackLoader)
+};
@@ -0,0 +1,112 @@
+#include "WaveformCache.h"
+
+// Reads a file from start to end into a pyramid, one chunk per time slice
+class WaveformCache::BuildJob : public TimeSliceClient
+{
+public:
+    BuildJob(AnalysisStore& storeToUse, AudioFormatReader* readerToUse, uint64 keyToUse,
+        std::shared_ptr<PeakPyramid> pyramidToBuild)
+        : store(storeToUse),
+        reader(readerToUse),
+        key(keyToUse),
+        pyramid(std::move(pyramidToBuild)),
+        buffer(static_cast<int>(jmax(1u, reader->numChannels)), chunkSize)
+    {
+    }
+
+    int useTimeSlice() override
+    {
+        // Nobody is looking at this waveform any more
+        if (pyramid.use_count() == 1)
+            return finish();
+
+        const int num = static_cast<int>(jmin(static_cast<int64>(chunkSize), reader->lengthInSamples - position));
+        reader->read(&buffer, 0, num, position, true, true);
+        pyramid->addSamples(buffer, num);
+        position += num;
+
+        if (position < reader->lengthInSamples)
+            return 0;
+
+        pyramid->finishBuild();
+        if (key != 0)
+            store.storeWaveform(key, *pyramid);
+
+        return finish();
+    }
+
+    // Returns true once the job needs no more time slices
+    bool isFinished() const noexcept { return finished.load(); }
+
+private:
+    int finish()
+    {
+        finished = true;
+        reader.reset();
+        return -1;
+    }
+
+    static constexpr int chunkSize = 32768;
+
+    AnalysisStore& store;
+    std::unique_ptr<AudioFormatReader> reader;
+    const uint64 key;
+    std::shared_ptr<PeakPyramid> pyramid;
+    AudioBuffer<float> buffer;
+    int64 position = 0;
+    std::atomic<bool> finished{ false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuildJob)
+};
+
+WaveformCache::WaveformCache(AnalysisStore& storeToUse)
+    : store(storeToUse)
+{
+    thread.startThread(Thread::Priority::low);
+}
+
+WaveformCache::~WaveformCache()
+{
+    for (auto* job : jobs)
+        thread.removeTimeSliceClient(job);
+
+    thread.stopThread(2000);
+}
+
+uint64 WaveformCache::findKeyFor(const File& file)
+{
+    return store.findKey(file);
+}
+
+std::shared_ptr<const PeakPyramid> WaveformCache::load(AudioFormatReader* newReader, uint64 key)
+{
+    std::unique_ptr<AudioFormatReader> reader(newReader);
+    removeFinishedJobs();
+
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+        return nullptr;
+
+    // A known track is a lookup in the store's map
+    auto pyramid = std::make_shared<PeakPyramid>();
+    if (key != 0 && store.findWaveform(key, *pyramid))
+        return pyramid;
+
+    pyramid->startBuild(reader->lengthInSamples, reader->sampleRate);
+
+    auto* job = jobs.add(new BuildJob(store, reader.release(), key, pyramid));
+    thread.addTimeSliceClient(job);
+    return pyramid;
+}
+
+void WaveformCache::removeFinishedJobs()
+{
+    for (int i = jobs.size(); --i >= 0;)
+    {
+        if (jobs[i]->isFinished())
+        {
+            // Waits until the thread has left the job's last time slice
+            thread.removeTimeSliceClient(jobs[i]);
+            jobs.remove(i);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AnalysisStore.h"
+#include "PeakPyramid.h"
+#include <memory>
+
+// WaveformCache hands out the peak pyramids that waveform views draw from. A pyramid the
+// AnalysisStore already holds is returned complete. Any other is returned empty and
+// filled in by a low-priority background thread in one pass over the file, so views can
+// draw it as it grows; once complete it is written to the store for next time
+class WaveformCache
+{
+public:
+    // Constructs WaveformCache, keeping finished pyramids in the store
+    explicit WaveformCache(AnalysisStore& store);
+
+    // Destructor. Abandons any pyramid still being built
+    ~WaveformCache();
+
+    // Returns the key to load a file's waveform with if the store already knows the file,
+    // or 0. Never reads the file, so safe on the message thread
+    uint64 findKeyFor(const File& file);
+
+    // Returns the pyramid for a reader, taking ownership of the reader. Returns nullptr if
+    // the reader is null or empty. A build is abandoned once nothing else holds its
+    // pyramid. Message thread only
+    std::shared_ptr<const PeakPyramid> load(AudioFormatReader* reader, uint64 key);
+
+private:
+    class BuildJob;
+
+    // Deletes jobs that have finished or been abandoned. Message thread only
+    void removeFinishedJobs();
+
+    AnalysisStore& store;
+    TimeSliceThread thread{ "Waveform builder" };
+    OwnedArray<BuildJob> jobs;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformCache)
+};
@@ -3,13 +3,12 @@
 
 //------------------------------------------------------------------------------
 WaveformDisplay::WaveformDisplay(AudioFormatManager& formatManagerToUse,
-    AudioThumbnailCache& cacheToUse)
-    : audioThumb(1000, formatManagerToUse, cacheToUse),
+    WaveformCache& cacheToUse)
+    : formatManager(formatManagerToUse),
+    waveformCache(cacheToUse),
     fileLoaded(false),
     position(0)
 {
-    // Register this component as a listener to the audio thumbnail
-    audioThumb.addChangeListener(this);
 }
 
 //------------------------------------------------------------------------------
@@ -30,15 +29,22 @@ void WaveformDisplay::paint(Graphics& g)
 
     // If audio file is loaded, draw its waveform
     g.setColour(Colours::orange);
-    if (fileLoaded)
+    if (loadProgress >= 0.0f)
     {
-        // Draw the audio thumbnail across the entire component
-        audioThumb.drawChannel(g,
+        // A track is being opened in the background
+        g.setFont(20.0f);
+        g.drawText("Loading... " + String(roundToInt(loadProgress * 100.0f)) + "%",
+            getLocalBounds(), Justification::centred, true);
+    }
+    else if (fileLoaded)
+    {
+        // Draw the whole track across the component, one pyramid lookup per column
+        peaks->draw(g,
             getLocalBounds(),
-            0,
-            audioThumb.getTotalLength(),
-            0,
-            1.0f
+            0.0,
+            static_cast<double>(peaks->getLengthInSamples()) / jmax(1, getWidth()),
+            Colours::orange,
+            Colours::orange.brighter(0.6f)
         );
 
         // Draw a rectangle to indicate the current playhead position
@@ -63,11 +69,9 @@ void WaveformDisplay::resized()
 //------------------------------------------------------------------------------
 void WaveformDisplay::loadURL(URL audioURL)
 {
-    // Clears any previous thumbnail data
-    audioThumb.clear();
-
-    // Sets source for the audio thumbnail using URLInputSource
-    fileLoaded = audioThumb.setSource(new URLInputSource(audioURL));
+    // Opens the file and shows its stored peaks, or builds them in the background
+    const auto file = audioURL.getLocalFile();
+    loadReader(formatManager.createReaderFor(file), waveformCache.findKeyFor(file));
 
     // Logs load status and trigger repaint
     if (fileLoaded)
@@ -82,12 +86,33 @@ void WaveformDisplay::loadURL(URL audioURL)
 }
 
 //------------------------------------------------------------------------------
-void WaveformDisplay::changeListenerCallback(ChangeBroadcaster* source)
+void WaveformDisplay::loadReader(AudioFormatReader* reader, uint64 key)
+{
+    // Clears the loading indicator; the cache owns the reader from here
+    loadProgress = -1.0f;
+    peaks = waveformCache.load(reader, key);
+    fileLoaded = peaks != nullptr;
+
+    // Peaks that are still being built are redrawn as they fill in
+    if (fileLoaded && !peaks->isComplete())
+        startTimer(100);
+
+    repaint();
+}
+
+//------------------------------------------------------------------------------
+void WaveformDisplay::setLoadProgress(float progress)
+{
+    loadProgress = progress;
+    repaint();
+}
+
+//------------------------------------------------------------------------------
+void WaveformDisplay::timerCallback()
 {
-    // Log change event was received
-    std::cout << "wfd: change received!" << std::endl;
+    if (peaks == nullptr || peaks->isComplete())
+        stopTimer();
 
-    // Repaint component to update waveform display
     repaint();
 }
 
@@ -1,16 +1,19 @@
 #pragma once
 
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "PeakPyramid.h"
+#include "WaveformCache.h"
+#include <memory>
 
-// WaveformDisplay renders audio waveform using AudioThumbnail
+// WaveformDisplay renders the whole track's waveform from a PeakPyramid
 // Also allows setting playhead position
 class WaveformDisplay : public Component,
-    public ChangeListener
+    private Timer
 {
 public:
-    // Constructs WaveformDisplay using AudioFormatManager and AudioThumbnailCache
+    // Constructs WaveformDisplay using AudioFormatManager and WaveformCache
     WaveformDisplay(AudioFormatManager& formatManagerToUse,
-        AudioThumbnailCache& cacheToUse);
+        WaveformCache& cacheToUse);
 
     // Destructor
     ~WaveformDisplay();
@@ -20,19 +23,34 @@ public:
 
     void resized() override;
 
-    // Called when change event is received from AudioThumbnail
-    void changeListenerCallback(ChangeBroadcaster* source) override;
-
     // Loads audio file from given URL into the waveform display
     void loadURL(URL audioURL);
 
+    // Shows the waveform of an already opened reader, taking ownership of it. Avoids
+    // reopening the file; the reader is only scanned if the store doesn't know the key
+    void loadReader(AudioFormatReader* reader, uint64 key);
+
+    // Returns the peaks being shown, or nullptr
+    std::shared_ptr<const PeakPyramid> getPeaks() const { return peaks; }
+
+    // Shows load progress (0 to 1) in place of the waveform until the next load completes
+    void setLoadProgress(float progress);
+
     // Sets relative position of the playhead and repaints display.
     void setPositionRelative(double pos);
 
 private:
-    AudioThumbnail audioThumb;
+    // Repaints while the peaks are still being built
+    void timerCallback() override;
+
+    AudioFormatManager& formatManager;
+    WaveformCache& waveformCache;
+    std::shared_ptr<const PeakPyramid> peaks;
     bool fileLoaded;
     double position;
 
+    // Progress of a background load, or negative when none is running
+    float loadProgress = -1.0f;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformDisplay)
 };